@@ -83,6 +83,8 @@ static const char *build_docstring = DOCSTRING_HEADER
     C_LBLUE "    --generate-foreign-info     " C_NORM "Generate information for foreign blocks\n"
     C_LBLUE "    --generate-name-section     " C_NORM "Generate the 'name' custom section for better debugging\n"
     C_LBLUE "    --no-stale-code             " C_NORM "Disables use of " C_YELLOW "#allow_stale_code" C_NORM " directive\n"
+    C_LBLUE "    --no-tree-shaking           " C_NORM "Keep functions and data that can never be used in the output\n"
+    C_LBLUE "    --no-peephole               " C_NORM "Disables peephole optimization of the generated code\n"
     "\n"
     C_LBLUE "    --doc                       " C_NORM "Generate a .odoc file, Onyx's documentation format used by " C_YELLOW "onyx-doc-gen\n"
     C_LBLUE "    --lspinfo " C_GREY "target_file       " C_NORM "Generate an LSP information file\n"
@@ -93,6 +95,7 @@ static const char *build_docstring = DOCSTRING_HEADER
     C_LBLUE "    --show-all-errors           " C_NORM "Print all errors\n"
     C_LBLUE "    --print-function-mappings   " C_NORM "Prints a mapping from WASM function index to source location\n"
     C_LBLUE "    --print-static-if-results   " C_NORM "Prints the conditional result of every " C_YELLOW "#if" C_NORM " statement\n"
+    C_LBLUE "    --trace-out " C_GREY "target_file     " C_NORM "Writes a Chrome trace of the compilation, and prints the slowest entities\n"
     "\n"
     C_LBLUE "    --no-file-contents          " C_NORM "Disables " C_YELLOW "#file_contents" C_NORM " for security\n"
     C_LBLUE "    --no-compiler-extensions    " C_NORM "Disables " C_YELLOW "#compiler_extension" C_NORM " for security\n"
@@ -136,12 +139,16 @@ typedef struct CLIArgs {
     b32 debug_session           : 1;
     b32 no_colors               : 1;
     b32 show_all_errors         : 1;
+    b32 print_perf_statistics   : 1;
+    b32 no_program_cache        : 1;
+    b32 no_jit                  : 1;
 
     i32    passthrough_argument_count;
     char** passthrough_argument_data;
 
     const char* target_file;
     const char* symbol_info_file;
+    const char* trace_file;
     const char* help_subcommand;
 
     char *error_format;
@@ -389,6 +396,12 @@ static int32_t cli_parse_compilation_options(CLIArgs *cli_args, onyx_context_t *
         else if (!strcmp(argv[i], "--no-stale-code")) {
             onyx_set_option_int(ctx, ONYX_OPTION_DISABLE_STALE_CODE, 1);
         }
+        else if (!strcmp(argv[i], "--no-tree-shaking")) {
+            onyx_set_option_int(ctx, ONYX_OPTION_DISABLE_TREE_SHAKING, 1);
+        }
+        else if (!strcmp(argv[i], "--no-peephole")) {
+            onyx_set_option_int(ctx, ONYX_OPTION_DISABLE_PEEPHOLE, 1);
+        }
         else if (!strcmp(argv[i], "--show-all-errors")) {
             cli_args->show_all_errors = 1; // :InCli
         }
@@ -465,6 +478,12 @@ static int32_t cli_parse_compilation_options(CLIArgs *cli_args, onyx_context_t *
             cli_args->debug_session = 1;
             cli_args->debug_socket = argv[++i]; // :InCli
         }
+        else if (!strcmp(argv[i], "--no-program-cache")) {
+            cli_args->no_program_cache = 1; // :InCli
+        }
+        else if (!strcmp(argv[i], "--no-jit")) {
+            cli_args->no_jit = 1; // :InCli
+        }
         else if (!strcmp(argv[i], "--debug-info")) {
             onyx_set_option_int(ctx, ONYX_OPTION_GENERATE_DEBUG_INFO, 1);
             onyx_set_option_int(ctx, ONYX_OPTION_GENERATE_STACK_TRACE, 1);
@@ -476,6 +495,11 @@ static int32_t cli_parse_compilation_options(CLIArgs *cli_args, onyx_context_t *
         }
         else if (!strcmp(argv[i], "--perf")) {
             onyx_set_option_int(ctx, ONYX_OPTION_COLLECT_PERF, 1);
+            cli_args->print_perf_statistics = 1;
+        }
+        else if (!strcmp(argv[i], "--trace-out")) {
+            onyx_set_option_int(ctx, ONYX_OPTION_COLLECT_TRACE, 1);
+            cli_args->trace_file = argv[++i];
         }
 #if defined(_BH_LINUX) || defined(_BH_DARWIN)
         // NOTE: Fun output is only enabled for Linux because Windows command line
@@ -552,6 +576,8 @@ static void print_subcommand_help(const char *subcommand) {
         bh_printf(build_docstring, subcommand, "[-- program args]");
         bh_printf(
             C_LBLUE "    --debug-socket " C_GREY "addr         " C_NORM "Specifies the address or port used for the debug server.\n"
+            C_LBLUE "    --no-program-cache          " C_NORM "Do not cache the translated program when running a .wasm file\n"
+            C_LBLUE "    --no-jit                    " C_NORM "Interpret every function, instead of compiling frequently called ones\n"
         );
         return;
     }
@@ -566,6 +592,20 @@ static void print_subcommand_help(const char *subcommand) {
     exit(1);
 }
 
+static char *get_program_cache_dir() {
+    #if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    if (getenv("XDG_CACHE_HOME")) {
+        return bh_aprintf(bh_heap_allocator(), "%s/onyx/programs", getenv("XDG_CACHE_HOME"));
+    }
+
+    if (getenv("HOME")) {
+        return bh_aprintf(bh_heap_allocator(), "%s/.cache/onyx/programs", getenv("HOME"));
+    }
+    #endif
+
+    return NULL;
+}
+
 static char *get_description_for_subcommand(char *path) {
     bh_file_contents contents = bh_file_read_contents(bh_heap_allocator(), path);
 
@@ -687,6 +727,26 @@ static int32_t output_files_to_disk(CLIArgs *cli_args, onyx_context_t *ctx, cons
     return 1;
 }
 
+static void print_memory_stat(const char *name, int64_t bytes) {
+    printf("    %-14s %10.2f KiB\n", name, (double) bytes / 1024.0);
+}
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+#include <sys/resource.h>
+
+static int64_t peak_resident_bytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+    // Linux reports the peak in kilobytes, MacOS reports it in bytes.
+    #if defined(_BH_DARWIN)
+        return usage.ru_maxrss;
+    #else
+        return (int64_t) usage.ru_maxrss * 1024;
+    #endif
+}
+#endif
+
 #if defined(_BH_LINUX) || defined(_BH_DARWIN)
 #include <sys/wait.h>
 
@@ -751,52 +811,352 @@ static void onyx_watch_run_executable(const char *target) {
     }
 }
 
-static void onyx_watch(CLIArgs *cli_args, int arg_parse_start, int argc, char **argv) {
-    signal(SIGINT, onyx_watch_stop);
+//
+// The watcher keeps a checked copy of the program between rebuilds. Every file that
+// changed since watching started is held out of it (see `onyx_hold_file`), so the copy
+// has everything checked that does not depend on those files. A rebuild forks the copy,
+// and the child only parses the held files, checks what depends on them, and emits the
+// program. Everything is compiled from scratch when a file that is not held changes, or
+// when the held files conflict with something that was checked without them. The copy
+// is then made again, with those files held as well.
+//
+typedef struct WatchedFile {
+    char *filename;
+    bh_file_stats stats;
+} WatchedFile;
+
+typedef struct WatchState {
+    CLIArgs *cli_args;
+    int arg_parse_start;
+    int argc;
+    char **argv;
+
+    onyx_source_cache_t *source_cache;
+
+    // Every file in the last build, as it was when the build finished.
+    bh_arr(WatchedFile) files;
+
+    bh_arr(char *) held_files;
+
+    // Paused with `held_files` held, or NULL.
+    onyx_context_t *checked;
+    b32 checked_is_stale;
+} WatchState;
+
+static onyx_context_t *onyx_watch_create_context(WatchState *watch) {
+    onyx_context_t *ctx = onyx_context_create();
+    onyx_context_set_source_cache(ctx, watch->source_cache);
+    onyx_add_mapped_dir(ctx, "core", -1, bh_bprintf("%s/core", watch->cli_args->core_installation), -1);
+    onyx_set_option_int(ctx, ONYX_OPTION_PLATFORM, ONYX_PLATFORM_ONYX);
 
-    b32 run_the_program = cli_args->action == ONYX_COMPILE_ACTION_WATCH_RUN;
+    if (!cli_parse_compilation_options(watch->cli_args, ctx, watch->arg_parse_start, watch->argc, watch->argv)) {
+        onyx_context_free(ctx);
+        return NULL;
+    }
 
-    while (1) {
-        bh_printf("\e[2J\e[?25l\n");
-        bh_printf("\e[3;1H");
+    return ctx;
+}
 
-        onyx_context_t *ctx = onyx_context_create();
-        onyx_add_mapped_dir(ctx, "core", -1, bh_bprintf("%s/core", cli_args->core_installation), -1);
-        onyx_set_option_int(ctx, ONYX_OPTION_PLATFORM, ONYX_PLATFORM_ONYX);
+static b32 onyx_watch_is_held(WatchState *watch, const char *filename) {
+    bh_arr_each(char *, held, watch->held_files) {
+        if (!strcmp(*held, filename)) return 1;
+    }
 
-        if (!cli_parse_compilation_options(cli_args, ctx, arg_parse_start, argc, argv)) {
-            return;
+    return 0;
+}
+
+static b32 onyx_watch_hold(WatchState *watch, const char *filename) {
+    if (filename == NULL || onyx_watch_is_held(watch, filename)) return 0;
+
+    bh_arr_push(watch->held_files, bh_strdup(bh_heap_allocator(), (char *) filename));
+    watch->checked_is_stale = 1;
+    return 1;
+}
+
+static void onyx_watch_drop_checked(WatchState *watch) {
+    if (watch->checked) onyx_context_free(watch->checked);
+    watch->checked = NULL;
+}
+
+static void onyx_watch_clear_files(WatchState *watch) {
+    bh_arr_each(WatchedFile, file, watch->files) {
+        bh_free(bh_heap_allocator(), file->filename);
+    }
+
+    bh_arr_clear(watch->files);
+}
+
+static void onyx_watch_add_file(WatchState *watch, const char *filename) {
+    WatchedFile file;
+    file.filename = bh_strdup(bh_heap_allocator(), (char *) filename);
+    if (!bh_file_stat(filename, &file.stats)) memset(&file.stats, 0, sizeof(file.stats));
+
+    bh_arr_push(watch->files, file);
+}
+
+//
+// Holds every file that changed since the last build. Returns whether
+// all of them were held already, so the checked copy is still good.
+static b32 onyx_watch_hold_changed_files(WatchState *watch) {
+    b32 all_held = 1;
+
+    bh_arr_each(WatchedFile, file, watch->files) {
+        bh_file_stats stats;
+        if (!bh_file_stat(file->filename, &stats)) memset(&stats, 0, sizeof(stats));
+
+        if (stats.modified_time == file->stats.modified_time && stats.size == file->stats.size) continue;
+        if (onyx_watch_is_held(watch, file->filename)) continue;
+
+        onyx_watch_hold(watch, file->filename);
+        all_held = 0;
+    }
+
+    return all_held;
+}
+
+static void onyx_watch_print_status(i32 error_count, i64 reread_count) {
+    char time_buf[128] = {0};
+    time_t now = time(NULL);
+    strftime(time_buf, 128, "%X", localtime(&now));
+    bh_printf("\e[1;1H\e[30;105m Onyx %d.%d.%d%s \e[30;104m Built %s \e[0m", 
+        onyx_version_major(),
+        onyx_version_minor(),
+        onyx_version_patch(),
+        onyx_version_suffix(),
+        time_buf
+    );
+
+    if (error_count == 0) {
+        bh_printf("\e[30;102m Errors 0 \e[0m");
+    } else {
+        bh_printf("\e[30;101m Error%s %d \e[0m", bh_num_plural(error_count), error_count);
+    }
+
+    bh_printf("\e[30;104m Reread %l file%s \e[0m", reread_count, bh_num_plural(reread_count));
+}
+
+static void onyx_watch_report(WatchState *watch, onyx_context_t *ctx, i64 reread_count) {
+    i32 error_count = onyx_error_count(ctx);
+    if (error_count == 0) {
+        output_files_to_disk(watch->cli_args, ctx, watch->cli_args->target_file);
+
+        bh_printf("\e[92mNo errors!\n");
+    } else {
+        onyx_errors_print(ctx, watch->cli_args->error_format, !watch->cli_args->no_colors, watch->cli_args->show_all_errors);
+    }
+
+    onyx_watch_print_status(error_count, reread_count);
+}
+
+//
+// Returns the number of errors, or -1 if the command line options were not valid.
+static i32 onyx_watch_build_everything(WatchState *watch) {
+    onyx_context_t *ctx = onyx_watch_create_context(watch);
+    if (!ctx) return -1;
+
+    onyx_options_ready(ctx);
+    while (onyx_pump(ctx) == ONYX_PUMP_CONTINUE) {
+        // doing the compilation
+    }
+
+    onyx_watch_report(watch, ctx, onyx_stat(ctx, ONYX_STAT_SOURCE_CACHE_MISSES));
+
+    onyx_watch_clear_files(watch);
+    fori (i, 0, onyx_stat(ctx, ONYX_STAT_FILE_COUNT)) {
+        onyx_watch_add_file(watch, onyx_stat_filepath(ctx, i));
+    }
+
+    i32 error_count = onyx_error_count(ctx);
+    onyx_context_free(ctx);
+    return error_count;
+}
+
+static void onyx_watch_write_line(int fd, const char *line) {
+    if (line == NULL) return;
+
+    i32 length = strlen(line);
+    while (length > 0) {
+        ssize_t written = write(fd, line, length);
+        if (written <= 0) return;
+
+        line += written;
+        length -= written;
+    }
+
+    (void) write(fd, "\n", 1);
+}
+
+static void onyx_watch_build_in_child(WatchState *watch, int fd) {
+    onyx_context_t *ctx = watch->checked;
+    i64 reread_before = onyx_stat(ctx, ONYX_STAT_SOURCE_CACHE_MISSES);
+
+    onyx_release_held_files(ctx);
+    while (onyx_pump(ctx) == ONYX_PUMP_CONTINUE) {
+        // doing the compilation
+    }
+
+    i32 conflict_count = onyx_held_file_conflict_count(ctx);
+    if (conflict_count > 0) {
+        fori (i, 0, conflict_count) {
+            onyx_watch_write_line(fd, onyx_held_file_conflict_filepath(ctx, i));
+        }
+
+        _exit(2);
+    }
+
+    onyx_watch_report(watch, ctx, onyx_stat(ctx, ONYX_STAT_SOURCE_CACHE_MISSES) - reread_before);
+
+    fori (i, 0, onyx_stat(ctx, ONYX_STAT_FILE_COUNT)) {
+        onyx_watch_write_line(fd, onyx_stat_filepath(ctx, i));
+    }
+
+    fflush(stdout);
+    _exit(onyx_error_count(ctx) > 0 ? 1 : 0);
+}
+
+//
+// Finishes the checked copy in a child process, so the copy itself is left as it was.
+// The child sends back the files in the build, or the files that caused a conflict.
+// Returns the number of errors (only whether there were any), or -1 if the copy could
+// not be used and everything has to be compiled again.
+static i32 onyx_watch_build_from_checked(WatchState *watch) {
+    int fds[2];
+    if (pipe(fds) == -1) return -1;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        close(fds[0]);
+        onyx_watch_build_in_child(watch, fds[1]);
+    }
+
+    close(fds[1]);
+
+    bh_buffer lines;
+    bh_buffer_init(&lines, bh_heap_allocator(), 4096);
+
+    char chunk[4096];
+    ssize_t count;
+    while ((count = read(fds[0], chunk, sizeof(chunk))) != 0) {
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        bh_buffer_append(&lines, chunk, count);
+    }
+
+    close(fds[0]);
+    bh_buffer_write_byte(&lines, '\0');
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+    i32 result = -1;
+    b32 conflicted = WIFEXITED(status) && WEXITSTATUS(status) == 2;
+    if (WIFEXITED(status) && WEXITSTATUS(status) <= 1) {
+        result = WEXITSTATUS(status);
+        onyx_watch_clear_files(watch);
+    }
+
+    char *line = (char *) lines.data;
+    while (*line && (result >= 0 || conflicted)) {
+        char *end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        if (conflicted) onyx_watch_hold(watch, line);
+        else            onyx_watch_add_file(watch, line);
+
+        if (!end) break;
+        line = end + 1;
+    }
+
+    bh_buffer_free(&lines);
+    return result;
+}
+
+//
+// Checks everything that does not depend on the held files, ahead of the next change.
+// Files where a decision conflicts with something only the held files could provide
+// are held as well, and the copy is made again, a few times at most.
+static void onyx_watch_check_ahead(WatchState *watch) {
+    onyx_watch_drop_checked(watch);
+
+    i32 attempts = 0;
+    while (watch->checked_is_stale && !bh_arr_is_empty(watch->held_files) && attempts++ < 4) {
+        watch->checked_is_stale = 0;
+
+        onyx_context_t *ctx = onyx_watch_create_context(watch);
+        if (!ctx) return;
+
+        bh_arr_each(char *, held, watch->held_files) {
+            onyx_hold_file(ctx, *held, -1);
         }
 
         onyx_options_ready(ctx);
-        while (onyx_pump(ctx) == ONYX_PUMP_CONTINUE) {
-            // doing the compilation
+
+        onyx_pump_t result;
+        while ((result = onyx_pump(ctx)) == ONYX_PUMP_CONTINUE) {
+            // checking the rest of the program
         }
 
-        i32 error_count = onyx_error_count(ctx);
-        if (error_count == 0) {
-            output_files_to_disk(cli_args, ctx, cli_args->target_file);
+        b32 usable = result == ONYX_PUMP_PAUSED && onyx_error_count(ctx) == 0;
 
-            bh_printf("\e[92mNo errors!\n");
-        } else {
-            onyx_errors_print(ctx, cli_args->error_format, !cli_args->no_colors, cli_args->show_all_errors);
+        fori (i, 0, onyx_held_file_conflict_count(ctx)) {
+            onyx_watch_hold(watch, onyx_held_file_conflict_filepath(ctx, i));
+            usable = 0;
         }
 
-        char time_buf[128] = {0};
-        time_t now = time(NULL);
-        strftime(time_buf, 128, "%X", localtime(&now));
-        bh_printf("\e[1;1H\e[30;105m Onyx %d.%d.%d%s \e[30;104m Built %s \e[0m", 
-            onyx_version_major(),
-            onyx_version_minor(),
-            onyx_version_patch(),
-            onyx_version_suffix(),
-            time_buf
-        );
+        if (usable) {
+            watch->checked = ctx;
+            return;
+        }
 
-        if (error_count == 0) {
-            bh_printf("\e[30;102m Errors 0 \e[0m");
-        } else {
-            bh_printf("\e[30;101m Error%s %d \e[0m", bh_num_plural(error_count), error_count);
+        onyx_context_free(ctx);
+    }
+}
+
+static void onyx_watch(CLIArgs *cli_args, int arg_parse_start, int argc, char **argv) {
+    signal(SIGINT, onyx_watch_stop);
+
+    b32 run_the_program = cli_args->action == ONYX_COMPILE_ACTION_WATCH_RUN;
+
+    WatchState watch = { 0 };
+    watch.cli_args = cli_args;
+    watch.arg_parse_start = arg_parse_start;
+    watch.argc = argc;
+    watch.argv = argv;
+
+    // Files that did not change between rebuilds are not read and tokenized again.
+    watch.source_cache = onyx_source_cache_create();
+
+    bh_arr_new(bh_heap_allocator(), watch.files, 64);
+    bh_arr_new(bh_heap_allocator(), watch.held_files, 4);
+
+    while (1) {
+        b32 checked_is_usable = onyx_watch_hold_changed_files(&watch) && watch.checked;
+
+        bh_printf("\e[2J\e[?25l\n");
+        bh_printf("\e[3;1H");
+
+        i32 error_count = -1;
+        if (checked_is_usable) {
+            error_count = onyx_watch_build_from_checked(&watch);
+        }
+
+        if (error_count < 0) {
+            onyx_watch_drop_checked(&watch);
+            watch.checked_is_stale = 1;
+
+            error_count = onyx_watch_build_everything(&watch);
+            if (error_count < 0) break;
         }
 
         if (run_the_program && error_count == 0) {
@@ -806,11 +1166,13 @@ static void onyx_watch(CLIArgs *cli_args, int arg_parse_start, int argc, char **
 
         watches = bh_file_watch_new();
 
-        fori (i, 0, onyx_stat(ctx, ONYX_STAT_FILE_COUNT)) {
-            bh_file_watch_add(&watches, onyx_stat_filepath(ctx, i));
+        bh_arr_each(WatchedFile, file, watch.files) {
+            bh_file_watch_add(&watches, file->filename);
         }
 
-        onyx_context_free(ctx);
+        if (watch.checked_is_stale) {
+            onyx_watch_check_ahead(&watch);
+        }
 
         b32 wait_successful = bh_file_watch_wait(&watches);
 
@@ -828,6 +1190,13 @@ static void onyx_watch(CLIArgs *cli_args, int arg_parse_start, int argc, char **
         }
     }
 
+    onyx_watch_drop_checked(&watch);
+    onyx_watch_clear_files(&watch);
+    bh_arr_free(watch.files);
+    bh_arr_each(char *, held, watch.held_files) bh_free(bh_heap_allocator(), *held);
+    bh_arr_free(watch.held_files);
+
+    onyx_source_cache_free(watch.source_cache);
     bh_printf("\e[2J\e[1;1H\e[?25h\n");
 }
 #endif
@@ -905,6 +1274,17 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        //
+        // Prebuilt binaries are often run many times without changing, so their translated
+        // program is cached. Programs compiled by `onyx run` are not, because compiling
+        // takes far longer than translating and the output changes with every edit.
+        if (!cli_args.no_program_cache) {
+            char *cache_dir = get_program_cache_dir();
+            if (cache_dir) onyx_run_set_program_cache_dir(cache_dir);
+        }
+
+        if (cli_args.no_jit) onyx_run_set_jit_enabled(0);
+
         if (cli_args.debug_session) {
             onyx_run_wasm_with_debug(wasm_content.data, wasm_content.length, cli_args.passthrough_argument_count, cli_args.passthrough_argument_data, cli_args.debug_socket);
         } else {
@@ -951,6 +1331,17 @@ int main(int argc, char *argv[]) {
 
     u64 duration = bh_time_duration(start_time);
 
+    // The trace is written even when compilation failed, since slow failing builds need it too.
+    if (cli_args.trace_file) {
+        output_file_to_disk(&cli_args, ctx, cli_args.trace_file, ONYX_OUTPUT_TYPE_TRACE);
+
+        int32_t summary_length = onyx_output_length(ctx, ONYX_OUTPUT_TYPE_TRACE_SUMMARY);
+        char *summary = malloc(summary_length);
+        onyx_output_write(ctx, ONYX_OUTPUT_TYPE_TRACE_SUMMARY, summary);
+        printf("\n%.*s\n", summary_length, summary);
+        free(summary);
+    }
+
     onyx_errors_print(ctx, cli_args.error_format, !cli_args.no_colors, cli_args.show_all_errors);
     if (onyx_errors_present(ctx)) {
         return 1;
@@ -967,8 +1358,41 @@ int main(int argc, char *argv[]) {
         printf("    Time taken: %lf ms\n", (double) duration);
         printf("    Processed %d lines (%f lines/second).\n", lines, lines_per_sec);
         printf("    Processed %d tokens (%f tokens/second).\n", tokens, tokens_per_sec);
+        printf("    Removed %d unreachable functions.\n", (int) onyx_stat(ctx, ONYX_STAT_FUNCTIONS_REMOVED));
+        printf("    Removed %d unreachable data segments.\n", (int) onyx_stat(ctx, ONYX_STAT_DATA_SEGMENTS_REMOVED));
+        printf("    Removed %d instructions by peephole optimization.\n", (int) onyx_stat(ctx, ONYX_STAT_INSTRUCTIONS_REMOVED));
         printf("\n");
     }
+
+    if (cli_args.print_perf_statistics) {
+        printf("\nScheduler:\n");
+        printf("    Entities processed:  %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_ENTITIES_PROCESSED));
+        printf("    Entities yielded:    %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_ENTITIES_YIELDED));
+        printf("    Entities parked:     %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_ENTITIES_PARKED));
+        printf("    Woken from parking:  %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_ENTITIES_WOKEN));
+        printf("\n");
+
+        printf("Memory:\n");
+        print_memory_stat("Source files", onyx_stat(ctx, ONYX_STAT_MEMORY_SOURCE));
+        print_memory_stat("Tokens",       onyx_stat(ctx, ONYX_STAT_MEMORY_TOKENS));
+        print_memory_stat("AST arena",    onyx_stat(ctx, ONYX_STAT_MEMORY_AST));
+        print_memory_stat("Entity arena", onyx_stat(ctx, ONYX_STAT_MEMORY_ENTITIES));
+        print_memory_stat("Instructions", onyx_stat(ctx, ONYX_STAT_MEMORY_INSTRUCTIONS));
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+        print_memory_stat("Peak RSS",     peak_resident_bytes());
+#endif
+        printf("\n");
+
+        printf("Polymorphism:\n");
+        printf("    Instance lookups:    %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_POLYMORPH_LOOKUPS));
+        printf("    Instances created:   %lld\n", (long long) onyx_stat(ctx, ONYX_STAT_POLYMORPH_INSTANCES));
+
+        int32_t summary_length = onyx_output_length(ctx, ONYX_OUTPUT_TYPE_POLYMORPH_SUMMARY);
+        char *summary = malloc(summary_length);
+        onyx_output_write(ctx, ONYX_OUTPUT_TYPE_POLYMORPH_SUMMARY, summary);
+        printf("\n%.*s\n", summary_length, summary);
+        free(summary);
+    }
   
     switch (cli_args.action) {
         case ONYX_COMPILE_ACTION_RUN:
@@ -978,6 +1402,8 @@ int main(int argc, char *argv[]) {
             onyx_output_write(ctx, ONYX_OUTPUT_TYPE_WASM, output);
             onyx_context_free(ctx);
 
+            if (cli_args.no_jit) onyx_run_set_jit_enabled(0);
+
             if (cli_args.debug_session) {
                 onyx_run_wasm_with_debug(output, output_length, cli_args.passthrough_argument_count, cli_args.passthrough_argument_data, cli_args.debug_socket);
             } else {
@@ -138,6 +138,8 @@ typedef struct Scope {
     struct Scope *parent;
     OnyxFilePos created_at;
     char* name;
+
+    // Keyed by atom, see atom_intern.
     Table(AstNode *) symbols;
 } Scope;
 
@@ -636,11 +638,15 @@ typedef struct ValueWithOffset {
 
 
 // Base Nodes
+//
+// Every node starts with this header, so it is kept to 24 bytes. Instead of
+// a pointer to its entity, a node stores the entity's id plus one, or zero
+// if it has no entity. Use ast_entity and ast_set_entity to access it.
 #define AstNode_base \
-    AstKind kind;             \
+    AstKind kind : 8;         \
+    u32 entity_id : 24;       \
     u32 flags;                \
     OnyxToken *token;         \
-    struct Entity* entity;    \
     AstNode *next
 struct AstNode { AstNode_base; };
 
@@ -737,7 +743,7 @@ struct AstFieldAccess   {
     AstTyped *expr;
     u32 offset;
     u32 idx;
-    char* field; // If token is null, defer to field
+    char* field; // An atom. If token is null, defer to field
 
     b32 is_union_variant_access : 1;
 };
@@ -995,10 +1001,10 @@ struct AstSwitch {
 // can't be in expressions so a 'next' thing
 // doesn't make sense.
 #define AstType_base       \
-    AstKind kind;          \
+    AstKind kind : 8;      \
+    u32 entity_id : 24;    \
     u32 flags;             \
     OnyxToken* token;      \
-    struct Entity* entity; \
     void* next;            \
     u64 type_id;           \
     Type* type
@@ -1067,6 +1073,20 @@ struct AstStructMember {
 
     b32 is_used : 1;
 };
+typedef struct PolyInstance PolyInstance;
+
+// The instances of a polymorphic procedure, struct or union. They are found by
+// a hash of their solutions, instead of by a string built from them, since a
+// lookup happens every time a polymorph is used. See polymorph.h.
+typedef struct PolyInstanceTable PolyInstanceTable;
+struct PolyInstanceTable {
+    bh_arr(PolyInstance) instances;
+
+    // Indexed by the low bits of the hash. Holds the index of the last instance
+    // added with those bits, or -1. The length is always a power of two.
+    bh_arr(i32) buckets;
+};
+
 struct AstPolyStructParam {
     AstTyped_base;
 };
@@ -1076,7 +1096,7 @@ struct AstPolyStructType {
 
     Scope *scope;
     bh_arr(AstPolyStructParam) poly_params;
-    Table(AstStructType *) concrete_structs;
+    PolyInstanceTable *concrete_structs;
 
     AstStructType* base_struct;
 };
@@ -1132,7 +1152,7 @@ struct AstPolyUnionType {
 
     Scope *scope;
     bh_arr(AstPolyStructParam) poly_params;
-    Table(AstUnionType *) concrete_unions;
+    PolyInstanceTable *concrete_unions;
 
     AstUnionType* base_union;
 };
@@ -1428,6 +1448,20 @@ struct AstSolidifiedFunction {
     struct Entity *func_header_entity;
 };
 
+struct PolyInstance {
+    u64 hash;
+    bh_arr(AstPolySolution) slns;
+
+    // The previous instance in the same bucket, or -1.
+    i32 next;
+
+    union {
+        AstSolidifiedFunction func;
+        AstStructType        *struct_type;
+        AstUnionType         *union_type;
+    };
+};
+
 struct AstFunction {
     AstTyped_base;
 
@@ -1475,7 +1509,8 @@ struct AstFunction {
 
     bh_arr(AstPolySolution) known_slns;
 
-    Table(AstSolidifiedFunction) concrete_funcs;
+    // Shared with partially applied copies of this procedure.
+    PolyInstanceTable *concrete_funcs;
     bh_imap active_queries;
 
     bh_arr(AstNode *) nodes_that_need_entities_after_clone;
@@ -1795,11 +1830,21 @@ typedef struct Entity {
 
     b32 entered_in_queue : 1;
 
+    // Set while the entity is parked in one of the entity heap's wait tables,
+    // instead of being in the queue.
+    b32 parked : 1;
+
+    // Set while the entity is loading a file that is held (see HeldFiles), instead
+    // of being in the queue.
+    b32 held : 1;
+
     Package *package;
     Scope *scope;
 
-    // TODO: This is incomplete. Add proper cycle detection and halting.
-    // struct Entity *waiting_on;
+    // The first entity this one was waiting on the last time it was processed,
+    // which makes up the wait graph. It is kept while the entity is not making
+    // progress, parked or not, so that cycles in the wait graph can be reported.
+    struct Entity *waiting_on_entity;
 
     union {
         AstDirectiveError     *error;
@@ -1839,10 +1884,41 @@ typedef struct EntityHeap {
     bh_arr(Entity *) quick_unsorted_entities;
     i32 next_id;
 
+    // Every entity that was registered, indexed by its id.
+    bh_arr(Entity *) all_entities;
+
     i32 state_count[Entity_State_Count];
     i32 type_count[Entity_Type_Count];
 
     i32 all_count[Entity_State_Count][Entity_Type_Count];
+
+    // Entities that yielded because a symbol could not be resolved are parked
+    // here, keyed by the atom of the symbol, until a symbol with that name is
+    // introduced somewhere. Retrying them any sooner would be wasted work.
+    Table(bh_arr(Entity *)) symbol_waiters;
+
+    // Entities that yielded because another entity has not finished something
+    // they need (a type, a function header, a polymorph solution) are parked
+    // here, keyed by that entity, until it is processed again.
+    //
+    // An entity can be parked in several of these lists at once, and is woken by
+    // the first of them. The entries left in the other lists are skipped if the
+    // entity is not parked anymore when they are reached.
+    struct { Entity *key; bh_arr(Entity *) value; } *entity_waiters;
+
+    // Entities that can only continue once nothing else can make progress. They
+    // are woken with everything else when the pump stalls.
+    bh_arr(Entity *) stall_waiters;
+
+    i32 parked_count;
+
+    // Set when every parked entity was woken because nothing else could make
+    // progress. Until something does, yielding entities are not parked, so
+    // the normal cycle detection sees all of them.
+    b32 parking_disabled;
+
+    u64 total_parked;
+    u64 total_woken;
 } EntityHeap;
 
 void entity_heap_init(bh_allocator a, EntityHeap* entities);
@@ -1852,9 +1928,31 @@ Entity* entity_heap_top(EntityHeap* entities);
 void entity_heap_change_top(EntityHeap* entities, Entity* new_top);
 void entity_heap_remove_top(EntityHeap* entities);
 void entity_change_type(EntityHeap* entities, Entity *ent, EntityType new_type);
+void entity_heap_park_on_symbol(EntityHeap* entities, Entity* e, char *atom);
+void entity_heap_park_on_entity(EntityHeap* entities, Entity* e, Entity *blocker);
+void entity_heap_park_until_stall(EntityHeap* entities, Entity* e);
+void entity_heap_wake_symbol(EntityHeap* entities, char *atom);
+void entity_heap_wake_entity(EntityHeap* entities, Entity *blocker);
+i32 entity_heap_wake_all(EntityHeap* entities);
+void entity_wait_on(Context *context, Entity *blocker);
+void entity_wait_on_type(Context *context, Type *type);
+void entity_wait_on_symbol(Context *context, OnyxToken *symbol);
+void entity_wait_on_stall(Context *context);
+void entity_note_yield(Context *context);
 void entity_change_state(EntityHeap* entities, Entity *ent, EntityState new_state);
 void entity_heap_add_job(EntityHeap *entities, enum TypeMatch (*func)(Context *, void *), void *job_data);
 
+static inline Entity *entity_heap_lookup(EntityHeap *entities, u32 node_entity_id) {
+    return node_entity_id ? entities->all_entities[node_entity_id - 1] : NULL;
+}
+
+static inline u32 entity_node_id(Entity *entity) {
+    return entity ? entity->id + 1 : 0;
+}
+
+#define ast_entity(context, node)        (entity_heap_lookup(&(context)->entities, ((AstNode *) (node))->entity_id))
+#define ast_set_entity(node, entity)     (((AstNode *) (node))->entity_id = entity_node_id(entity))
+
 // If target_arr is null, the entities will be placed directly in the heap.
 void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *)* target_arr, AstNode* node, Scope* scope, Package* package);
 
@@ -1951,6 +2049,20 @@ typedef struct CheckerData {
     bh_arr(Scope *) scope_stack;
 
     b32 resolved_a_symbol;
+
+    // What the current entity was found to be waiting on while it was processed:
+    // symbols that failed to resolve, and entities it needs to make progress. If it
+    // yields, it is parked on all of them. See entity_wait_on.
+    bh_arr(OnyxToken *) unresolved_symbols;
+    bh_arr(struct Entity *) blocking_entities;
+    b32 waiting_on_stall;
+
+    // Set when something was recorded above since the last yield.
+    b32 wait_recorded;
+
+    // Set when the current entity yielded without recording why. It could be waiting
+    // on anything, so it is left in the queue instead of being parked.
+    b32 untracked_yield;
 } CheckerData;
 
 typedef struct ClonerData {
@@ -1971,6 +2083,9 @@ typedef struct PolymorphData {
     // to a polymorphic procedure, and you have enough information to instantiate said procedure
     // in order to resolve the type of one of the return values.
     b32 doing_nested_polymorph_lookup;
+
+    // Every polymorphic procedure that has been instantiated, for the statistics in --perf.
+    bh_arr(AstFunction *) instantiated_procs;
 } PolymorphData;
 
 typedef struct ContextCaches {
@@ -1982,6 +2097,78 @@ typedef struct DefinedVariable {
     char *value;
 } DefinedVariable;
 
+// A source file that was read and tokenized ahead of time, on a worker thread.
+// It is parsed when its load entity is processed, just like any other file.
+typedef struct PreparedSourceFile {
+    bh_file_contents contents;
+    bh_arr(OnyxToken) tokens;
+    u64 line_count;
+    u16 file_id;
+    b32 failed;
+
+    // Reported when the file is parsed, since it may have been lexed on a worker thread.
+    bh_arr(OnyxLexError) lex_errors;
+} PreparedSourceFile;
+
+//
+// Files can be left out of a compilation until they are released (see onyx_hold_file),
+// so everything that does not depend on them is checked ahead of time. The checked
+// program is then reused for any number of versions of those files.
+//
+// A few decisions in the checker depend on something *not* existing yet: a symbol is
+// resolved to the first scope that has it, and an overloaded procedure or operator uses
+// the first option that matches. While files are held, these decisions are noted. After
+// they are released, anything that would have changed one of them is a conflict, and
+// the result may differ from compiling everything at once.
+//
+typedef struct HeldLookup {
+    Scope *scope;
+    char  *atom;
+} HeldLookup;
+
+typedef struct HeldDecision {
+    u16 file_id;
+
+    // Set if any argument was something like `.{ ... }` or `.Value`, which can
+    // match a type that did not exist when the decision was made.
+    b32 untyped_arguments;
+} HeldDecision;
+
+typedef struct HeldLateOption {
+    AstTyped *option;
+    HeldDecision decision;
+} HeldLateOption;
+
+typedef struct HeldFiles {
+    // Keyed by the full path.
+    Table(b32) files;
+    bh_arr(Entity *) entities;
+
+    // Folders listed by '#load_all' and files read while checking, with their
+    // modification time. If one of them changes, the checked program is stale.
+    Table(u64) dependencies;
+
+    // Scopes that a lookup went past because the symbol was found further out.
+    // The value is the file the lookup was made from.
+    struct { HeldLookup key; u16 value; } *passed_lookups;
+
+    // Overload option arrays that a decision was made from. When an option is added,
+    // the mark is moved to the reallocated array.
+    struct { void *key; HeldDecision value; } *decided_overloads;
+
+    // Options added to a decided array after release. They only conflict if they could
+    // have matched one of the earlier decisions, which is known once they are checked.
+    bh_arr(HeldLateOption) late_options;
+
+    bh_arr(u16) conflicts;
+
+    u32 last_scope_id;
+    u32 last_type_id;
+
+    b32 holding  : 1;
+    b32 released : 1;
+} HeldFiles;
+
 
 typedef enum ProceduralMacroExpansionKind {
     PMEK_Expression,
@@ -2035,6 +2222,8 @@ struct CompileOptions {
     b32 generate_odoc         : 1;
     b32 no_core               : 1;
     b32 no_stale_code         : 1;
+    b32 no_tree_shaking       : 1;
+    b32 no_peephole           : 1;
     b32 show_all_errors       : 1;
 
     b32 enable_optional_semicolons : 1;
@@ -2043,6 +2232,7 @@ struct CompileOptions {
     b32 generate_lsp_info_file    : 1;
 
     b32 running_perf : 1;
+    b32 collect_trace : 1;
 
     Runtime runtime;
 
@@ -2152,6 +2342,45 @@ struct CompilerStats {
 
     u64 microseconds_per_state[Entity_State_Count];
     u64 microseconds_per_type[Entity_Type_Count];
+
+    u64 entities_processed;
+    u64 entities_yielded;
+
+    u64 source_cache_hits;
+    u64 source_cache_misses;
+
+    // Includes the unused capacity at the end of each file's token array.
+    u64 token_bytes;
+
+    u64 functions_removed;
+    u64 data_segments_removed;
+    u64 instructions_removed;
+
+    u64 polymorph_lookups;
+    u64 polymorph_instances;
+};
+
+typedef enum CompilerTraceResult {
+    Compiler_Trace_Progressed,
+    Compiler_Trace_Yielded,
+    Compiler_Trace_Parked,
+    Compiler_Trace_Failed,
+} CompilerTraceResult;
+
+// One time an entity was processed by onyx_pump. These are only
+// recorded when tracing is enabled (ONYX_OPTION_COLLECT_TRACE).
+typedef struct CompilerTraceEvent CompilerTraceEvent;
+struct CompilerTraceEvent {
+    Entity *entity;
+    u64 start_us;
+    u64 duration_us;
+
+    EntityState state;
+    EntityState next_state;
+    CompilerTraceResult result;
+
+    u32 macro_attempts;
+    u32 micro_attempts;
 };
 
 typedef struct SpecialGlobalEntities SpecialGlobalEntities;
@@ -2181,6 +2410,36 @@ typedef struct CompilerEvent {
     CompilerEventField *first_field;
 } CompilerEvent;
 
+// Every identifier is interned once per context as an atom: a NUL-terminated
+// copy of its text that is shared by every occurrence of the same name. Two
+// names are equal exactly when their atoms are the same pointer, so tables
+// keyed by atoms hash and compare pointers instead of strings.
+typedef struct AtomTableEntry {
+    u64   hash;
+    char *text;
+    i32   length;
+} AtomTableEntry;
+
+typedef struct AtomTable {
+    AtomTableEntry *entries;
+    u32 capacity;
+    u32 count;
+} AtomTable;
+
+// The atoms of the tokens of each source file, indexed by the token's position in
+// the file's token array. Tokens cannot hold their atom, because token arrays are
+// shared by contexts through the source cache. Files are sorted by their first token.
+typedef struct TokenAtomFile {
+    OnyxToken *first;
+    u32        count;
+    char     **atoms;
+} TokenAtomFile;
+
+typedef struct TokenAtomTable {
+    bh_arr(TokenAtomFile) files;
+    i32 last_file;
+} TokenAtomTable;
+
 typedef struct EventSystem {
     bh_arena     event_arena;
     bh_allocator event_alloc;
@@ -2194,6 +2453,8 @@ typedef struct EventSystem {
 struct Context {
     Table(Package *)      packages;
     EntityHeap            entities;
+    AtomTable             atoms;
+    TokenAtomTable        token_atoms;
 
     Scope *global_scope;
 
@@ -2211,12 +2472,29 @@ struct Context {
     bh_arr(bh_file_contents) loaded_files;
     bh_arr(DefinedVariable) defined_variables;
 
+    // Files that have been prepared but not parsed yet, keyed by their full path.
+    // Each worker thread allocates from its own heap, which lives as long as the context.
+    Table(PreparedSourceFile) prepared_files;
+    bh_arr(bh_managed_heap *) prepared_file_heaps;
+
+    // Ids in the source file table of files whose tokens are not kept in the source cache.
+    // They are released when the context is freed.
+    bh_arr(u16) source_file_ids;
+
+    // Optional, outlives the context. Defined in library_main.c.
+    struct onyx_source_cache_t *source_cache;
+
+    HeldFiles held;
+
     // NOTE: This is defined in wasm_emit.h
     struct OnyxWasmModule* wasm_module;
     bh_buffer generated_wasm_buffer;
     bh_buffer generated_js_buffer;
     bh_buffer generated_odoc_buffer;
     bh_buffer generated_osym_buffer;
+    bh_buffer generated_trace_buffer;
+    bh_buffer generated_trace_summary_buffer;
+    bh_buffer generated_polymorph_summary_buffer;
 
     struct SymbolInfoTable *symbol_info;
     struct OnyxDocInfo     *doc_info;
@@ -2258,6 +2536,7 @@ struct Context {
     u32 next_entity_id;
 
     CompilerStats stats;
+    bh_arr(CompilerTraceEvent) trace_events;
 
     // HACK
     SpecialGlobalEntities special_global_entities;
@@ -2387,7 +2666,7 @@ typedef struct OverloadReturnTypeCheck {
     OnyxToken *group;
 } OverloadReturnTypeCheck;
 
-void add_overload_option(bh_arr(OverloadOption)* poverloads, u64 order, AstTyped* overload);
+void add_overload_option(Context *context, bh_arr(OverloadOption)* poverloads, u64 order, AstTyped* overload);
 AstTyped* find_matching_overload_by_arguments(Context *context, bh_arr(OverloadOption) overloads, Arguments* args);
 AstTyped* find_matching_overload_by_type(Context *context, bh_arr(OverloadOption) overloads, Type* type);
 void report_unable_to_match_overload(Context *context, AstCall* call, bh_arr(OverloadOption) overloads);
@@ -2524,7 +2803,7 @@ static inline void convert_polyproc_to_function(AstFunction *func) {
     func->active_queries.hashes = NULL;
     func->active_queries.entries = NULL;
     func->poly_scope = NULL;
-    func->entity = NULL;
+    ast_set_entity(func, NULL);
     func->type = NULL;
     func->tags = NULL;
 }
@@ -2535,7 +2814,7 @@ static inline void convert_function_to_polyproc(Context *context, AstFunction *f
     func->kind = Ast_Kind_Polymorphic_Proc;
     func->parent_scope_of_poly_proc = func->scope->parent;
     func->scope = NULL;
-    if (func->entity) entity_change_type(&context->entities, func->entity, Entity_Type_Polymorphic_Proc);
+    if (ast_entity(context, func)) entity_change_type(&context->entities, ast_entity(context, func), Entity_Type_Polymorphic_Proc);
 }
 
 #endif // #ifndef ONYXASTNODES_H
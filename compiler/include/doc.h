@@ -6,7 +6,7 @@
 
 // Onyx Documentation generation
 
-void onyx_docs_submit(OnyxDocInfo *docs, AstBinding *binding);
+void onyx_docs_submit(Context *context, AstBinding *binding);
 void onyx_docs_generate_odoc(Context *context, bh_buffer *out_buffer);
 
 
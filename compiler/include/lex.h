@@ -93,14 +93,28 @@ typedef enum TokenType {
     Token_Type_Count,
 } TokenType;
 
+// A position in a source file. Every token has one, so it is kept small: the file is
+// identified by its id in the table of source files, and the line and column are only
+// computed from the offset when they are needed, see file_pos_location.
 typedef struct OnyxFilePos {
+    u32 offset;
+
+    // 0 for positions that are not in any file.
+    u16 file_id;
+
+    // NOTE: This assumes that no token is longer than 2^16 chars
+    u16 length;
+} OnyxFilePos;
+
+typedef struct OnyxFileLocation {
     const char* filename;
     char* line_start;
     u32 line;
+    u32 column;
+} OnyxFileLocation;
 
-    // NOTE: This assumes that no line is no longer than 2^16 chars
-    u16 column, length;
-} OnyxFilePos;
+// The file of positions in code that the compiler generates itself.
+#define INTERNAL_SOURCE_FILE_ID 1
 
 typedef struct OnyxToken {
     TokenType type;
@@ -109,29 +123,46 @@ typedef struct OnyxToken {
     OnyxFilePos pos;
 } OnyxToken;
 
+typedef struct OnyxLexError {
+    OnyxFilePos pos;
+    char *message;
+} OnyxLexError;
+
 typedef struct OnyxTokenizer {
     struct Context *context;
 
     char *start, *curr, *end;
 
     const char* filename;
+    u16 file_id;
 
-    char* line_start;
     u64 line_number;
 
     bh_arr(OnyxToken) tokens;
 
+    // Files can be lexed on worker threads, which must not touch the error
+    // list in the context. Errors are kept here instead, and reported with
+    // onyx_report_lex_errors once the tokens are used.
+    bh_arr(OnyxLexError) errors;
+
     b32 optional_semicolons : 1;
     b32 insert_semicolon: 1;
 } OnyxTokenizer;
 
 const char *token_type_name(TokenType tkn_type);
 const char* token_name(OnyxToken *tkn);
-void token_toggle_end(OnyxToken* tkn);
 OnyxToken* onyx_get_token(OnyxTokenizer* tokenizer);
 OnyxTokenizer onyx_tokenizer_create(struct Context *context, bh_file_contents *fc);
+OnyxTokenizer onyx_tokenizer_create_with_allocator(struct Context *context, bh_file_contents *fc, bh_allocator token_alloc);
 void onyx_tokenizer_free(OnyxTokenizer* tokenizer);
 void onyx_lex_tokens(OnyxTokenizer* tokenizer);
+void onyx_report_lex_errors(struct Context *context, bh_arr(OnyxLexError) errors);
+
+u16 source_file_register(const char *filename, char *data, u32 length);
+void source_file_release(u16 file_id);
+OnyxFilePos source_file_pos(u16 file_id, char *position, u16 length);
+const char *file_pos_filename(OnyxFilePos pos);
+OnyxFileLocation file_pos_location(OnyxFilePos pos);
 
 b32 token_equals(OnyxToken* tkn1, OnyxToken* tkn2);
 b32 token_text_equals(OnyxToken* tkn, char* text);
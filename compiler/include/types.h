@@ -262,6 +262,7 @@ Type* type_get_contained_type(Type* type);
 
 b32 type_is_ready_for_lookup(Type* type);
 b32 type_lookup_member(struct Context *context, Type* type, char* member, StructMember* smem);
+b32 type_lookup_member_atom(struct Context *context, Type* type, char* member, StructMember* smem);
 b32 type_lookup_member_by_idx(struct Context *context, Type* type, i32 idx, StructMember* smem);
 
 i32 type_linear_member_count(Type* type);
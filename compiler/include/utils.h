@@ -10,6 +10,13 @@ void package_track_use_package(Context *context, Package* package, Entity* entit
 void package_reinsert_use_packages(Context *context, Package* package);
 void package_mark_as_used(Context *context, Package* package);
 
+char *atom_intern(Context *context, const char *text, i32 length);
+char *atom_find(Context *context, const char *text, i32 length);
+char *token_atom(Context *context, OnyxToken *token);
+void token_atoms_add_file(Context *context, bh_arr(OnyxToken) tokens);
+void atom_table_free(AtomTable *table);
+void token_atom_table_free(TokenAtomTable *table);
+
 Scope* scope_create(Context *context, Scope* parent, OnyxFilePos created_at);
 void scope_include(Context *context, Scope* target, Scope* source, OnyxFilePos pos);
 b32 symbol_introduce(Context *context, Scope* scope, OnyxToken* tkn, AstNode* symbol);
@@ -23,11 +30,18 @@ AstNode* try_symbol_raw_resolve_from_node(Context *context, AstNode* node, char*
 AstNode* try_symbol_resolve_from_node(Context *context, AstNode* node, OnyxToken* token);
 AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* symbol);
 AstNode* try_symbol_resolve_from_type(Context *context, Type *type, OnyxToken *token);
+AstNode* try_symbol_atom_resolve_from_node(Context *context, AstNode* node, char* atom);
+AstNode* try_symbol_atom_resolve_from_type(Context *context, Type *type, char* atom);
 Scope *get_scope_from_node(Context *context, AstNode *node);
 Scope *get_scope_from_node_or_create(Context *context, AstNode *node);
 
 void build_all_overload_options(bh_arr(OverloadOption) overloads, bh_imap* all_overloads);
 
+void held_files_note_dependency(Context *context, char *path);
+void held_files_conflict(Context *context, u16 file_id);
+void held_files_note_overload_decision(Context *context, bh_arr(OverloadOption) overloads, bh_imap *all_overloads, Arguments *args);
+void held_files_check_late_options(Context *context);
+
 u32 char_to_base16_value(char x);
 
 // Returns the length after processing the string.
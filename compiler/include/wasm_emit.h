@@ -582,6 +582,10 @@ typedef struct WasmDatum {
     u32 offset_, alignment;
     u32 length;
     ptr data;
+
+    // Set when linking finds that nothing reachable refers to this datum.
+    // It is not placed in memory, and is removed from the module at the end.
+    b32 unreachable;
 } WasmDatum;
 
 typedef struct WasmCustomSection {
@@ -657,6 +661,19 @@ typedef struct CodePatchInfo {
     OnyxToken *token_related_to_patch;
 } CodePatchInfo;
 
+//
+// Every time the address of a function is taken, the element index that was
+// used is recorded along with where it was written: in the code of a function,
+// or in a datum. When linking, only the elements that are written somewhere
+// reachable keep their function alive. If neither `func_idx` nor `data_id` is
+// set, the element is always kept.
+//
+typedef struct ElemReference {
+    i32 elem_idx;
+    i32 func_idx;
+    u32 data_id;
+} ElemReference;
+
 // Context used when building a constexpr buffer
 typedef struct ConstExprContext {
    struct OnyxWasmModule *module;
@@ -728,6 +745,7 @@ typedef struct OnyxWasmModule {
 
     // NOTE: Mapping ptrs to elements
     bh_imap elem_map;
+    bh_arr(ElemReference) elem_references;
 
     bh_arr(DeferredStmt)   deferred_stmts;
     bh_arr(AllocatedSpace) local_allocations;
@@ -839,6 +857,8 @@ void onyx_wasm_module_write_js_partials_to_file(OnyxWasmModule* module, bh_file
 
 #ifdef ONYX_RUNTIME_LIBRARY
 void onyx_run_initialize(b32 debug_enabled, const char *debug_socket);
+void onyx_run_set_program_cache(char *dir);
+void onyx_run_set_jit(b32 enabled);
 b32 onyx_run_wasm_code(bh_buffer code_buffer, int argc, char *argv[]);
 #endif
 
@@ -594,7 +594,7 @@ TypeMatch unify_node_and_type_(Context *context, AstTyped** pnode, Type* type, b
     if (node == NULL) return TYPE_MATCH_FAILED;
 
     if (node->kind == Ast_Kind_Struct_Literal && (node->type_node == NULL && node->type == NULL)) {
-        if (node->entity != NULL) return TYPE_MATCH_SUCCESS;
+        if (ast_entity(context, node) != NULL) return TYPE_MATCH_SUCCESS;
         if (type->kind == Type_Kind_VarArgs) type = type->VarArgs.elem;
 
         //
@@ -620,7 +620,7 @@ TypeMatch unify_node_and_type_(Context *context, AstTyped** pnode, Type* type, b
     }
 
     if (node->kind == Ast_Kind_Array_Literal && node->type == NULL) {
-        if (node->entity != NULL) return TYPE_MATCH_SUCCESS;
+        if (ast_entity(context, node) != NULL) return TYPE_MATCH_SUCCESS;
 
         // If this shouldn't make permanent changes and submit entities,
         // just assume that it works and don't submit the entities.
@@ -664,19 +664,17 @@ TypeMatch unify_node_and_type_(Context *context, AstTyped** pnode, Type* type, b
 
     if (node->kind == Ast_Kind_Unary_Field_Access) {
         if (type->kind == Type_Kind_Union) {
-            token_toggle_end(node->token);
             int index = 0;
-            if ((index = shgeti(type->Union.variants, node->token->text)) != -1) {
+            if ((index = shgeti(type->Union.variants, token_atom(context, node->token))) != -1) {
                 UnionVariant *uv = type->Union.variants[index].value;
                 if (uv->type != context->types.basic[Basic_Kind_Void]) {
                     if (permanent) {
                         ONYX_ERROR(node->token->pos, Error_Critical,
-                            "Shorthand union literal syntax '.%s' is not all for this variant, because its type is not void; it is '%s'. Use the longer syntax, '.{ %s = value }'",
-                            node->token->text,
+                            "Shorthand union literal syntax '.%b' is not all for this variant, because its type is not void; it is '%s'. Use the longer syntax, '.{ %b = value }'",
+                            node->token->text, node->token->length,
                             type_get_name(context, uv->type),
-                            node->token->text);
+                            node->token->text, node->token->length);
                     }
-                    token_toggle_end(node->token);
                     return TYPE_MATCH_FAILED;
                 }
 
@@ -685,18 +683,14 @@ TypeMatch unify_node_and_type_(Context *context, AstTyped** pnode, Type* type, b
                     *pnode = (AstTyped *) sl;
                 }
 
-                token_toggle_end(node->token);
                 return TYPE_MATCH_SUCCESS;
             }
-            token_toggle_end(node->token);
         }
 
         AstNode* resolved = try_symbol_resolve_from_type(context, type, node->token);
         if (resolved == NULL) {
             if (context->cycle_detected) {
-                token_toggle_end(node->token);
-                char *closest = find_closest_symbol_in_node(context, (AstNode *) type->ast_type, node->token->text);
-                token_toggle_end(node->token);
+                char *closest = find_closest_symbol_in_node(context, (AstNode *) type->ast_type, token_atom(context, node->token));
 
                 if (closest) {
                     ONYX_ERROR(node->token->pos, Error_Critical, "'%b' does not exist in '%s'. Did you mean '%s'?",
@@ -1147,7 +1141,7 @@ Type* resolve_expression_type(Context *context, AstTyped* node) {
             node->type = type_make_array(context, elem_type, bh_arr_length(al->values));
             node->flags |= Ast_Flag_Array_Literal_Typed;
 
-            if (node->entity == NULL) {
+            if (ast_entity(context, node) == NULL) {
                 add_entities_for_node(&context->entities, NULL, (AstNode *) node, NULL, NULL);
             }
         }
@@ -1593,10 +1587,11 @@ char* get_function_assembly_name(Context *context, AstFunction* func) {
     }
 
     if (func->token) {
+        OnyxFileLocation location = file_pos_location(func->token->pos);
         return bh_aprintf(context->ast_alloc,
             "unnamed_at_%s_%d",
-            sanitize_name(context->scratch_alloc, (char *) func->token->pos.filename),
-            func->token->pos.line);
+            sanitize_name(context->scratch_alloc, (char *) location.filename),
+            location.line);
     }
 
     return "unnamed";
@@ -1701,7 +1696,7 @@ AstArgument* make_argument(Context *context, AstTyped* value) {
 AstFieldAccess* make_field_access(Context *context, AstTyped* node, char* field) {
     AstFieldAccess* fa = onyx_ast_node_new(context->ast_alloc, sizeof(AstFieldAccess), Ast_Kind_Field_Access);
     if (node->token) fa->token = node->token;
-    fa->field = field;
+    fa->field = field ? atom_intern(context, field, strlen(field)) : NULL;
     fa->expr = node;
 
     return fa;
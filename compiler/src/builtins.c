@@ -338,45 +338,45 @@ void prepare_builtins(Context *context) {
     // `types_init()` needs to be called first so the pointers in context->types.basic are valid
     assert(context->types.basic[Basic_Kind_Void]);
 
-    context->basic_types.type_void      = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_void_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Void]  });
-    context->basic_types.type_bool      = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_bool_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Bool]  });
-    context->basic_types.type_i8        = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_i8_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I8]    });
-    context->basic_types.type_u8        = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_u8_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_U8]    });
-    context->basic_types.type_i16       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_i16_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I16]   });
-    context->basic_types.type_u16       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_u16_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_U16]   });
-    context->basic_types.type_i32       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_i32_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I32]   });
-    context->basic_types.type_u32       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_u32_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_U32]   });
-    context->basic_types.type_i64       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_i64_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I64]   });
-    context->basic_types.type_u64       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_u64_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_U64]   });
-    context->basic_types.type_f32       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_f32_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_F32]   });
-    context->basic_types.type_f64       = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_f64_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_F64]   });
-    context->basic_types.type_rawptr    = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_rawptr_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Rawptr] });
-    context->basic_types.type_type_expr = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &basic_type_type_expr_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Type_Index] });
+    context->basic_types.type_void      = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_void_token, NULL, 0, NULL, context->types.basic[Basic_Kind_Void]  });
+    context->basic_types.type_bool      = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_bool_token, NULL, 0, NULL, context->types.basic[Basic_Kind_Bool]  });
+    context->basic_types.type_i8        = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_i8_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I8]    });
+    context->basic_types.type_u8        = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_u8_token, NULL, 0, NULL, context->types.basic[Basic_Kind_U8]    });
+    context->basic_types.type_i16       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_i16_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I16]   });
+    context->basic_types.type_u16       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_u16_token, NULL, 0, NULL, context->types.basic[Basic_Kind_U16]   });
+    context->basic_types.type_i32       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_i32_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I32]   });
+    context->basic_types.type_u32       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_u32_token, NULL, 0, NULL, context->types.basic[Basic_Kind_U32]   });
+    context->basic_types.type_i64       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_i64_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I64]   });
+    context->basic_types.type_u64       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_u64_token, NULL, 0, NULL, context->types.basic[Basic_Kind_U64]   });
+    context->basic_types.type_f32       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_f32_token, NULL, 0, NULL, context->types.basic[Basic_Kind_F32]   });
+    context->basic_types.type_f64       = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_f64_token, NULL, 0, NULL, context->types.basic[Basic_Kind_F64]   });
+    context->basic_types.type_rawptr    = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_rawptr_token, NULL, 0, NULL, context->types.basic[Basic_Kind_Rawptr] });
+    context->basic_types.type_type_expr = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &basic_type_type_expr_token, NULL, 0, NULL, context->types.basic[Basic_Kind_Type_Index] });
 
     // NOTE: Types used for numeric literals
-    context->basic_types.type_int_unsized   = ((AstBasicType) { Ast_Kind_Basic_Type, 0, NULL, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Int_Unsized] });
-    context->basic_types.type_float_unsized = ((AstBasicType) { Ast_Kind_Basic_Type, 0, NULL, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Float_Unsized] });
+    context->basic_types.type_int_unsized   = ((AstBasicType) { Ast_Kind_Basic_Type, 0, 0, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Int_Unsized] });
+    context->basic_types.type_float_unsized = ((AstBasicType) { Ast_Kind_Basic_Type, 0, 0, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_Float_Unsized] });
 
-    context->basic_types.type_i8x16 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I8X16] });
-    context->basic_types.type_i16x8 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I16X8] });
-    context->basic_types.type_i32x4 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I32X4] });
-    context->basic_types.type_i64x2 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_I64X2] });
-    context->basic_types.type_f32x4 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_F32X4] });
-    context->basic_types.type_f64x2 = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_F64X2] });
-    context->basic_types.type_v128  = ((AstBasicType) { Ast_Kind_Basic_Type, Ast_Flag_Comptime, &simd_token, NULL, NULL, 0, NULL, context->types.basic[Basic_Kind_V128]  });
+    context->basic_types.type_i8x16 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I8X16] });
+    context->basic_types.type_i16x8 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I16X8] });
+    context->basic_types.type_i32x4 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I32X4] });
+    context->basic_types.type_i64x2 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_I64X2] });
+    context->basic_types.type_f32x4 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_F32X4] });
+    context->basic_types.type_f64x2 = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_F64X2] });
+    context->basic_types.type_v128  = ((AstBasicType) { Ast_Kind_Basic_Type, 0, Ast_Flag_Comptime, &simd_token, NULL, 0, NULL, context->types.basic[Basic_Kind_V128]  });
 
     // HACK
     // :AutoReturnType
     context->types.auto_return = bh_alloc_item(context->ast_alloc, Type);
-    context->basic_types.type_auto_return = ((AstBasicType) { Ast_Kind_Basic_Type, 0, &simd_token, NULL, NULL, 0, NULL, context->types.auto_return });
+    context->basic_types.type_auto_return = ((AstBasicType) { Ast_Kind_Basic_Type, 0, 0, &simd_token, NULL, 0, NULL, context->types.auto_return });
 
     // Builtins
-    context->builtins.heap_start   = ((AstGlobal) { Ast_Kind_Global, Ast_Flag_Const, &builtin_heap_start_token, NULL, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
-    context->builtins.stack_top    = ((AstGlobal) { Ast_Kind_Global, 0, &builtin_stack_top_token, NULL, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
-    context->builtins.tls_base     = ((AstGlobal) { Ast_Kind_Global, 0, &builtin_tls_base_token, NULL, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
-    context->builtins.tls_size     = ((AstGlobal) { Ast_Kind_Global, 0, &builtin_tls_size_token, NULL, NULL, (AstType *) &context->basic_types.type_u32, NULL });
-    context->builtins.closure_base = ((AstGlobal) { Ast_Kind_Global, 0, &builtin_closure_base_token, NULL, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
-    context->builtins.stack_trace  = ((AstGlobal) { Ast_Kind_Global, 0, &builtin_stack_trace_token, NULL, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
+    context->builtins.heap_start   = ((AstGlobal) { Ast_Kind_Global, 0, Ast_Flag_Const, &builtin_heap_start_token, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
+    context->builtins.stack_top    = ((AstGlobal) { Ast_Kind_Global, 0, 0, &builtin_stack_top_token, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
+    context->builtins.tls_base     = ((AstGlobal) { Ast_Kind_Global, 0, 0, &builtin_tls_base_token, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
+    context->builtins.tls_size     = ((AstGlobal) { Ast_Kind_Global, 0, 0, &builtin_tls_size_token, NULL, (AstType *) &context->basic_types.type_u32, NULL });
+    context->builtins.closure_base = ((AstGlobal) { Ast_Kind_Global, 0, 0, &builtin_closure_base_token, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
+    context->builtins.stack_trace  = ((AstGlobal) { Ast_Kind_Global, 0, 0, &builtin_stack_trace_token, NULL, (AstType *) &context->basic_types.type_rawptr, NULL });
 
     context->node_that_signals_a_yield.kind = Ast_Kind_Function;
 }
@@ -29,6 +29,7 @@
         ONYX_ERROR(loc, Error_Waiting_On, msg); \
         return Check_Error; \
     } else { \
+        entity_note_yield(context); \
         return Check_Yield; \
     } \
     } while (0)
@@ -38,15 +39,23 @@
         ONYX_ERROR(loc, Error_Waiting_On, msg, __VA_ARGS__); \
         return Check_Error; \
     } else { \
+        entity_note_yield(context); \
         return Check_Yield; \
     } \
     } while (0)
 
+// Yields without a message, when there is nothing to report even if a cycle is found.
+#define YIELD_AGAIN() do { \
+    entity_note_yield(context); \
+    return Check_Yield; \
+    } while (0)
+
 #define YIELD_ERROR(loc, msg) do { \
     if (context->cycle_detected) { \
         ONYX_ERROR(loc, Error_Critical, msg); \
         return Check_Error; \
     } else { \
+        entity_note_yield(context); \
         return Check_Yield; \
     } \
     } while (0)
@@ -56,6 +65,7 @@
         ONYX_ERROR(loc, Error_Critical, msg, __VA_ARGS__); \
         return Check_Error; \
     } else { \
+        entity_note_yield(context); \
         return Check_Yield; \
     } \
     } while (0)
@@ -200,23 +210,22 @@ static void reset_statement_idx_on_all_blocks(Context *context, AstBlock *block)
 }
 
 CHECK_FUNC(symbol, AstNode** symbol_node) {
-    if (mode_enabled(context, CM_Dont_Resolve_Symbols)) return Check_Yield;
+    if (mode_enabled(context, CM_Dont_Resolve_Symbols)) YIELD_AGAIN();
 
     OnyxToken* token = (*symbol_node)->token;
     AstNode* res = symbol_resolve(context, context->checker.current_scope, token);
 
     if (!res) {
         if (context->cycle_detected) {
-            token_toggle_end(token);
-            char *closest = find_closest_symbol_in_scope_and_parents(context, context->checker.current_scope, token->text);
-            token_toggle_end(token);
+            char *closest = find_closest_symbol_in_scope_and_parents(context, context->checker.current_scope, token_atom(context, token));
 
             if (closest) ERROR_(token->pos, "Unable to resolve symbol '%b'. Did you mean '%s'?", token->text, token->length, closest);
             else         ERROR_(token->pos, "Unable to resolve symbol '%b'.", token->text, token->length);
 
             return Check_Error;
         } else {
-            return Check_Yield;
+            entity_wait_on_symbol(context, token);
+            YIELD_AGAIN();
         }
 
     } else {
@@ -331,6 +340,7 @@ retry_return_expr_check:
 CHECK_FUNC(if, AstIfWhile* ifnode) {
     if (ifnode->kind == Ast_Kind_Static_If) {
         if ((ifnode->flags & Ast_Flag_Static_If_Resolved) == 0) {
+            entity_wait_on(context, ast_entity(context, ifnode));
             YIELD(ifnode->token->pos, "Waiting for static if to be resolved.");
         }
 
@@ -951,6 +961,7 @@ CHECK_FUNC(resolve_callee, AstCall* call, AstTyped** effective_callee) {
     // NOTE: Build callee's type
     fill_in_type(context, (AstTyped *) callee);
     if (callee->type == NULL) {
+        if (callee->kind == Ast_Kind_Function) entity_wait_on(context, ((AstFunction *) callee)->entity_header);
         YIELD(call->token->pos, "Trying to resolve function type for callee.");
     }
 
@@ -1045,10 +1056,12 @@ CHECK_FUNC(call, AstCall** pcall) {
 
             callsite->callsite_token = call->token;
 
+            OnyxFileLocation location = file_pos_location(call->token->pos);
+
             // HACK CLEANUP
             OnyxToken* str_token = bh_alloc(context->ast_alloc, sizeof(OnyxToken));
-            str_token->text  = bh_strdup(context->gp_alloc, (char *) call->token->pos.filename);
-            str_token->length = strlen(call->token->pos.filename);
+            str_token->text  = bh_strdup(context->gp_alloc, (char *) location.filename);
+            str_token->length = strlen(location.filename);
             str_token->pos = call->token->pos;
             str_token->type = Token_Type_Literal_String;
 
@@ -1062,8 +1075,8 @@ CHECK_FUNC(call, AstCall** pcall) {
             add_entities_for_node(&context->entities, NULL, (AstNode *) filename, NULL, NULL);
             callsite->filename = filename;
 
-            callsite->line   = make_int_literal(context, call->token->pos.line);
-            callsite->column = make_int_literal(context, call->token->pos.column);
+            callsite->line   = make_int_literal(context, location.line);
+            callsite->column = make_int_literal(context, location.column);
 
             convert_numlit_to_type(context, callsite->line,   context->types.basic[Basic_Kind_U32], 1);
             convert_numlit_to_type(context, callsite->column, context->types.basic[Basic_Kind_U32], 1);
@@ -1079,8 +1092,7 @@ CHECK_FUNC(call, AstCall** pcall) {
         call->kind = Ast_Kind_Intrinsic_Call;
         call->callee = NULL;
 
-        token_toggle_end(callee->intrinsic_name);
-        char* intr_name = callee->intrinsic_name->text;
+        char* intr_name = token_atom(context, callee->intrinsic_name);
 
         OnyxIntrinsic intrinsic = 0xffffffff;
         const IntrinsicMap *im = &builtin_intrinsics[0];
@@ -1094,18 +1106,16 @@ CHECK_FUNC(call, AstCall** pcall) {
 
         if (intrinsic == 0xffffffff) {
             ONYX_ERROR(callee->token->pos, Error_Critical, "Intrinsic not supported, '%s'.", intr_name);
-            token_toggle_end(callee->intrinsic_name);
             return Check_Error;
         }
 
         call->intrinsic = intrinsic;
-
-        token_toggle_end(callee->intrinsic_name);
     }
 
     call->va_kind = VA_Kind_Not_VA;
     call->type = callee->type->Function.return_type;
     if (call->type == context->types.auto_return && call->callee->kind != Ast_Kind_Macro) {
+        if (callee->kind == Ast_Kind_Function) entity_wait_on(context, callee->entity_body);
         YIELD(call->token->pos, "Waiting for auto-return type to be solved.");
     }
 
@@ -1127,7 +1137,7 @@ CHECK_FUNC(call, AstCall** pcall) {
 
     if (call->kind == Ast_Kind_Call && call->callee->kind == Ast_Kind_Macro) {
         expand_macro(context, pcall, callee);
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     if (callee->kind == Ast_Kind_Function && callee->deprecated_warning) {
@@ -1148,7 +1158,10 @@ static void report_bad_binaryop(Context *context, AstBinaryOp* binop) {
 }
 
 static AstCall* binaryop_try_operator_overload(Context *context, AstBinaryOp* binop, AstTyped* third_argument) {
-    if (bh_arr_length(context->operator_overloads[binop->operation]) == 0) return &context->checker.__op_maybe_overloaded;
+    if (bh_arr_length(context->operator_overloads[binop->operation]) == 0) {
+        if (context->held.holding) held_files_note_overload_decision(context, context->operator_overloads[binop->operation], NULL, NULL);
+        return &context->checker.__op_maybe_overloaded;
+    }
 
     if (binop->overload_args == NULL || binop->overload_args->values[1] == NULL) {
         if (binop->overload_args == NULL) {
@@ -1193,7 +1206,10 @@ static AstCall* binaryop_try_operator_overload(Context *context, AstBinaryOp* bi
 }
 
 static AstCall* unaryop_try_operator_overload(Context *context, AstUnaryOp* unop) {
-    if (bh_arr_length(context->unary_operator_overloads[unop->operation]) == 0) return &context->checker.__op_maybe_overloaded;
+    if (bh_arr_length(context->unary_operator_overloads[unop->operation]) == 0) {
+        if (context->held.holding) held_files_note_overload_decision(context, context->unary_operator_overloads[unop->operation], NULL, NULL);
+        return &context->checker.__op_maybe_overloaded;
+    }
 
     if (unop->overload_args == NULL || unop->overload_args->values[0] == NULL) {
         if (unop->overload_args == NULL) {
@@ -1263,7 +1279,7 @@ CHECK_FUNC(binaryop_assignment, AstBinaryOp** pbinop) {
         // If a left operand has an unknown type, fill it in with the type of
         // the right hand side.
         if (binop->left->type == NULL) {
-            if (binop->left->type_node != NULL && binop->left->entity && binop->left->entity->state <= Entity_State_Check_Types) {
+            if (binop->left->type_node != NULL && ast_entity(context, binop->left) && ast_entity(context, binop->left)->state <= Entity_State_Check_Types) {
                 YIELD(binop->token->pos, "Waiting for type to be constructed on left hand side.");
             }
 
@@ -1275,7 +1291,7 @@ CHECK_FUNC(binaryop_assignment, AstBinaryOp** pbinop) {
 
             Type* right_type = get_expression_type(context, binop->right);
             if (right_type == NULL) {
-                if (binop->right->entity == NULL || binop->right->entity->state > Entity_State_Check_Types) {
+                if (ast_entity(context, binop->right) == NULL || ast_entity(context, binop->right)->state > Entity_State_Check_Types) {
                     ERROR(binop->token->pos, "Could not resolve type of right hand side to infer.");
 
                 } else {
@@ -1351,7 +1367,7 @@ CHECK_FUNC(binaryop_assignment, AstBinaryOp** pbinop) {
     }
 
     if (binop->right->type == NULL) {
-        if (binop->right->entity != NULL && binop->right->entity->state <= Entity_State_Check_Types) {
+        if (ast_entity(context, binop->right) != NULL && ast_entity(context, binop->right)->state <= Entity_State_Check_Types) {
             YIELD(binop->token->pos, "Trying to resolve type of right hand side.");
         }
     }
@@ -1616,10 +1632,10 @@ CHECK_FUNC(binaryop, AstBinaryOp** pbinop) {
 
     if (binop_is_assignment(binop->operation)) return check_binaryop_assignment(context, pbinop);
 
-    if (binop->left->type == NULL && binop->left->entity && binop->left->entity->state <= Entity_State_Check_Types) {
+    if (binop->left->type == NULL && ast_entity(context, binop->left) && ast_entity(context, binop->left)->state <= Entity_State_Check_Types) {
         YIELD(binop->left->token->pos, "Waiting for this type to be known");
     }
-    if (binop->right->type == NULL && binop->right->entity && binop->right->entity->state <= Entity_State_Check_Types) {
+    if (binop->right->type == NULL && ast_entity(context, binop->right) && ast_entity(context, binop->right)->state <= Entity_State_Check_Types) {
         YIELD(binop->right->token->pos, "Waiting for this type to be known");
     }
 
@@ -1850,12 +1866,9 @@ CHECK_FUNC(struct_literal, AstStructLiteral* sl) {
         }
 
         AstNamedValue* value = sl->args.named_values[0];
-        token_toggle_end(value->token);
-
         UnionVariant *matched_variant = union_type->Union.variants[
-            shgeti(union_type->Union.variants, value->token->text)
+            shgeti(union_type->Union.variants, token_atom(context, value->token))
         ].value;
-        token_toggle_end(value->token);
 
         if (!matched_variant) {
             ERROR_(value->token->pos, "'%b' is not a variant of '%s'.",
@@ -2013,6 +2026,7 @@ CHECK_FUNC(struct_literal, AstStructLiteral* sl) {
     sl->flags |= Ast_Flag_Has_Been_Checked;
 
     if (!type_is_ready_for_lookup(sl->type)) {
+        entity_wait_on_type(context, sl->type);
         YIELD(sl->token->pos, "Waiting for structure type to be ready.");
     }
 
@@ -2032,7 +2046,7 @@ CHECK_FUNC(struct_literal, AstStructLiteral* sl) {
         Type* formal = smem.type;
 
         CHECK(expression, actual);
-        if ((*actual)->type == NULL && (*actual)->entity != NULL && (*actual)->entity->state <= Entity_State_Check_Types) {
+        if ((*actual)->type == NULL && ast_entity(context, *actual) != NULL && ast_entity(context, *actual)->state <= Entity_State_Check_Types) {
             YIELD((*actual)->token->pos, "Trying to resolve type of expression for member.");
         }
 
@@ -2101,8 +2115,8 @@ CHECK_FUNC(array_literal, AstArrayLiteral* al) {
     bh_arr_each(AstTyped *, expr, al->values) {
         // HACK HACK HACK
         if ((*expr)->type == NULL &&
-            (*expr)->entity != NULL &&
-            (*expr)->entity->state <= Entity_State_Check_Types) {
+            ast_entity(context, *expr) != NULL &&
+            ast_entity(context, *expr)->state <= Entity_State_Check_Types) {
             YIELD_(al->token->pos, "Trying to resolve type of %d%s element of array literal.", expr - al->values, bh_num_suffix(expr - al->values));
         }
 
@@ -2399,7 +2413,7 @@ CHECK_FUNC(address_of, AstAddressOf** paof) {
 
         if (aof->can_be_removed) {
             *(AstTyped **) paof = aof->expr;
-            return Check_Yield;
+            YIELD_AGAIN();
         }
 
         ERROR_(aof->token->pos, "Cannot take the address of something that is not an l-value. %s", onyx_ast_node_kind_string(expr->kind));
@@ -2513,9 +2527,7 @@ CHECK_FUNC(field_access, AstFieldAccess** pfield) {
     if (field->flags & Ast_Flag_Has_Been_Checked) return Check_Success;
 
     if (field->token != NULL && field->field == NULL) {
-        token_toggle_end(field->token);
-        field->field = bh_strdup(context->ast_alloc, field->token->text);
-        token_toggle_end(field->token);
+        field->field = token_atom(context, field->token);
     }
 
     //
@@ -2564,11 +2576,12 @@ CHECK_FUNC(field_access, AstFieldAccess** pfield) {
     }
 
     if (!type_is_ready_for_lookup(field->expr->type)) {
+        entity_wait_on_type(context, field->expr->type);
         YIELD(field->token->pos, "Waiting for struct type to be completed before looking up members.");
     }
 
     StructMember smem;
-    if (!type_lookup_member(context, field->expr->type, field->field, &smem)) {
+    if (!type_lookup_member_atom(context, field->expr->type, field->field, &smem)) {
         if (field->expr->type->kind == Type_Kind_Array) {
             u32 field_count = field->expr->type->Array.count;
 
@@ -2678,12 +2691,12 @@ CHECK_FUNC(field_access, AstFieldAccess** pfield) {
   try_resolve_from_type:
     type_node = field->expr->type->ast_type;
 
-    n = try_symbol_raw_resolve_from_type(context, field->expr->type, field->field);
+    n = try_symbol_atom_resolve_from_type(context, field->expr->type, field->field);
     if (n) goto resolved;
 
   try_resolve_from_node:
     type_node = NULL;
-    n = try_symbol_raw_resolve_from_node(context, (AstNode *) field->expr, field->field);
+    n = try_symbol_atom_resolve_from_node(context, (AstNode *) field->expr, field->field);
 
   resolved:
     if (n) {
@@ -2700,9 +2713,14 @@ CHECK_FUNC(field_access, AstFieldAccess** pfield) {
     // this reason, I have to produce an error at the last minute, BEFORE the loop
     // enters a cycle detected state, when there is no point of return.
     if (!context->cycle_almost_detected && !context->cycle_detected) {
+        // Members of a package can only appear by being introduced into its scope.
+        if (expr->kind == Ast_Kind_Package) {
+            entity_wait_on_symbol(context, field->token);
+        }
+
         // Skipping the slightly expensive symbol lookup
         // below by not using YIELD_ERROR.
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     if (expr->kind == Ast_Kind_Package) {
@@ -2729,7 +2747,7 @@ CHECK_FUNC(field_access, AstFieldAccess** pfield) {
             }
         }
 
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     if (context->cycle_detected || context->cycle_almost_detected >= 2) {
@@ -2838,7 +2856,7 @@ CHECK_FUNC(method_call, AstBinaryOp** pmcall) {
     if (mcall->right->kind != Ast_Kind_Call) {
         *pmcall = (AstBinaryOp *) mcall->right;
         // CHECK(expression, (AstCall **) pmcall);
-        return Check_Yield;
+        YIELD_AGAIN();
 
     } else {
         CHECK(call, (AstCall **) &mcall->right);
@@ -3026,7 +3044,7 @@ CHECK_FUNC(expression, AstTyped** pexpr) {
 
         case Ast_Kind_NumLit:
             if (!expr->type) {
-                return Check_Yield;
+                YIELD_AGAIN();
             }
             break;
 
@@ -3046,8 +3064,10 @@ CHECK_FUNC(expression, AstTyped** pexpr) {
                 ((AstFunction *) expr)->scope_to_lookup_captured_values = context->checker.current_scope;
             }
 
-            if (expr->type == NULL)
+            if (expr->type == NULL) {
+                entity_wait_on(context, ((AstFunction *) expr)->entity_header);
                 YIELD(expr->token->pos, "Waiting for function type to be resolved.");
+            }
 
             break;
 
@@ -3085,8 +3105,9 @@ CHECK_FUNC(expression, AstTyped** pexpr) {
             // Otherwise, there can be weird cases where symbols resolve
             // incorrectly because they are being checked in the wrong scope.
             //
-            if (alias->entity && context->checker.current_entity != alias->entity) {
-                if (alias->entity->state < Entity_State_Code_Gen) {
+            if (ast_entity(context, alias) && context->checker.current_entity != ast_entity(context, alias)) {
+                if (ast_entity(context, alias)->state < Entity_State_Code_Gen) {
+                    entity_wait_on(context, ast_entity(context, alias));
                     YIELD(expr->token->pos, "Waiting for alias to pass type checking.");
                 }
             } else {
@@ -3120,7 +3141,13 @@ CHECK_FUNC(expression, AstTyped** pexpr) {
         }
 
         case Ast_Kind_Memres:
-            if (expr->type == NULL || expr->type->kind == Type_Kind_Invalid) YIELD(expr->token->pos, "Waiting to know globals type.");
+            if (expr->type == NULL || expr->type->kind == Type_Kind_Invalid) {
+                // The type comes from the type entity if the global has a type, and from the
+                // global's own entity if it is inferred from its initial value.
+                entity_wait_on(context, ((AstMemRes *) expr)->type_entity);
+                entity_wait_on(context, ast_entity(context, expr));
+                YIELD(expr->token->pos, "Waiting to know globals type.");
+            }
             break;
 
         case Ast_Kind_Directive_First:
@@ -3223,7 +3250,7 @@ CHECK_FUNC(insert_directive, AstDirectiveInsert** pinsert, b32 expected_expressi
 
     CHECK(expression, &insert->code_expr);
     if (insert->code_expr->type == NULL) {
-        if (insert->code_expr->entity && insert->code_expr->entity->state >= Entity_State_Code_Gen) {
+        if (ast_entity(context, insert->code_expr) && ast_entity(context, insert->code_expr)->state >= Entity_State_Code_Gen) {
             ERROR(insert->token->pos, "Expected expression of type 'Code'.");
         }
 
@@ -3336,7 +3363,7 @@ CHECK_FUNC(insert_directive, AstDirectiveInsert** pinsert, b32 expected_expressi
 
     insert->flags |= Ast_Flag_Has_Been_Checked;
 
-    return Check_Yield;
+    YIELD_AGAIN();
 }
 
 CHECK_FUNC(directive_defined, AstDirectiveDefined** pdefined) {
@@ -3349,6 +3376,7 @@ CHECK_FUNC(directive_defined, AstDirectiveDefined** pdefined) {
     onyx_errors_disable(context);
     context->checker.resolved_a_symbol = 0;
 
+    b32 untracked_yield = context->checker.untracked_yield;
     CheckStatus ss = check_expression(context, &defined->expr);
     if (has_to_be_resolved && ss != Check_Success && !context->checker.resolved_a_symbol) {
         // The symbol definitely was not found and there is no chance that it could be found.
@@ -3366,7 +3394,15 @@ CHECK_FUNC(directive_defined, AstDirectiveDefined** pdefined) {
     }
 
     onyx_errors_enable(context);
-    return Check_Yield;
+
+    // If nothing in the expression resolved, the answer cannot change until everything
+    // else has stalled, so the yields of the expression itself do not matter.
+    if (!context->checker.resolved_a_symbol) {
+        context->checker.untracked_yield = untracked_yield;
+        entity_wait_on_stall(context);
+    }
+
+    YIELD_AGAIN();
 }
 
 CHECK_FUNC(directive_solidify, AstDirectiveSolidify** psolid) {
@@ -3376,7 +3412,7 @@ CHECK_FUNC(directive_solidify, AstDirectiveSolidify** psolid) {
 
     if (solid->poly_proc && solid->poly_proc->kind == Ast_Kind_Directive_Solidify) {
         AstFunction* potentially_resolved_proc = (AstFunction *) ((AstDirectiveSolidify *) solid->poly_proc)->resolved_proc;
-        if (!potentially_resolved_proc) return Check_Yield;
+        if (!potentially_resolved_proc) YIELD_AGAIN();
 
         solid->poly_proc = potentially_resolved_proc;
     }
@@ -3438,7 +3474,7 @@ CHECK_FUNC(directive_export_name, AstDirectiveExportName *ename) {
     // to make string literals, tokens, exports, etc...
     if (ename->func->exported_name == NULL) {
         if (ename->created_export_entity) {
-            return Check_Yield;
+            YIELD_AGAIN();
         }
 
         // In this case, we know the function is not exported.
@@ -3471,7 +3507,7 @@ CHECK_FUNC(directive_export_name, AstDirectiveExportName *ename) {
         add_entities_for_node(&context->entities, NULL, (AstNode *) export, NULL, NULL);
 
         ename->created_export_entity = 1;
-        return Check_Yield;
+        YIELD_AGAIN();
 
     } else {
         AstStrLit* name = bh_alloc_item(context->ast_alloc, AstStrLit);
@@ -3728,6 +3764,7 @@ CHECK_FUNC(function, AstFunction* func) {
 
     if (func->flags & Ast_Flag_Has_Been_Checked) return Check_Success;
     if (!func->ready_for_body_to_be_checked || !func->type) {
+        entity_wait_on(context, func->entity_header);
         YIELD(func->token->pos, "Waiting for procedure header to pass type-checking");
     }
 
@@ -3777,9 +3814,12 @@ CHECK_FUNC(function, AstFunction* func) {
                         st = param->local->type->Pointer.elem;
                     }
 
-                    if (st->Struct.status != SPS_Uses_Done) return Check_Yield;
+                    if (st->Struct.status != SPS_Uses_Done) {
+                        entity_wait_on_type(context, st);
+                        YIELD_AGAIN();
+                    }
 
-                    fori (i, 0, shlen(st->Struct.members)) {
+                    fori (i, 0, hmlen(st->Struct.members)) {
                         StructMember* value = st->Struct.members[i].value;
                         AstFieldAccess* fa = make_field_access(context, (AstTyped *) param->local, value->name);
                         symbol_raw_introduce(context, context->checker.current_scope, value->name, param->local->token->pos, (AstNode *) fa);
@@ -4035,7 +4075,7 @@ CHECK_FUNC(enum, AstEnumType* enum_node) {
                 n_value->type = enum_node->etcache;
 
             } else {
-                if (value->entity == NULL) {
+                if (ast_entity(context, value) == NULL) {
                     add_entities_for_node(&context->entities, NULL, (AstNode *) value, enum_node->scope, NULL);
                 }
 
@@ -4131,7 +4171,7 @@ CHECK_FUNC(struct, AstStructType* s_node) {
         s_node->constraints.produce_errors = (s_node->flags & Ast_Flag_Header_Check_No_Error) == 0;
 
         OnyxFilePos pos = s_node->token->pos;
-        if (s_node->polymorphic_error_loc.filename) {
+        if (s_node->polymorphic_error_loc.file_id) {
             pos = s_node->polymorphic_error_loc;
         }
 
@@ -4197,8 +4237,10 @@ CHECK_FUNC(struct, AstStructType* s_node) {
 }
 
 CHECK_FUNC(struct_defaults, AstStructType* s_node) {
-    if (s_node->entity_type && s_node->entity_type->state < Entity_State_Code_Gen)
+    if (s_node->entity_type && s_node->entity_type->state < Entity_State_Code_Gen) {
+        entity_wait_on(context, s_node->entity_type);
         YIELD(s_node->token->pos, "Waiting for struct type to be constructed before checking defaulted members.");
+    }
     if (s_node->entity_type && s_node->entity_type->state == Entity_State_Failed)
         return Check_Failed;
 
@@ -4289,7 +4331,7 @@ CHECK_FUNC(union, AstUnionType *u_node) {
         u_node->constraints.produce_errors = (u_node->flags & Ast_Flag_Header_Check_No_Error) == 0;
 
         OnyxFilePos pos = u_node->token->pos;
-        if (u_node->polymorphic_error_loc.filename) {
+        if (u_node->polymorphic_error_loc.file_id) {
             pos = u_node->polymorphic_error_loc;
         }
         CHECK(constraint_context, &u_node->constraints, u_node->scope, pos);
@@ -4345,7 +4387,7 @@ CHECK_FUNC(function_header, AstFunction* func) {
     if (func->captures && !func->scope_to_lookup_captured_values) {
         if (func->flags & Ast_Flag_Function_Is_Lambda_Inside_PolyProc) return Check_Complete;
 
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     b32 expect_default_param = 0;
@@ -4395,7 +4437,7 @@ CHECK_FUNC(function_header, AstFunction* func) {
         }
     }
 
-    if (func->nodes_that_need_entities_after_clone && bh_arr_length(func->nodes_that_need_entities_after_clone) > 0 && func->entity) {
+    if (func->nodes_that_need_entities_after_clone && bh_arr_length(func->nodes_that_need_entities_after_clone) > 0 && ast_entity(context, func)) {
         bh_arr_each(AstNode *, node, func->nodes_that_need_entities_after_clone) {
             // This makes a lot of assumptions about how these nodes are being processed,
             // and I don't want to start using this with other nodes without considering
@@ -4417,7 +4459,7 @@ CHECK_FUNC(function_header, AstFunction* func) {
                 }
             }
 
-            add_entities_for_node(&context->entities, NULL, *node, scope, func->entity->package);
+            add_entities_for_node(&context->entities, NULL, *node, scope, ast_entity(context, func)->package);
         }
 
         bh_arr_set_length(func->nodes_that_need_entities_after_clone, 0);
@@ -4583,14 +4625,14 @@ CHECK_FUNC(memres, AstMemRes* memres) {
 
         } else {
             resolve_expression_type(context, memres->initial_value);
-            if (memres->initial_value->type == NULL && memres->initial_value->entity != NULL && memres->initial_value->entity->state <= Entity_State_Check_Types) {
+            if (memres->initial_value->type == NULL && ast_entity(context, memres->initial_value) != NULL && ast_entity(context, memres->initial_value)->state <= Entity_State_Check_Types) {
                 YIELD(memres->token->pos, "Waiting for global type to be constructed.");
             }
             memres->type = memres->initial_value->type;
         }
 
         if ((memres->initial_value->flags & Ast_Flag_Comptime) == 0) {
-            if (memres->initial_value->entity != NULL && memres->initial_value->entity->state <= Entity_State_Check_Types) {
+            if (ast_entity(context, memres->initial_value) != NULL && ast_entity(context, memres->initial_value)->state <= Entity_State_Check_Types) {
                 YIELD(memres->token->pos, "Waiting for initial value to be checked.");
             }
 
@@ -4819,12 +4861,14 @@ CHECK_FUNC(static_if, AstIf* static_if) {
 
     b32 resolution = static_if_resolution(context, static_if);
 
-    if (context->options->print_static_if_results)
+    if (context->options->print_static_if_results) {
+        OnyxFileLocation location = file_pos_location(static_if->token->pos);
         bh_printf("Static if statement at %s:%d:%d resulted in %s\n",
-            static_if->token->pos.filename,
-            static_if->token->pos.line,
-            static_if->token->pos.column,
+            location.filename,
+            location.line,
+            location.column,
             resolution ? "true" : "false");
+    }
 
     if (resolution) {
         bh_arr_each(Entity *, ent, static_if->true_entities) {
@@ -4878,7 +4922,7 @@ CHECK_FUNC(process_directive, AstNode* directive) {
 
         add_overload->overload->flags &= ~Ast_Flag_Function_Is_Lambda;
 
-        add_overload_option(&ofunc->overloads, add_overload->order, add_overload->overload);
+        add_overload_option(context, &ofunc->overloads, add_overload->order, add_overload->overload);
         return Check_Success;
     }
 
@@ -4916,7 +4960,7 @@ CHECK_FUNC(process_directive, AstNode* directive) {
                 ERROR(operator->token->pos, "Unknown operator.");
             }
 
-            add_overload_option(&context->unary_operator_overloads[unop], operator->order, operator->overload);
+            add_overload_option(context, &context->unary_operator_overloads[unop], operator->order, operator->overload);
             return Check_Success;
         }
 
@@ -4924,7 +4968,7 @@ CHECK_FUNC(process_directive, AstNode* directive) {
             ERROR(operator->token->pos, "Expected exactly 2 arguments for binary operator overload.");
         }
 
-        add_overload_option(&context->operator_overloads[operator->operator], operator->order, operator->overload);
+        add_overload_option(context, &context->operator_overloads[operator->operator], operator->order, operator->overload);
         return Check_Success;
     }
 
@@ -4952,8 +4996,10 @@ CHECK_FUNC(process_directive, AstNode* directive) {
             }
         }
 
-        if (exported->entity && exported->entity->state <= Entity_State_Check_Types)
+        if (ast_entity(context, exported) && ast_entity(context, exported)->state <= Entity_State_Check_Types) {
+            entity_wait_on(context, ast_entity(context, exported));
             YIELD(directive->token->pos, "Waiting for exported type to be known.");
+        }
 
         if (exported->kind != Ast_Kind_Function) {
             ONYX_ERROR(export->token->pos, Error_Critical, "Cannot export something that is not a procedure.");
@@ -5003,8 +5049,8 @@ CHECK_FUNC(process_directive, AstNode* directive) {
                     ERROR_(init->token->pos, "All dependencies of an #init must be another #init. The %d%s dependency was not.", i + 1, bh_num_suffix(i + 1));
                 }
 
-                assert(d->entity);
-                if (d->entity->state != Entity_State_Finalized) {
+                assert(ast_entity(context, d));
+                if (ast_entity(context, d)->state != Entity_State_Finalized) {
                     YIELD(init->token->pos, "Circular dependency in #init nodes. Here are the nodes involved.");
                 }
 
@@ -5107,7 +5153,7 @@ CHECK_FUNC(process_directive, AstNode* directive) {
         u32 content_length = string_process_escape_seqs(temp_str, symbol->token->text, symbol->token->length);
 
         if (section->from_file) {
-            const char *containing_filename = section->token->pos.filename;
+            const char *containing_filename = file_pos_filename(section->token->pos);
             char *parent_folder = bh_path_get_parent(containing_filename, context->scratch_alloc);
 
             char *path = bh_strdup(
@@ -5119,6 +5165,8 @@ CHECK_FUNC(process_directive, AstNode* directive) {
                 ERROR_(section->token->pos, "Failed to open file '%s' for custom section.", path);
             }
 
+            held_files_note_dependency(context, path);
+
             bh_file_contents contents = bh_file_read_contents(context->gp_alloc, path);
             section->contents = contents.data;
             section->length = contents.length;
@@ -5190,9 +5238,9 @@ CHECK_FUNC(interface_constraint, AstConstraint *constraint) {
         bh_arr_push(constraint->exprs, new_ic);
     }
 
-    assert(constraint->interface->entity && constraint->interface->entity->scope);
+    assert(ast_entity(context, constraint->interface) && ast_entity(context, constraint->interface)->scope);
     assert(constraint->interface->scope);
-    assert(constraint->interface->scope->parent == constraint->interface->entity->scope);
+    assert(constraint->interface->scope->parent == ast_entity(context, constraint->interface)->scope);
 
     if (constraint->scope == NULL) {
         constraint->scope = scope_create(context, constraint->interface->scope, constraint->token->pos);
@@ -5231,11 +5279,11 @@ CHECK_FUNC(interface_constraint, AstConstraint *constraint) {
         symbol_introduce(context, constraint->scope, is->name, (AstNode *) sentinel);
     }
 
-    assert(constraint->entity);
-    constraint->entity->scope = constraint->scope;
+    assert(ast_entity(context, constraint));
+    ast_entity(context, constraint)->scope = constraint->scope;
 
     constraint->phase = Constraint_Phase_Checking_Expressions;
-    return Check_Yield;
+    YIELD_AGAIN();
 }
 
 CHECK_FUNC(expression_constraint, AstConstraint *constraint) {
@@ -5391,9 +5439,7 @@ CHECK_FUNC(constraint_context, ConstraintContext *cc, Scope *scope, OnyxFilePos
                         if (i != 0) strncat(constraint_map, ", ", 511);
 
                         OnyxToken* symbol = constraint->interface->params[i].value_token;
-                        token_toggle_end(symbol);
-                        strncat(constraint_map, symbol->text, 511);
-                        token_toggle_end(symbol);
+                        strncat(constraint_map, token_atom(context, symbol), 511);
 
                         strncat(constraint_map, " is of type '", 511);
                         strncat(constraint_map, type_get_name(context, type_build_from_ast(context, (AstType *) constraint->args[i])), 511);
@@ -5436,6 +5482,7 @@ CHECK_FUNC(constraint_context, ConstraintContext *cc, Scope *scope, OnyxFilePos
             }
 
             if (cc->constraint_checks[i] == Constraint_Check_Status_Queued) {
+                entity_wait_on(context, ast_entity(context, cc->constraints[i]));
                 YIELD(pos, "Waiting for constraints to be checked.");
             }
         }
@@ -5455,9 +5502,10 @@ CHECK_FUNC(constraint_context, ConstraintContext *cc, Scope *scope, OnyxFilePos
             cc->constraints[i]->phase = Constraint_Phase_Cloning_Expressions;
 
             add_entities_for_node(&context->entities, NULL, (AstNode *) cc->constraints[i], scope, NULL);
+            entity_wait_on(context, ast_entity(context, cc->constraints[i]));
         }
 
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 }
 
@@ -5465,9 +5513,13 @@ CHECK_FUNC(polyquery, AstPolyQuery *query) {
     if (query->function_header->scope == NULL)
         query->function_header->scope = scope_create(context, query->proc->parent_scope_of_poly_proc, query->token->pos);
 
+    // The result of these checks is not used, so neither are the reasons they yielded.
+    b32 untracked_yield = context->checker.untracked_yield;
+
     enable_mode(context, CM_Dont_Resolve_Symbols);
     check_temp_function_header(context, query->function_header);
     disable_mode(context, CM_Dont_Resolve_Symbols);
+    context->checker.untracked_yield = untracked_yield;
 
     scope_enter(context, query->function_header->scope);
 
@@ -5495,6 +5547,8 @@ CHECK_FUNC(polyquery, AstPolyQuery *query) {
             check_type(context, &param->local->type_node);
             param->local->flags &= ~Ast_Flag_Symbol_Invisible;
             onyx_errors_enable(context);
+
+            context->checker.untracked_yield = untracked_yield;
             
             if (context->checker.resolved_a_symbol) {
                 solved_something = 1;
@@ -5528,7 +5582,7 @@ CHECK_FUNC(polyquery, AstPolyQuery *query) {
                 goto poly_var_solved;
 
             case TYPE_MATCH_SPECIAL:
-                return Check_Yield;
+                YIELD_AGAIN();
 
             case TYPE_MATCH_YIELD:
             case TYPE_MATCH_FAILED: {
@@ -5557,7 +5611,7 @@ poly_query_done:
 
     if (solved_count != bh_arr_length(query->proc->poly_params)) {
         if (solved_something) {
-            return Check_Yield;
+            YIELD_AGAIN();
         } else {
             return Check_Failed;
         }
@@ -5572,8 +5626,8 @@ CHECK_FUNC(arbitrary_job, EntityJobData *job) {
     switch (result) {
         case TYPE_MATCH_SUCCESS: return Check_Complete;
         case TYPE_MATCH_FAILED:  return Check_Error;
-        case TYPE_MATCH_YIELD:   return Check_Yield;
-        case TYPE_MATCH_SPECIAL: return Check_Yield;
+        case TYPE_MATCH_YIELD:   YIELD_AGAIN();
+        case TYPE_MATCH_SPECIAL: YIELD_AGAIN();
     }
 
     return Check_Error;
@@ -5646,7 +5700,7 @@ CHECK_FUNC(foreign_block, AstForeignBlock *fb) {
             ent->function->foreign.module_name = fb->module_name;
             ent->function->is_foreign = 1;
             ent->function->is_foreign_dyncall = fb->uses_dyncall;
-            ent->function->entity = NULL;
+            ast_set_entity(ent->function, NULL);
             ent->function->entity_header = NULL;
             ent->function->entity_body = NULL;
 
@@ -5696,10 +5750,8 @@ CHECK_FUNC(include, AstInclude* include) {
 
     OnyxToken* str_token = include->name_node->token;
     if (str_token != NULL) {
-        token_toggle_end(str_token);
-        include->name = bh_strdup(context->ast_alloc, str_token->text);
-        string_process_escape_seqs(include->name, include->name, strlen(include->name));
-        token_toggle_end(str_token);
+        include->name = bh_strdup_len(context->ast_alloc, str_token->text, str_token->length);
+        string_process_escape_seqs(include->name, include->name, str_token->length);
     }
 
     return Check_Goto_Parse;
@@ -5717,7 +5769,7 @@ CHECK_FUNC(import, AstImport* import) {
     }
 
     if (import->specified_imports) {
-        package_track_use_package(context, package->package, import->entity);
+        package_track_use_package(context, package->package, ast_entity(context, import));
 
         Scope *import_scope = package->package->scope;
         if (import_scope == context->checker.current_scope) return Check_Complete;
@@ -5751,16 +5803,18 @@ CHECK_FUNC(compiler_extension, AstCompilerExtension *ext) {
         ERROR(ext->token->pos, "Compiler extensions are disabled in this compilation.");
     }
 
-    token_toggle_end(ext->name);
-    TypeMatch status = compiler_extension_start(context, ext->name->text, ext->token->pos.filename, context->checker.current_entity, &ext->extension_id);
-    token_toggle_end(ext->name);
+    // The extension runs in its own process, which cannot be shared by the compilations
+    // that continue from this one once the held files are released.
+    if (context->held.holding) held_files_conflict(context, ext->token->pos.file_id);
+
+    TypeMatch status = compiler_extension_start(context, token_atom(context, ext->name), file_pos_filename(ext->token->pos), context->checker.current_entity, &ext->extension_id);
 
     if (status == TYPE_MATCH_FAILED) {
         ERROR(ext->token->pos, "Failed to initialize this compiler extension.");
     }
 
     if (status == TYPE_MATCH_YIELD) {
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     return Check_Complete;
@@ -5779,10 +5833,7 @@ CHECK_FUNC(proc_expansion, AstProceduralExpansion **pexp, ProceduralMacroExpansi
 
     AstProceduralMacro *proc_macro = (AstProceduralMacro *) exp->proc_macro;
 
-    token_toggle_end(proc_macro->token);
-    // HACK store this differently so a copy is not necessary here.
-    char *macro_name = bh_strdup(context->scratch_alloc, proc_macro->token->text);
-    token_toggle_end(proc_macro->token);
+    char *macro_name = token_atom(context, proc_macro->token);
 
     AstNode *expansion = NULL;
 
@@ -5802,7 +5853,7 @@ CHECK_FUNC(proc_expansion, AstProceduralExpansion **pexp, ProceduralMacroExpansi
     }
 
     if (expansion_state == TYPE_MATCH_YIELD) {
-        return Check_Yield;
+        YIELD_AGAIN();
     }
 
     if (expansion == NULL) {
@@ -5852,7 +5903,7 @@ void check_entity(Context *context, Entity* ent) {
             symbol_introduce(context, context->checker.current_scope, ent->binding->token, ent->binding->node);
             track_documentation_for_symbol_info(context, ent->binding->node, ent->binding);
 
-            onyx_docs_submit(context->doc_info, ent->binding);
+            onyx_docs_submit(context, ent->binding);
 
             package_reinsert_use_packages(context, ent->package);
 
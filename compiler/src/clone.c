@@ -157,7 +157,7 @@ AstNode* ast_clone_list(Context *context, void* n) {
 
 #define E(ent) do { \
     assert(context->cloner.captured_entities); \
-    ent->entity = NULL; \
+    ast_set_entity(ent, NULL); \
     bh_arr_push(context->cloner.captured_entities, (AstNode *) ent); \
     } while (0);
     
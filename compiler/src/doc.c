@@ -119,9 +119,10 @@ void onyx_docs_emit_symbol_info(Context *context, bh_buffer *out_buffer) {
 // Onyx Documentation Format
 //
 
-void onyx_docs_submit(OnyxDocInfo *docs, AstBinding *binding) {
+void onyx_docs_submit(Context *context, AstBinding *binding) {
+    OnyxDocInfo *docs = context->doc_info;
     if (!docs) return;
-    if (!binding->entity || !binding->entity->package) return;
+    if (!ast_entity(context, binding) || !ast_entity(context, binding)->package) return;
 
     AstNode *node = binding->node;
     if (!(binding->flags & Ast_Flag_Binding_Isnt_Captured)) {
@@ -209,7 +210,8 @@ static void write_string(bh_buffer *buffer, i32 len, char *data) {
     bh_buffer_append(buffer, data, len);
 }
 
-static void write_location(Context *context, bh_buffer *buffer, OnyxFilePos location) {
+static void write_location(Context *context, bh_buffer *buffer, OnyxFilePos pos) {
+    OnyxFileLocation location = file_pos_location(pos);
     if (shgeti(context->doc_info->file_ids, location.filename) == -1) {
         shput(context->doc_info->file_ids, location.filename, context->doc_info->next_file_id);
         context->doc_info->next_file_id++;
@@ -403,7 +405,7 @@ static void write_entity_header(Context *context, bh_buffer *buffer, AstBinding
         bh_buffer_write_u32(buffer, visibility);
 
         // Package ID
-        bh_buffer_write_u32(buffer, binding->entity->package->id - 1);
+        bh_buffer_write_u32(buffer, ast_entity(context, binding)->package->id - 1);
     }
 
     // Location
@@ -486,8 +488,8 @@ static void write_doc_methods(Context *context, bh_buffer *buffer, Scope *method
             && node->kind != Ast_Kind_Macro)
             continue;
 
-        assert(node->entity);
-        assert(node->entity->function == node);
+        assert(ast_entity(context, node));
+        assert(ast_entity(context, node)->function == node);
 
         AstBinding *binding = NULL;
         switch (node->kind) {
@@ -77,6 +77,10 @@ void entity_heap_init(bh_allocator a, EntityHeap* entities) {
     bh_arena_init(&entities->entity_arena, a, 32 * 1024);
     bh_arr_new(a, entities->entities, 128);
     bh_arr_new(a, entities->quick_unsorted_entities, 128);
+    bh_arr_new(a, entities->all_entities, 1024);
+    entities->symbol_waiters = NULL;
+    entities->entity_waiters = NULL;
+    bh_arr_new(a, entities->stall_waiters, 16);
 }
 
 // Allocates the entity in the entity heap. Don't quite feel this is necessary...
@@ -85,9 +89,16 @@ Entity* entity_heap_register(EntityHeap* entities, Entity e) {
     Entity* entity = bh_alloc_item(alloc, Entity);
     *entity = e;
     entity->id = entities->next_id++;
+    bh_arr_push(entities->all_entities, entity);
+
+    // Nodes only have room for 24 bits of entity id.
+    assert(entity->id < (1 << 24) - 1);
     entity->macro_attempts = 0;
     entity->micro_attempts = 0;
     entity->entered_in_queue = 0;
+    entity->parked = 0;
+    entity->held = 0;
+    entity->waiting_on_entity = NULL;
 
     return entity;
 }
@@ -95,6 +106,13 @@ Entity* entity_heap_register(EntityHeap* entities, Entity e) {
 void entity_heap_insert_existing(EntityHeap* entities, Entity* e) {
     if (e->entered_in_queue) return;
 
+    // If the entity was parked, it is being requeued by something else. The
+    // entries left in the wait tables are stale and will be skipped when woken.
+    if (e->parked) {
+        e->parked = 0;
+        entities->parked_count--;
+    }
+
     if (e->state <= Entity_State_Introduce_Symbols) {
         bh_arr_push(entities->quick_unsorted_entities, e);
     } else {
@@ -172,6 +190,159 @@ void entity_change_state(EntityHeap* entities, Entity *ent, EntityState new_stat
     ent->state = new_state;
 }
 
+static void entity_heap_mark_parked(EntityHeap* entities, Entity* e) {
+    if (e->parked) return;
+
+    assert(!e->entered_in_queue);
+    e->parked = 1;
+    entities->parked_count++;
+    entities->total_parked++;
+}
+
+void entity_heap_park_on_symbol(EntityHeap* entities, Entity* e, char *atom) {
+    i32 index = hmgeti(entities->symbol_waiters, atom);
+    if (index == -1) {
+        bh_arr(Entity *) waiters = NULL;
+        bh_arr_new(entities->allocator, waiters, 4);
+        hmput(entities->symbol_waiters, atom, waiters);
+        index = hmgeti(entities->symbol_waiters, atom);
+    }
+
+    entity_heap_mark_parked(entities, e);
+    bh_arr_push(entities->symbol_waiters[index].value, e);
+}
+
+void entity_heap_park_on_entity(EntityHeap* entities, Entity* e, Entity *blocker) {
+    i32 index = hmgeti(entities->entity_waiters, blocker);
+    if (index == -1) {
+        bh_arr(Entity *) waiters = NULL;
+        bh_arr_new(entities->allocator, waiters, 4);
+        hmput(entities->entity_waiters, blocker, waiters);
+        index = hmgeti(entities->entity_waiters, blocker);
+    }
+
+    entity_heap_mark_parked(entities, e);
+    bh_arr_push(entities->entity_waiters[index].value, e);
+}
+
+//
+// Wakes the entities in `waiters` that are still parked. The other entries are
+// stale, because the entity was woken by something else it was parked on. If it
+// has been parked again since, waking it early only costs one more attempt.
+static i32 entity_heap_wake_waiters(EntityHeap* entities, bh_arr(Entity *) waiters) {
+    i32 woken = 0;
+    bh_arr_each(Entity *, pent, waiters) {
+        Entity *e = *pent;
+        if (!e->parked) continue;
+
+        entity_heap_insert_existing(entities, e);
+        woken++;
+    }
+
+    entities->total_woken += woken;
+    return woken;
+}
+
+void entity_heap_park_until_stall(EntityHeap* entities, Entity* e) {
+    entity_heap_mark_parked(entities, e);
+    bh_arr_push(entities->stall_waiters, e);
+}
+
+void entity_heap_wake_symbol(EntityHeap* entities, char *atom) {
+    if (entities->parked_count == 0) return;
+
+    i32 index = hmgeti(entities->symbol_waiters, atom);
+    if (index == -1) return;
+
+    entity_heap_wake_waiters(entities, entities->symbol_waiters[index].value);
+    bh_arr_clear(entities->symbol_waiters[index].value);
+}
+
+void entity_heap_wake_entity(EntityHeap* entities, Entity *blocker) {
+    if (entities->parked_count == 0) return;
+
+    i32 index = hmgeti(entities->entity_waiters, blocker);
+    if (index == -1) return;
+
+    entity_heap_wake_waiters(entities, entities->entity_waiters[index].value);
+    bh_arr_clear(entities->entity_waiters[index].value);
+}
+
+i32 entity_heap_wake_all(EntityHeap* entities) {
+    if (entities->parked_count == 0) return 0;
+
+    i32 woken = 0;
+    fori (i, 0, hmlen(entities->symbol_waiters)) {
+        woken += entity_heap_wake_waiters(entities, entities->symbol_waiters[i].value);
+        bh_arr_clear(entities->symbol_waiters[i].value);
+    }
+
+    fori (i, 0, hmlen(entities->entity_waiters)) {
+        woken += entity_heap_wake_waiters(entities, entities->entity_waiters[i].value);
+        bh_arr_clear(entities->entity_waiters[i].value);
+    }
+
+    woken += entity_heap_wake_waiters(entities, entities->stall_waiters);
+    bh_arr_clear(entities->stall_waiters);
+
+    assert(entities->parked_count == 0);
+    return woken;
+}
+
+//
+// Called by the checker when the entity being processed finds that it cannot continue
+// until `blocker` makes progress. If the entity then yields, it is parked on `blocker`.
+// Waits found during tentative checks (run with errors disabled) are recorded too, as
+// every yield has to record its own reason, and an extra reason only means the entity
+// can be woken by one more thing.
+void entity_wait_on(Context *context, Entity *blocker) {
+    if (blocker == NULL) return;
+    if (blocker == context->checker.current_entity) return;
+    if (blocker->state == Entity_State_Finalized || blocker->state == Entity_State_Failed) return;
+
+    context->checker.wait_recorded = 1;
+
+    bh_arr_each(Entity *, pent, context->checker.blocking_entities) {
+        if (*pent == blocker) return;
+    }
+
+    bh_arr_push(context->checker.blocking_entities, blocker);
+}
+
+// Waits on the entity that finishes constructing `type`, if there is one.
+void entity_wait_on_type(Context *context, Type *type) {
+    if (type == NULL) return;
+    if (type->kind == Type_Kind_Pointer) type = type->Pointer.elem;
+
+    if (type->kind == Type_Kind_Struct && type->ast_type && type->ast_type->kind == Ast_Kind_Struct_Type) {
+        entity_wait_on(context, ((AstStructType *) type->ast_type)->entity_type);
+    }
+}
+
+// Called by the checker when a symbol could not be resolved. If the entity then yields,
+// it is parked until a symbol with that name is introduced.
+void entity_wait_on_symbol(Context *context, OnyxToken *symbol) {
+    context->checker.wait_recorded = 1;
+    bh_arr_push(context->checker.unresolved_symbols, symbol);
+}
+
+// Called by the checker when the entity cannot continue until nothing else in the queue
+// can make progress, like a #defined that has not found its symbol. If the entity then
+// yields, it is parked until the pump finds that everything has stalled.
+void entity_wait_on_stall(Context *context) {
+    context->checker.wait_recorded = 1;
+    context->checker.waiting_on_stall = 1;
+}
+
+//
+// Called by the checker every time it starts to yield. If nothing was recorded as the
+// reason since the last yield, nothing would wake the entity if it was parked, so it is
+// not parked. Yields that only pass on the result of a nested check are not noted.
+void entity_note_yield(Context *context) {
+    if (!context->checker.wait_recorded) context->checker.untracked_yield = 1;
+    context->checker.wait_recorded = 0;
+}
+
 void entity_heap_add_job(EntityHeap *entities, TypeMatch (*func)(Context *, void *), void *job_data) {
     EntityJobData *job = bh_alloc(entities->allocator, sizeof(*job));
     job->func = func;
@@ -197,12 +368,11 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
         entity_heap_insert_existing(entities, entity);          \
     }                                                           \
 
-    if (node->entity != NULL) return;
+    if (node->entity_id != 0) return;
 
     Entity* entity;
 
     Entity ent;
-    ent.id = entities->next_id++;
     ent.state = Entity_State_Check_Types;
     ent.package = package;
     ent.scope   = scope;
@@ -244,7 +414,6 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
                 ENTITY_INSERT(ent);
                 ((AstFunction *) node)->entity_header = entity;
 
-                ent.id       = entities->next_id++;
                 ent.type     = Entity_Type_Function;
                 ent.function = (AstFunction *) node;
                 ENTITY_INSERT(ent);
@@ -265,7 +434,6 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
             ent.global = (AstGlobal *) node;
             ENTITY_INSERT(ent);
 
-            ent.id     = entities->next_id++;
             ent.type   = Entity_Type_Global;
             ent.global = (AstGlobal *) node;
             ENTITY_INSERT(ent);
@@ -292,7 +460,6 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
             ENTITY_INSERT(ent);
             ((AstStructType *) node)->entity_defaults = entity;
 
-            ent.id       = entities->next_id++;
             // fallthrough
         }
 
@@ -332,7 +499,6 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
             ENTITY_INSERT(ent);
             ((AstMemRes *) node)->type_entity = entity;
 
-            ent.id       = entities->next_id++;
             ent.type = Entity_Type_Memory_Reservation;
             ent.mem_res = (AstMemRes *) node;
             ENTITY_INSERT(ent);
@@ -447,5 +613,5 @@ void add_entities_for_node(EntityHeap *entities, bh_arr(Entity *) *target_arr, A
         }
     }
 
-    node->entity = entity;
+    ast_set_entity(node, entity);
 }
@@ -281,7 +281,8 @@ static AstNode * parse_code(Context *context, ProceduralMacroExpansionKind kind,
     file_contents.allocator = context->ast_alloc;
     file_contents.data = code;
     file_contents.length = code_length;
-    file_contents.filename = bh_aprintf(context->ast_alloc, "(expansion from %s:%d,%d)", pos.filename, pos.line, pos.column);
+    OnyxFileLocation location = file_pos_location(pos);
+    file_contents.filename = bh_aprintf(context->ast_alloc, "(expansion from %s:%d,%d)", location.filename, location.line, location.column);
 
     OnyxTokenizer tokenizer = onyx_tokenizer_create(context, &file_contents);
     onyx_lex_tokens(&tokenizer);
@@ -315,15 +316,12 @@ static b32 handle_common_messages(Context *context, CompilerExtension *ext, int
             u32 length = extension_recv_int(ext);
             char *msg =  extension_recv_str(ext, NULL);
 
-            OnyxFilePos pos;
-            pos.column = column + (line == tkn->pos.line ? 2 : 0);
-            pos.line = line;
-            pos.filename = tkn->pos.filename;
-            pos.length = length;
+            OnyxFileLocation tkn_location = file_pos_location(tkn->pos);
 
-            i32 line_diff = line - tkn->pos.line;
+            char *position;
+            i32 line_diff = line - tkn_location.line;
             if (line_diff == 0) {
-                pos.line_start = tkn->pos.line_start; 
+                position = tkn_location.line_start + column + 1;
             } else {
                 char *c = tkn->text;
                 while (*c && line_diff > 0) {
@@ -332,9 +330,12 @@ static b32 handle_common_messages(Context *context, CompilerExtension *ext, int
                     c++;
                 }
 
-                pos.line_start = c;
+                position = c + column - 1;
             }
 
+            OnyxFilePos pos = source_file_pos(tkn->pos.file_id, position, (u16) length);
+            if (pos.file_id == 0) pos = tkn->pos;
+
             ONYX_ERROR(pos, Error_Critical, msg);
             break;
         }
@@ -394,9 +395,10 @@ TypeMatch compiler_extension_expand_macro(
         extension_send_int(ext, MSG_HOST_EXPAND_MACRO);
         extension_send_int(ext, *expansion_id);
         extension_send_int(ext, kind);
-        extension_send_str(ext, body->pos.filename);
-        extension_send_int(ext, body->pos.line);
-        extension_send_int(ext, body->pos.column);
+        OnyxFileLocation location = file_pos_location(body->pos);
+        extension_send_str(ext, location.filename);
+        extension_send_int(ext, location.line);
+        extension_send_int(ext, location.column);
         extension_send_int(ext, 0);
         extension_send_str(ext, macro_name);
         extension_send_bytes(ext, body->text, body->length);
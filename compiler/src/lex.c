@@ -88,44 +88,175 @@ static const char* token_type_names[] = {
     "TOKEN_TYPE_COUNT"
 };
 
-#ifndef LITERAL_TOKEN
-#define LITERAL_TOKEN(token, word, token_type) \
-    if (token_lit(tokenizer, &tk, token, word, token_type)) goto token_parsed;
-#endif
-
 #ifndef INCREMENT_CURR_TOKEN
 #define INCREMENT_CURR_TOKEN(tkn) { \
-    if (*(tkn)->curr == '\n') { \
-        (tkn)->line_number++; \
-        (tkn)->line_start = (tkn)->curr + 1; \
-    } \
+    if (*(tkn)->curr == '\n') (tkn)->line_number++; \
     if ((tkn)->curr != (tkn)->end) (tkn)->curr++; \
 }
 #endif
 
-#define char_is_alphanum(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) >= '0' && (c) <= '9'))
 #define char_is_num(c)      ((c) >= '0' && (c) <= '9')
-#define char_is_alpha(c)    (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
 
-static inline b32 token_lit(OnyxTokenizer* tokenizer, OnyxToken* tk, char* lit, b32 is_word, TokenType type) {
-    i64 len = 0;
-    char* ptr1 = tokenizer->curr;
-    char* ptr2 = lit;
-    while (*ptr2 != '\0' && *ptr1 == *ptr2) ptr1++, ptr2++, len++;
-    if (*ptr2 != '\0') return 0;
+//
+// Every byte is classified with one table lookup, instead of a chain of
+// comparisons. Bytes outside of ASCII are in no class.
+//
+#define S CC_Space
+#define A CC_Alpha
+#define D CC_Digit
+
+enum {
+    CC_Space = 0x01, // ' ', '\t', '\r'. Newlines are handled separately.
+    CC_Alpha = 0x02, // Can start a symbol: letters and '_'.
+    CC_Digit = 0x04,
+    CC_Ident = CC_Alpha | CC_Digit,
+};
+
+static const u8 char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, 0, 0, 0, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+};
 
-    if (is_word && (char_is_alphanum(*ptr1) || *ptr1 == '_'))
-        return 0;
+#undef S
+#undef A
+#undef D
+
+#define char_in_class(c, cls) (char_class[(u8) (c)] & (cls))
+
+//
+// Keywords are found with a perfect hash of their first character, their
+// last two characters and their length. Every keyword has its own slot, so
+// a symbol is compared against at most one keyword.
+//
+typedef struct Keyword {
+    const char *text;
+    i32 length;
+    TokenType type;
+} Keyword;
+
+#define KEYWORD_MAX_LENGTH 11
+#define KEYWORD_HASH(text, len) \
+    (((u8) (text)[0] * 29 + (u8) (text)[(len) - 2] * 17 + (u8) (text)[(len) - 1] * 31 + (len)) & 63)
+
+static const Keyword keywords[64] = {
+    [ 5] = { "break",        5, Token_Type_Keyword_Break },
+    [ 6] = { "sizeof",       6, Token_Type_Keyword_Sizeof },
+    [ 8] = { "fallthrough", 11, Token_Type_Keyword_Fallthrough },
+    [ 9] = { "package",      7, Token_Type_Keyword_Package },
+    [10] = { "elseif",       6, Token_Type_Keyword_Elseif },
+    [13] = { "where",        5, Token_Type_Keyword_Where },
+    [19] = { "else",         4, Token_Type_Keyword_Else },
+    [20] = { "return",       6, Token_Type_Keyword_Return },
+    [25] = { "case",         4, Token_Type_Keyword_Case },
+    [28] = { "defer",        5, Token_Type_Keyword_Defer },
+    [29] = { "as",           2, Token_Type_Keyword_As },
+    [33] = { "macro",        5, Token_Type_Keyword_Macro },
+    [34] = { "use",          3, Token_Type_Keyword_Use },
+    [35] = { "typeof",       6, Token_Type_Keyword_Typeof },
+    [39] = { "while",        5, Token_Type_Keyword_While },
+    [40] = { "true",         4, Token_Type_Literal_True },
+    [42] = { "cast",         4, Token_Type_Keyword_Cast },
+    [43] = { "do",           2, Token_Type_Keyword_Do },
+    [44] = { "struct",       6, Token_Type_Keyword_Struct },
+    [45] = { "enum",         4, Token_Type_Keyword_Enum },
+    [49] = { "false",        5, Token_Type_Literal_False },
+    [50] = { "in",           2, Token_Type_Keyword_In },
+    [54] = { "global",       6, Token_Type_Keyword_Global },
+    [55] = { "union",        5, Token_Type_Keyword_Union },
+    [56] = { "switch",       6, Token_Type_Keyword_Switch },
+    [58] = { "if",           2, Token_Type_Keyword_If },
+    [60] = { "interface",    9, Token_Type_Keyword_Interface },
+    [61] = { "alignof",      7, Token_Type_Keyword_Alignof },
+    [62] = { "for",          3, Token_Type_Keyword_For },
+    [63] = { "continue",     8, Token_Type_Keyword_Continue },
+};
 
-    tk->type = type;
-    tk->text = tokenizer->curr;
-    tk->length = len;
-    tk->pos.line = tokenizer->line_number;
-    tk->pos.column = (i32)(tokenizer->curr - tokenizer->line_start) + 1;
+static inline TokenType lookup_keyword(const char *text, i32 length) {
+    if (length < 2 || length > KEYWORD_MAX_LENGTH) return Token_Type_Symbol;
 
-    tokenizer->curr += len;
+    const Keyword *kw = &keywords[KEYWORD_HASH(text, length)];
+    if (kw->length == length && !memcmp(kw->text, text, length)) {
+        return kw->type;
+    }
 
-    return 1;
+    return Token_Type_Symbol;
+}
+
+// Returns the operator of more than one character at `c`, or Token_Type_Unknown
+// if there is none. The longest operator wins. The source always ends with a
+// NUL, so reading past a character that matched is safe.
+static TokenType lookup_operator(const char *c, i32 *length) {
+    #define OP(len, type) { *length = (len); return (type); }
+
+    switch (c[0]) {
+        case '-':
+            if (c[1] == '>') OP(2, Token_Type_Right_Arrow);
+            if (c[1] == '=') OP(2, Token_Type_Minus_Equal);
+            if (c[1] == '-' && c[2] == '-') OP(3, Token_Type_Empty_Block);
+            break;
+
+        case '<':
+            if (c[1] == '=') OP(2, Token_Type_Less_Equal);
+            if (c[1] == '-') OP(2, Token_Type_Left_Arrow);
+            if (c[1] == '<') {
+                if (c[2] == '=') OP(3, Token_Type_Shl_Equal);
+                OP(2, Token_Type_Shift_Left);
+            }
+            break;
+
+        case '>':
+            if (c[1] == '=') OP(2, Token_Type_Greater_Equal);
+            if (c[1] == '>') {
+                if (c[2] == '>') {
+                    if (c[3] == '=') OP(4, Token_Type_Sar_Equal);
+                    OP(3, Token_Type_Shift_Arith_Right);
+                }
+                if (c[2] == '=') OP(3, Token_Type_Shr_Equal);
+                OP(2, Token_Type_Shift_Right);
+            }
+            break;
+
+        case '&':
+            if (c[1] == '&') OP(2, Token_Type_And_And);
+            if (c[1] == '=') OP(2, Token_Type_And_Equal);
+            break;
+
+        case '|':
+            if (c[1] == '>') OP(2, Token_Type_Pipe);
+            if (c[1] == '|') OP(2, Token_Type_Or_Or);
+            if (c[1] == '=') OP(2, Token_Type_Or_Equal);
+            break;
+
+        case '=':
+            if (c[1] == '=') OP(2, Token_Type_Equal_Equal);
+            if (c[1] == '>') OP(2, Token_Type_Fat_Right_Arrow);
+            break;
+
+        case '.':
+            if (c[1] == '.') {
+                if (c[2] == '=') OP(3, Token_Type_Dot_Dot_Equal);
+                OP(2, Token_Type_Dot_Dot);
+            }
+            break;
+
+        case '!': if (c[1] == '=') OP(2, Token_Type_Not_Equal);         break;
+        case '+': if (c[1] == '=') OP(2, Token_Type_Plus_Equal);        break;
+        case '*': if (c[1] == '=') OP(2, Token_Type_Star_Equal);        break;
+        case '^': if (c[1] == '=') OP(2, Token_Type_Xor_Equal);         break;
+        case '/': if (c[1] == '=') OP(2, Token_Type_Fslash_Equal);      break;
+        case '%': if (c[1] == '=') OP(2, Token_Type_Percent_Equal);     break;
+        case '~': if (c[1] == '~') OP(2, Token_Type_Tilde_Tilde);       break;
+        case '?': if (c[1] == '?') OP(2, Token_Type_Question_Question); break;
+    }
+
+    #undef OP
+    return Token_Type_Unknown;
 }
 
 const char *token_type_name(TokenType tkn_type) {
@@ -150,12 +281,18 @@ const char* token_name(OnyxToken * tkn) {
     return token_type_name(tkn_type);
 }
 
-void token_toggle_end(OnyxToken* tkn) {
-    static char backup = 0;
-    char tmp = tkn->text[tkn->length];
-    assert(backup == '\0' || tmp == '\0'); // Sanity check
-    tkn->text[tkn->length] = backup;
-    backup = tmp;
+static void lex_error(OnyxTokenizer *tokenizer, OnyxFilePos pos, char *message) {
+    if (tokenizer->errors == NULL) {
+        bh_arr_new(bh_arr_allocator(tokenizer->tokens), tokenizer->errors, 2);
+    }
+
+    bh_arr_push(tokenizer->errors, ((OnyxLexError) { pos, message }));
+}
+
+void onyx_report_lex_errors(Context *context, bh_arr(OnyxLexError) errors) {
+    bh_arr_each(OnyxLexError, err, errors) {
+        onyx_report_error(context, err->pos, Error_Critical, "%s", err->message);
+    }
 }
 
 OnyxToken* onyx_get_token(OnyxTokenizer* tokenizer) {
@@ -172,17 +309,31 @@ OnyxToken* onyx_get_token(OnyxTokenizer* tokenizer) {
                     semicolon_token.type = Token_Type_Inserted_Semicolon;
                     semicolon_token.text = "; ";
                     semicolon_token.length = 1;
-                    semicolon_token.pos.line_start = tokenizer->line_start;
-                    semicolon_token.pos.filename = tokenizer->filename;
-                    semicolon_token.pos.line = tokenizer->line_number;
-                    semicolon_token.pos.column = (u16)(tokenizer->curr - tokenizer->line_start) + 1;
+                    semicolon_token.pos.offset = (u32) (tokenizer->curr - tokenizer->start);
+                    semicolon_token.pos.file_id = tokenizer->file_id;
+                    semicolon_token.pos.length = 1;
                     bh_arr_push(tokenizer->tokens, semicolon_token);
                     tokenizer->insert_semicolon = 0;
                 }
+
+                INCREMENT_CURR_TOKEN(tokenizer);
+                break;
+
             case ' ':
             case '\t':
             case '\r':
-                INCREMENT_CURR_TOKEN(tokenizer);
+                // Indentation is usually a run of spaces, so skip 8 at a time.
+                while (tokenizer->end - tokenizer->curr >= 8) {
+                    u64 word;
+                    memcpy(&word, tokenizer->curr, sizeof(word));
+                    if (word != 0x2020202020202020ULL) break;
+
+                    tokenizer->curr += 8;
+                }
+
+                while (tokenizer->curr != tokenizer->end && char_in_class(*tokenizer->curr, CC_Space)) {
+                    tokenizer->curr++;
+                }
                 break;
             default:
                 goto whitespace_skipped;
@@ -194,16 +345,26 @@ whitespace_skipped:
     tk.type = Token_Type_Unknown;
     tk.text = tokenizer->curr;
     tk.length = 1;
-    tk.pos.line_start = tokenizer->line_start;
-    tk.pos.filename = tokenizer->filename;
-    tk.pos.line = tokenizer->line_number;
-    tk.pos.column = (u16)(tokenizer->curr - tokenizer->line_start) + 1;
+    tk.pos.offset = (u32) (tokenizer->curr - tokenizer->start);
+    tk.pos.file_id = tokenizer->file_id;
 
     if (tokenizer->curr == tokenizer->end) {
         tk.type = Token_Type_End_Stream;
         goto token_parsed;
     }
 
+    // Symbols and keywords. These are the most common tokens, so they are checked first.
+    if (char_in_class(*tokenizer->curr, CC_Alpha)) {
+        tokenizer->curr++;
+        while (tokenizer->curr != tokenizer->end && char_in_class(*tokenizer->curr, CC_Ident)) {
+            tokenizer->curr++;
+        }
+
+        tk.length = tokenizer->curr - tk.text;
+        tk.type = lookup_keyword(tk.text, tk.length);
+        goto token_parsed;
+    }
+
     // She-bang
     if (tokenizer->curr == tokenizer->start) {
         if (*tokenizer->curr == '#' && *(tokenizer->curr + 1) == '!') {
@@ -229,11 +390,11 @@ whitespace_skipped:
         }
 
         tk.text = tokenizer->curr;
-        tk.pos.column = (u16)(tokenizer->curr - tokenizer->line_start) + 1;
+        tk.pos.offset = (u32) (tokenizer->curr - tokenizer->start);
 
-        while (*tokenizer->curr != '\n' && tokenizer->curr != tokenizer->end) {
-            INCREMENT_CURR_TOKEN(tokenizer);
-        }
+        // The line does not contain a newline, so there is no position to track.
+        char *newline = memchr(tokenizer->curr, '\n', tokenizer->end - tokenizer->curr);
+        tokenizer->curr = newline ? newline : tokenizer->end;
 
         tk.length = tokenizer->curr - tk.text;
 
@@ -305,7 +466,7 @@ whitespace_skipped:
 
             if (*tokenizer->curr == '\n' && ch == '\'') {
                 tk.pos.length = (u16) len;
-                onyx_report_error(tokenizer->context, tk.pos, Error_Critical, "Character literal not terminated by end of line.");
+                lex_error(tokenizer, tk.pos, "Character literal not terminated by end of line.");
                 break;
             }
 
@@ -318,7 +479,7 @@ whitespace_skipped:
 
             INCREMENT_CURR_TOKEN(tokenizer);
             if (tokenizer->curr == tokenizer->end) {
-                onyx_report_error(tokenizer->context, tk.pos, Error_Critical, "String literal not closed. String literal starts here.");
+                lex_error(tokenizer, tk.pos, "String literal not closed. String literal starts here.");
                 break;
             }
         }
@@ -408,158 +569,15 @@ whitespace_skipped:
         goto token_parsed;
     }
 
-    char curr = *tokenizer->curr;
-    switch (curr) {
-    case 'a':
-        LITERAL_TOKEN("as",          1, Token_Type_Keyword_As);
-        LITERAL_TOKEN("alignof",     1, Token_Type_Keyword_Alignof);
-        break;
-    case 'b':
-        LITERAL_TOKEN("break",       1, Token_Type_Keyword_Break);
-        break;
-    case 'c':
-        LITERAL_TOKEN("case",        1, Token_Type_Keyword_Case);
-        LITERAL_TOKEN("cast",        1, Token_Type_Keyword_Cast);
-        LITERAL_TOKEN("continue",    1, Token_Type_Keyword_Continue);
-        break;
-    case 'd':
-        LITERAL_TOKEN("defer",       1, Token_Type_Keyword_Defer);
-        LITERAL_TOKEN("do",          1, Token_Type_Keyword_Do);
-        break;
-    case 'e':
-        LITERAL_TOKEN("enum",        1, Token_Type_Keyword_Enum);
-        LITERAL_TOKEN("elseif",      1, Token_Type_Keyword_Elseif);
-        LITERAL_TOKEN("else",        1, Token_Type_Keyword_Else);
-        break;
-    case 'f':
-        LITERAL_TOKEN("for",         1, Token_Type_Keyword_For);
-        LITERAL_TOKEN("false",       1, Token_Type_Literal_False);
-        LITERAL_TOKEN("fallthrough", 1, Token_Type_Keyword_Fallthrough);
-        break;
-    case 'g':
-        LITERAL_TOKEN("global",      1, Token_Type_Keyword_Global);
-        break;
-    case 'i':
-        LITERAL_TOKEN("if",          1, Token_Type_Keyword_If);
-        LITERAL_TOKEN("in",          1, Token_Type_Keyword_In);
-        LITERAL_TOKEN("interface",   1, Token_Type_Keyword_Interface);
-        break;
-    case 'm':
-        LITERAL_TOKEN("macro",       1, Token_Type_Keyword_Macro);
-        break;
-    case 'p':
-        LITERAL_TOKEN("package",     1, Token_Type_Keyword_Package);
-        break;
-    case 'r':
-        LITERAL_TOKEN("return",      1, Token_Type_Keyword_Return);
-        break;
-    case 's':
-        LITERAL_TOKEN("struct",      1, Token_Type_Keyword_Struct);
-        LITERAL_TOKEN("sizeof",      1, Token_Type_Keyword_Sizeof);
-        LITERAL_TOKEN("switch",      1, Token_Type_Keyword_Switch);
-        break;
-    case 't':
-        LITERAL_TOKEN("true",        1, Token_Type_Literal_True);
-        LITERAL_TOKEN("typeof",      1, Token_Type_Keyword_Typeof);
-        break;
-    case 'u':
-        LITERAL_TOKEN("use",         1, Token_Type_Keyword_Use);
-        LITERAL_TOKEN("union",       1, Token_Type_Keyword_Union);
-        break;
-    case 'w':
-        LITERAL_TOKEN("while",       1, Token_Type_Keyword_While);
-        LITERAL_TOKEN("where",       1, Token_Type_Keyword_Where);
-        break;
-
-    case '-':
-        LITERAL_TOKEN("->",          0, Token_Type_Right_Arrow);
-        LITERAL_TOKEN("---",         0, Token_Type_Empty_Block);
-        LITERAL_TOKEN("-=",          0, Token_Type_Minus_Equal);
-        break;
-
-    case '<':
-        LITERAL_TOKEN("<=",          0, Token_Type_Less_Equal);
-        LITERAL_TOKEN("<-",          0, Token_Type_Left_Arrow);
-        LITERAL_TOKEN("<<=",         0, Token_Type_Shl_Equal);
-        LITERAL_TOKEN("<<",          0, Token_Type_Shift_Left);
-        break;
-
-    case '>':
-        LITERAL_TOKEN(">=",          0, Token_Type_Greater_Equal);
-        LITERAL_TOKEN(">>>=",        0, Token_Type_Sar_Equal);
-        LITERAL_TOKEN(">>=",         0, Token_Type_Shr_Equal);
-        LITERAL_TOKEN(">>>",         0, Token_Type_Shift_Arith_Right);
-        LITERAL_TOKEN(">>",          0, Token_Type_Shift_Right);
-        break;
-
-    case '&':
-        LITERAL_TOKEN("&&",          0, Token_Type_And_And);
-        LITERAL_TOKEN("&=",          0, Token_Type_And_Equal);
-        break;
-
-    case '|':
-        LITERAL_TOKEN("|>",          0, Token_Type_Pipe);
-        LITERAL_TOKEN("||",          0, Token_Type_Or_Or);
-        LITERAL_TOKEN("|=",          0, Token_Type_Or_Equal);
-        break;
-
-    case '=':
-        LITERAL_TOKEN("==",          0, Token_Type_Equal_Equal);
-        LITERAL_TOKEN("=>",          0, Token_Type_Fat_Right_Arrow);
-        break;
-
-    case '!':
-        LITERAL_TOKEN("!=",          0, Token_Type_Not_Equal);
-        break;
-
-    case '+':
-        LITERAL_TOKEN("+=",          0, Token_Type_Plus_Equal);
-        break;
-
-    case '*':
-        LITERAL_TOKEN("*=",          0, Token_Type_Star_Equal);
-        break;
-
-    case '^':
-        LITERAL_TOKEN("^=",          0, Token_Type_Xor_Equal);
-        break;
-
-    case '/':
-        LITERAL_TOKEN("/=",          0, Token_Type_Fslash_Equal);
-        break;
-
-    case '%':
-        LITERAL_TOKEN("%=",          0, Token_Type_Percent_Equal);
-        break;
-
-    case '.':
-        LITERAL_TOKEN("..=",         0, Token_Type_Dot_Dot_Equal);
-        LITERAL_TOKEN("..",          0, Token_Type_Dot_Dot);
-        break;
-
-    case '~':
-        LITERAL_TOKEN("~~",          0, Token_Type_Tilde_Tilde);
-        break;
-
-    case '?':
-        LITERAL_TOKEN("??",          0, Token_Type_Question_Question);
-        break;
-    }
-
-    // Symbols
-    if (char_is_alpha(*tk.text) || *tokenizer->curr == '_') {
-        u64 len = 0;
-        while (char_is_alphanum(*tokenizer->curr) || *tokenizer->curr == '_') {
-            len++;
-            INCREMENT_CURR_TOKEN(tokenizer);
-        }
-
-        tk.length = len;
-        tk.type = Token_Type_Symbol;
+    i32 operator_length;
+    TokenType operator_type = lookup_operator(tokenizer->curr, &operator_length);
+    if (operator_type != Token_Type_Unknown) {
+        tk.type = operator_type;
+        tk.length = operator_length;
+        tokenizer->curr += operator_length;
         goto token_parsed;
     }
 
-
     tk.type = (TokenType) *tokenizer->curr;
     INCREMENT_CURR_TOKEN(tokenizer);
 
@@ -599,7 +617,177 @@ token_parsed:
     return &tokenizer->tokens[bh_arr_length(tokenizer->tokens) - 1];
 }
 
+//
+// Token positions only store the id of their file and an offset into it. The files are
+// kept in one table for the whole process, because cached token arrays outlive the context
+// that lexed them. The table is stored in chunks that never move, so ids can be resolved
+// without taking the lock. The lines of a file are only found when a position in it is
+// first resolved, which for most files is never.
+//
+
+#define SOURCE_FILE_CHUNK_SIZE 256
+#define SOURCE_FILE_CHUNK_COUNT (65536 / SOURCE_FILE_CHUNK_SIZE)
+
+typedef struct SourceFile {
+    const char *filename;
+    char *data;
+    u32 length;
+
+    u32 *line_offsets;
+    u32  line_count;
+} SourceFile;
+
+static SourceFile first_source_file_chunk[SOURCE_FILE_CHUNK_SIZE] = {
+    [INTERNAL_SOURCE_FILE_ID] = { .filename = "<compiler internal>", .data = "" },
+};
+
+static SourceFile *source_file_chunks[SOURCE_FILE_CHUNK_COUNT] = { first_source_file_chunk };
+static u32 next_source_file_id = INTERNAL_SOURCE_FILE_ID + 1;
+static bh_arr(u16) free_source_file_ids = NULL;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+static pthread_mutex_t source_file_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define SOURCE_FILE_LOCK()   pthread_mutex_lock(&source_file_mutex)
+#define SOURCE_FILE_UNLOCK() pthread_mutex_unlock(&source_file_mutex)
+#else
+#define SOURCE_FILE_LOCK()
+#define SOURCE_FILE_UNLOCK()
+#endif
+
+static SourceFile *source_file_get(u16 file_id) {
+    if (file_id == 0) return NULL;
+
+    SourceFile *chunk = source_file_chunks[file_id / SOURCE_FILE_CHUNK_SIZE];
+    if (chunk == NULL) return NULL;
+
+    SourceFile *file = &chunk[file_id % SOURCE_FILE_CHUNK_SIZE];
+    return file->filename ? file : NULL;
+}
+
+// Returns 0 when every id is in use, in which case positions in the file are unknown.
+u16 source_file_register(const char *filename, char *data, u32 length) {
+    SOURCE_FILE_LOCK();
+
+    u16 file_id = 0;
+    if (!bh_arr_is_empty(free_source_file_ids)) {
+        file_id = bh_arr_pop(free_source_file_ids);
+
+    } else if (next_source_file_id < 65536) {
+        file_id = (u16) next_source_file_id++;
+
+        SourceFile **chunk = &source_file_chunks[file_id / SOURCE_FILE_CHUNK_SIZE];
+        if (*chunk == NULL) {
+            *chunk = bh_alloc_array(bh_heap_allocator(), SourceFile, SOURCE_FILE_CHUNK_SIZE);
+            memset(*chunk, 0, sizeof(SourceFile) * SOURCE_FILE_CHUNK_SIZE);
+        }
+    }
+
+    if (file_id != 0) {
+        source_file_chunks[file_id / SOURCE_FILE_CHUNK_SIZE][file_id % SOURCE_FILE_CHUNK_SIZE] = (SourceFile) {
+            .filename = filename,
+            .data     = data,
+            .length   = length,
+        };
+    }
+
+    SOURCE_FILE_UNLOCK();
+    return file_id;
+}
+
+void source_file_release(u16 file_id) {
+    if (file_id <= INTERNAL_SOURCE_FILE_ID) return;
+
+    SOURCE_FILE_LOCK();
+
+    SourceFile *file = source_file_get(file_id);
+    if (file) {
+        bh_free(bh_heap_allocator(), file->line_offsets);
+        *file = (SourceFile) { 0 };
+
+        if (free_source_file_ids == NULL) bh_arr_new(bh_heap_allocator(), free_source_file_ids, 16);
+        bh_arr_push(free_source_file_ids, file_id);
+    }
+
+    SOURCE_FILE_UNLOCK();
+}
+
+static void source_file_find_lines(SourceFile *file) {
+    u32 line_count = 1;
+    char *walker = file->data;
+    char *end    = file->data + file->length;
+    while ((walker = memchr(walker, '\n', end - walker)) != NULL) {
+        line_count++;
+        walker++;
+    }
+
+    u32 *line_offsets = bh_alloc_array(bh_heap_allocator(), u32, line_count);
+    line_offsets[0] = 0;
+
+    u32 line = 1;
+    walker = file->data;
+    while ((walker = memchr(walker, '\n', end - walker)) != NULL) {
+        walker++;
+        line_offsets[line++] = (u32) (walker - file->data);
+    }
+
+    file->line_count = line_count;
+    __atomic_store_n(&file->line_offsets, line_offsets, __ATOMIC_RELEASE);
+}
+
+OnyxFilePos source_file_pos(u16 file_id, char *position, u16 length) {
+    SourceFile *file = source_file_get(file_id);
+    if (!file || position < file->data || position > file->data + file->length) {
+        return (OnyxFilePos) { 0 };
+    }
+
+    return (OnyxFilePos) {
+        .offset  = (u32) (position - file->data),
+        .file_id = file_id,
+        .length  = length,
+    };
+}
+
+const char *file_pos_filename(OnyxFilePos pos) {
+    SourceFile *file = source_file_get(pos.file_id);
+    return file ? file->filename : NULL;
+}
+
+OnyxFileLocation file_pos_location(OnyxFilePos pos) {
+    SourceFile *file = source_file_get(pos.file_id);
+    if (!file) return (OnyxFileLocation) { 0 };
+
+    if (__atomic_load_n(&file->line_offsets, __ATOMIC_ACQUIRE) == NULL) {
+        SOURCE_FILE_LOCK();
+        if (file->line_offsets == NULL) source_file_find_lines(file);
+        SOURCE_FILE_UNLOCK();
+    }
+
+    // The last line that starts at or before the offset.
+    u32 low = 0, high = file->line_count;
+    while (high - low > 1) {
+        u32 middle = low + (high - low) / 2;
+        if (file->line_offsets[middle] <= pos.offset) low = middle;
+        else                                         high = middle;
+    }
+
+    return (OnyxFileLocation) {
+        .filename   = file->filename,
+        .line_start = file->data + file->line_offsets[low],
+        .line       = low + 1,
+        .column     = pos.offset - file->line_offsets[low] + 1,
+    };
+}
+
 OnyxTokenizer onyx_tokenizer_create(Context *context, bh_file_contents *fc) {
+    OnyxTokenizer tokenizer = onyx_tokenizer_create_with_allocator(context, fc, context->token_alloc);
+    bh_arr_push(context->source_file_ids, tokenizer.file_id);
+    return tokenizer;
+}
+
+// The allocator is only used for the token array, so a tokenizer created with
+// a thread-local allocator can run on any thread. The caller is responsible for
+// releasing the file id of the tokenizer once its tokens are no longer used.
+OnyxTokenizer onyx_tokenizer_create_with_allocator(Context *context, bh_file_contents *fc, bh_allocator token_alloc) {
     OnyxTokenizer tknizer = {
         .context = context,
 
@@ -608,21 +796,25 @@ OnyxTokenizer onyx_tokenizer_create(Context *context, bh_file_contents *fc) {
         .end            = bh_pointer_add(fc->data, fc->length),
 
         .filename       = fc->filename,
+        .file_id        = source_file_register(fc->filename, fc->data, (u32) fc->length),
 
         .line_number    = 1,
-        .line_start     = fc->data,
         .tokens         = NULL,
+        .errors         = NULL,
 
         .optional_semicolons = context->options->enable_optional_semicolons,
         .insert_semicolon = 0,
     };
 
-    bh_arr_new(context->token_alloc, tknizer.tokens, 1 << 12);
+    // Onyx source averages about five bytes per token, so this is enough for
+    // most files without growing, and without reserving much that is unused.
+    bh_arr_new(token_alloc, tknizer.tokens, fc->length / 4 + 16);
     return tknizer;
 }
 
 void onyx_tokenizer_free(OnyxTokenizer* tokenizer) {
     bh_arr_free(tokenizer->tokens);
+    bh_arr_free(tokenizer->errors);
 }
 
 void onyx_lex_tokens(OnyxTokenizer* tokenizer) {
@@ -631,6 +823,9 @@ void onyx_lex_tokens(OnyxTokenizer* tokenizer) {
         tk = onyx_get_token(tokenizer);
     } while (tk->type != Token_Type_End_Stream);
 
+    onyx_report_lex_errors(tokenizer->context, tokenizer->errors);
+    bh_arr_free(tokenizer->errors);
+
     tokenizer->context->stats.lexer_lines_processed += tokenizer->line_number - 1;
     tokenizer->context->stats.lexer_tokens_processed += bh_arr_length(tokenizer->tokens);
 }
@@ -655,8 +850,12 @@ b32 token_text_equals(OnyxToken* tkn, char* text) {
 b32 token_same_file(OnyxToken *tkn1, OnyxToken *tkn2) {
     if (!tkn1 || !tkn2) return 0;
     
-    if (tkn1->pos.filename == tkn2->pos.filename) return 1;
+    if (tkn1->pos.file_id == tkn2->pos.file_id) return 1;
+
+    const char *filename1 = file_pos_filename(tkn1->pos);
+    const char *filename2 = file_pos_filename(tkn2->pos);
+    if (!filename1 || !filename2) return 0;
 
     // :Security?
-    return strcmp(tkn1->pos.filename, tkn2->pos.filename) == 0;
+    return strcmp(filename1, filename2) == 0;
 }
@@ -102,13 +102,14 @@ onyx_context_t *onyx_context_create() {
     context->options->generate_type_info = 1;
 
     OnyxFilePos internal_location = { 0 };
-    internal_location.filename = "<compiler internal>";
-    internal_location.line     = 1;
-    internal_location.column   = 1;
+    internal_location.file_id = INTERNAL_SOURCE_FILE_ID;
     context->global_scope = scope_create(context, NULL, internal_location);
 
     sh_new_arena(context->packages);
+    sh_new_arena(context->prepared_files);
     bh_arr_new(context->gp_alloc, context->scopes, 128);
+    bh_arr_new(context->gp_alloc, context->prepared_file_heaps, 8);
+    bh_arr_new(context->gp_alloc, context->source_file_ids, 16);
 
     onyx_errors_init(context, &context->loaded_files);
 
@@ -124,13 +125,28 @@ void onyx_context_free(onyx_context_t *ctx) {
 	Context *context = &ctx->context;
 
     bh_arr_each(Scope *, pscope, context->scopes) {
-        shfree((*pscope)->symbols);
+        hmfree((*pscope)->symbols);
     }
 
     onyx_wasm_module_free(context->wasm_module);
     bh_arena_free(&context->ast_arena);
     bh_arr_free(context->loaded_files);
     bh_arr_free(context->scopes);
+    bh_arr_each(bh_managed_heap *, pheap, context->prepared_file_heaps) {
+        bh_managed_heap_free(*pheap);
+    }
+    bh_arr_free(context->prepared_file_heaps);
+    bh_arr_each(u16, file_id, context->source_file_ids) {
+        source_file_release(*file_id);
+    }
+    bh_arr_free(context->source_file_ids);
+    shfree(context->held.files);
+    shfree(context->held.dependencies);
+    hmfree(context->held.passed_lookups);
+    hmfree(context->held.decided_overloads);
+    shfree(context->prepared_files);
+    atom_table_free(&context->atoms);
+    token_atom_table_free(&context->token_atoms);
     bh_scratch_free(&context->scratch);
     bh_managed_heap_free(&context->heap);
 
@@ -222,42 +238,342 @@ void onyx_options_ready(onyx_context_t *ctx) {
         bh_arr_new(context->gp_alloc, context->doc_info->structures, 128);
         bh_arr_new(context->gp_alloc, context->doc_info->enumerations, 128);
     }
+
+    if (context->options->collect_trace) {
+        bh_arr_new(context->gp_alloc, context->trace_events, 4096);
+    }
 }
 
-static void parse_source_file(Context *context, bh_file_contents* file_contents) {
-    // :Remove passing the allocators as parameters
-    OnyxTokenizer tokenizer = onyx_tokenizer_create(context, file_contents);
-    onyx_lex_tokens(&tokenizer);
+//
+// Reading and tokenizing a source file does not touch any shared compiler state, so it
+// is done ahead of time on worker threads. Whenever a file is needed that has not been
+// prepared yet, every other file load that is waiting in the entity heap is prepared
+// alongside it. This covers all of the files found by a '#load_all' as well as all of
+// the '#load's in the files that were just parsed. Parsing still happens on this thread,
+// one file at a time in entity order, so the result is the same as loading serially.
+//
+
+#define MAX_SOURCE_FILE_WORKERS 8
 
-    file_contents->line_count = tokenizer.line_number;
+typedef struct SourceFileBatch {
+    Context *context;
+    char **filenames;
+    PreparedSourceFile **results;
+    i32 count;
+    i32 next;
+} SourceFileBatch;
 
-    OnyxParser parser = onyx_parser_create(context, &tokenizer);
-    onyx_parse(&parser);
-    onyx_parser_free(&parser);
+typedef struct SourceFileWorker {
+    SourceFileBatch *batch;
+    bh_allocator alloc;
+} SourceFileWorker;
+
+//
+// When a source cache is attached to the context, prepared files are kept in it after the
+// context is freed. The next context reuses every file whose size and modification time
+// did not change, and only reads and tokenizes the rest. Cached files are allocated from
+// the plain heap so they can be freed one at a time when they go stale.
+//
+typedef struct CachedSourceFile {
+    PreparedSourceFile prepared;
+    u64 modified_time;
+    isize size;
+} CachedSourceFile;
+
+struct onyx_source_cache_t {
+    Table(CachedSourceFile) files;
+};
+
+static void free_cached_source_file(CachedSourceFile *cached) {
+    bh_allocator alloc = cached->prepared.contents.allocator;
+    bh_free(alloc, cached->prepared.contents.data);
+    bh_free(alloc, (char *) cached->prepared.contents.filename);
+    bh_arr_free(cached->prepared.tokens);
+    source_file_release(cached->prepared.file_id);
 }
 
-static b32 process_source_file(Context *context, char* filename) {
+onyx_source_cache_t *onyx_source_cache_create() {
+    onyx_source_cache_t *cache = malloc(sizeof(*cache));
+    memset(cache, 0, sizeof(*cache));
+    sh_new_arena(cache->files);
+    return cache;
+}
+
+void onyx_source_cache_free(onyx_source_cache_t *cache) {
+    fori (i, 0, shlen(cache->files)) {
+        free_cached_source_file(&cache->files[i].value);
+    }
+
+    shfree(cache->files);
+    free(cache);
+}
+
+void onyx_context_set_source_cache(onyx_context_t *ctx, onyx_source_cache_t *cache) {
+    ctx->context.source_cache = cache;
+}
+
+static b32 source_cache_lookup(onyx_source_cache_t *cache, char *filename, bh_file_stats *stats, PreparedSourceFile *out) {
+    i32 index = shgeti(cache->files, filename);
+    if (index == -1) return 0;
+
+    CachedSourceFile *cached = &cache->files[index].value;
+    if (cached->modified_time != stats->modified_time || cached->size != stats->size) return 0;
+
+    *out = cached->prepared;
+    return 1;
+}
+
+static void source_cache_store(onyx_source_cache_t *cache, char *filename, bh_file_stats *stats, PreparedSourceFile *prepared) {
+    i32 index = shgeti(cache->files, filename);
+    if (index != -1) {
+        free_cached_source_file(&cache->files[index].value);
+    }
+
+    shput(cache->files, filename, ((CachedSourceFile) {
+        .prepared      = *prepared,
+        .modified_time = stats->modified_time,
+        .size          = stats->size,
+    }));
+}
+
+static void prepare_source_file(Context *context, bh_allocator alloc, char *filename, PreparedSourceFile *prepared) {
+    bh_file file;
+    bh_file_error err = bh_file_open(&file, filename);
+    if (err != BH_FILE_ERROR_NONE) {
+        prepared->failed = 1;
+        return;
+    }
+
+    prepared->contents = bh_file_read_contents(alloc, &file);
+    bh_file_close(&file);
+
+    OnyxTokenizer tokenizer = onyx_tokenizer_create_with_allocator(context, &prepared->contents, alloc);
+
+    // Not using onyx_lex_tokens here, because it updates the statistics in the context.
+    OnyxToken *tk;
+    do {
+        tk = onyx_get_token(&tokenizer);
+    } while (tk->type != Token_Type_End_Stream);
+
+    // The tokens live as long as the AST, so the unused capacity is given back.
+    bh_arr_shrink(tokenizer.tokens, bh_arr_length(tokenizer.tokens));
+
+    prepared->tokens = tokenizer.tokens;
+    prepared->line_count = tokenizer.line_number;
+    prepared->file_id = tokenizer.file_id;
+    prepared->lex_errors = tokenizer.errors;
+}
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+static void *source_file_worker(void *data) {
+    SourceFileWorker *worker = data;
+    SourceFileBatch *batch = worker->batch;
+
+    while (1) {
+        i32 index = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (index >= batch->count) break;
+
+        prepare_source_file(batch->context, worker->alloc, batch->filenames[index], batch->results[index]);
+    }
+
+    return NULL;
+}
+
+static i32 source_file_worker_count(i32 file_count) {
+    i32 cpu_count = (i32) sysconf(_SC_NPROCESSORS_ONLN);
+    return bh_max(1, bh_min(file_count, bh_min(cpu_count, MAX_SOURCE_FILE_WORKERS)));
+}
+#endif
+
+static void run_source_file_batch(Context *context, SourceFileBatch *batch) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    i32 worker_count = source_file_worker_count(batch->count);
+    if (worker_count > 1) {
+        // The heaps are reused from batch to batch, and are only freed with the context,
+        // because the tokens and file contents in them are referenced by the AST.
+        while (!context->source_cache && bh_arr_length(context->prepared_file_heaps) < worker_count) {
+            bh_managed_heap *heap = bh_alloc_item(context->gp_alloc, bh_managed_heap);
+            bh_managed_heap_init(heap);
+            bh_arr_push(context->prepared_file_heaps, heap);
+        }
+
+        pthread_t threads[MAX_SOURCE_FILE_WORKERS];
+        SourceFileWorker workers[MAX_SOURCE_FILE_WORKERS];
+
+        fori (i, 0, worker_count) {
+            workers[i].batch = batch;
+            workers[i].alloc = context->source_cache
+                ? bh_heap_allocator()
+                : bh_managed_heap_allocator(context->prepared_file_heaps[i]);
+            pthread_create(&threads[i], NULL, source_file_worker, &workers[i]);
+        }
+
+        fori (i, 0, worker_count) {
+            pthread_join(threads[i], NULL);
+        }
+
+        return;
+    }
+#endif
+
+    bh_allocator alloc = context->source_cache ? bh_heap_allocator() : context->token_alloc;
+    fori (i, 0, batch->count) {
+        prepare_source_file(context, alloc, batch->filenames[i], batch->results[i]);
+    }
+}
+
+static b32 source_file_is_loaded(Context *context, char *filename) {
     bh_arr_each(bh_file_contents, fc, context->loaded_files) {
         // Duplicates are detected here and since these filenames will be the full path,
         // string comparing them should be all that is necessary.
         if (!strcmp(fc->filename, filename)) return 1;
     }
 
-    bh_file file;
-    bh_file_error err = bh_file_open(&file, filename);
-    if (err != BH_FILE_ERROR_NONE) {
+    return 0;
+}
+
+static char *find_file_for_load(Context *context, AstInclude *include) {
+    // :RelativeFiles
+    const char* parent_file = file_pos_filename(include->token->pos);
+    if (parent_file == NULL) parent_file = ".";
+
+    char* parent_folder = bh_path_get_parent(parent_file, context->scratch_alloc);
+    return bh_search_for_mapped_file(
+        include->name,
+        parent_folder,
+        ".onyx",
+        context->options->mapped_folders,
+        context->gp_alloc
+    );
+}
+
+static void prepare_source_files(Context *context, char *needed_filename) {
+    bh_arr(i32) indices = NULL;
+    bh_arr_new(context->gp_alloc, indices, 16);
+
+    shput(context->prepared_files, needed_filename, ((PreparedSourceFile) { 0 }));
+    bh_arr_push(indices, shgeti(context->prepared_files, needed_filename));
+
+    bh_arr_each(Entity *, pent, context->entities.entities) {
+        Entity *ent = *pent;
+        if (ent->type != Entity_Type_Load_File || ent->state != Entity_State_Parse) continue;
+        if (ent->include->kind != Ast_Kind_Load_File) continue;
+
+        // Files that cannot be found are skipped here, and reported when their entity is processed.
+        char *filename = find_file_for_load(context, ent->include);
+        if (filename == NULL) continue;
+        if (shgeti(context->prepared_files, filename) != -1) continue;
+        if (source_file_is_loaded(context, filename)) continue;
+        if (context->held.holding && shgeti(context->held.files, filename) != -1) continue;
+
+        shput(context->prepared_files, filename, ((PreparedSourceFile) { 0 }));
+        bh_arr_push(indices, shgeti(context->prepared_files, filename));
+    }
+
+    // The table does not grow past this point, so pointers into it are stable.
+    i32 count = bh_arr_length(indices);
+    SourceFileBatch batch = {
+        .context   = context,
+        .filenames = bh_alloc_array(context->gp_alloc, char *, count),
+        .results   = bh_alloc_array(context->gp_alloc, PreparedSourceFile *, count),
+        .count     = 0,
+        .next      = 0,
+    };
+
+    onyx_source_cache_t *cache = context->source_cache;
+    bh_file_stats *file_stats = NULL;
+    if (cache) file_stats = bh_alloc_array(context->gp_alloc, bh_file_stats, count);
+
+    fori (i, 0, count) {
+        char *filename = context->prepared_files[indices[i]].key;
+        PreparedSourceFile *prepared = &context->prepared_files[indices[i]].value;
+
+        if (cache) {
+            // The file is stat'ed before it is read, so if it changes in between, the
+            // cached modification time is older than the file and the next build rereads it.
+            bh_file_stats *stats = &file_stats[batch.count];
+            if (!bh_file_stat(filename, stats)) stats->modified_time = 0;
+
+            if (stats->modified_time != 0 && source_cache_lookup(cache, filename, stats, prepared)) {
+                context->stats.source_cache_hits++;
+                continue;
+            }
+
+            context->stats.source_cache_misses++;
+        }
+
+        batch.filenames[batch.count] = filename;
+        batch.results[batch.count]   = prepared;
+        batch.count++;
+    }
+
+    run_source_file_batch(context, &batch);
+
+    fori (i, 0, batch.count) {
+        PreparedSourceFile *prepared = batch.results[i];
+        if (prepared->failed) continue;
+
+        // A cache hit skips lexing, so files with errors are not cached, or the errors
+        // would not be reported again.
+        if (cache && file_stats[i].modified_time != 0 && bh_arr_is_empty(prepared->lex_errors)) {
+            source_cache_store(cache, batch.filenames[i], &file_stats[i], prepared);
+            continue;
+        }
+
+        bh_arr_push(context->source_file_ids, prepared->file_id);
+    }
+
+    if (cache) bh_free(context->gp_alloc, file_stats);
+
+    bh_free(context->gp_alloc, batch.filenames);
+    bh_free(context->gp_alloc, batch.results);
+    bh_arr_free(indices);
+}
+
+static b32 process_source_file(Context *context, char* filename) {
+    if (source_file_is_loaded(context, filename)) return 1;
+
+    i32 index = shgeti(context->prepared_files, filename);
+    if (index == -1) {
+        prepare_source_files(context, filename);
+        index = shgeti(context->prepared_files, filename);
+    }
+
+    PreparedSourceFile prepared = context->prepared_files[index].value;
+    shdel(context->prepared_files, filename);
+
+    if (prepared.failed) {
         return 0;
     }
 
-    bh_file_contents fc = bh_file_read_contents(context->token_alloc, &file);
-    bh_file_close(&file);
+    bh_arr_push(context->loaded_files, prepared.contents);
 
-    bh_arr_push(context->loaded_files, fc);
+    bh_file_contents *fc = &bh_arr_last(context->loaded_files);
+    fc->line_count = prepared.line_count;
 
     // if (context->options->verbose_output == 2)
-    //     bh_printf("Processing source file:    %s (%d bytes)\n", file.filename, fc.length);
+    //     bh_printf("Processing source file:    %s (%d bytes)\n", fc->filename, fc->length);
+
+    context->stats.lexer_lines_processed += prepared.line_count - 1;
+    context->stats.lexer_tokens_processed += bh_arr_length(prepared.tokens);
+    context->stats.token_bytes += bh_arr_capacity(prepared.tokens) * sizeof(OnyxToken);
+
+    // Files with lexer errors are never cached, so these are not shared.
+    onyx_report_lex_errors(context, prepared.lex_errors);
+    bh_arr_free(prepared.lex_errors);
+
+    token_atoms_add_file(context, prepared.tokens);
+
+    OnyxTokenizer tokenizer = {
+        .context     = context,
+        .filename    = fc->filename,
+        .line_number = prepared.line_count,
+        .tokens      = prepared.tokens,
+    };
 
-    parse_source_file(context, &bh_arr_last(context->loaded_files));
+    OnyxParser parser = onyx_parser_create(context, &tokenizer);
+    onyx_parse(&parser);
+    onyx_parser_free(&parser);
     return 1;
 }
 
@@ -266,22 +582,10 @@ static b32 process_load_entity(Context *context, Entity* ent) {
     AstInclude* include = ent->include;
 
     if (include->kind == Ast_Kind_Load_File) {
-        // :RelativeFiles
-        const char* parent_file = include->token->pos.filename;
-        if (parent_file == NULL) parent_file = ".";
-
-        char* parent_folder = bh_path_get_parent(parent_file, context->scratch_alloc);
-        char* filename      = bh_search_for_mapped_file(
-            include->name,
-            parent_folder,
-            ".onyx",
-            context->options->mapped_folders,
-            context->gp_alloc
-        );
-
+        char* filename = find_file_for_load(context, include);
         if (filename == NULL) {
             OnyxFilePos error_pos = include->token->pos;
-            if (error_pos.filename == NULL) {
+            if (error_pos.file_id == 0) {
                 ONYX_ERROR(error_pos, Error_Command_Line_Arg, "Failed to open file '%s'", include->name);
             } else {
                 ONYX_ERROR(error_pos, Error_Critical, "Failed to open file '%s'", include->name);
@@ -289,10 +593,17 @@ static b32 process_load_entity(Context *context, Entity* ent) {
             return 0;
         }
 
+        // The entity is kept out of the queue until the file is released.
+        if (context->held.holding && ent->state == Entity_State_Parse && shgeti(context->held.files, filename) != -1) {
+            ent->held = 1;
+            bh_arr_push(context->held.entities, ent);
+            return 0;
+        }
+
         return process_source_file(context, filename);
 
     } else if (include->kind == Ast_Kind_Load_All) {
-        const char* parent_file = include->token->pos.filename;
+        const char* parent_file = file_pos_filename(include->token->pos);
         if (parent_file == NULL) parent_file = ".";
 
         char* parent_folder = bh_path_get_parent(parent_file, context->scratch_alloc);
@@ -319,6 +630,8 @@ static b32 process_load_entity(Context *context, Entity* ent) {
                 return 0;
             }
 
+            held_files_note_dependency(context, folder);
+
             bh_dirent entry;
             char fullpath[512];
             while (bh_dir_read(dir, &entry)) {
@@ -331,7 +644,7 @@ static b32 process_load_entity(Context *context, Entity* ent) {
                     AstInclude* new_include = onyx_ast_node_new(context->ast_alloc, sizeof(AstInclude), Ast_Kind_Load_File);
                     new_include->token = include->token;
                     new_include->name = formatted_name;
-                    add_entities_for_node(&context->entities, NULL, (AstNode *) new_include, include->entity->scope, include->entity->package);
+                    add_entities_for_node(&context->entities, NULL, (AstNode *) new_include, ast_entity(context, include)->scope, ast_entity(context, include)->package);
                 }
 
                 if (entry.type == BH_DIRENT_DIRECTORY && include->recursive) {
@@ -421,10 +734,71 @@ static b32 process_entity(Context *context, Entity* ent) {
     return changed;
 }
 
+static OnyxToken *trace_entity_token(Entity *ent);
+static char *trace_entity_name(Context *context, Entity *ent);
+static char *trace_entity_location(Context *context, Entity *ent);
+
+static void report_wait_cycle(Context *context, Entity **cycle, i32 count) {
+    Entity *first = cycle[0];
+    OnyxToken *token = trace_entity_token(first);
+    OnyxFilePos pos = token ? token->pos : (OnyxFilePos) { 0 };
+
+    char *message = bh_aprintf(context->scratch_alloc, "Circular dependency. '%s' is waiting on ",
+        trace_entity_name(context, first));
+
+    fori (i, 1, count) {
+        message = bh_aprintf(context->scratch_alloc, "%s'%s' (%s), which is waiting on ", message,
+            trace_entity_name(context, cycle[i]),
+            trace_entity_location(context, cycle[i]));
+    }
+
+    ONYX_ERROR(pos, Error_Critical, "%s'%s'.", message, trace_entity_name(context, first));
+}
+
+//
+// Follows what every remaining entity is waiting on, and reports each cycle that is
+// found. Nothing in a cycle can ever make progress, so this is the actual reason
+// compilation cannot continue, instead of one "waiting on" error per entity.
+static void report_wait_cycles(Context *context) {
+    struct { Entity *key; i32 value; } *walk_of = NULL;
+    bh_arr(Entity *) path = NULL;
+    bh_arr_new(context->gp_alloc, path, 16);
+
+    i32 walk = 0;
+    bh_arr(Entity *) queues[] = { context->entities.entities, context->entities.quick_unsorted_entities };
+    fori (q, 0, 2) {
+        bh_arr_each(Entity *, pent, queues[q]) {
+            walk++;
+            bh_arr_clear(path);
+
+            Entity *e = *pent;
+            while (e && hmgeti(walk_of, e) == -1) {
+                hmput(walk_of, e, walk);
+                bh_arr_push(path, e);
+                e = e->waiting_on_entity;
+            }
+
+            // Only a path that runs into itself is a cycle. Running into an earlier
+            // path means the cycle, if any, was already reported.
+            if (!e || hmget(walk_of, e) != walk) continue;
+
+            i32 start = 0;
+            while (path[start] != e) start++;
+
+            report_wait_cycle(context, path + start, bh_arr_length(path) - start);
+        }
+    }
+
+    bh_arr_free(path);
+    hmfree(walk_of);
+}
+
 static void dump_cycles(Context *context) {
     context->cycle_detected = 1;
     Entity* ent;
 
+    report_wait_cycles(context);
+
     while (1) {
         ent = entity_heap_top(&context->entities);
         entity_heap_remove_top(&context->entities);
@@ -444,15 +818,63 @@ static void send_stalled_hooks(Context *context) {
     }
 }
 
+//
+// Called when nothing can make progress anymore. Parked entities are retried as well,
+// because the steps below (#defined giving up, stalled hooks, cycle reporting) can
+// change the outcome for them too. Each time this happens without any progress in
+// between, the next step is taken.
+static void pump_stalled(Context *context) {
+    entity_heap_wake_all(&context->entities);
+    context->entities.parking_disabled = 1;
+
+    if (context->cycle_almost_detected == 4) {
+        dump_cycles(context);
+    } else if (context->cycle_almost_detected == 3) {
+        send_stalled_hooks(context);
+    } else if (context->cycle_almost_detected == 2) {
+        compiler_event_add(context, 4);
+    }
+
+    context->cycle_almost_detected += 1;
+}
+
 onyx_pump_t onyx_pump(onyx_context_t *ctx) {
     Context *context = &ctx->context;
 
     compiler_events_clear(context);
 
+    // While files are held, everything that can be checked without them has been once
+    // the queue runs dry, is about to start code generation, or stalls. Stalls are
+    // left to the compilations that continue after the files are released.
+    if (context->held.holding) {
+        if (bh_arr_is_empty(context->entities.entities)
+            || entity_heap_top(&context->entities)->state >= Entity_State_Code_Gen) {
+            return ONYX_PUMP_PAUSED;
+        }
+    }
+
+    if (context->entities.parked_count > 0) {
+        // Once the queue runs dry, or is about to move on to code generation (which
+        // expects everything to be checked), every entity that is left to check is
+        // parked. Nothing they wait on can happen anymore, so this is a stall, found
+        // without waiting for the watermark below to notice it.
+        if (bh_arr_is_empty(context->entities.entities)
+            || entity_heap_top(&context->entities)->state >= Entity_State_Code_Gen) {
+            pump_stalled(context);
+
+            if (onyx_has_errors(context)) return ONYX_PUMP_ERRORED;
+        }
+    }
+
     if (bh_arr_is_empty(context->entities.entities)) {
         // Once the module has been linked, we are all done and ready to say everything compiled successfully!
         if (context->wasm_module_linked) return ONYX_PUMP_DONE;
 
+        if (context->held.released) {
+            held_files_check_late_options(context);
+            if (bh_arr_length(context->held.conflicts) > 0) return ONYX_PUMP_ERRORED;
+        }
+
         link_wasm_module(context);
         context->wasm_module_linked = 1;
         return ONYX_PUMP_DONE;
@@ -468,14 +890,72 @@ onyx_pump_t onyx_pump(onyx_context_t *ctx) {
     u64 perf_start;
     EntityType perf_entity_type;
     EntityState perf_entity_state;
-    if (context->options->running_perf) {
+    if (context->options->running_perf || context->options->collect_trace) {
         perf_start = bh_time_curr_micro();
         perf_entity_type = ent->type;
         perf_entity_state = ent->state;
     }
 
+    onyx_pump_t result = ONYX_PUMP_CONTINUE;
+
+    bh_arr_clear(context->checker.unresolved_symbols);
+    bh_arr_clear(context->checker.blocking_entities);
+    context->checker.waiting_on_stall = 0;
+    context->checker.wait_recorded = 0;
+    context->checker.untracked_yield = 0;
     b32 changed = process_entity(context, ent);
 
+    context->stats.entities_processed++;
+    if (!changed) context->stats.entities_yielded++;
+
+    if (ent->held) goto pump_done;
+
+    bh_arr(OnyxToken *) unresolved_symbols = context->checker.unresolved_symbols;
+    bh_arr(Entity *) blocking_entities = context->checker.blocking_entities;
+
+    ent->waiting_on_entity = NULL;
+    if (!changed && bh_arr_length(blocking_entities) > 0) {
+        ent->waiting_on_entity = blocking_entities[0];
+    }
+
+    // If the checker knows everything the entity could not make progress on (symbols
+    // that are not defined yet, or other entities that have not gotten far enough),
+    // there is no point in retrying it until one of those changes. Park it on all of
+    // them instead of putting it back in the queue. If it yielded for any reason that
+    // was not recorded, it stays in the queue, as it could be waiting on anything.
+    if (!changed
+        && (ent->state == Entity_State_Introduce_Symbols || ent->state == Entity_State_Check_Types)
+        && !context->checker.untracked_yield
+        && (bh_arr_length(unresolved_symbols) > 0 || bh_arr_length(blocking_entities) > 0 || context->checker.waiting_on_stall)
+        && !context->entities.parking_disabled
+        && !context->cycle_detected
+        && !onyx_has_errors(context)) {
+
+        if (context->watermarked_node == ent) context->watermarked_node = NULL;
+
+        bh_arr_each(OnyxToken *, symbol, unresolved_symbols) {
+            entity_heap_park_on_symbol(&context->entities, ent, token_atom(context, *symbol));
+        }
+
+        bh_arr_each(Entity *, blocker, blocking_entities) {
+            entity_heap_park_on_entity(&context->entities, ent, *blocker);
+        }
+
+        if (context->checker.waiting_on_stall) {
+            entity_heap_park_until_stall(&context->entities, ent);
+        }
+
+        goto pump_done;
+    }
+
+    // Entities that were waiting on this one might be able to continue now. This is
+    // done every time it is processed and not parked, not only when its state changes,
+    // because most entities make some progress in place before they finish a state (a
+    // struct gets its `use` members, a function checks some of its statements), and the
+    // waiting entities could need exactly that. Parked entities do not wake anything,
+    // otherwise two entities waiting on each other would wake each other forever.
+    entity_heap_wake_entity(&context->entities, ent);
+
     // NOTE: VERY VERY dumb cycle breaking. Basically, remember the first entity that did
     // not change (i.e. did not make any progress). Then everytime an entity doesn't change,
     // check if it is the same entity. If it is, it means all other entities that were processed
@@ -496,38 +976,61 @@ onyx_pump_t onyx_pump(onyx_context_t *ctx) {
             if (ent->macro_attempts > context->highest_watermark) {
                 entity_heap_insert_existing(&context->entities, ent);
 
-                if (context->cycle_almost_detected == 4) {
-                    dump_cycles(context);
-                } else if (context->cycle_almost_detected == 3) {
-                    send_stalled_hooks(context);
-                } else if (context->cycle_almost_detected == 2) {
-                    compiler_event_add(context, 4);
+                if (context->held.holding) {
+                    result = ONYX_PUMP_PAUSED;
+                    goto pump_done;
                 }
 
-                context->cycle_almost_detected += 1;
+                pump_stalled(context);
             }
         }
     } else {
         context->watermarked_node = NULL;
         context->cycle_almost_detected = 0;
+        context->entities.parking_disabled = 0;
     }
 
     if (onyx_has_errors(context)) {
-        return ONYX_PUMP_ERRORED;
+        result = ONYX_PUMP_ERRORED;
+        goto pump_done;
+    }
+
+    // Going on would only produce something that a full compilation might not.
+    if (context->held.released && bh_arr_length(context->held.conflicts) > 0) {
+        result = ONYX_PUMP_ERRORED;
+        goto pump_done;
     }
 
     if (ent->state != Entity_State_Finalized && ent->state != Entity_State_Failed)
         entity_heap_insert_existing(&context->entities, ent);
 
-    if (context->options->running_perf) {
+  pump_done:
+    if (context->options->running_perf || context->options->collect_trace) {
         u64 perf_end = bh_time_curr_micro();
 
         u64 duration = perf_end - perf_start;
         context->stats.microseconds_per_type[perf_entity_type] += duration;
         context->stats.microseconds_per_state[perf_entity_state] += duration;
+
+        if (context->options->collect_trace) {
+            CompilerTraceResult trace_result = changed ? Compiler_Trace_Progressed : Compiler_Trace_Yielded;
+            if (ent->parked)                   trace_result = Compiler_Trace_Parked;
+            if (result == ONYX_PUMP_ERRORED)   trace_result = Compiler_Trace_Failed;
+
+            bh_arr_push(context->trace_events, ((CompilerTraceEvent) {
+                .entity         = ent,
+                .start_us       = perf_start,
+                .duration_us    = duration,
+                .state          = perf_entity_state,
+                .next_state     = ent->state,
+                .result         = trace_result,
+                .macro_attempts = ent->macro_attempts,
+                .micro_attempts = ent->micro_attempts,
+            }));
+        }
     }
 
-    return ONYX_PUMP_CONTINUE;
+    return result;
 }
 
 //
@@ -628,6 +1131,10 @@ int32_t onyx_set_option_int(onyx_context_t *ctx, onyx_option_t opt, int32_t valu
     case ONYX_OPTION_DISABLE_FILE_CONTENTS:  ctx->context.options->no_file_contents = value; return 1;
     case ONYX_OPTION_DISABLE_EXTENSIONS:     ctx->context.options->no_compiler_extensions = value; return 1;
     case ONYX_OPTION_PLATFORM:               ctx->context.options->runtime = value; return 1;
+    case ONYX_OPTION_DISABLE_TREE_SHAKING:   ctx->context.options->no_tree_shaking = value; return 1;
+    case ONYX_OPTION_DISABLE_PEEPHOLE:       ctx->context.options->no_peephole = value; return 1;
+    case ONYX_OPTION_COLLECT_PERF:           ctx->context.options->running_perf = value; return 1;
+    case ONYX_OPTION_COLLECT_TRACE:          ctx->context.options->collect_trace = value; return 1;
 
     default:
         break;
@@ -675,6 +1182,64 @@ void onyx_inject_code(onyx_context_t *ctx, uint8_t *code, int32_t length) {
     assert(0 && "unimplemented");
 }
 
+void onyx_hold_file(onyx_context_t *ctx, char *filename, int32_t length) {
+    Context *context = &ctx->context;
+    if (length < 0) length = strlen(filename);
+
+    if (!context->held.holding) {
+        context->held.holding = 1;
+        sh_new_arena(context->held.files);
+        sh_new_arena(context->held.dependencies);
+        bh_arr_new(context->gp_alloc, context->held.entities, 4);
+        bh_arr_new(context->gp_alloc, context->held.late_options, 4);
+        bh_arr_new(context->gp_alloc, context->held.conflicts, 4);
+    }
+
+    char *name = bh_strdup_len(context->scratch_alloc, filename, length);
+    shput(context->held.files, bh_path_get_full_name(name, context->scratch_alloc), 1);
+}
+
+void onyx_release_held_files(onyx_context_t *ctx) {
+    Context *context = &ctx->context;
+    if (!context->held.holding) return;
+
+    context->held.holding  = 0;
+    context->held.released = 1;
+    context->held.last_scope_id = context->next_scope_id;
+    context->held.last_type_id  = context->next_type_id;
+
+    fori (i, 0, shlen(context->held.dependencies)) {
+        bh_file_stats stats;
+        u64 modified_time = bh_file_stat(context->held.dependencies[i].key, &stats) ? stats.modified_time : 0;
+        if (modified_time != context->held.dependencies[i].value) {
+            held_files_conflict(context, 0);
+        }
+    }
+
+    bh_arr_each(Entity *, pent, context->held.entities) {
+        (*pent)->held = 0;
+        entity_heap_insert_existing(&context->entities, *pent);
+    }
+
+    bh_arr_clear(context->held.entities);
+    context->watermarked_node = NULL;
+}
+
+int32_t onyx_held_file_conflict_count(onyx_context_t *ctx) {
+    return bh_arr_length(ctx->context.held.conflicts);
+}
+
+const char *onyx_held_file_conflict_filepath(onyx_context_t *ctx, int32_t conflict_index) {
+    if (conflict_index < 0 || conflict_index >= onyx_held_file_conflict_count(ctx)) return NULL;
+
+    u16 file_id = ctx->context.held.conflicts[conflict_index];
+    if (file_id == 0 || file_id == INTERNAL_SOURCE_FILE_ID) return NULL;
+
+    OnyxFilePos pos = { 0 };
+    pos.file_id = file_id;
+    return file_pos_filename(pos);
+}
+
 //
 // Output
 //
@@ -694,21 +1259,21 @@ const char *onyx_error_filename(onyx_context_t *ctx, int32_t error_idx) {
     int32_t error_count = onyx_error_count(ctx);
     if (error_idx < 0 || error_idx >= error_count) return NULL;
 
-    return ctx->context.errors.errors[error_idx].pos.filename;
+    return file_pos_location(ctx->context.errors.errors[error_idx].pos).filename;
 }
 
 int32_t onyx_error_line(onyx_context_t *ctx, int32_t error_idx) {
     int32_t error_count = onyx_error_count(ctx);
     if (error_idx < 0 || error_idx >= error_count) return 0;
 
-    return ctx->context.errors.errors[error_idx].pos.line;
+    return file_pos_location(ctx->context.errors.errors[error_idx].pos).line;
 }
 
 int32_t onyx_error_column(onyx_context_t *ctx, int32_t error_idx) {
     int32_t error_count = onyx_error_count(ctx);
     if (error_idx < 0 || error_idx >= error_count) return 0;
 
-    return ctx->context.errors.errors[error_idx].pos.column;
+    return file_pos_location(ctx->context.errors.errors[error_idx].pos).column;
 }
 
 int32_t onyx_error_length(onyx_context_t *ctx, int32_t error_idx) {
@@ -723,14 +1288,15 @@ int32_t onyx_error_line_text(onyx_context_t *ctx, int32_t error_idx, char *line_
     if (error_idx < 0 || error_idx >= error_count) return 0;
 
     int line_length = 0;
-    char *walker = ctx->context.errors.errors[error_idx].pos.line_start;
+    char *line_start = file_pos_location(ctx->context.errors.errors[error_idx].pos).line_start;
+    char *walker = line_start;
     if (!walker) return 0;
 
     while (*walker && *walker++ != '\n') line_length++;
 
     if (line_buffer != NULL && max_length > 0) {
         i32 to_copy = bh_min(max_length - 1, line_length);
-        memcpy(line_buffer, ctx->context.errors.errors[error_idx].pos.line_start, to_copy);
+        memcpy(line_buffer, line_start, to_copy);
         line_buffer[to_copy] = '\0';
     }
 
@@ -745,6 +1311,244 @@ onyx_error_t onyx_error_rank(onyx_context_t *ctx, int32_t error_idx) {
 }
 
 
+//
+// Tracing
+//
+
+static const char *trace_result_strings[] = {
+    "progressed",
+    "yielded",
+    "parked",
+    "failed",
+};
+
+static void trace_write_string(bh_buffer *out, const char *text) {
+    bh_buffer_write_byte(out, '"');
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') bh_buffer_write_byte(out, '\\');
+
+        // Control characters cannot appear in a JSON string.
+        bh_buffer_write_byte(out, (u8) *c < 0x20 ? ' ' : *c);
+    }
+    bh_buffer_write_byte(out, '"');
+}
+
+// Job entities do not have a node, so they do not have a location either.
+static OnyxToken *trace_entity_token(Entity *ent) {
+    if (ent->type == Entity_Type_Job || ent->expr == NULL) return NULL;
+    return ent->expr->token;
+}
+
+static char *trace_entity_name(Context *context, Entity *ent) {
+    char *name = NULL;
+    switch (ent->type) {
+        case Entity_Type_Function:
+        case Entity_Type_Function_Header:
+        case Entity_Type_Temp_Function_Header:
+        case Entity_Type_Foreign_Function_Header:
+            name = get_function_name(context, ent->function);
+            break;
+
+        // get_function_name only names procedures that are not polymorphic. The token
+        // of an anonymous procedure is its '(', so those are left to their location.
+        case Entity_Type_Polymorphic_Proc:
+            name = ent->poly_proc->name;
+            break;
+
+        case Entity_Type_Binding:
+            if (ent->binding->token) {
+                name = bh_aprintf(context->scratch_alloc, "%b", ent->binding->token->text, ent->binding->token->length);
+            }
+            break;
+
+        case Entity_Type_Type_Alias:
+            if (ent->type_alias->kind == Ast_Kind_Struct_Type) {
+                name = ((AstStructType *) ent->type_alias)->name;
+            }
+            break;
+
+        default: break;
+    }
+
+    if (name == NULL) return (char *) entity_type_strings[ent->type];
+    return bh_aprintf(context->scratch_alloc, "%s %s", entity_type_strings[ent->type], name);
+}
+
+static char *trace_entity_location(Context *context, Entity *ent) {
+    OnyxToken *token = trace_entity_token(ent);
+    if (token == NULL || token->pos.file_id == 0) return "";
+
+    OnyxFileLocation location = file_pos_location(token->pos);
+    return bh_aprintf(context->scratch_alloc, "%s:%d:%d", location.filename, location.line, location.column);
+}
+
+// Writes the events in the Chrome trace event format, which can be opened
+// in chrome://tracing, Perfetto or speedscope. Every call to process an
+// entity is one complete ("X") event on the same thread.
+static void trace_generate_json(Context *context, bh_buffer *out) {
+    bh_buffer_init(out, context->gp_alloc, 1 << 16);
+    bh_buffer_write_string(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    u64 first_start = bh_arr_length(context->trace_events) > 0 ? context->trace_events[0].start_us : 0;
+
+    bh_arr_each(CompilerTraceEvent, event, context->trace_events) {
+        if (event != context->trace_events) bh_buffer_write_string(out, ",\n");
+
+        bh_buffer_write_string(out, "{\"name\":");
+        trace_write_string(out, trace_entity_name(context, event->entity));
+        bh_buffer_write_string(out, ",\"cat\":");
+        trace_write_string(out, (char *) entity_state_strings[event->state]);
+        bh_buffer_write_string(out, bh_bprintf(",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%l,\"dur\":%l",
+            event->start_us - first_start, event->duration_us));
+
+        bh_buffer_write_string(out, bh_bprintf(",\"args\":{\"entity\":%d,\"result\":\"%s\",\"next_state\":\"%s\",\"macro_attempts\":%d,\"micro_attempts\":%d,\"location\":",
+            event->entity->id,
+            trace_result_strings[event->result],
+            entity_state_strings[event->next_state],
+            event->macro_attempts,
+            event->micro_attempts));
+        trace_write_string(out, trace_entity_location(context, event->entity));
+        bh_buffer_write_string(out, "}}");
+    }
+
+    bh_buffer_write_string(out, "\n]}\n");
+}
+
+typedef struct TraceEntityTotals {
+    Entity *entity;
+    u64 microseconds;
+    u32 runs;
+    u32 requeues;
+} TraceEntityTotals;
+
+static int trace_compare_by_time(const void *a, const void *b) {
+    const TraceEntityTotals *x = *(TraceEntityTotals **) a, *y = *(TraceEntityTotals **) b;
+    if (x->microseconds != y->microseconds) return x->microseconds < y->microseconds ? 1 : -1;
+    return x->entity->id - y->entity->id;
+}
+
+static int trace_compare_by_requeues(const void *a, const void *b) {
+    const TraceEntityTotals *x = *(TraceEntityTotals **) a, *y = *(TraceEntityTotals **) b;
+    if (x->requeues != y->requeues) return x->requeues < y->requeues ? 1 : -1;
+    return x->entity->id - y->entity->id;
+}
+
+#define TRACE_SUMMARY_COUNT 15
+
+static void trace_write_summary_table(Context *context, bh_buffer *out, TraceEntityTotals **totals, i32 count) {
+    bh_buffer_write_string(out, "      Time (us)      Runs  Requeued  Entity\n");
+
+    char line[1024];
+    fori (i, 0, bh_min(count, TRACE_SUMMARY_COUNT)) {
+        TraceEntityTotals *t = totals[i];
+        snprintf(line, sizeof(line), "    %11llu  %8u  %8u  %s %s\n",
+            (unsigned long long) t->microseconds, t->runs, t->requeues,
+            trace_entity_name(context, t->entity),
+            trace_entity_location(context, t->entity));
+
+        bh_buffer_write_string(out, line);
+    }
+}
+
+// Totals the events per entity, and lists the entities that took the most
+// time, and the ones that were processed the most times without finishing.
+static void trace_generate_summary(Context *context, bh_buffer *out) {
+    bh_buffer_init(out, context->gp_alloc, 4096);
+
+    // Entity ids are handed out sequentially, so they can index the totals directly.
+    i32 entity_count = context->entities.next_id;
+    TraceEntityTotals *totals = bh_alloc_array(context->gp_alloc, TraceEntityTotals, entity_count);
+    memset(totals, 0, sizeof(TraceEntityTotals) * entity_count);
+
+    bh_arr_each(CompilerTraceEvent, event, context->trace_events) {
+        TraceEntityTotals *t = &totals[event->entity->id];
+        t->entity = event->entity;
+        t->microseconds += event->duration_us;
+        t->runs += 1;
+        if (event->result != Compiler_Trace_Progressed) t->requeues += 1;
+    }
+
+    bh_arr(TraceEntityTotals *) sorted = NULL;
+    bh_arr_new(context->gp_alloc, sorted, 512);
+    fori (i, 0, entity_count) {
+        if (totals[i].runs > 0) bh_arr_push(sorted, &totals[i]);
+    }
+
+    bh_buffer_write_string(out, bh_bprintf("Traced %d entity runs over %d entities.\n\n",
+        bh_arr_length(context->trace_events), bh_arr_length(sorted)));
+
+    bh_buffer_write_string(out, "Most expensive entities:\n");
+    qsort(sorted, bh_arr_length(sorted), sizeof(TraceEntityTotals *), trace_compare_by_time);
+    trace_write_summary_table(context, out, sorted, bh_arr_length(sorted));
+
+    bh_buffer_write_string(out, "\nMost requeued entities:\n");
+    qsort(sorted, bh_arr_length(sorted), sizeof(TraceEntityTotals *), trace_compare_by_requeues);
+    trace_write_summary_table(context, out, sorted, bh_arr_length(sorted));
+
+    bh_arr_free(sorted);
+    bh_free(context->gp_alloc, totals);
+}
+
+static void ensure_trace_has_been_generated(onyx_context_t *ctx) {
+    if (!ctx->context.options->collect_trace) return;
+
+    if (ctx->context.generated_trace_buffer.data == NULL) {
+        trace_generate_json(&ctx->context, &ctx->context.generated_trace_buffer);
+        trace_generate_summary(&ctx->context, &ctx->context.generated_trace_summary_buffer);
+    }
+}
+
+
+//
+// Polymorph Statistics
+//
+
+static int polymorph_compare_by_instances(const void *a, const void *b) {
+    AstFunction *x = *(AstFunction **) a, *y = *(AstFunction **) b;
+    return bh_arr_length(y->concrete_funcs->instances) - bh_arr_length(x->concrete_funcs->instances);
+}
+
+#define POLYMORPH_SUMMARY_COUNT 15
+
+// Lists the polymorphic procedures with the most instances, since those are
+// the ones that add the most code to the binary.
+static void polymorph_generate_summary(Context *context, bh_buffer *out) {
+    bh_buffer_init(out, context->gp_alloc, 4096);
+
+    // A procedure that was turned back into a normal function has no instances.
+    bh_arr(AstFunction *) procs = NULL;
+    bh_arr_new(context->gp_alloc, procs, bh_arr_length(context->polymorph.instantiated_procs));
+    bh_arr_each(AstFunction *, pp, context->polymorph.instantiated_procs) {
+        if ((*pp)->concrete_funcs) bh_arr_push(procs, *pp);
+    }
+
+    qsort(procs, bh_arr_length(procs), sizeof(AstFunction *), polymorph_compare_by_instances);
+
+    bh_buffer_write_string(out, "    Instances  Procedure\n");
+
+    char line[1024];
+    fori (i, 0, bh_min(bh_arr_length(procs), POLYMORPH_SUMMARY_COUNT)) {
+        AstFunction *pp = procs[i];
+        OnyxFileLocation location = pp->token ? file_pos_location(pp->token->pos) : (OnyxFileLocation) { 0 };
+
+        snprintf(line, sizeof(line), "    %9d  %s %s:%d:%d\n",
+            bh_arr_length(pp->concrete_funcs->instances),
+            pp->name ? pp->name : "unnamed_proc",
+            location.filename ? location.filename : "", location.line, location.column);
+
+        bh_buffer_write_string(out, line);
+    }
+
+    bh_arr_free(procs);
+}
+
+static void ensure_polymorph_summary_has_been_generated(onyx_context_t *ctx) {
+    if (ctx->context.generated_polymorph_summary_buffer.data == NULL) {
+        polymorph_generate_summary(&ctx->context, &ctx->context.generated_polymorph_summary_buffer);
+    }
+}
+
+
 //
 // Code Generation
 //
@@ -794,6 +1598,18 @@ int32_t onyx_output_length(onyx_context_t *ctx, onyx_output_type_t type) {
     case ONYX_OUTPUT_TYPE_OSYM:
         ensure_osym_has_been_generated(ctx);
         return ctx->context.generated_osym_buffer.length;
+
+    case ONYX_OUTPUT_TYPE_TRACE:
+        ensure_trace_has_been_generated(ctx);
+        return ctx->context.generated_trace_buffer.length;
+
+    case ONYX_OUTPUT_TYPE_TRACE_SUMMARY:
+        ensure_trace_has_been_generated(ctx);
+        return ctx->context.generated_trace_summary_buffer.length;
+
+    case ONYX_OUTPUT_TYPE_POLYMORPH_SUMMARY:
+        ensure_polymorph_summary_has_been_generated(ctx);
+        return ctx->context.generated_polymorph_summary_buffer.length;
     }
 
     return 0;
@@ -820,6 +1636,21 @@ void onyx_output_write(onyx_context_t *ctx, onyx_output_type_t type, void *buffe
         ensure_osym_has_been_generated(ctx);
         memcpy(buffer, ctx->context.generated_osym_buffer.data, ctx->context.generated_osym_buffer.length);
         break;
+
+    case ONYX_OUTPUT_TYPE_TRACE:
+        ensure_trace_has_been_generated(ctx);
+        memcpy(buffer, ctx->context.generated_trace_buffer.data, ctx->context.generated_trace_buffer.length);
+        break;
+
+    case ONYX_OUTPUT_TYPE_TRACE_SUMMARY:
+        ensure_trace_has_been_generated(ctx);
+        memcpy(buffer, ctx->context.generated_trace_summary_buffer.data, ctx->context.generated_trace_summary_buffer.length);
+        break;
+
+    case ONYX_OUTPUT_TYPE_POLYMORPH_SUMMARY:
+        ensure_polymorph_summary_has_been_generated(ctx);
+        memcpy(buffer, ctx->context.generated_polymorph_summary_buffer.data, ctx->context.generated_polymorph_summary_buffer.length);
+        break;
     }
 }
 
@@ -828,11 +1659,72 @@ void onyx_output_write(onyx_context_t *ctx, onyx_output_type_t type, void *buffe
 // Compilation Info
 //
 
+// An arena only knows how much of its current block is used. The earlier blocks
+// are counted as full, since a new block is only started when the current one
+// cannot fit an allocation.
+static u64 arena_bytes_used(bh_arena *arena) {
+    if (arena->first_arena == NULL) return 0;
+
+    u64 block_count = 0;
+    bh__arena_internal *block = arena->first_arena;
+    while (block != NULL) {
+        block_count++;
+        block = block->next_arena;
+    }
+
+    return (block_count - 1) * arena->arena_size + arena->size;
+}
+
+// The code of every function, and the arena that holds the immediates that do
+// not fit in an instruction, like branch tables and SIMD constants.
+static u64 instruction_bytes_used(Context *context) {
+    OnyxWasmModule *module = context->wasm_module;
+    if (module == NULL) return 0;
+
+    u64 bytes = arena_bytes_used(module->extended_instr_data);
+    bh_arr_each(WasmFunc, func, module->funcs) {
+        bytes += bh_arr_capacity(func->code) * sizeof(WasmInstruction);
+    }
+
+    return bytes;
+}
+
+static u64 source_bytes_loaded(Context *context) {
+    u64 bytes = 0;
+    bh_arr_each(bh_file_contents, fc, context->loaded_files) {
+        bytes += fc->length;
+    }
+
+    return bytes;
+}
+
 int64_t onyx_stat(onyx_context_t *ctx, onyx_stat_t stat) {
     switch (stat) {
         case ONYX_STAT_FILE_COUNT:  return bh_arr_length(ctx->context.loaded_files);
         case ONYX_STAT_LINE_COUNT:  return ctx->context.stats.lexer_lines_processed;
         case ONYX_STAT_TOKEN_COUNT: return ctx->context.stats.lexer_tokens_processed;
+
+        case ONYX_STAT_ENTITIES_PROCESSED: return ctx->context.stats.entities_processed;
+        case ONYX_STAT_ENTITIES_YIELDED:   return ctx->context.stats.entities_yielded;
+        case ONYX_STAT_ENTITIES_PARKED:    return ctx->context.entities.total_parked;
+        case ONYX_STAT_ENTITIES_WOKEN:     return ctx->context.entities.total_woken;
+
+        case ONYX_STAT_SOURCE_CACHE_HITS:   return ctx->context.stats.source_cache_hits;
+        case ONYX_STAT_SOURCE_CACHE_MISSES: return ctx->context.stats.source_cache_misses;
+
+        case ONYX_STAT_FUNCTIONS_REMOVED:    return ctx->context.stats.functions_removed;
+        case ONYX_STAT_INSTRUCTIONS_REMOVED: return ctx->context.stats.instructions_removed;
+
+        case ONYX_STAT_MEMORY_SOURCE:       return source_bytes_loaded(&ctx->context);
+        case ONYX_STAT_MEMORY_TOKENS:       return ctx->context.stats.token_bytes;
+        case ONYX_STAT_MEMORY_AST:          return arena_bytes_used(&ctx->context.ast_arena);
+        case ONYX_STAT_MEMORY_ENTITIES:     return arena_bytes_used(&ctx->context.entities.entity_arena) + bh_arr_capacity(ctx->context.entities.all_entities) * sizeof(Entity *);
+        case ONYX_STAT_MEMORY_INSTRUCTIONS: return instruction_bytes_used(&ctx->context);
+
+        case ONYX_STAT_POLYMORPH_LOOKUPS:   return ctx->context.stats.polymorph_lookups;
+        case ONYX_STAT_POLYMORPH_INSTANCES: return ctx->context.stats.polymorph_instances;
+
+        case ONYX_STAT_DATA_SEGMENTS_REMOVED: return ctx->context.stats.data_segments_removed;
         default: return -1;
     }
 }
@@ -871,6 +1763,14 @@ void onyx_run_wasm_with_debug(void *buffer, int32_t buffer_length, int argc, cha
 
     onyx_run_wasm_code(wasm_bytes, argc, argv);
 }
+
+void onyx_run_set_program_cache_dir(char *dir) {
+    onyx_run_set_program_cache(dir);
+}
+
+void onyx_run_set_jit_enabled(int32_t enabled) {
+    onyx_run_set_jit(enabled);
+}
 #else
 void onyx_run_wasm(void *buffer, int32_t buffer_length, int argc, char **argv) {
     printf("ERROR: Cannot run WASM code. No runtime was configured at the time Onyx was built");
@@ -879,6 +1779,12 @@ void onyx_run_wasm(void *buffer, int32_t buffer_length, int argc, char **argv) {
 void onyx_run_wasm_with_debug(void *buffer, int32_t buffer_length, int argc, char **argv, char *socket_path) {
     printf("ERROR: Cannot run WASM code. No runtime was configured at the time Onyx was built");
 }
+
+void onyx_run_set_program_cache_dir(char *dir) {
+}
+
+void onyx_run_set_jit_enabled(int32_t enabled) {
+}
 #endif
 
 
@@ -886,7 +1792,7 @@ void onyx_run_wasm_with_debug(void *buffer, int32_t buffer_length, int argc, cha
 // Internal procedures
 
 static AstInclude* create_load(Context *context, char* filename, int32_t length) {
-    static OnyxToken implicit_load_token = { '#', 1, 0, { 0, 0, 0, 0, 0 } };
+    static OnyxToken implicit_load_token = { '#', 1, 0, { 0, 0, 0 } };
     
     AstInclude* include_node = onyx_ast_node_new(context->ast_alloc, sizeof(AstInclude), Ast_Kind_Load_File);
     include_node->name = bh_strdup_len(context->ast_alloc, filename, length);
@@ -13,7 +13,7 @@
 // :LinearTokenDependent
 #define peek_token(ahead)                   (parser->curr + ahead)
 
-static AstNode error_node = { Ast_Kind_Error, 0, NULL, NULL };
+static AstNode error_node = { Ast_Kind_Error, 0, 0, NULL, NULL };
 
 #define ENTITY_SUBMIT(node)                 (submit_entity_in_scope(parser, (AstNode *) (node), parser->current_scope, parser->package))
 #define ENTITY_SUBMIT_IN_SCOPE(node, scope) (submit_entity_in_scope(parser, (AstNode *) (node), scope, parser->package))
@@ -304,13 +304,11 @@ static void flush_doc_tokens(OnyxParser *parser, const char **out_string, OnyxTo
 static u64 parse_int_token(OnyxToken *int_token) {
     u64 value = 0;
 
-    token_toggle_end(int_token);
-
     char *buf = int_token->text;
     i32     i = 0;
     i64  base = 10;
 
-    if (buf[0] == '0' && buf[1] == 'x') {
+    if (int_token->length > 1 && buf[0] == '0' && buf[1] == 'x') {
         base = 16;
         i = 2;
     }
@@ -323,11 +321,12 @@ static u64 parse_int_token(OnyxToken *int_token) {
         if ('a' <= c && c <= 'z') { value *= base; value += ((c - 'a') + 10); }
     }
 
-    token_toggle_end(int_token);
     return value;
 }
 
-static f64 parse_float_sign(char **s) {
+static f64 parse_float_sign(char **s, char *end) {
+    if (*s == end) return 1;
+
     if (**s == '-') {
         *s += 1;
         return -1;
@@ -341,9 +340,9 @@ static f64 parse_float_sign(char **s) {
     return 1;
 }
 
-static f64 parse_float_digit(char **s, i32 *digit_count) {
+static f64 parse_float_digit(char **s, char *end, i32 *digit_count) {
     f64 value = 0;
-    while (**s) {
+    while (*s < end) {
         char c = **s;
         if ('0' <= c && c <= '9') {
             value = value * 10 + (c - '0');
@@ -359,18 +358,17 @@ static f64 parse_float_digit(char **s, i32 *digit_count) {
 }
 
 static f64 parse_float_token(OnyxToken *float_token) {
-    token_toggle_end(float_token);
-
-    char *s = float_token->text;
+    char *s   = float_token->text;
+    char *end = float_token->text + float_token->length;
     i32 digit_count = 0;
 
-    f64 sign  = parse_float_sign(&s);
-    f64 value = parse_float_digit(&s, &digit_count);
+    f64 sign  = parse_float_sign(&s, end);
+    f64 value = parse_float_digit(&s, end, &digit_count);
 
-    if (*s == '.') {
+    if (s < end && *s == '.') {
         s++;
         digit_count = 0;
-        f64 fraction = parse_float_digit(&s, &digit_count);
+        f64 fraction = parse_float_digit(&s, end, &digit_count);
         while (digit_count > 0) {
             digit_count -= 1;
             fraction /= 10;
@@ -380,12 +378,12 @@ static f64 parse_float_token(OnyxToken *float_token) {
 
     value *= sign;
 
-    if (*s == 'e') {
+    if (s < end && *s == 'e') {
         s++;
 
         digit_count = 0;
-        f64 exponent_sign = parse_float_sign(&s);
-        f64 exponent      = parse_float_digit(&s, &digit_count);
+        f64 exponent_sign = parse_float_sign(&s, end);
+        f64 exponent      = parse_float_digit(&s, end, &digit_count);
 
         if (exponent_sign > 0) {
             while (exponent > 0) {
@@ -400,7 +398,6 @@ static f64 parse_float_token(OnyxToken *float_token) {
         }
     }
 
-    token_toggle_end(float_token);
     return value;
 }
 
@@ -943,9 +940,11 @@ static AstTyped* parse_factor(OnyxParser* parser) {
             else if (parse_possible_directive(parser, "file")) {
                 OnyxToken* dir_token = parser->curr - 2;
 
+                const char *dir_filename = file_pos_filename(dir_token->pos);
+
                 OnyxToken* str_token = bh_alloc(parser->allocator, sizeof(OnyxToken));
-                str_token->text  = bh_strdup(parser->context->gp_alloc, (char *) dir_token->pos.filename);
-                str_token->length = strlen(dir_token->pos.filename);
+                str_token->text  = bh_strdup(parser->context->gp_alloc, (char *) dir_filename);
+                str_token->length = strlen(dir_filename);
                 str_token->pos = dir_token->pos;
                 str_token->type = Token_Type_Literal_String;
 
@@ -960,14 +959,14 @@ static AstTyped* parse_factor(OnyxParser* parser) {
             else if (parse_possible_directive(parser, "line")) {
                 OnyxToken* dir_token = parser->curr - 2;
 
-                AstNumLit* line_num = make_int_literal(parser->context, dir_token->pos.line);
+                AstNumLit* line_num = make_int_literal(parser->context, file_pos_location(dir_token->pos).line);
                 retval = (AstTyped *) line_num;
                 break;
             }
             else if (parse_possible_directive(parser, "column")) {
                 OnyxToken* dir_token = parser->curr - 2;
 
-                AstNumLit* col_num = make_int_literal(parser->context, dir_token->pos.column);
+                AstNumLit* col_num = make_int_literal(parser->context, file_pos_location(dir_token->pos).column);
                 retval = (AstTyped *) col_num;
                 break;
             }
@@ -3274,7 +3273,7 @@ static AstOverloadedFunction* parse_overloaded_function(OnyxParser* parser, Onyx
 
         AstTyped* option = parse_expression(parser, 0);
         option->flags &= ~Ast_Flag_Function_Is_Lambda;
-        add_overload_option(&ofunc->overloads, order++, option);
+        add_overload_option(parser->context, &ofunc->overloads, order++, option);
 
         if (parser->curr->type != '}')
             expect_token(parser, ',');
@@ -3535,15 +3534,13 @@ static b32 parse_possible_quick_function_definition(OnyxParser* parser, AstTyped
         memset(text, 0, 512);
         strncat(text, "__type_", 511);
 
-        token_toggle_end(param->token);
-        if (!strcmp(param->token->text, "_")) {
+        if (param->token->length == 1 && param->token->text[0] == '_') {
             int index = param - params;
             int len = strnlen(text, 511);
             snprintf(text + len, 511 - len, "%d", index);
         } else {
-            strncat(text, param->token->text, 511);
+            strncat(text, token_atom(parser->context, param->token), 511);
         }
-        token_toggle_end(param->token);
 
         OnyxToken* new_token = bh_alloc(parser->allocator, sizeof(OnyxToken));
         new_token->type = Token_Type_Symbol;
@@ -4518,18 +4515,19 @@ static b32 parse_package_name(OnyxParser *parser, AstPackage *package) {
     }
 
     char* package_name = bh_alloc_array(parser->context->ast_alloc, char, total_package_name_length);
-    *package_name = '\0';
+    char* name_end = package_name;
 
     bh_arr_each(OnyxToken *, token, package->path) {
-        token_toggle_end(*token);
-        strncat(package_name, (*token)->text, total_package_name_length - 1);
-        token_toggle_end(*token);
+        memcpy(name_end, (*token)->text, (*token)->length);
+        name_end += (*token)->length;
 
         if (token != &bh_arr_last(package->path)) {
-            strncat(package_name, ".", total_package_name_length - 1);
+            *name_end++ = '.';
         }
     }
 
+    *name_end = '\0';
+
     package->package_name = package_name;
     return 1;
 }
@@ -4625,9 +4623,7 @@ static Package* parse_file_package(OnyxParser* parser) {
     Package* prevpackage = NULL;
 
     bh_arr_each(OnyxToken *, symbol, package_node->path) {
-        token_toggle_end(*symbol);
-
-        strncat(aggregate_name, (*symbol)->text, 2047);
+        strncat(aggregate_name, token_atom(parser->context, *symbol), 2047);
         Package* newpackage = package_lookup_or_create(parser->context, aggregate_name, parser->context->global_scope, package_node->token->pos);
         newpackage->parent_id = prevpackage ? prevpackage->id : 0xffffffff;
 
@@ -4639,11 +4635,10 @@ static Package* parse_file_package(OnyxParser* parser) {
         pnode->flags |= Ast_Flag_Comptime;
 
         if (prevpackage != NULL) {
-            symbol_subpackage_introduce(parser->context, prevpackage, (*symbol)->text, pnode);
+            symbol_subpackage_introduce(parser->context, prevpackage, token_atom(parser->context, *symbol), pnode);
             package_reinsert_use_packages(parser->context, prevpackage);
         }
 
-        token_toggle_end(*symbol);
         strncat(aggregate_name, ".", 2047);
 
         prevpackage = newpackage;
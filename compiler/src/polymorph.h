@@ -1,10 +1,131 @@
 
+//
+// Polymorphic Instances
+//
+
+static PolyInstanceTable *poly_instance_table_create(Context *context) {
+    PolyInstanceTable *table = bh_alloc_item(context->gp_alloc, PolyInstanceTable);
+    bh_arr_new(context->gp_alloc, table->instances, 4);
+    bh_arr_new(context->gp_alloc, table->buckets, 8);
+    bh_arr_set_length(table->buckets, 8);
+    fori (i, 0, 8) table->buckets[i] = -1;
+
+    return table;
+}
+
+// Hashes the same things that instances are told apart by: the name of each
+// polymorphic variable, and the type or value it was solved to. Values that
+// are not number literals are identified by their node.
+static u64 poly_slns_hash(bh_arr(AstPolySolution) slns) {
+    u64 hash = 0xcbf29ce484222325ull;
+
+    bh_arr_each(AstPolySolution, sln, slns) {
+        OnyxToken *name = sln->poly_sym->token;
+        fori (i, 0, name->length) hash = (hash ^ (u8) name->text[i]) * 0x100000001b3ull;
+
+        u64 value = 0;
+        if (sln->kind == PSK_Type) {
+            value = sln->type->id;
+
+        } else if (sln->kind == PSK_Value) {
+            if (sln->value->kind == Ast_Kind_NumLit) value = ((AstNumLit *) sln->value)->value.l;
+            else                                     value = (u64) sln->value;
+        }
+
+        hash = (hash ^ sln->kind) * 0x100000001b3ull;
+        hash = (hash ^ value)     * 0x100000001b3ull;
+    }
+
+    // The buckets are picked with the low bits, which the multiplications
+    // above only fill from the low bits of the values.
+    return hash ^ (hash >> 29);
+}
+
+static b32 poly_slns_equal(bh_arr(AstPolySolution) a, bh_arr(AstPolySolution) b) {
+    if (bh_arr_length(a) != bh_arr_length(b)) return 0;
+
+    fori (i, 0, bh_arr_length(a)) {
+        AstPolySolution *x = &a[i], *y = &b[i];
+        if (x->kind != y->kind) return 0;
+        if (!token_equals(x->poly_sym->token, y->poly_sym->token)) return 0;
+
+        if (x->kind == PSK_Type && x->type->id != y->type->id) return 0;
+
+        if (x->kind == PSK_Value) {
+            b32 x_is_num = x->value->kind == Ast_Kind_NumLit;
+            b32 y_is_num = y->value->kind == Ast_Kind_NumLit;
+            if (x_is_num != y_is_num) return 0;
+
+            if (x_is_num) {
+                if (((AstNumLit *) x->value)->value.l != ((AstNumLit *) y->value)->value.l) return 0;
+            } else {
+                if (x->value != y->value) return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Returns the index of the instance created from `slns`, or -1.
+static i32 poly_instance_find(Context *context, PolyInstanceTable *table, bh_arr(AstPolySolution) slns, u64 hash) {
+    context->stats.polymorph_lookups++;
+
+    i32 index = table->buckets[hash & (bh_arr_length(table->buckets) - 1)];
+    while (index != -1) {
+        PolyInstance *instance = &table->instances[index];
+        if (instance->hash == hash && poly_slns_equal(instance->slns, slns)) return index;
+
+        index = instance->next;
+    }
+
+    return -1;
+}
+
+// The returned pointer is only valid until the next instance is added to the table.
+static PolyInstance *poly_instance_add(Context *context, PolyInstanceTable *table, bh_arr(AstPolySolution) slns, u64 hash) {
+    // There are always at least as many buckets as instances, so the chains stay short.
+    if (bh_arr_length(table->instances) >= bh_arr_length(table->buckets)) {
+        i32 bucket_count = bh_arr_length(table->buckets) * 2;
+        bh_arr_grow(table->buckets, bucket_count);
+        bh_arr_set_length(table->buckets, bucket_count);
+        fori (i, 0, bucket_count) table->buckets[i] = -1;
+
+        fori (i, 0, bh_arr_length(table->instances)) {
+            PolyInstance *instance = &table->instances[i];
+            i32 *bucket = &table->buckets[instance->hash & (bucket_count - 1)];
+            instance->next = *bucket;
+            *bucket = i;
+        }
+    }
+
+    i32 *bucket = &table->buckets[hash & (bh_arr_length(table->buckets) - 1)];
+    bh_arr_push(table->instances, ((PolyInstance) {
+        .hash = hash,
+        .slns = bh_arr_copy(context->gp_alloc, slns),
+        .next = *bucket,
+    }));
+    *bucket = bh_arr_length(table->instances) - 1;
+
+    context->stats.polymorph_instances++;
+    return &bh_arr_last(table->instances);
+}
+
+
 //
 // Polymorphic Procedures
 //
 
 static void ensure_polyproc_cache_is_created(Context *context, AstFunction* pp) {
-    if (pp->concrete_funcs == NULL)        sh_new_arena(pp->concrete_funcs);
+    if (pp->concrete_funcs == NULL) {
+        pp->concrete_funcs = poly_instance_table_create(context);
+
+        if (context->polymorph.instantiated_procs == NULL) {
+            bh_arr_new(context->gp_alloc, context->polymorph.instantiated_procs, 64);
+        }
+        bh_arr_push(context->polymorph.instantiated_procs, pp);
+    }
+
     if (pp->active_queries.hashes == NULL) bh_imap_init(&pp->active_queries, context->gp_alloc, 31);
 }
 
@@ -78,13 +199,9 @@ static char* build_poly_slns_unique_key(Context *context, bh_arr(AstPolySolution
     bh_arr_each(AstPolySolution, sln, slns) {
         if (sln != slns) strncat(key_buf, "$", 1023);
 
-        token_toggle_end(sln->poly_sym->token);
-
-        strncat(key_buf, sln->poly_sym->token->text, 1023);
+        strncat(key_buf, token_atom(context, sln->poly_sym->token), 1023);
         strncat(key_buf, "=", 1023);
         strncat(key_buf, build_poly_solution_key(context, sln), 1023);
-
-        token_toggle_end(sln->poly_sym->token);
     }
 
     return key_buf;
@@ -118,7 +235,7 @@ static b32 add_solidified_function_entities(Context *context, AstSolidifiedFunct
     solidified_func->func_header_entity  = entity_header;
     solidified_func->func->entity_header = entity_header;
     solidified_func->func->entity_body   = entity_body;
-    solidified_func->func->entity        = entity_body;
+    ast_set_entity(solidified_func->func, entity_body);
     return 1;
 }
 
@@ -766,11 +883,12 @@ static bh_arr(AstPolySolution) find_polymorphic_slns(Context *context, AstFuncti
     if (bh_imap_has(&pp->active_queries, (u64) actual)) {
         AstPolyQuery *query = (AstPolyQuery *) bh_imap_get(&pp->active_queries, (u64) actual);
         assert(query->kind == Ast_Kind_Polymorph_Query);
-        assert(query->entity);
+        assert(ast_entity(context, query));
 
-        if (query->entity->state == Entity_State_Finalized) return query->slns;
-        if (query->entity->state == Entity_State_Failed)    return NULL;
+        if (ast_entity(context, query)->state == Entity_State_Finalized) return query->slns;
+        if (ast_entity(context, query)->state == Entity_State_Failed)    return NULL;
 
+        entity_wait_on(context, ast_entity(context, query));
         context->polymorph.flag_to_yield = 1;
         return NULL;
     }
@@ -798,6 +916,7 @@ static bh_arr(AstPolySolution) find_polymorphic_slns(Context *context, AstFuncti
     bh_imap_put(&pp->active_queries, (u64) actual, (u64) query);
     add_entities_for_node(&context->entities, NULL, (AstNode *) query, NULL, NULL);
 
+    entity_wait_on(context, ast_entity(context, query));
     context->polymorph.flag_to_yield = 1;
     return NULL;
 }
@@ -808,8 +927,11 @@ static bh_arr(AstPolySolution) find_polymorphic_slns(Context *context, AstFuncti
 AstFunction* polymorphic_proc_lookup(Context *context, AstFunction* pp, PolyProcLookupMethod pp_lookup, ptr actual, OnyxToken* tkn) {
 
     // Ensure the polymorphic procedure is ready to be solved for.
-    assert(pp->entity);
-    if (pp->entity->state < Entity_State_Check_Types) return (AstFunction *) &context->node_that_signals_a_yield;
+    assert(ast_entity(context, pp));
+    if (ast_entity(context, pp)->state < Entity_State_Check_Types) {
+        entity_wait_on(context, ast_entity(context, pp));
+        return (AstFunction *) &context->node_that_signals_a_yield;
+    }
 
     ensure_polyproc_cache_is_created(context, pp);
 
@@ -831,10 +953,10 @@ AstFunction* polymorphic_proc_solidify(Context *context, AstFunction* pp, bh_arr
     ensure_polyproc_cache_is_created(context, pp);
 
     // NOTE: Check if a version of this polyproc has already been created.
-    char* unique_key = build_poly_slns_unique_key(context, slns);
-    i32 index = shgeti(pp->concrete_funcs, unique_key);
+    u64 slns_hash = poly_slns_hash(slns);
+    i32 index = poly_instance_find(context, pp->concrete_funcs, slns, slns_hash);
     if (index != -1) {
-        AstSolidifiedFunction solidified_func = pp->concrete_funcs[index].value;
+        AstSolidifiedFunction solidified_func = pp->concrete_funcs->instances[index].func;
 
         // NOTE: If this solution was originally created from a "build_only_header" call, then the body
         // will not have been or type checked, or anything. This ensures that the body is copied, the
@@ -852,16 +974,17 @@ AstFunction* polymorphic_proc_solidify(Context *context, AstFunction* pp, bh_arr
 
     AstSolidifiedFunction solidified_func = generate_solidified_function(context, pp, slns, tkn, 0);
     add_solidified_function_entities(context, &solidified_func);
+    entity_wait_on(context, solidified_func.func_header_entity);
 
     // NOTE: Cache the function for later use, reducing duplicate functions.
-    shput(pp->concrete_funcs, unique_key, solidified_func);
+    poly_instance_add(context, pp->concrete_funcs, slns, slns_hash)->func = solidified_func;
 
     if (solidified_func.func->name) {
         solidified_func.func->assembly_name = bh_aprintf(
             context->gp_alloc,
             "%s$%s",
             solidified_func.func->name,
-            unique_key
+            build_poly_slns_unique_key(context, slns)
         );
     }
 
@@ -940,10 +1063,10 @@ AstFunction* polymorphic_proc_build_only_header(Context *context, AstFunction* p
 AstFunction* polymorphic_proc_build_only_header_with_slns(Context *context, AstFunction* pp, bh_arr(AstPolySolution) slns, b32 error_if_failed) {
     AstSolidifiedFunction solidified_func;
 
-    char* unique_key = build_poly_slns_unique_key(context, slns);
-    i32 index = shgeti(pp->concrete_funcs, unique_key);
+    u64 slns_hash = poly_slns_hash(slns);
+    i32 index = poly_instance_find(context, pp->concrete_funcs, slns, slns_hash);
     if (index != -1) {
-        solidified_func = pp->concrete_funcs[index].value;
+        solidified_func = pp->concrete_funcs->instances[index].func;
 
     } else {
         // NOTE: This function is only going to have the header of it correctly created.
@@ -956,6 +1079,7 @@ AstFunction* polymorphic_proc_build_only_header_with_slns(Context *context, AstF
         if (solidified_func.func_header_entity->state == Entity_State_Finalized) return solidified_func.func;
         if (solidified_func.func_header_entity->state == Entity_State_Failed)    return NULL;
 
+        entity_wait_on(context, solidified_func.func_header_entity);
         return (AstFunction *) &context->node_that_signals_a_yield;
     }
 
@@ -971,9 +1095,11 @@ AstFunction* polymorphic_proc_build_only_header_with_slns(Context *context, AstF
 
     Entity* func_header_entity_ptr = entity_heap_insert(&context->entities, func_header_entity);
     solidified_func.func_header_entity = func_header_entity_ptr;
+    entity_wait_on(context, func_header_entity_ptr);
 
     // NOTE: Cache the function for later use.
-    shput(pp->concrete_funcs, unique_key, solidified_func);
+    if (index != -1) pp->concrete_funcs->instances[index].func = solidified_func;
+    else             poly_instance_add(context, pp->concrete_funcs, slns, slns_hash)->func = solidified_func;
 
     return (AstFunction *) &context->node_that_signals_a_yield;
 }
@@ -1145,7 +1271,7 @@ char* build_poly_struct_name(Context *context, char *name, Type* type) {
                     }
                 } else if (value->kind == Ast_Kind_Code_Block) {
                     AstCodeBlock* code = (AstCodeBlock *) value;
-                    OnyxFilePos code_loc = code->token->pos;
+                    OnyxFileLocation code_loc = file_pos_location(code->token->pos);
                     strncat(name_buf, bh_bprintf("code at %s:%d,%d", code_loc.filename, code_loc.line, code_loc.column), 127);
                 } else {
                     strncat(name_buf, "<expr>", 127);
@@ -1168,7 +1294,7 @@ Type* polymorphic_struct_lookup(Context *context, AstPolyStructType* ps_type, bh
     assert(!ps_type->base_struct->scope);
 
     if (ps_type->concrete_structs == NULL) {
-        sh_new_arena(ps_type->concrete_structs);
+        ps_type->concrete_structs = poly_instance_table_create(context);
     }
 
     if (bh_arr_length(slns) != bh_arr_length(ps_type->poly_params)) {
@@ -1186,12 +1312,13 @@ Type* polymorphic_struct_lookup(Context *context, AstPolyStructType* ps_type, bh
         i++;
     }
 
-    char* unique_key = build_poly_slns_unique_key(context, slns);
-    i32 index = shgeti(ps_type->concrete_structs, unique_key);
+    u64 slns_hash = poly_slns_hash(slns);
+    i32 index = poly_instance_find(context, ps_type->concrete_structs, slns, slns_hash);
     if (index != -1) {
-        AstStructType* concrete_struct = ps_type->concrete_structs[index].value;
+        AstStructType* concrete_struct = ps_type->concrete_structs->instances[index].struct_type;
 
         if (concrete_struct->entity_type->state < Entity_State_Check_Types) {
+            entity_wait_on(context, concrete_struct->entity_type);
             return NULL;
         }
 
@@ -1200,7 +1327,10 @@ Type* polymorphic_struct_lookup(Context *context, AstPolyStructType* ps_type, bh
         }
 
         Type* cs_type = type_build_from_ast(context, (AstType *) concrete_struct);
-        if (!cs_type) return NULL;
+        if (!cs_type) {
+            entity_wait_on(context, concrete_struct->entity_type);
+            return NULL;
+        }
 
         cs_type->Struct.constructed_from = (AstType *) ps_type;
         
@@ -1228,8 +1358,9 @@ Type* polymorphic_struct_lookup(Context *context, AstPolyStructType* ps_type, bh
         concrete_struct->polymorphic_argument_types[i] = (AstType *) ast_clone(context, ps_type->poly_params[i].type_node);
     }
 
-    shput(ps_type->concrete_structs, unique_key, concrete_struct);
+    poly_instance_add(context, ps_type->concrete_structs, slns, slns_hash)->struct_type = concrete_struct;
     add_entities_for_node(&context->entities, NULL, (AstNode *) concrete_struct, sln_scope, NULL);
+    entity_wait_on(context, concrete_struct->entity_type);
     return NULL;
 }
 
@@ -1241,7 +1372,7 @@ Type* polymorphic_union_lookup(Context *context, AstPolyUnionType* pu_type, bh_a
     assert(!pu_type->base_union->scope);
 
     if (pu_type->concrete_unions == NULL) {
-        sh_new_arena(pu_type->concrete_unions);
+        pu_type->concrete_unions = poly_instance_table_create(context);
     }
 
     if (bh_arr_length(slns) != bh_arr_length(pu_type->poly_params)) {
@@ -1259,16 +1390,16 @@ Type* polymorphic_union_lookup(Context *context, AstPolyUnionType* pu_type, bh_a
         i++;
     }
 
-    char* unique_key = build_poly_slns_unique_key(context, slns);
-    i32 index = shgeti(pu_type->concrete_unions, unique_key);
+    u64 slns_hash = poly_slns_hash(slns);
+    i32 index = poly_instance_find(context, pu_type->concrete_unions, slns, slns_hash);
     if (index != -1) {
-        AstUnionType* concrete_union = pu_type->concrete_unions[index].value;
+        AstUnionType* concrete_union = pu_type->concrete_unions->instances[index].union_type;
 
-        if (concrete_union->entity->state < Entity_State_Check_Types) {
+        if (ast_entity(context, concrete_union)->state < Entity_State_Check_Types) {
             return NULL;
         }
 
-        if (concrete_union->entity->state == Entity_State_Failed) {
+        if (ast_entity(context, concrete_union)->state == Entity_State_Failed) {
             return (Type *) &context->node_that_signals_failure;
         }
 
@@ -1301,7 +1432,7 @@ Type* polymorphic_union_lookup(Context *context, AstPolyUnionType* pu_type, bh_a
         concrete_union->polymorphic_argument_types[i] = (AstType *) ast_clone(context, pu_type->poly_params[i].type_node);
     }
 
-    shput(pu_type->concrete_unions, unique_key, concrete_union);
+    poly_instance_add(context, pu_type->concrete_unions, slns, slns_hash)->union_type = concrete_union;
     add_entities_for_node(&context->entities, NULL, (AstNode *) concrete_union, sln_scope, NULL);
     return NULL;
 }
@@ -416,7 +416,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                 type_register(context, s_type);
 
                 s_type->Struct.memarr = NULL;
-                sh_new_arena(s_type->Struct.members);
+                s_type->Struct.members = NULL;
                 bh_arr_new(context->gp_alloc, s_type->Struct.memarr, s_type->Struct.mem_count);
 
             } else {
@@ -424,8 +424,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
             }
 
             bh_arr_clear(s_type->Struct.memarr);
-            shfree(s_type->Struct.members);
-            sh_new_arena(s_type->Struct.members);
+            hmfree(s_type->Struct.members);
 
             s_node->pending_type_is_valid = 1;
 
@@ -448,6 +447,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                 }
 
                 if (!type_is_ready_to_be_used_in_construction((*member)->type)) {
+                    entity_wait_on_type(context, (*member)->type);
                     s_node->pending_type_is_valid = 0;
                     return accept_partial_types ? s_node->pending_type : NULL;
                 }
@@ -464,10 +464,9 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                     bh_align(offset, mem_alignment);
                 }
 
-                token_toggle_end((*member)->token);
-                if (shgeti(s_type->Struct.members, (*member)->token->text) != -1) {
-                    ONYX_ERROR((*member)->token->pos, Error_Critical, "Duplicate struct member, '%s'.", (*member)->token->text);
-                    token_toggle_end((*member)->token);
+                char *member_name = token_atom(context, (*member)->token);
+                if (hmgeti(s_type->Struct.members, member_name) != -1) {
+                    ONYX_ERROR((*member)->token->pos, Error_Critical, "Duplicate struct member, '%s'.", member_name);
                     return NULL;
                 }
 
@@ -475,7 +474,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                 smem->offset = offset;
                 smem->type = (*member)->type;
                 smem->idx = idx;
-                smem->name = bh_strdup(context->ast_alloc, (*member)->token->text);
+                smem->name = member_name;
                 smem->token = (*member)->token;
                 smem->initial_value = &(*member)->initial_value;
                 smem->meta_tags = (*member)->meta_tags;
@@ -484,9 +483,8 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                 smem->included_through_use = 0;
                 smem->used = (*member)->is_used;
                 smem->use_through_pointer_index = -1;
-                shput(s_type->Struct.members, (*member)->token->text, smem);
+                hmput(s_type->Struct.members, member_name, smem);
                 bh_arr_push(s_type->Struct.memarr, smem);
-                token_toggle_end((*member)->token);
 
                 u32 type_size = type_size_of((*member)->type);
 
@@ -780,7 +778,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
             tag_enum_node->backing_type = type_build_from_ast(context, union_->tag_backing_type);
             bh_arr_new(context->ast_alloc, tag_enum_node->values, bh_arr_length(union_->variants));
 
-            add_entities_for_node(&context->entities, NULL, (AstNode *) tag_enum_node, union_->entity->scope, union_->entity->package);
+            add_entities_for_node(&context->entities, NULL, (AstNode *) tag_enum_node, ast_entity(context, union_)->scope, ast_entity(context, union_)->package);
 
             //
             // Create variant instances
@@ -796,10 +794,9 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
 
                 if (var_alignment > alignment) alignment = var_alignment;
 
-                token_toggle_end(variant->token);
-                if (shgeti(u_type->Union.variants, variant->token->text) != -1) {
-                    ONYX_ERROR(variant->token->pos, Error_Critical, "Duplicate union variant, '%s'.", variant->token->text);
-                    token_toggle_end(variant->token);
+                char *variant_name = token_atom(context, variant->token);
+                if (shgeti(u_type->Union.variants, variant_name) != -1) {
+                    ONYX_ERROR(variant->token->pos, Error_Critical, "Duplicate union variant, '%s'.", variant_name);
                     return NULL;
                 }
 
@@ -807,7 +804,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                 size = bh_max(size, type_size);
 
                 UnionVariant* uv = bh_alloc_item(context->ast_alloc, UnionVariant);
-                uv->name = bh_strdup(context->ast_alloc, variant->token->text);
+                uv->name = variant_name;
                 uv->token = variant->token;
                 uv->meta_tags = variant->meta_tags;
                 uv->type = variant->type;
@@ -825,8 +822,7 @@ static Type* type_build_from_ast_inner(Context *context, AstType* type_node, b32
                     uv->tag_value = next_tag_value++;
                 }
 
-                shput(u_type->Union.variants, variant->token->text, uv);
-                token_toggle_end(variant->token);
+                shput(u_type->Union.variants, variant_name, uv);
 
                 bh_arr_push(u_type->Union.variants_ordered, uv);
 
@@ -951,7 +947,7 @@ Type* type_build_implicit_type_of_struct_literal(Context *context, AstStructLite
     type_register(context, type);
 
     type->Struct.memarr = NULL;
-    sh_new_arena(type->Struct.members);
+    type->Struct.members = NULL;
     bh_arr_new(context->gp_alloc, type->Struct.memarr, type->Struct.mem_count);
 
     u32 size = 0;
@@ -980,9 +976,8 @@ Type* type_build_implicit_type_of_struct_literal(Context *context, AstStructLite
         // Should these structs be packed or not?
         bh_align(offset, mem_alignment);
 
-        token_toggle_end(nv->token);
-        if (shgeti(type->Struct.members, nv->token->text) != -1) {
-            token_toggle_end(nv->token);
+        char *member_name = token_atom(context, nv->token);
+        if (hmgeti(type->Struct.members, member_name) != -1) {
             return NULL;
         }
 
@@ -990,7 +985,7 @@ Type* type_build_implicit_type_of_struct_literal(Context *context, AstStructLite
         smem->offset = offset;
         smem->type = member_type;
         smem->idx = idx;
-        smem->name = bh_strdup(context->ast_alloc, nv->token->text);
+        smem->name = member_name;
         smem->token = nv->token;
         smem->meta_tags = NULL;
         smem->included_through_use = 0;
@@ -1005,9 +1000,8 @@ Type* type_build_implicit_type_of_struct_literal(Context *context, AstStructLite
         // smem->initial_value = &nv->value;
         smem->initial_value = NULL;
 
-        shput(type->Struct.members, nv->token->text, smem);
+        hmput(type->Struct.members, member_name, smem);
         bh_arr_push(type->Struct.memarr, smem);
-        token_toggle_end(nv->token);
 
         u32 type_size = type_size_of(member_type);
         offset += type_size;
@@ -1212,7 +1206,7 @@ b32 type_struct_member_apply_use(Context *context, Type *s_type, StructMember *s
 
     if (used_type->Struct.status < SPS_Uses_Done) return 0;
 
-    fori (i, 0, shlen(used_type->Struct.members)) {
+    fori (i, 0, hmlen(used_type->Struct.members)) {
         StructMember *nsmem = used_type->Struct.members[i].value;
 
         //
@@ -1222,7 +1216,7 @@ b32 type_struct_member_apply_use(Context *context, Type *s_type, StructMember *s
             continue;
         }
 
-        if (shgeti(s_type->Struct.members, nsmem->name) != -1) {
+        if (hmgeti(s_type->Struct.members, nsmem->name) != -1) {
             ONYX_ERROR(smem->token->pos, Error_Critical, "Used name '%s' conflicts with existing struct member.", nsmem->name);
             return 0;
         }
@@ -1247,7 +1241,7 @@ b32 type_struct_member_apply_use(Context *context, Type *s_type, StructMember *s
             new_smem->use_through_pointer_index = -1;
         }
 
-        shput(s_type->Struct.members, nsmem->name, new_smem);
+        hmput(s_type->Struct.members, nsmem->name, new_smem);
     }
 
     return 1;
@@ -1461,13 +1455,18 @@ static const StructMember union_members[] = {
 };
 
 b32 type_lookup_member(Context *context, Type* type, char* member, StructMember* smem) {
+    char *atom = atom_find(context, member, strlen(member));
+    return type_lookup_member_atom(context, type, atom ? atom : member, smem);
+}
+
+b32 type_lookup_member_atom(Context *context, Type* type, char* member, StructMember* smem) {
     if (type->kind == Type_Kind_Pointer) type = type->Pointer.elem;
 
     switch (type->kind) {
         case Type_Kind_Struct: {
             TypeStruct* stype = &type->Struct;
 
-            i32 index = shgeti(stype->members, member);
+            i32 index = hmgeti(stype->members, member);
             if (index == -1) return 0;
             *smem = *stype->members[index].value;
             return 1;
@@ -102,6 +102,172 @@ void package_mark_as_used(Context *context, Package* package) {
 
 
 
+//
+// Atoms
+//
+
+// FNV-1a
+static u64 atom_hash(const char *text, i32 length) {
+    u64 hash = 0xcbf29ce484222325;
+    fori (i, 0, length) {
+        hash ^= (u8) text[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static AtomTableEntry *atom_table_find_slot(AtomTable *table, u64 hash, const char *text, i32 length) {
+    u32 mask = table->capacity - 1;
+    u32 index = (u32) hash & mask;
+
+    while (1) {
+        AtomTableEntry *entry = &table->entries[index];
+        if (entry->text == NULL) return entry;
+
+        if (entry->hash == hash && entry->length == length && !memcmp(entry->text, text, length)) {
+            return entry;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void atom_table_grow(AtomTable *table) {
+    AtomTableEntry *old_entries = table->entries;
+    u32 old_capacity = table->capacity;
+
+    table->capacity = old_capacity == 0 ? 4096 : old_capacity * 2;
+    table->entries = calloc(table->capacity, sizeof(AtomTableEntry));
+
+    fori (i, 0, old_capacity) {
+        AtomTableEntry *old = &old_entries[i];
+        if (old->text == NULL) continue;
+
+        *atom_table_find_slot(table, old->hash, old->text, old->length) = *old;
+    }
+
+    free(old_entries);
+}
+
+// Returns the atom for the text. The text does not have to be NUL-terminated.
+char *atom_intern(Context *context, const char *text, i32 length) {
+    AtomTable *table = &context->atoms;
+
+    // Keep the table at most 3/4 full, so probe sequences stay short.
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        atom_table_grow(table);
+    }
+
+    u64 hash = atom_hash(text, length);
+    AtomTableEntry *entry = atom_table_find_slot(table, hash, text, length);
+    if (entry->text) return entry->text;
+
+    char *atom = bh_alloc_array(context->ast_alloc, char, length + 1);
+    memcpy(atom, text, length);
+    atom[length] = '\0';
+
+    entry->hash   = hash;
+    entry->text   = atom;
+    entry->length = length;
+    table->count++;
+
+    return atom;
+}
+
+// Returns the atom for the text, or NULL if it was never interned. Nothing
+// can be keyed by a name that has no atom, so a NULL means a lookup would fail.
+char *atom_find(Context *context, const char *text, i32 length) {
+    AtomTable *table = &context->atoms;
+    if (table->count == 0) return NULL;
+
+    AtomTableEntry *entry = atom_table_find_slot(table, atom_hash(text, length), text, length);
+    return entry->text;
+}
+
+void token_atoms_add_file(Context *context, bh_arr(OnyxToken) tokens) {
+    TokenAtomTable *table = &context->token_atoms;
+    if (bh_arr_length(tokens) == 0) return;
+    if (table->files == NULL) bh_arr_new(context->gp_alloc, table->files, 64);
+
+    TokenAtomFile file;
+    file.first = tokens;
+    file.count = bh_arr_length(tokens);
+    file.atoms = calloc(file.count, sizeof(char *));
+
+    bh_arr_push(table->files, file);
+
+    i32 index = bh_arr_length(table->files) - 1;
+    while (index > 0 && (u64) table->files[index - 1].first > (u64) tokens) {
+        table->files[index] = table->files[index - 1];
+        index--;
+    }
+
+    table->files[index] = file;
+    table->last_file = index;
+}
+
+static TokenAtomFile *token_atoms_find_file(TokenAtomTable *table, OnyxToken *token) {
+    i32 count = bh_arr_length(table->files);
+    if (count == 0) return NULL;
+
+    // Tokens are mostly looked up in the order they appear, so the last file usually has it.
+    TokenAtomFile *file = &table->files[table->last_file];
+    if ((u64) token >= (u64) file->first && (u64) token < (u64) (file->first + file->count)) {
+        return file;
+    }
+
+    i32 lo = 0, hi = count;
+    while (hi - lo > 1) {
+        i32 mid = (lo + hi) / 2;
+        if ((u64) table->files[mid].first <= (u64) token) lo = mid;
+        else                                             hi = mid;
+    }
+
+    file = &table->files[lo];
+    if ((u64) token >= (u64) file->first && (u64) token < (u64) (file->first + file->count)) {
+        table->last_file = lo;
+        return file;
+    }
+
+    return NULL;
+}
+
+// Returns the atom for the token's text. The text of a token from a source file is
+// only hashed the first time; after that, its atom is found by its position. Tokens
+// made by the compiler are not in any file, and are interned every time.
+char *token_atom(Context *context, OnyxToken *token) {
+    TokenAtomFile *file = token_atoms_find_file(&context->token_atoms, token);
+    if (!file) return atom_intern(context, token->text, token->length);
+
+    char **atom = &file->atoms[token - file->first];
+    if (*atom == NULL) *atom = atom_intern(context, token->text, token->length);
+
+    return *atom;
+}
+
+void atom_table_free(AtomTable *table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+void token_atom_table_free(TokenAtomTable *table) {
+    bh_arr_each(TokenAtomFile, file, table->files) free(file->atoms);
+    bh_arr_free(table->files);
+    table->last_file = 0;
+}
+
+// Used by the functions that take the symbol as a string. A name without an
+// atom is passed through unchanged. It will not be found in any table, but
+// some lookups compare the text of the symbol.
+static char *symbol_atom(Context *context, char *sym) {
+    char *atom = atom_find(context, sym, strlen(sym));
+    return atom ? atom : sym;
+}
+
+
+
 //
 // Scoping
 //
@@ -121,32 +287,69 @@ Scope* scope_create(Context *context, Scope* parent, OnyxFilePos created_at) {
     return scope;
 }
 
-void scope_include(Context *context, Scope* target, Scope* source, OnyxFilePos pos) {
-    fori (i, 0, shlen(source->symbols)) {
-        symbol_raw_introduce(context, target, source->symbols[i].key, pos, source->symbols[i].value);
+//
+// While files are held, the decisions below are made without them. The file a
+// decision is blamed on is the one of the entity making it, so that file can
+// be held as well the next time.
+static u16 held_files_decision_file(Context *context, Scope *scope) {
+    Entity *ent = context->checker.current_entity;
+    if (ent && ent->type != Entity_Type_Job && ent->expr && ent->expr->token) {
+        return ent->expr->token->pos.file_id;
     }
+
+    return scope ? scope->created_at.file_id : 0;
 }
 
-b32 symbol_introduce(Context *context, Scope* scope, OnyxToken* tkn, AstNode* symbol) {
-    token_toggle_end(tkn);
+// Anything besides source files that was read while the files were held.
+void held_files_note_dependency(Context *context, char *path) {
+    if (!context->held.holding) return;
+
+    bh_file_stats stats;
+    u64 modified_time = bh_file_stat(path, &stats) ? stats.modified_time : 0;
+    shput(context->held.dependencies, path, modified_time);
+}
 
-    b32 ret = symbol_raw_introduce(context, scope, tkn->text, tkn->pos, symbol);
+void held_files_conflict(Context *context, u16 file_id) {
+    bh_arr_each(u16, conflict, context->held.conflicts) {
+        if (*conflict == file_id) return;
+    }
 
-    token_toggle_end(tkn);
-    return ret;
+    bh_arr_push(context->held.conflicts, file_id);
 }
 
-b32 symbol_raw_introduce(Context *context, Scope* scope, char* name, OnyxFilePos pos, AstNode* symbol) {
-    if (!scope->symbols) {
-        sh_new_arena(scope->symbols);
+static void held_files_note_passed_scopes(Context *context, Scope *start_scope, Scope *found_in, char *atom) {
+    u16 file_id = held_files_decision_file(context, start_scope);
+
+    for (Scope *scope = start_scope; scope != found_in; scope = scope->parent) {
+        HeldLookup key = { scope, atom };
+        hmput(context->held.passed_lookups, key, file_id);
+    }
+}
+
+//
+// A symbol introduced into a scope that a lookup went past would have been found
+// instead. Function bodies are skipped, since their locals are introduced in order
+// and are only visible after they are declared anyway.
+static void held_files_check_introduction(Context *context, Scope *scope, char *atom) {
+    if (!context->held.released || scope->id > context->held.last_scope_id) return;
+
+    Entity *ent = context->checker.current_entity;
+    if (ent && (ent->type == Entity_Type_Function || ent->type == Entity_Type_Function_Header)) return;
+
+    HeldLookup key = { scope, atom };
+    i32 index = hmgeti(context->held.passed_lookups, key);
+    if (index != -1) {
+        held_files_conflict(context, context->held.passed_lookups[index].value);
     }
+}
 
-    if (strcmp(name, "_")) {
-        i32 index = shgeti(scope->symbols, name);
+static b32 symbol_atom_introduce(Context *context, Scope* scope, char* atom, OnyxFilePos pos, AstNode* symbol) {
+    if (atom[0] != '_' || atom[1] != '\0') {
+        i32 index = hmgeti(scope->symbols, atom);
         if (index != -1) {
             AstNode *node = scope->symbols[index].value;
             if (node != symbol) {
-                ONYX_ERROR(pos, Error_Critical, "Redeclaration of symbol '%s'.", name);
+                ONYX_ERROR(pos, Error_Critical, "Redeclaration of symbol '%s'.", atom);
 
                 if (node->token) {
                     ONYX_ERROR(node->token->pos, Error_Critical, "Previous declaration was here.");
@@ -158,22 +361,40 @@ b32 symbol_raw_introduce(Context *context, Scope* scope, char* name, OnyxFilePos
         }
     }
 
-    shput(scope->symbols, name, symbol);
+    hmput(scope->symbols, atom, symbol);
     track_declaration_for_symbol_info(context, pos, symbol);
+    entity_heap_wake_symbol(&context->entities, atom);
+    held_files_check_introduction(context, scope, atom);
     return 1;
 }
 
+void scope_include(Context *context, Scope* target, Scope* source, OnyxFilePos pos) {
+    fori (i, 0, hmlen(source->symbols)) {
+        symbol_atom_introduce(context, target, source->symbols[i].key, pos, source->symbols[i].value);
+    }
+}
+
+b32 symbol_introduce(Context *context, Scope* scope, OnyxToken* tkn, AstNode* symbol) {
+    return symbol_atom_introduce(context, scope, token_atom(context, tkn), tkn->pos, symbol);
+}
+
+b32 symbol_raw_introduce(Context *context, Scope* scope, char* name, OnyxFilePos pos, AstNode* symbol) {
+    return symbol_atom_introduce(context, scope, atom_intern(context, name, strlen(name)), pos, symbol);
+}
+
 void symbol_builtin_introduce(Context *context, Scope* scope, char* sym, AstNode *node) {
-    if (!scope->symbols) sh_new_arena(scope->symbols);
+    char *atom = atom_intern(context, sym, strlen(sym));
 
-    shput(scope->symbols, sym, node);
+    hmput(scope->symbols, atom, node);
+    entity_heap_wake_symbol(&context->entities, atom);
+    held_files_check_introduction(context, scope, atom);
 }
 
 void symbol_subpackage_introduce(Context *context, Package* parent, char* sym, AstPackage* subpackage) {
     Scope *scope = parent->scope;
-    if (!scope->symbols) sh_new_arena(scope->symbols);
+    char *atom = atom_intern(context, sym, strlen(sym));
 
-    i32 index = shgeti(scope->symbols, sym);
+    i32 index = hmgeti(scope->symbols, atom);
     if (index != -1) {
         AstNode* maybe_package = scope->symbols[index].value;
         
@@ -181,7 +402,9 @@ void symbol_subpackage_introduce(Context *context, Package* parent, char* sym, A
         assert(maybe_package->kind == Ast_Kind_Package);
 
     } else {
-        shput(scope->symbols, sym, (AstNode *) subpackage);
+        hmput(scope->symbols, atom, (AstNode *) subpackage);
+        entity_heap_wake_symbol(&context->entities, atom);
+        held_files_check_introduction(context, scope, atom);
 
         // Parent: parent->id
         // Child:  subpackage->package->id
@@ -189,10 +412,10 @@ void symbol_subpackage_introduce(Context *context, Package* parent, char* sym, A
     }
 }
 
-AstNode* symbol_raw_resolve_no_ascend(Context *context, Scope* scope, char* sym) {
+static AstNode* symbol_atom_resolve_no_ascend(Scope* scope, char* atom) {
     if (!scope || !scope->symbols) return NULL;
 
-    i32 index = shgeti(scope->symbols, sym);
+    i32 index = hmgeti(scope->symbols, atom);
     if (index != -1) {
         AstNode* res = scope->symbols[index].value;
 
@@ -204,13 +427,17 @@ AstNode* symbol_raw_resolve_no_ascend(Context *context, Scope* scope, char* sym)
     return NULL;
 }
 
-AstNode* symbol_raw_resolve_limited(Context *context, Scope* start_scope, char* sym, i32 limit) {
+static AstNode* symbol_atom_resolve_limited(Context *context, Scope* start_scope, char* atom, i32 limit) {
     Scope* scope = start_scope;
     AstNode *res = NULL;
 
     while (scope != NULL && limit-- > 0) {
-        res = symbol_raw_resolve_no_ascend(context, scope, sym);
+        res = symbol_atom_resolve_no_ascend(scope, atom);
         if (res) {
+            if (context->held.holding && scope != start_scope) {
+                held_files_note_passed_scopes(context, start_scope, scope, atom);
+            }
+
             return res;
         }
 
@@ -220,13 +447,17 @@ AstNode* symbol_raw_resolve_limited(Context *context, Scope* start_scope, char*
     return NULL;
 }
 
-AstNode* symbol_raw_resolve(Context *context, Scope* start_scope, char* sym) {
+static AstNode* symbol_atom_resolve(Context *context, Scope* start_scope, char* atom) {
     Scope* scope = start_scope;
     AstNode *res = NULL;
 
     while (scope != NULL) {
-        res = symbol_raw_resolve_no_ascend(context, scope, sym);
+        res = symbol_atom_resolve_no_ascend(scope, atom);
         if (res) {
+            if (context->held.holding && scope != start_scope) {
+                held_files_note_passed_scopes(context, start_scope, scope, atom);
+            }
+
             return res;
         }
 
@@ -236,15 +467,19 @@ AstNode* symbol_raw_resolve(Context *context, Scope* start_scope, char* sym) {
     return NULL;
 }
 
-AstNode* symbol_resolve(Context *context, Scope* start_scope, OnyxToken* tkn) {
-    token_toggle_end(tkn);
-    AstNode* res = symbol_raw_resolve(context, start_scope, tkn->text);
-    token_toggle_end(tkn);
+AstNode* symbol_raw_resolve_no_ascend(Context *context, Scope* scope, char* sym) {
+    return symbol_atom_resolve_no_ascend(scope, symbol_atom(context, sym));
+}
 
-    return res;
+AstNode* symbol_raw_resolve(Context *context, Scope* start_scope, char* sym) {
+    return symbol_atom_resolve(context, start_scope, symbol_atom(context, sym));
 }
 
-AstNode* try_symbol_raw_resolve_from_node(Context *context, AstNode* node, char* symbol) {
+AstNode* symbol_resolve(Context *context, Scope* start_scope, OnyxToken* tkn) {
+    return symbol_atom_resolve(context, start_scope, token_atom(context, tkn));
+}
+
+AstNode* try_symbol_atom_resolve_from_node(Context *context, AstNode* node, char* symbol) {
     // CLEANUP: I think this has a lot of duplication from get_scope_from_node.
     // There are some additional cases handled here, but I think the majority
     // of this code could be rewritten in terms of get_scope_from_node.
@@ -286,7 +521,7 @@ all_types_peeled_off:
                 return NULL;
             }
 
-            return symbol_raw_resolve_no_ascend(context, package->package->scope, symbol);
+            return symbol_atom_resolve_no_ascend(package->package->scope, symbol);
         } 
 
         case Ast_Kind_Foreign_Block:
@@ -296,7 +531,7 @@ all_types_peeled_off:
         case Ast_Kind_Distinct_Type:
         case Ast_Kind_Interface: {
             Scope* scope = get_scope_from_node(context, node);
-            return symbol_raw_resolve_no_ascend(context, scope, symbol);
+            return symbol_atom_resolve_no_ascend(scope, symbol);
         }
 
         case Ast_Kind_Slice_Type:
@@ -306,7 +541,7 @@ all_types_peeled_off:
             if (!scope)
                 return NULL;
 
-            return symbol_raw_resolve(context, scope, symbol);
+            return symbol_atom_resolve(context, scope, symbol);
         }
 
         case Ast_Kind_Struct_Type: {
@@ -318,11 +553,11 @@ all_types_peeled_off:
             // bleed to the top level scope.            AstNode *result = NULL;
             AstNode *result = NULL;
             if (stype->stcache != NULL) {
-                result = try_symbol_raw_resolve_from_type(context, stype->stcache, symbol);
+                result = try_symbol_atom_resolve_from_type(context, stype->stcache, symbol);
             }
 
             if (result == NULL && stype->scope) {
-                result = symbol_raw_resolve_no_ascend(context, stype->scope, symbol);
+                result = symbol_atom_resolve_no_ascend(stype->scope, symbol);
             }
 
             return result;
@@ -333,11 +568,11 @@ all_types_peeled_off:
 
             AstNode *result = NULL;
             if (utype->utcache != NULL) {
-                result = try_symbol_raw_resolve_from_type(context, utype->utcache, symbol);
+                result = try_symbol_atom_resolve_from_type(context, utype->utcache, symbol);
             }
 
             if (result == NULL && utype->scope) {
-                result = symbol_raw_resolve_no_ascend(context, utype->scope, symbol);
+                result = symbol_atom_resolve_no_ascend(utype->scope, symbol);
             }
 
             return result;
@@ -352,17 +587,17 @@ all_types_peeled_off:
                 // forcing the use the Slice functions, but then it can
                 // get confusing about where every function lives, ya know.
                 // Is "get" in Array or Slice.
-                return symbol_raw_resolve_limited(context, stype->scope, symbol, 2);
+                return symbol_atom_resolve_limited(context, stype->scope, symbol, 2);
 
             } else {
-                return symbol_raw_resolve_no_ascend(context, stype->scope, symbol);
+                return symbol_atom_resolve_no_ascend(stype->scope, symbol);
             }
         }
 
         case Ast_Kind_Poly_Call_Type: {
             AstPolyCallType* pctype = (AstPolyCallType *) node;
             if (pctype->resolved_type) {
-                return try_symbol_raw_resolve_from_type(context, pctype->resolved_type, symbol);
+                return try_symbol_atom_resolve_from_type(context, pctype->resolved_type, symbol);
             }
             return NULL;
         }
@@ -403,19 +638,19 @@ all_types_peeled_off:
     return NULL;
 }
 
-AstNode* try_symbol_resolve_from_node(Context *context, AstNode* node, OnyxToken* token) {
-    token_toggle_end(token);
-    AstNode* result = try_symbol_raw_resolve_from_node(context, node, token->text);
-    token_toggle_end(token);
+AstNode* try_symbol_raw_resolve_from_node(Context *context, AstNode* node, char* symbol) {
+    return try_symbol_atom_resolve_from_node(context, node, symbol_atom(context, symbol));
+}
 
-    return result;
+AstNode* try_symbol_resolve_from_node(Context *context, AstNode* node, OnyxToken* token) {
+    return try_symbol_atom_resolve_from_node(context, node, token_atom(context, token));
 }
 
-static AstNode* try_symbol_raw_resolve_from_poly_sln(Context *context, bh_arr(AstPolySolution) slns, char *symbol) {
+static AstNode* try_symbol_atom_resolve_from_poly_sln(Context *context, bh_arr(AstPolySolution) slns, char *symbol) {
     if (slns == NULL) return NULL;
 
     bh_arr_each(AstPolySolution, sln, slns) {
-        if (token_text_equals(sln->poly_sym->token, symbol)) {
+        if (token_atom(context, sln->poly_sym->token) == symbol) {
             if (sln->kind == PSK_Type) {
                 AstTypeRawAlias* alias = onyx_ast_node_new(context->ast_alloc, sizeof(AstTypeRawAlias), Ast_Kind_Type_Raw_Alias);
                 alias->type = context->types.basic[Basic_Kind_Type_Index];
@@ -431,30 +666,30 @@ static AstNode* try_symbol_raw_resolve_from_poly_sln(Context *context, bh_arr(As
     return NULL;
 }
 
-AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* symbol) {
+AstNode* try_symbol_atom_resolve_from_type(Context *context, Type *type, char* symbol) {
     while (type->kind == Type_Kind_Pointer) {
         type = type->Pointer.elem; 
     }
 
     switch (type->kind) {
         case Type_Kind_Basic: {
-            return symbol_raw_resolve_no_ascend(context, ((AstBasicType *) type->ast_type)->scope, symbol);
+            return symbol_atom_resolve_no_ascend(((AstBasicType *) type->ast_type)->scope, symbol);
         }
 
         case Type_Kind_Enum: {
-            return symbol_raw_resolve_no_ascend(context, ((AstEnumType *) type->ast_type)->scope, symbol);
+            return symbol_atom_resolve_no_ascend(((AstEnumType *) type->ast_type)->scope, symbol);
         }
 
         case Type_Kind_Slice: {
-            return symbol_raw_resolve(context, type->Slice.scope, symbol);
+            return symbol_atom_resolve(context, type->Slice.scope, symbol);
         }
 
         case Type_Kind_DynArray: {
-            return symbol_raw_resolve(context, type->DynArray.scope, symbol);
+            return symbol_atom_resolve(context, type->DynArray.scope, symbol);
         }
 
         case Type_Kind_Struct: {
-            AstNode *poly_sln_res = try_symbol_raw_resolve_from_poly_sln(context, type->Struct.poly_sln, symbol);
+            AstNode *poly_sln_res = try_symbol_atom_resolve_from_poly_sln(context, type->Struct.poly_sln, symbol);
             if (poly_sln_res) return poly_sln_res;
 
             i32 limit = 1;
@@ -463,11 +698,11 @@ AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* sy
                 limit = 3;
             }
 
-            return symbol_raw_resolve_limited(context, type->Struct.scope, symbol, limit);
+            return symbol_atom_resolve_limited(context, type->Struct.scope, symbol, limit);
         }
 
         case Type_Kind_Union: {
-            AstNode *poly_sln_res = try_symbol_raw_resolve_from_poly_sln(context, type->Union.poly_sln, symbol);
+            AstNode *poly_sln_res = try_symbol_atom_resolve_from_poly_sln(context, type->Union.poly_sln, symbol);
             if (poly_sln_res) return poly_sln_res;
 
             if (!strcmp(symbol, "tag_enum")) {
@@ -480,19 +715,19 @@ AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* sy
                 limit = 3;
             }
 
-            return symbol_raw_resolve_limited(context, type->Union.scope, symbol, limit);
+            return symbol_atom_resolve_limited(context, type->Union.scope, symbol, limit);
         }
 
         case Type_Kind_PolyStruct: {
-            return symbol_raw_resolve_no_ascend(context, type->PolyStruct.scope, symbol);
+            return symbol_atom_resolve_no_ascend(type->PolyStruct.scope, symbol);
         }
 
         case Type_Kind_PolyUnion: {
-            return symbol_raw_resolve_no_ascend(context, type->PolyUnion.scope, symbol);
+            return symbol_atom_resolve_no_ascend(type->PolyUnion.scope, symbol);
         }
 
         case Type_Kind_Distinct: {
-            return symbol_raw_resolve(context, type->Distinct.scope, symbol);
+            return symbol_atom_resolve(context, type->Distinct.scope, symbol);
         }
 
         default: return NULL;
@@ -501,16 +736,16 @@ AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* sy
     return NULL;
 }
 
-AstNode* try_symbol_resolve_from_type(Context *context, Type *type, OnyxToken *token) {
-    token_toggle_end(token);
-    AstNode* result = try_symbol_raw_resolve_from_type(context, type, token->text);
-    token_toggle_end(token);
+AstNode* try_symbol_raw_resolve_from_type(Context *context, Type *type, char* symbol) {
+    return try_symbol_atom_resolve_from_type(context, type, symbol_atom(context, symbol));
+}
 
-    return result;
+AstNode* try_symbol_resolve_from_type(Context *context, Type *type, OnyxToken *token) {
+    return try_symbol_atom_resolve_from_type(context, type, token_atom(context, token));
 }
 
 void scope_clear(Scope* scope) {
-    sh_new_arena(scope->symbols);
+    hmfree(scope->symbols);
 }
 
 // Polymorphic procedures are in their own file to clean up this file.
@@ -543,9 +778,14 @@ void scope_clear(Scope* scope) {
 //  * Resolving an overload from a TypeFunction (so an overloaded procedure can be passed as a parameter)
 //
 
-void add_overload_option(bh_arr(OverloadOption)* poverloads, u64 order, AstTyped* overload) {
+void add_overload_option(Context *context, bh_arr(OverloadOption)* poverloads, u64 order, AstTyped* overload) {
     bh_arr(OverloadOption) overloads = *poverloads;
 
+    i32 decided = -1;
+    if ((context->held.holding || context->held.released) && overloads) {
+        decided = hmgeti(context->held.decided_overloads, (void *) overloads);
+    }
+
     i32 index = -1;
     fori (i, 0, bh_arr_length(overloads)) {
         if (overloads[i].order > order) {
@@ -566,6 +806,15 @@ void add_overload_option(bh_arr(OverloadOption)* poverloads, u64 order, AstTyped
         overloads[index].option = overload;
     }
 
+    if (decided != -1) {
+        HeldDecision decision = context->held.decided_overloads[decided].value;
+        hmput(context->held.decided_overloads, (void *) overloads, decision);
+
+        if (context->held.released) {
+            bh_arr_push(context->held.late_options, ((HeldLateOption) { overload, decision }));
+        }
+    }
+
     *poverloads = overloads;
 }
 
@@ -600,6 +849,206 @@ void build_all_overload_options(bh_arr(OverloadOption) overloads, bh_imap* all_o
     }
 }
 
+static b32 argument_has_no_type_of_its_own(AstTyped *arg) {
+    if (arg == NULL) return 0;
+    if (arg->kind == Ast_Kind_Argument)    arg = ((AstArgument *) arg)->value;
+    if (arg->kind == Ast_Kind_Named_Value) arg = ((AstNamedValue *) arg)->value;
+    if (arg == NULL) return 0;
+
+    // A rawptr converts to any pointer type.
+    if (arg->type && type_is_rawptr(arg->type)) return 1;
+
+    switch (arg->kind) {
+        case Ast_Kind_Struct_Literal:      return ((AstStructLiteral *) arg)->stnode == NULL;
+        case Ast_Kind_Array_Literal:       return ((AstArrayLiteral *) arg)->atnode == NULL;
+        case Ast_Kind_Unary_Field_Access:  return 1;
+        default:                           return node_is_auto_cast((AstNode *) arg);
+    }
+}
+
+//
+// Notes that a decision was made from `overloads`, and from every overloaded
+// procedure among its options, as those were searched too.
+void held_files_note_overload_decision(Context *context, bh_arr(OverloadOption) overloads, bh_imap *all_overloads, Arguments *args) {
+    HeldDecision decision = { 0 };
+    decision.file_id = held_files_decision_file(context, NULL);
+
+    if (args) {
+        bh_arr_each(AstTyped *, value, args->values) {
+            decision.untyped_arguments |= argument_has_no_type_of_its_own(*value);
+        }
+
+        bh_arr_each(AstNamedValue *, named, args->named_values) {
+            decision.untyped_arguments |= argument_has_no_type_of_its_own((AstTyped *) *named);
+        }
+    }
+
+    bh_arr(bh_arr(OverloadOption)) decided = NULL;
+    bh_arr_new(context->gp_alloc, decided, 4);
+    bh_arr_push(decided, overloads);
+
+    if (all_overloads) {
+        bh_arr_each(bh__imap_entry, entry, all_overloads->entries) {
+            AstNode *node = (AstNode *) entry->key;
+            if (node->kind == Ast_Kind_Overloaded_Function) {
+                bh_arr_push(decided, ((AstOverloadedFunction *) node)->overloads);
+            }
+        }
+    }
+
+    bh_arr_each(bh_arr(OverloadOption), list, decided) {
+        if (*list == NULL) continue;
+
+        i32 index = hmgeti(context->held.decided_overloads, (void *) *list);
+        if (index != -1) {
+            context->held.decided_overloads[index].value.untyped_arguments |= decision.untyped_arguments;
+            continue;
+        }
+
+        hmput(context->held.decided_overloads, (void *) *list, decision);
+    }
+
+    bh_arr_free(decided);
+}
+
+//
+static b32 type_is_new_nominal(Context *context, Type *type) {
+    while (type) {
+        switch (type->kind) {
+            case Type_Kind_Pointer:      type = type->Pointer.elem; break;
+            case Type_Kind_MultiPointer: type = type->MultiPointer.elem; break;
+            case Type_Kind_Slice:        type = type->Slice.elem; break;
+            case Type_Kind_DynArray:     type = type->DynArray.elem; break;
+
+            case Type_Kind_Struct:
+            case Type_Kind_Union:
+            case Type_Kind_Enum:
+                return type->id > context->held.last_type_id;
+
+            default: return 0;
+        }
+    }
+
+    return 0;
+}
+
+// `pp` is the polymorphic procedure whose parameter pattern is being examined. Names
+// in the pattern are looked up where it was declared, unless they are its own
+// polymorphic variables, which could stand for any type.
+static b32 type_node_is_new_nominal(Context *context, AstFunction *pp, AstType *node) {
+    while (node) {
+        switch (node->kind) {
+            case Ast_Kind_Symbol: {
+                if (pp == NULL || pp->parent_scope_of_poly_proc == NULL) return 0;
+
+                bh_arr_each(AstPolyParam, poly_param, pp->poly_params) {
+                    if (token_equals(poly_param->poly_sym->token, node->token)) return 0;
+                }
+
+                node = (AstType *) symbol_resolve(context, pp->parent_scope_of_poly_proc, node->token);
+                pp = NULL;
+                break;
+            }
+
+            case Ast_Kind_Type_Alias:         node = ((AstTypeAlias *) node)->to; break;
+            case Ast_Kind_Pointer_Type:       node = ((AstPointerType *) node)->elem; break;
+            case Ast_Kind_Multi_Pointer_Type: node = ((AstMultiPointerType *) node)->elem; break;
+            case Ast_Kind_Slice_Type:         node = ((AstSliceType *) node)->elem; break;
+            case Ast_Kind_DynArr_Type:        node = ((AstDynArrType *) node)->elem; break;
+            case Ast_Kind_Poly_Call_Type:     node = ((AstPolyCallType *) node)->callee; break;
+
+            case Ast_Kind_Struct_Type:
+            case Ast_Kind_Union_Type:
+            case Ast_Kind_Enum_Type:
+                return node->type_id == 0 || node->type_id > context->held.last_type_id;
+
+            // A polymorphic struct or union pattern can only match one of its instances.
+            case Ast_Kind_Poly_Struct_Type: {
+                PolyInstanceTable *table = ((AstPolyStructType *) node)->concrete_structs;
+                if (table == NULL) return 1;
+
+                bh_arr_each(PolyInstance, inst, table->instances) {
+                    if (inst->struct_type && !type_node_is_new_nominal(context, NULL, (AstType *) inst->struct_type)) return 0;
+                }
+                return 1;
+            }
+
+            case Ast_Kind_Poly_Union_Type: {
+                PolyInstanceTable *table = ((AstPolyUnionType *) node)->concrete_unions;
+                if (table == NULL) return 1;
+
+                bh_arr_each(PolyInstance, inst, table->instances) {
+                    if (inst->union_type && !type_node_is_new_nominal(context, NULL, (AstType *) inst->union_type)) return 0;
+                }
+                return 1;
+            }
+
+            default: return 0;
+        }
+    }
+
+    return 0;
+}
+
+//
+// An option added after the files were released could only have been picked by an
+// earlier decision if it accepts the arguments given then. When one of its required
+// parameters is (a pointer to, or a slice of) a struct, union or enum that was only
+// created after release, no typed argument from back then could have matched it.
+// For a polymorphic option, the same holds when the parameter's pattern names such
+// a type, or a polymorphic struct or union with no instances from before release.
+static b32 overload_option_needs_new_type(Context *context, AstTyped *option, HeldDecision decision) {
+    AstTyped *node = (AstTyped *) strip_aliases((AstNode *) option);
+    if (node->kind == Ast_Kind_Macro) node = ((AstMacro *) node)->body;
+
+    // A nested overloaded function is only safe if every option in it is. It is
+    // marked as decided so options added to it later are checked as well.
+    if (node->kind == Ast_Kind_Overloaded_Function) {
+        AstOverloadedFunction *ofunc = (AstOverloadedFunction *) node;
+        if (ofunc->overloads == NULL) return 1;
+
+        if (hmgeti(context->held.decided_overloads, (void *) ofunc->overloads) == -1) {
+            hmput(context->held.decided_overloads, (void *) ofunc->overloads, decision);
+        }
+
+        bh_arr_each(OverloadOption, other, ofunc->overloads) {
+            if (!overload_option_needs_new_type(context, other->option, decision)) return 0;
+        }
+        return 1;
+    }
+
+    AstFunction *func = (AstFunction *) node;
+    if (func->kind == Ast_Kind_Polymorphic_Proc) {
+        bh_arr_each(AstParam, param, func->params) {
+            if (param->default_value != NULL) continue;
+
+            if (type_node_is_new_nominal(context, func, param->local->type_node)) return 1;
+        }
+
+        return 0;
+    }
+
+    if (func->kind != Ast_Kind_Function || func->type == NULL) return 0;
+
+    bh_arr_each(AstParam, param, func->params) {
+        if (param->default_value != NULL) continue;
+
+        if (type_is_new_nominal(context, param->local->type)) return 1;
+    }
+
+    return 0;
+}
+
+void held_files_check_late_options(Context *context) {
+    bh_arr_each(HeldLateOption, late, context->held.late_options) {
+        if (!late->decision.untyped_arguments && overload_option_needs_new_type(context, late->option, late->decision)) continue;
+
+        held_files_conflict(context, late->decision.file_id);
+    }
+
+    bh_arr_clear(context->held.late_options);
+}
+
 AstTyped* find_matching_overload_by_arguments(Context *context, bh_arr(OverloadOption) overloads, Arguments* param_args) {
     Arguments args;
     arguments_clone(context, &args, param_args);
@@ -663,6 +1112,9 @@ AstTyped* find_matching_overload_by_arguments(Context *context, bh_arr(OverloadO
         }
     }
 
+    // Not finding a match is only final for operators, but noting it either way is harmless.
+    if (context->held.holding) held_files_note_overload_decision(context, overloads, &all_overloads, param_args);
+
     bh_imap_free(&all_overloads);
     bh_arr_free(args.values);
     return matched_overload;
@@ -691,6 +1143,8 @@ AstTyped* find_matching_overload_by_type(Context *context, bh_arr(OverloadOption
             return (AstTyped *) &context->node_that_signals_a_yield;
         }
     }
+
+    if (context->held.holding) held_files_note_overload_decision(context, overloads, &all_overloads, NULL);
     
     bh_imap_free(&all_overloads);
     return matched_overload;
@@ -713,9 +1167,7 @@ void report_unable_to_match_overload(Context *context, AstCall* call, bh_arr(Ove
         }
 
         bh_arr_each(AstNamedValue *, named_value, call->args.named_values) { 
-            token_toggle_end((*named_value)->token);
-            strncat(arg_str, (*named_value)->token->text, 1023);
-            token_toggle_end((*named_value)->token);
+            strncat(arg_str, token_atom(context, (*named_value)->token), 1023);
 
             strncat(arg_str, "=", 1023);
             strncat(arg_str, node_get_type_name(context, (*named_value)->value), 1023); // CHECK: this might say 'unknown'.
@@ -761,7 +1213,7 @@ static TypeMatch ensure_overload_returns_correct_type_job(Context *context, void
     
     // If the entity on the node has been completed and unused,
     // skip checking this because the function is likely not used.
-    if (node->entity && node->entity->state >= Entity_State_Finalized) {
+    if (ast_entity(context, node) && ast_entity(context, node)->state >= Entity_State_Finalized) {
         return TYPE_MATCH_SUCCESS;
     }
 
@@ -921,7 +1373,7 @@ void expand_macro(Context *context, AstCall** pcall, AstFunction* template) {
                 }
             }
 
-            add_entities_for_node(&context->entities, NULL, *node, scope, macro->entity->package);
+            add_entities_for_node(&context->entities, NULL, *node, scope, ast_entity(context, macro)->package);
         }
     }
 
@@ -963,6 +1415,7 @@ AstFunction* macro_resolve_header(Context *context, AstMacro* macro, Arguments*
 //
 // Arguments resolving
 //
+// `name` must be an atom.
 static i32 lookup_idx_by_name(Context *context, AstNode* provider, char* name) {
     switch (provider->kind) {
         case Ast_Kind_Struct_Literal: {
@@ -970,7 +1423,7 @@ static i32 lookup_idx_by_name(Context *context, AstNode* provider, char* name) {
             assert(sl->type);
 
             StructMember s;
-            if (!type_lookup_member(context, sl->type, name, &s)) return -1;
+            if (!type_lookup_member_atom(context, sl->type, name, &s)) return -1;
             if (s.included_through_use) return -1;
 
             return s.idx;
@@ -982,7 +1435,7 @@ static i32 lookup_idx_by_name(Context *context, AstNode* provider, char* name) {
             i32 param_idx = -1;
             i32 idx = 0;
             bh_arr_each(AstParam, param, func->params) {
-                if (token_text_equals(param->local->token, name)) {
+                if (token_atom(context, param->local->token) == name) {
                     param_idx = idx;
                     break;
                 }
@@ -1109,29 +1562,25 @@ b32 fill_in_arguments(Context *context, Arguments* args, AstNode* provider, char
                 }
             }
 
-            token_toggle_end(named_value->token);
-            i32 idx = lookup_idx_by_name(context, provider, named_value->token->text);
+            char *name = token_atom(context, named_value->token);
+            i32 idx = lookup_idx_by_name(context, provider, name);
             if (idx == -1) {
-                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "'%s' is not a valid named parameter here.", named_value->token->text);
-                token_toggle_end(named_value->token);
+                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "'%s' is not a valid named parameter here.", name);
                 return 0;
             }
 
             // assert(idx < bh_arr_length(args->values));
             if (idx >= bh_arr_length(args->values)) {
-                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "Error placing value with name '%s' at index '%d'.", named_value->token->text, idx);
-                token_toggle_end(named_value->token);
+                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "Error placing value with name '%s' at index '%d'.", name, idx);
                 return 0;
             }
 
             if (args->values[idx] != NULL && args->values[idx] != named_value->value) {
-                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "Multiple values given for parameter named '%s'.", named_value->token->text);
-                token_toggle_end(named_value->token);
+                if (err_msg) *err_msg = bh_aprintf(context->scratch_alloc, "Multiple values given for parameter named '%s'.", name);
                 return 0;
             }
 
             args->values[idx] = named_value->value;
-            token_toggle_end(named_value->token);
         }
     }
 
@@ -1691,7 +2140,7 @@ static u32 symbol_info_get_file_id(SymbolInfoTable *syminfo, const char *filenam
 
 void track_declaration_for_symbol_info(Context *context, OnyxFilePos pos, AstNode *node) {
     if (!context->options->generate_symbol_info_file) return;
-    if (pos.filename == NULL) return;
+    if (pos.file_id == 0) return;
 
     SymbolInfoTable *syminfo = context->symbol_info;
     assert(syminfo);
@@ -1699,13 +2148,14 @@ void track_declaration_for_symbol_info(Context *context, OnyxFilePos pos, AstNod
     if (bh_imap_has(&syminfo->node_to_id, (u64) node)) return;
 
     u32 symbol_id = syminfo->next_symbol_id++;
-    u32 file_id = symbol_info_get_file_id(syminfo, pos.filename);
+    OnyxFileLocation location = file_pos_location(pos);
+    u32 file_id = symbol_info_get_file_id(syminfo, location.filename);
 
     SymbolInfo symbol;
     symbol.id = symbol_id;
     symbol.file_id = file_id;
-    symbol.line = pos.line;
-    symbol.column = pos.column;
+    symbol.line = location.line;
+    symbol.column = location.column;
     symbol.documentation = NULL;
     symbol.documentation_length = 0;
     bh_arr_push(syminfo->symbols, symbol);
@@ -1746,13 +2196,14 @@ void track_resolution_for_symbol_info(Context *context, AstNode *original, AstNo
 
     u32 symbol_id = (u32) bh_imap_get(&syminfo->node_to_id, (u64) resolved);
 
-    u32 file_id = symbol_info_get_file_id(syminfo, original->token->pos.filename);
+    OnyxFileLocation location = file_pos_location(original->token->pos);
+    u32 file_id = symbol_info_get_file_id(syminfo, location.filename);
 
     SymbolResolution res;
     res.symbol_id = symbol_id;
     res.file_id = file_id;
-    res.line = original->token->pos.line;
-    res.column = original->token->pos.column;
+    res.line = location.line;
+    res.column = location.column;
     res.length = original->token->length;
 
     bh_arr_push(syminfo->symbols_resolutions, res);
@@ -93,7 +93,7 @@ static b32 onyx_type_is_multiple_wasm_values(Type *type) {
 }
 
 static i32 generate_type_idx(OnyxWasmModule* mod, Type* ft);
-static i32 get_element_idx(OnyxWasmModule* mod, AstFunction* func);
+static i32 get_element_idx(OnyxWasmModule* mod, AstFunction* func, u32 data_id);
 
 #define LOCAL_I32  0x000000000
 #define LOCAL_I64  0x100000000
@@ -231,9 +231,7 @@ static u32 debug_introduce_symbol(OnyxWasmModule *mod, OnyxToken *token, DebugSy
     sym_info.type          = type->id;
 
     if (token) {
-        token_toggle_end(token);
-        sym_info.name = bh_strdup(mod->context->ast_alloc, token->text);
-        token_toggle_end(token);
+        sym_info.name = bh_strdup_len(mod->context->ast_alloc, token->text, token->length);
     } else {
         sym_info.name = NULL;
     }
@@ -284,7 +282,8 @@ static u32 debug_get_file_id(OnyxWasmModule *mod, const char *name) {
 }
 
 static void debug_set_position(OnyxWasmModule *mod, OnyxToken *token) {
-    i32 file_id = debug_get_file_id(mod, token->pos.filename);
+    OnyxFileLocation location = file_pos_location(token->pos);
+    i32 file_id = debug_get_file_id(mod, location.filename);
 
     bh_buffer_write_byte(&mod->debug_context->op_buffer, DOT_SET);
     mod->debug_context->last_op_was_rep = 0;
@@ -293,7 +292,7 @@ static void debug_set_position(OnyxWasmModule *mod, OnyxToken *token) {
     u8 *bytes = uint_to_uleb128(file_id, &leb_len);
     bh_buffer_append(&mod->debug_context->op_buffer, bytes, leb_len);
 
-    bytes = uint_to_uleb128(token->pos.line, &leb_len);
+    bytes = uint_to_uleb128(location.line, &leb_len);
     bh_buffer_append(&mod->debug_context->op_buffer, bytes, leb_len);
 
     mod->debug_context->last_token = token;
@@ -318,15 +317,19 @@ static void debug_emit_instruction(OnyxWasmModule *mod, OnyxToken *token) {
         assert((ctx->op_buffer.data[ctx->op_buffer.length - 1] & DOT_REP) == DOT_REP);
     }
     i32 file_id, old_file_id;
+    OnyxFileLocation location, old_location;
 
     b32 repeat_previous = 0;
-    if (!token || !token->pos.filename) {
+    if (!token || token->pos.file_id == 0) {
         repeat_previous = 1;
 
     } else {
-        file_id = debug_get_file_id(mod, token->pos.filename);
-        old_file_id = debug_get_file_id(mod, ctx->last_token->pos.filename);
-        if (old_file_id == file_id && token->pos.line == ctx->last_token->pos.line) {
+        location = file_pos_location(token->pos);
+        old_location = file_pos_location(ctx->last_token->pos);
+
+        file_id = debug_get_file_id(mod, location.filename);
+        old_file_id = debug_get_file_id(mod, old_location.filename);
+        if (old_file_id == file_id && location.line == old_location.line) {
             repeat_previous = 1;
         }
     }
@@ -352,16 +355,16 @@ static void debug_emit_instruction(OnyxWasmModule *mod, OnyxToken *token) {
 
     if (old_file_id == file_id) {
         // We see if we can INC/DEC to get to the line number
-        if (ctx->last_token->pos.line < token->pos.line) {
-            u32 diff = token->pos.line - ctx->last_token->pos.line;
+        if (old_location.line < location.line) {
+            u32 diff = location.line - old_location.line;
             if (diff <= 64) {
                 bh_buffer_write_byte(&mod->debug_context->op_buffer, DOT_INC | (diff - 1));
                 goto done;
             }
         }
 
-        if (ctx->last_token->pos.line > token->pos.line) {
-            u32 diff = ctx->last_token->pos.line - token->pos.line;
+        if (old_location.line > location.line) {
+            u32 diff = old_location.line - location.line;
             if (diff <= 64) {
                 bh_buffer_write_byte(&mod->debug_context->op_buffer, DOT_DEC | (diff - 1));
                 goto done;
@@ -380,8 +383,9 @@ static void debug_emit_instruction(OnyxWasmModule *mod, OnyxToken *token) {
 }
 
 static void debug_begin_function(OnyxWasmModule *mod, u32 func_idx, OnyxToken *token, char *name) {
-    u32 file_id = debug_get_file_id(mod, token->pos.filename);
-    u32 line    = token->pos.line;
+    OnyxFileLocation location = file_pos_location(token->pos);
+    u32 file_id = debug_get_file_id(mod, location.filename);
+    u32 line    = location.line;
 
     assert(mod->debug_context);
 
@@ -556,14 +560,14 @@ static void emit_constexpr(ConstExprContext *ctx, AstTyped *node, u32 offset);
 static b32 emit_constexpr_(ConstExprContext *ctx, AstTyped *node, u32 offset);
 
 static void ensure_node_has_been_submitted_for_emission(Context *context, AstNode *node) {
-    assert(node->entity);
+    assert(ast_entity(context, node));
 
     if (node->flags & Ast_Flag_Has_Been_Scheduled_For_Emit) return;
     node->flags |= Ast_Flag_Has_Been_Scheduled_For_Emit;
 
     // Node should be finalized at this point.
     // Actually no, it could have been entered by something else.
-    // assert(node->entity->state == Entity_State_Finalized);
+    // assert(ast_entity(context, node)->state == Entity_State_Finalized);
 
     if (node->kind == Ast_Kind_Function) {
         // Need to add header and body for functions
@@ -581,8 +585,8 @@ static void ensure_node_has_been_submitted_for_emission(Context *context, AstNod
     }
 
   submit_normal_node:
-    entity_change_state(&context->entities, node->entity, Entity_State_Code_Gen);
-    entity_heap_insert_existing(&context->entities, node->entity);
+    entity_change_state(&context->entities, ast_entity(context, node), Entity_State_Code_Gen);
+    entity_heap_insert_existing(&context->entities, ast_entity(context, node));
 }
 
 static void ensure_type_has_been_submitted_for_emission(OnyxWasmModule *mod, Type *type) {
@@ -2027,7 +2031,7 @@ EMIT_FUNC(call, AstCall* call) {
 
     if (mod->context->options->stack_trace_enabled) {
         emit_stack_address(mod, &code, mod->stack_trace_idx, NULL);
-        WIL(NULL, WI_I32_CONST, call->token->pos.line);
+        WIL(NULL, WI_I32_CONST, file_pos_location(call->token->pos).line);
         emit_store_instruction(mod, &code, mod->context->types.basic[Basic_Kind_U32], 8);
 
         u64 stack_trace_pass_global = bh_imap_get(&mod->index_map, (u64) &mod->context->builtins.stack_trace);
@@ -3288,7 +3292,7 @@ EMIT_FUNC(expression, AstTyped* expr) {
 
         case Ast_Kind_Function: {
             AstFunction *func = (AstFunction *) expr;
-            i32 elemidx = get_element_idx(mod, func);
+            i32 elemidx = get_element_idx(mod, func, 0);
 
             // This is not patched because it refers to the element index, which
             // requires the function be submitted and part of the binary already.
@@ -4065,14 +4069,18 @@ static i32 generate_type_idx(OnyxWasmModule* mod, Type* ft) {
     return mod->next_type_idx++;
 }
 
-static i32 get_element_idx(OnyxWasmModule* mod, AstFunction* func) {
+//
+// `data_id` is the datum that the element index is written into. If it is 0, the
+// index is written into the code of the function being emitted, if there is one.
+static i32 get_element_idx(OnyxWasmModule* mod, AstFunction* func, u32 data_id) {
     ensure_node_has_been_submitted_for_emission(mod->context, (AstNode *) func);
 
+    i32 idx;
     if (bh_imap_has(&mod->elem_map, (u64) func)) {
-        return bh_imap_get(&mod->elem_map, (u64) func);
+        idx = bh_imap_get(&mod->elem_map, (u64) func);
 
     } else {
-        i32 idx = bh_arr_length(mod->elems);
+        idx = bh_arr_length(mod->elems);
 
         // Cache which function goes to which element slot.
         bh_imap_put(&mod->elem_map, (u64) func, idx);
@@ -4084,9 +4092,15 @@ static i32 get_element_idx(OnyxWasmModule* mod, AstFunction* func) {
         code_patch.node_related_to_patch = (AstNode *) func;
         bh_arr_push(mod->code_patches, code_patch);
         bh_arr_push(mod->elems, 0);
-
-        return idx;
     }
+
+    bh_arr_push(mod->elem_references, ((ElemReference) {
+        .elem_idx = idx,
+        .func_idx = data_id ? -1 : mod->current_func_idx,
+        .data_id  = data_id,
+    }));
+
+    return idx;
 }
 
 EMIT_FUNC(stack_trace_blob, AstFunction *fd)  {
@@ -4099,9 +4113,10 @@ EMIT_FUNC(stack_trace_blob, AstFunction *fd)  {
     u8* node_data = bh_alloc_array(mod->context->ast_alloc, u8, 5 * POINTER_SIZE);
 
     char *name = get_function_name(mod->context, fd);
-    emit_raw_string(mod, (char *) fd->token->pos.filename, strlen(fd->token->pos.filename), &file_name_id, (u64 *) &node_data[4]);
+    OnyxFileLocation location = file_pos_location(fd->token->pos);
+    emit_raw_string(mod, (char *) location.filename, strlen(location.filename), &file_name_id, (u64 *) &node_data[4]);
     emit_raw_string(mod, name, strlen(name), &func_name_id, (u64 *) &node_data[16]);
-    *((u32 *) &node_data[8]) = fd->token->pos.line;
+    *((u32 *) &node_data[8]) = location.line;
 
     WasmDatum stack_node_data = ((WasmDatum) {
         .data = node_data,
@@ -4378,11 +4393,10 @@ static void emit_export_directive(OnyxWasmModule* mod, AstDirectiveExport* expor
     assert(export->export_name);
     assert(export->export);
 
-    token_toggle_end(export->export_name);
+    char *export_name = token_atom(mod->context, export->export_name);
 
-    if (shgeti(mod->exports, export->export_name->text) != -1) {
-        ONYX_ERROR(export->token->pos, Error_Critical, "Duplicate export name, '%s'.", export->export_name->text);
-        token_toggle_end(export->export_name);
+    if (shgeti(mod->exports, export_name) != -1) {
+        ONYX_ERROR(export->token->pos, Error_Critical, "Duplicate export name, '%s'.", export_name);
         return;        
     }
 
@@ -4411,10 +4425,9 @@ static void emit_export_directive(OnyxWasmModule* mod, AstDirectiveExport* expor
         default: assert("Invalid export node" && 0);
     }
 
-    shput(mod->exports, export->export_name->text, wasm_export);
+    shput(mod->exports, export_name, wasm_export);
     mod->export_count++;
 
-    token_toggle_end(export->export_name);
     return;
 }
 
@@ -4599,7 +4612,7 @@ static b32 emit_constexpr_(ConstExprContext *ctx, AstTyped *node, u32 offset) {
 
     case Ast_Kind_Function: {
         AstFunction* func = (AstFunction *) node;
-        CE(u32, 0) = get_element_idx(ctx->module, func);
+        CE(u32, 0) = get_element_idx(ctx->module, func, ctx->data_id);
         CE(u32, 4) = 0;
         break;
     }
@@ -4787,19 +4800,17 @@ static void emit_file_contents(OnyxWasmModule* mod, AstFileContents* fc) {
     // once. But somehow filename isn't NULL occasionally so I have to check for that...
     //                                                                      - brendanfh  2021/05/23
     if (fc->filename == NULL) {
-        const char* parent_file = fc->token->pos.filename;
+        const char* parent_file = file_pos_filename(fc->token->pos);
         if (parent_file == NULL) parent_file = ".";
 
         char* parent_folder = bh_path_get_parent(parent_file, mod->context->scratch_alloc);
 
         OnyxToken *filename_token = fc->filename_expr->token;
 
-        token_toggle_end(filename_token);
-        char* temp_fn     = bh_alloc_array(mod->context->scratch_alloc, char, filename_token->length);
+        char* temp_fn     = bh_alloc_array(mod->context->scratch_alloc, char, filename_token->length + 1);
         i32   temp_fn_len = string_process_escape_seqs(temp_fn, filename_token->text, filename_token->length);
         char* filename    = bh_lookup_file(temp_fn, parent_folder, NULL, NULL, NULL, mod->context->scratch_alloc);
         fc->filename      = bh_strdup(mod->context->gp_alloc, filename);
-        token_toggle_end(filename_token);
     }
 
     i32 index = shgeti(mod->loaded_file_info, fc->filename);
@@ -4846,23 +4857,20 @@ static void emit_js_node(OnyxWasmModule* mod, AstJsNode *js) {
     char *contents = NULL;
 
     if (js->filepath) {
-        const char* parent_file = js->token->pos.filename;
+        const char* parent_file = file_pos_filename(js->token->pos);
         if (parent_file == NULL) parent_file = ".";
 
         char* parent_folder = bh_path_get_parent(parent_file, mod->context->scratch_alloc);
 
         OnyxToken *filename_token = js->filepath->token;
-        token_toggle_end(filename_token);
 
-        char* temp_fn     = bh_alloc_array(mod->context->scratch_alloc, char, filename_token->length);
+        char* temp_fn     = bh_alloc_array(mod->context->scratch_alloc, char, filename_token->length + 1);
         i32   temp_fn_len = string_process_escape_seqs(temp_fn, filename_token->text, filename_token->length);
         char* filename    = bh_strdup(
             mod->context->gp_alloc,
             bh_lookup_file(temp_fn, parent_folder, NULL, NULL, NULL, mod->context->scratch_alloc)
         );
 
-        token_toggle_end(filename_token);
-
         if (!bh_file_exists(filename)) {
             ONYX_ERROR(js->token->pos, Error_Critical,
                     "Unable to open file for reading, '%s'.",
@@ -4974,6 +4982,7 @@ void onyx_wasm_module_initialize(Context *context, OnyxWasmModule *module) {
     bh_arr_new(context->gp_alloc, module->globals, 4);
     bh_arr_new(context->gp_alloc, module->data, 4);
     bh_arr_new(context->gp_alloc, module->elems, 4);
+    bh_arr_new(context->gp_alloc, module->elem_references, 4);
     bh_arr_new(context->gp_alloc, module->libraries, 4);
     bh_arr_new(context->gp_alloc, module->library_paths, 4);
     bh_arr_new(context->gp_alloc, module->js_partials, 4);
@@ -5041,7 +5050,7 @@ void emit_entity(Context *context, Entity* ent) {
 
         case Entity_Type_Function_Header:
             if (ent->function->flags & Ast_Flag_Proc_Is_Null) {
-                if (mod->null_proc_func_idx == -1) mod->null_proc_func_idx = get_element_idx(mod, ent->function);
+                if (mod->null_proc_func_idx == -1) mod->null_proc_func_idx = get_element_idx(mod, ent->function, 0);
             }
 
             if (ent->function->tags != NULL) {
@@ -5126,10 +5135,242 @@ static i32 cmp_type_info(const void *a, const void *b) {
     return *(i32 *) a - *(i32 *) b;
 }
 
-
 #undef BH_INTERNAL_ALLOCATOR
 #define BH_INTERNAL_ALLOCATOR (context->gp_alloc)
 
+//
+// Tree shaking. Functions and data that were emitted but can never be used are removed.
+// The roots are the exported functions, which include the start function. A reachable
+// function reaches the functions it calls directly, the data it refers to, and the
+// functions whose address it takes. A reachable datum reaches the data it points to, and
+// the functions whose address is written in it. Everything else is removed.
+//
+// Function pointers are indices into the function table, and the table cannot be
+// shortened without changing indices that are already written into code and data. So
+// the elements of removed functions are kept, and point at the null procedure instead,
+// since nothing reachable has their index. Imported functions are never removed, so the
+// module requires the same imports either way.
+//
+static void find_reachable_code_and_data(OnyxWasmModule *module, u8 *func_reached, u8 *data_reached) {
+    Context *context = module->context;
+    bh_allocator alloc = context->gp_alloc;
+
+    i32 import_count = module->next_foreign_func_idx;
+    i32 func_count   = module->next_func_idx;
+    i32 data_count   = bh_arr_length(module->data);
+    i32 patch_count  = bh_arr_length(module->data_patches);
+    i32 ref_count    = bh_arr_length(module->elem_references);
+
+    // What every function and datum refers to, as linked lists threaded through the data
+    // patches and the element references. Data is indexed by its id. -1 ends a list.
+    i32 *lists = bh_alloc_array(alloc, i32, 2 * (func_count + data_count + 1) + patch_count + ref_count);
+    i32 *func_patches = lists;
+    i32 *data_patches = func_patches + func_count;
+    i32 *func_refs    = data_patches + data_count + 1;
+    i32 *data_refs    = func_refs + func_count;
+    i32 *next_patch   = data_refs + data_count + 1;
+    i32 *next_ref     = next_patch + patch_count;
+    fori (i, 0, 2 * (func_count + data_count + 1)) lists[i] = -1;
+
+    bh_arr(i32) func_worklist = NULL;
+    bh_arr(i32) data_worklist = NULL;
+    bh_arr_new(alloc, func_worklist, 64);
+    bh_arr_new(alloc, data_worklist, 64);
+
+#define MARK_FUNC(idx) do { \
+        i64 __i = (i64) (idx); \
+        if (__i >= 0 && __i < func_count && !func_reached[__i]) { \
+            func_reached[__i] = 1; \
+            bh_arr_push(func_worklist, (i32) __i); \
+        } \
+    } while (0)
+
+#define MARK_DATA(id) do { \
+        i64 __i = (i64) (id); \
+        if (__i > 0 && __i <= data_count && !data_reached[__i]) { \
+            data_reached[__i] = 1; \
+            bh_arr_push(data_worklist, (i32) __i); \
+        } \
+    } while (0)
+
+#define MARK_ELEM(elem_idx) do { \
+        i64 __e = (i64) (elem_idx); \
+        if (__e >= 0 && __e < bh_arr_length(module->elems)) MARK_FUNC(module->elems[__e] - import_count); \
+    } while (0)
+
+    fori (i, 0, patch_count) {
+        DatumPatchInfo *patch = &module->data_patches[i];
+        i32 *head = NULL;
+        if (patch->kind == Datum_Patch_Instruction) {
+            if (patch->index < (u32) func_count) head = &func_patches[patch->index];
+        } else {
+            if (patch->index <= (u32) data_count) head = &data_patches[patch->index];
+        }
+
+        if (head) {
+            next_patch[i] = *head;
+            *head = i;
+        }
+    }
+
+    fori (i, 0, ref_count) {
+        ElemReference *ref = &module->elem_references[i];
+        if (ref->data_id > 0 && ref->data_id <= (u32) data_count) {
+            next_ref[i] = data_refs[ref->data_id];
+            data_refs[ref->data_id] = i;
+
+        } else if (ref->data_id == 0 && ref->func_idx >= 0 && ref->func_idx < func_count) {
+            next_ref[i] = func_refs[ref->func_idx];
+            func_refs[ref->func_idx] = i;
+
+        } else {
+            // Taken outside of any function or datum, so it could be used from anywhere.
+            MARK_ELEM(ref->elem_idx);
+        }
+    }
+
+    fori (i, 0, shlen(module->exports)) {
+        if (module->exports[i].value.kind == WASM_FOREIGN_FUNCTION) {
+            MARK_FUNC(module->exports[i].value.idx - import_count);
+        }
+    }
+
+    if (module->null_proc_func_idx >= 0) {
+        MARK_ELEM(module->null_proc_func_idx);
+    } else {
+        // Without the null procedure, there is nothing to point unused elements at.
+        fori (i, 0, bh_arr_length(module->elems)) MARK_ELEM(i);
+    }
+
+    while (bh_arr_length(func_worklist) > 0 || bh_arr_length(data_worklist) > 0) {
+        if (bh_arr_length(func_worklist) > 0) {
+            i32 func_idx = bh_arr_pop(func_worklist);
+
+            // __initialize_data_segments is only generated after this, and calls nothing.
+            if (func_idx < bh_arr_length(module->funcs)) {
+                bh_arr_each(WasmInstruction, instr, module->funcs[func_idx].code) {
+                    if (instr->type == WI_CALL) MARK_FUNC(instr->data.l - import_count);
+                }
+            }
+
+            for (i32 p = func_patches[func_idx]; p != -1; p = next_patch[p]) MARK_DATA(module->data_patches[p].data_id);
+            for (i32 r = func_refs[func_idx];    r != -1; r = next_ref[r])   MARK_ELEM(module->elem_references[r].elem_idx);
+
+        } else {
+            i32 data_id = bh_arr_pop(data_worklist);
+
+            for (i32 p = data_patches[data_id]; p != -1; p = next_patch[p]) MARK_DATA(module->data_patches[p].data_id);
+            for (i32 r = data_refs[data_id];    r != -1; r = next_ref[r])   MARK_ELEM(module->elem_references[r].elem_idx);
+        }
+    }
+
+#undef MARK_ELEM
+#undef MARK_DATA
+#undef MARK_FUNC
+
+    bh_free(alloc, lists);
+    bh_arr_free(func_worklist);
+    bh_arr_free(data_worklist);
+}
+
+static void remove_unreachable_functions(OnyxWasmModule *module, u8 *func_reached) {
+    i32 import_count = module->next_foreign_func_idx;
+    i32 func_count   = bh_arr_length(module->funcs);
+    if (func_count == 0) return;
+
+    Context *context = module->context;
+    bh_allocator alloc = context->gp_alloc;
+
+    // -1 means the function is removed.
+    i32 *new_index = bh_alloc_array(alloc, i32, func_count);
+
+    i32 kept_count = 0;
+    fori (i, 0, func_count) {
+        new_index[i] = func_reached[i] ? kept_count++ : -1;
+    }
+
+    if (kept_count < func_count) {
+#define REMAP(idx) ((i32) (idx) < import_count ? (i32) (idx) : new_index[(i32) (idx) - import_count] + import_count)
+
+        fori (i, 0, func_count) {
+            if (new_index[i] == -1) continue;
+
+            WasmFunc *func = &module->funcs[i];
+            bh_arr_each(WasmInstruction, instr, func->code) {
+                if (instr->type == WI_CALL) instr->data.l = REMAP(instr->data.l);
+            }
+
+            module->funcs[new_index[i]] = *func;
+        }
+
+        i32 null_proc = module->null_proc_func_idx >= 0 ? REMAP(module->elems[module->null_proc_func_idx]) : -1;
+        bh_arr_each(i32, elem, module->elems) {
+            if (*elem >= import_count && new_index[*elem - import_count] == -1) {
+                assert(null_proc >= 0);
+                *elem = null_proc;
+            } else {
+                *elem = REMAP(*elem);
+            }
+        }
+
+        fori (i, 0, shlen(module->exports)) {
+            WasmExport *export = &module->exports[i].value;
+            if (export->kind == WASM_FOREIGN_FUNCTION) {
+                export->idx = REMAP(export->idx);
+            }
+        }
+
+#ifdef ENABLE_DEBUG_INFO
+        if (module->debug_context) {
+            i32 debug_func_count = 0;
+            bh_arr_each(DebugFuncContext, func, module->debug_context->funcs) {
+                if (func->func_index >= (u32) import_count && new_index[func->func_index - import_count] == -1) continue;
+
+                func->func_index = REMAP(func->func_index);
+                module->debug_context->funcs[debug_func_count++] = *func;
+            }
+            bh_arr_set_length(module->debug_context->funcs, debug_func_count);
+
+            i32 sym_patch_count = 0;
+            bh_arr_each(DebugSymPatch, patch, module->debug_context->sym_patches) {
+                if (patch->func_idx < (u32) func_count) {
+                    if (new_index[patch->func_idx] == -1) continue;
+                    patch->func_idx = new_index[patch->func_idx];
+                }
+
+                module->debug_context->sym_patches[sym_patch_count++] = *patch;
+            }
+            bh_arr_set_length(module->debug_context->sym_patches, sym_patch_count);
+        }
+#endif
+
+#undef REMAP
+
+        bh_arr_set_length(module->funcs, kept_count);
+        context->stats.functions_removed += func_count - kept_count;
+    }
+
+    bh_free(alloc, new_index);
+}
+
+//
+// Unreachable data was already left out when placing data in memory. Nothing looks
+// data up by its id after linking, so it can be removed from the module now.
+//
+static void remove_unreachable_data(OnyxWasmModule *module) {
+    i32 kept_count = 0;
+    bh_arr_each(WasmDatum, datum, module->data) {
+        if (datum->unreachable) continue;
+
+        module->data[kept_count++] = *datum;
+    }
+
+    module->context->stats.data_segments_removed += bh_arr_length(module->data) - kept_count;
+    bh_arr_set_length(module->data, kept_count);
+}
+
+#include "wasm_peephole.h"
+
 void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLinkOptions *options) {
     // If the pointer size is going to change,
     // the code will probably need to be altered.
@@ -5173,9 +5414,7 @@ void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLin
                     func_idx += module->next_foreign_func_idx;
                 }
 
-                token_toggle_end(patch->token_related_to_patch);
-                i32 export_idx = shgeti(module->exports, patch->token_related_to_patch->text);
-                token_toggle_end(patch->token_related_to_patch);
+                i32 export_idx = shgeti(module->exports, token_atom(context, patch->token_related_to_patch));
 
                 module->exports[export_idx].value.idx = (i32) func_idx;
                 break;
@@ -5218,6 +5457,38 @@ void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLin
         }
     }
 
+    // Some data patches only know the node whose data they refer to, because it had
+    // not been emitted yet when the patch was made.
+    bh_arr_each(DatumPatchInfo, patch, module->data_patches) {
+        if (patch->data_id == 0) {
+            assert(patch->node_to_use_if_data_id_is_null || ("Unexpected empty data_id in linking!" && 0));
+            switch (patch->node_to_use_if_data_id_is_null->kind) {
+                case Ast_Kind_Memres:        patch->data_id = ((AstMemRes *) patch->node_to_use_if_data_id_is_null)->data_id; break;
+                case Ast_Kind_StrLit:        patch->data_id = ((AstStrLit *) patch->node_to_use_if_data_id_is_null)->data_id; break;
+                case Ast_Kind_File_Contents: patch->data_id = ((AstFileContents *) patch->node_to_use_if_data_id_is_null)->data_id; break;
+                default: assert("Unexpected node kind in linking phase." && 0);
+            }
+        }
+    }
+
+    // This has to happen before data is placed in memory, so that unreachable data
+    // does not take up any space.
+    u8 *func_reached = NULL;
+    if (!context->options->no_tree_shaking) {
+        func_reached = bh_alloc_array(context->gp_alloc, u8, module->next_func_idx);
+        u8 *data_reached = bh_alloc_array(context->gp_alloc, u8, bh_arr_length(module->data) + 1);
+        memset(func_reached, 0, module->next_func_idx);
+        memset(data_reached, 0, bh_arr_length(module->data) + 1);
+
+        find_reachable_code_and_data(module, func_reached, data_reached);
+
+        bh_arr_each(WasmDatum, datum, module->data) {
+            datum->unreachable = !data_reached[datum->id];
+        }
+
+        bh_free(context->gp_alloc, data_reached);
+    }
+
     module->memory_min_size = options->memory_min_size;
     module->memory_max_size = options->memory_max_size;
 
@@ -5274,6 +5545,7 @@ void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLin
 
     bh_arr_each(WasmDatum, datum, module->data) {
         assert(datum->id > 0);
+        if (datum->unreachable) continue;
 
         bh_align(datum_offset, datum->alignment);
         datum->offset_ = datum_offset;
@@ -5294,16 +5566,6 @@ void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLin
 #endif
 
     bh_arr_each(DatumPatchInfo, patch, module->data_patches) {
-        if (patch->data_id == 0) {
-            assert(patch->node_to_use_if_data_id_is_null || ("Unexpected empty data_id in linking!" && 0));
-            switch (patch->node_to_use_if_data_id_is_null->kind) {
-                case Ast_Kind_Memres:        patch->data_id = ((AstMemRes *) patch->node_to_use_if_data_id_is_null)->data_id; break;
-                case Ast_Kind_StrLit:        patch->data_id = ((AstStrLit *) patch->node_to_use_if_data_id_is_null)->data_id; break;
-                case Ast_Kind_File_Contents: patch->data_id = ((AstFileContents *) patch->node_to_use_if_data_id_is_null)->data_id; break;
-                default: assert("Unexpected node kind in linking phase." && 0);
-            }
-        }
-
         WasmDatum *datum = &module->data[patch->data_id - 1];
         assert(datum->id == patch->data_id);
 
@@ -5354,6 +5616,18 @@ void onyx_wasm_module_link(Context *context, OnyxWasmModule *module, OnyxWasmLin
         bh_align(*module->tls_size_ptr, 16);
     }
 
+    if (func_reached) {
+        remove_unreachable_functions(module, func_reached);
+        remove_unreachable_data(module);
+        bh_free(context->gp_alloc, func_reached);
+    }
+
+    // The peephole optimizer is skipped when debug info is generated, since debug
+    // info maps every instruction back to its source location.
+    if (!context->options->no_peephole && !context->options->debug_info_enabled) {
+        peephole_optimize_module(module);
+    }
+
 
     // if (context->options->print_function_mappings) {
     //     bh_arr_each(AstFunction *, pfunc, module->all_procedures) {
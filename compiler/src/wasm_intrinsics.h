@@ -502,6 +502,7 @@ EMIT_FUNC_NO_ARGS(initialize_data_segments_body) {
     i32 index = 0;
     bh_arr_each(WasmDatum, datum, mod->data) {
         assert(datum->id > 0);
+        if (datum->unreachable) continue;
         if (datum->data == NULL) { index++; continue; }
 
         WIL(NULL, WI_PTR_CONST,   datum->offset_);
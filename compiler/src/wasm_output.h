@@ -772,7 +772,7 @@ static i32 output_ovm_debug_sections(OnyxWasmModule* module, bh_buffer* buff) {
             output_unsigned_integer(1, &section_buff);
             output_unsigned_integer(func->op_offset, &section_buff);
 
-            LocalAllocator *locals = &module->funcs[i].locals;
+            LocalAllocator *locals = &module->funcs[func->func_index - module->next_foreign_func_idx].locals;
             if (func->stack_ptr_idx > 0) {
                 u32 local_idx = local_lookup_idx(locals, func->stack_ptr_idx);
                 output_unsigned_integer(local_idx, &section_buff);
@@ -0,0 +1,235 @@
+// This file is directly included in src/onxywasm.c
+// It is here purely to decrease the amount of clutter in the main file.
+
+//
+// Peephole optimization of the emitted instruction streams. This runs once per function
+// at the end of linking, after every code patch has been applied, because the patches
+// refer to instructions by their index in the stream. The instructions are compacted in
+// place; each one is appended to the output and then simplified against the instructions
+// just before it, so one rewrite can enable the next.
+//
+//   - WI_NOPs (mostly left behind by call sites that did not need stack space) are dropped.
+//   - Code between an unconditional branch and the end of its block is dropped.
+//   - local.set x; local.get x          => local.tee x
+//   - i32.const a; i32.const b; i32.add => i32.const (a + b), and other integer operators.
+//   - i32.const 0; i32.add              => (nothing)
+//   - i32.const a; i32.add; i32.const b; i32.add => i32.const (a + b); i32.add
+//   - i32.const c; i32.add; load offset=o        => load offset=(o + c)
+//   - i32.const c; i32.add; <value>; store offset=o => <value>; store offset=(o + c)
+//
+// Offsets are only folded for non-negative constants, since the address computation in a
+// load or store does not wrap around like i32.add does.
+//
+
+static b32 instr_is_unconditional_branch(WasmInstructionType type) {
+    switch (type) {
+        case WI_UNREACHABLE:
+        case WI_JUMP:
+        case WI_JUMP_TABLE:
+        case WI_RETURN:
+            return 1;
+
+        default: return 0;
+    }
+}
+
+static b32 instr_starts_block(WasmInstructionType type) {
+    return type == WI_BLOCK_START || type == WI_LOOP_START || type == WI_IF_START;
+}
+
+static b32 instr_has_memarg(WasmInstructionType type) {
+    switch (type) {
+        case WI_I32_LOAD: case WI_I64_LOAD: case WI_F32_LOAD: case WI_F64_LOAD:
+        case WI_I32_LOAD_8_S: case WI_I32_LOAD_8_U: case WI_I32_LOAD_16_S: case WI_I32_LOAD_16_U:
+        case WI_I64_LOAD_8_S: case WI_I64_LOAD_8_U: case WI_I64_LOAD_16_S: case WI_I64_LOAD_16_U:
+        case WI_I64_LOAD_32_S: case WI_I64_LOAD_32_U:
+        case WI_V128_LOAD:
+            return 1;
+
+        default: return 0;
+    }
+}
+
+static b32 instr_is_store(WasmInstructionType type) {
+    switch (type) {
+        case WI_I32_STORE: case WI_I32_STORE_8: case WI_I32_STORE_16:
+        case WI_I64_STORE: case WI_I64_STORE_8: case WI_I64_STORE_16: case WI_I64_STORE_32:
+        case WI_F32_STORE: case WI_F64_STORE:
+        case WI_V128_STORE:
+            return 1;
+
+        default: return 0;
+    }
+}
+
+// Instructions that push a single value without popping anything.
+static b32 instr_is_pure_producer(WasmInstructionType type) {
+    switch (type) {
+        case WI_I32_CONST: case WI_I64_CONST: case WI_F32_CONST: case WI_F64_CONST:
+        case WI_LOCAL_GET: case WI_GLOBAL_GET:
+            return 1;
+
+        default: return 0;
+    }
+}
+
+static b32 fold_i32_binop(WasmInstructionType type, u32 a, u32 b, u32 *out) {
+    switch (type) {
+        case WI_I32_ADD:   *out = a + b; return 1;
+        case WI_I32_SUB:   *out = a - b; return 1;
+        case WI_I32_MUL:   *out = a * b; return 1;
+        case WI_I32_AND:   *out = a & b; return 1;
+        case WI_I32_OR:    *out = a | b; return 1;
+        case WI_I32_XOR:   *out = a ^ b; return 1;
+        case WI_I32_SHL:   *out = a << (b & 31); return 1;
+        case WI_I32_SHR_U: *out = a >> (b & 31); return 1;
+        case WI_I32_SHR_S: *out = (u32) ((i32) a >> (b & 31)); return 1;
+        default: return 0;
+    }
+}
+
+static b32 fold_i64_binop(WasmInstructionType type, u64 a, u64 b, u64 *out) {
+    switch (type) {
+        case WI_I64_ADD:   *out = a + b; return 1;
+        case WI_I64_SUB:   *out = a - b; return 1;
+        case WI_I64_MUL:   *out = a * b; return 1;
+        case WI_I64_AND:   *out = a & b; return 1;
+        case WI_I64_OR:    *out = a | b; return 1;
+        case WI_I64_XOR:   *out = a ^ b; return 1;
+        case WI_I64_SHL:   *out = a << (b & 63); return 1;
+        case WI_I64_SHR_U: *out = a >> (b & 63); return 1;
+        case WI_I64_SHR_S: *out = (u64) ((i64) a >> (b & 63)); return 1;
+        default: return 0;
+    }
+}
+
+static b32 fold_memarg_offset(WasmInstruction *instr, i32 constant) {
+    if (constant < 0) return 0;
+    if ((i64) instr->data.i2 + (i64) constant > 0x7fffffff) return 0;
+
+    instr->data.i2 += constant;
+    return 1;
+}
+
+//
+// Appends `instr` to code[0 .. *count] and simplifies the tail of the stream.
+static void peephole_push(WasmInstruction *code, i32 *count, WasmInstruction instr) {
+    i32 n = *count;
+
+    #define TAIL(i) (code[n - 1 - (i)])
+
+    switch (instr.type) {
+        case WI_LOCAL_GET:
+            if (n >= 1 && TAIL(0).type == WI_LOCAL_SET && TAIL(0).data.l == instr.data.l) {
+                TAIL(0).type = WI_LOCAL_TEE;
+                return;
+            }
+            break;
+
+        case WI_I32_ADD:
+            if (n >= 1 && TAIL(0).type == WI_I32_CONST && TAIL(0).data.i1 == 0) {
+                *count = n - 1;
+                return;
+            }
+
+            if (n >= 3 && TAIL(0).type == WI_I32_CONST && TAIL(1).type == WI_I32_ADD && TAIL(2).type == WI_I32_CONST) {
+                TAIL(2).data.l = (i64) (i32) ((u32) TAIL(2).data.i1 + (u32) TAIL(0).data.i1);
+                *count = n - 1;
+                return;
+            }
+            break;
+
+        case WI_I32_SUB:
+            if (n >= 1 && TAIL(0).type == WI_I32_CONST && TAIL(0).data.i1 == 0) {
+                *count = n - 1;
+                return;
+            }
+            break;
+
+        default: break;
+    }
+
+    if (n >= 2 && TAIL(0).type == WI_I32_CONST && TAIL(1).type == WI_I32_CONST) {
+        u32 result;
+        if (fold_i32_binop(instr.type, (u32) TAIL(1).data.i1, (u32) TAIL(0).data.i1, &result)) {
+            TAIL(1).data.l = (i64) (i32) result;
+            *count = n - 1;
+            return;
+        }
+    }
+
+    if (n >= 2 && TAIL(0).type == WI_I64_CONST && TAIL(1).type == WI_I64_CONST) {
+        u64 result;
+        if (fold_i64_binop(instr.type, (u64) TAIL(1).data.l, (u64) TAIL(0).data.l, &result)) {
+            TAIL(1).data.l = (i64) result;
+            *count = n - 1;
+            return;
+        }
+    }
+
+    if (instr_has_memarg(instr.type)) {
+        if (n >= 2 && TAIL(0).type == WI_I32_ADD && TAIL(1).type == WI_I32_CONST) {
+            if (fold_memarg_offset(&instr, TAIL(1).data.i1)) {
+                n -= 2;
+            }
+        }
+    }
+
+    if (instr_is_store(instr.type)) {
+        if (n >= 3 && instr_is_pure_producer(TAIL(0).type) && TAIL(1).type == WI_I32_ADD && TAIL(2).type == WI_I32_CONST) {
+            if (fold_memarg_offset(&instr, TAIL(2).data.i1)) {
+                TAIL(2) = TAIL(0);
+                n -= 2;
+            }
+        }
+    }
+
+    #undef TAIL
+
+    code[n] = instr;
+    *count = n + 1;
+}
+
+static void peephole_optimize_function(Context *context, WasmFunc *func) {
+    WasmInstruction *code = func->code;
+    i32 length = bh_arr_length(code);
+    i32 count  = 0;
+
+    // When dead_depth is positive, everything is skipped until the end (or else) of the
+    // block containing the unconditional branch. It counts the blocks still open.
+    i32 dead_depth = 0;
+
+    fori (i, 0, length) {
+        WasmInstruction instr = code[i];
+
+        if (dead_depth > 0) {
+            if (instr_starts_block(instr.type)) {
+                dead_depth++;
+                continue;
+            }
+
+            if (instr.type == WI_BLOCK_END || (instr.type == WI_ELSE && dead_depth == 1)) {
+                dead_depth--;
+                if (dead_depth > 0) continue;
+
+            } else {
+                continue;
+            }
+        }
+
+        if (instr.type == WI_NOP) continue;
+
+        peephole_push(code, &count, instr);
+
+        if (instr_is_unconditional_branch(instr.type)) dead_depth = 1;
+    }
+
+    bh_arr_set_length(func->code, count);
+    context->stats.instructions_removed += length - count;
+}
+
+static void peephole_optimize_module(OnyxWasmModule *module) {
+    bh_arr_each(WasmFunc, func, module->funcs) {
+        peephole_optimize_function(module->context, func);
+    }
+}
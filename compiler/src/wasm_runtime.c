@@ -7,7 +7,6 @@
 #ifdef USE_DYNCALL
     #include "dyncall.h"
     #include "dyncall_callback.h"
-    static DCCallVM *dcCallVM;
 #endif
 
 #ifndef USE_OVM_DEBUGGER
@@ -26,6 +25,8 @@ static wasm_engine_t*    wasm_engine;
 static wasm_store_t*     wasm_store;
 static wasm_extern_vec_t wasm_imports;
 static bh_buffer         wasm_raw_bytes;
+static char*             program_cache_dir;
+static b32               jit_disabled;
 wasm_instance_t*  wasm_instance;
 wasm_module_t*    wasm_module;
 wasm_memory_t*    wasm_memory;
@@ -217,46 +218,115 @@ static void lookup_and_load_custom_libraries(LinkLibraryContext *ctx, bh_arr(Was
 // module import name to dynamically load a shared library at runtime.
 //
 
+//
+// Every thread gets its own call VM, since a call VM holds the arguments of the
+// call being made. They are created the first time a thread makes a dynamic call.
+//
+#if defined(_BH_WINDOWS)
+    static __declspec(thread) DCCallVM *dcCallVM;
+#else
+    static __thread DCCallVM *dcCallVM;
+
+    static pthread_key_t  dyncall_vm_key;
+    static pthread_once_t dyncall_vm_key_once = PTHREAD_ONCE_INIT;
+
+    static void free_dyncall_vm(void *vm) { dcFree(vm); }
+    static void create_dyncall_vm_key() { pthread_key_create(&dyncall_vm_key, free_dyncall_vm); }
+#endif
+
+static DCCallVM *get_dyncall_vm() {
+    if (!dcCallVM) {
+        dcCallVM = dcNewCallVM(4096);
+        dcMode(dcCallVM, DC_CALL_C_DEFAULT);
+
+        #if !defined(_BH_WINDOWS)
+            // Frees the call VM when the thread exits.
+            pthread_once(&dyncall_vm_key_once, create_dyncall_vm_key);
+            pthread_setspecific(dyncall_vm_key, dcCallVM);
+        #endif
+    }
+
+    return dcCallVM;
+}
+
+//
+// The type string after the ':' in the import name is decoded once when the
+// function is linked. The first character is the return type, and the rest
+// are the parameters.
+//
+typedef enum DynCallArg {
+    Dyn_Arg_I32,
+    Dyn_Arg_I64,
+    Dyn_Arg_F32,
+    Dyn_Arg_F64,
+    Dyn_Arg_Ptr,
+    Dyn_Arg_Slice, // A pointer and a count, passed as two arguments.
+    Dyn_Arg_Skip,  // Consumes a wasm argument without passing it.
+} DynCallArg;
+
 typedef struct DynCallContext {
     void (*func)();
-    char types[64];
+    char return_type;
+    u8   arg_count;
+    u8   args[63];
 } DynCallContext;
 
+static b32 decode_dyncall_types(DynCallContext *ctx, char *types, u32 length) {
+    if (length == 0) return 0;
+
+    ctx->return_type = types[0];
+    ctx->arg_count = 0;
+
+    fori (i, 1, (i32) length) {
+        DynCallArg arg;
+        switch (types[i]) {
+            case 'i': arg = Dyn_Arg_I32;   break;
+            case 'l': arg = Dyn_Arg_I64;   break;
+            case 'f': arg = Dyn_Arg_F32;   break;
+            case 'd': arg = Dyn_Arg_F64;   break;
+            case 'p': arg = Dyn_Arg_Ptr;   break;
+            case 's': arg = Dyn_Arg_Slice; break;
+            case 'v': arg = Dyn_Arg_Skip;  break;
+            default: return 0;
+        }
+
+        ctx->args[ctx->arg_count++] = arg;
+    }
+
+    return 1;
+}
+
 static wasm_trap_t *__wasm_dyncall(void *env, const wasm_val_vec_t *args, wasm_val_vec_t *res) {
     DynCallContext *ctx = env;
-    dcReset(dcCallVM);
-
-    int arg_idx = 0;
-    for (int i = 1; i < 64; i++) {
-        switch (ctx->types[i]) {
-            case '\0': goto arguments_placed;
-            case 'i':  dcArgInt(dcCallVM, args->data[arg_idx++].of.i32);               break;
-            case 'l':  dcArgLongLong(dcCallVM, args->data[arg_idx++].of.i64);          break;
-            case 'f':  dcArgFloat(dcCallVM, args->data[arg_idx++].of.f32);             break;
-            case 'd':  dcArgDouble(dcCallVM, args->data[arg_idx++].of.f64);            break;
-            case 'p':  dcArgPointer(dcCallVM, ONYX_PTR(args->data[arg_idx].of.i32)); arg_idx++; break;
-            case 'v':  arg_idx++;                                                      break;
-            case 's':
-                dcArgPointer(dcCallVM, ONYX_PTR(args->data[arg_idx].of.i32));
-                arg_idx++;
-                dcArgInt(dcCallVM, args->data[arg_idx++].of.i32);
+    DCCallVM *vm = get_dyncall_vm();
+    dcReset(vm);
+
+    wasm_val_t *arg = args->data;
+    fori (i, 0, ctx->arg_count) {
+        switch (ctx->args[i]) {
+            case Dyn_Arg_I32: dcArgInt(vm, (arg++)->of.i32);                  break;
+            case Dyn_Arg_I64: dcArgLongLong(vm, (arg++)->of.i64);             break;
+            case Dyn_Arg_F32: dcArgFloat(vm, (arg++)->of.f32);                break;
+            case Dyn_Arg_F64: dcArgDouble(vm, (arg++)->of.f64);               break;
+            case Dyn_Arg_Ptr: dcArgPointer(vm, ONYX_PTR(arg->of.i32)); arg++;  break;
+            case Dyn_Arg_Skip: arg++;                                         break;
+            case Dyn_Arg_Slice:
+                dcArgPointer(vm, ONYX_PTR(arg[0].of.i32));
+                dcArgInt(vm, arg[1].of.i32);
+                arg += 2;
                 break;
-
-            default: assert("bad dynamic call type" && 0);
         }
     }
 
-  arguments_placed:
-    switch (ctx->types[0]) {
-        case 'i': res->data[0] = WASM_I32_VAL(dcCallInt(dcCallVM, ctx->func));           break;
-        case 'l': res->data[0] = WASM_I64_VAL(dcCallLongLong(dcCallVM, ctx->func));      break;
-        case 'f': res->data[0] = WASM_F32_VAL(dcCallFloat(dcCallVM, ctx->func));         break;
-        case 'd': res->data[0] = WASM_F64_VAL(dcCallDouble(dcCallVM, ctx->func));        break;
-        case 'p': res->data[0] = WASM_I64_VAL((u64) dcCallPointer(dcCallVM, ctx->func)); break;
-        case 'v': dcCallVoid(dcCallVM, ctx->func);                                       break;
+    switch (ctx->return_type) {
+        case 'i': res->data[0] = WASM_I32_VAL(dcCallInt(vm, ctx->func));           break;
+        case 'l': res->data[0] = WASM_I64_VAL(dcCallLongLong(vm, ctx->func));      break;
+        case 'f': res->data[0] = WASM_F32_VAL(dcCallFloat(vm, ctx->func));         break;
+        case 'd': res->data[0] = WASM_F64_VAL(dcCallDouble(vm, ctx->func));        break;
+        case 'p': res->data[0] = WASM_I64_VAL((u64) dcCallPointer(vm, ctx->func)); break;
+        case 'v': dcCallVoid(vm, ctx->func);                                       break;
     }
 
-    dcReset(dcCallVM);
     return NULL;
 }
 
@@ -266,13 +336,6 @@ static wasm_func_t *link_and_prepare_dyncall_function(
         wasm_name_t library_name,
         wasm_name_t function_name)
 {
-    //
-    // When using any dynamic functions, a DCCallVM has to be created.
-    if (!dcCallVM) {
-        dcCallVM = dcNewCallVM(4096);
-        dcMode(dcCallVM, DC_CALL_C_DEFAULT);
-    }
-
     char lib_name[256] = {0};
     strncpy(lib_name, library_name.data, bh_min(256, library_name.size));
 
@@ -288,8 +351,9 @@ static wasm_func_t *link_and_prepare_dyncall_function(
     }
 
     char dynamic_types[64] = {0};
-    for (u32 write_index = 0; index < function_name.size; write_index++, index++) {
-        dynamic_types[write_index] = function_name.data[index];
+    u32 type_count = 0;
+    for (; index < function_name.size && type_count < 64; type_count++, index++) {
+        dynamic_types[type_count] = function_name.data[index];
     }
 
     void (*func)() = locate_symbol_in_dynamic_library_raw(lib_name, func_name);
@@ -299,7 +363,11 @@ static wasm_func_t *link_and_prepare_dyncall_function(
 
     DynCallContext* dcc = bh_alloc_item(bh_heap_allocator(), DynCallContext);
     dcc->func = func;
-    memcpy(&dcc->types, dynamic_types, 64);
+    if (!decode_dyncall_types(dcc, dynamic_types, type_count)) {
+        bh_printf("Invalid dynamic call signature '%b' for '%s'.\n", dynamic_types, type_count, func_name);
+        bh_free(bh_heap_allocator(), dcc);
+        return NULL;
+    }
 
     wasm_func_t *wasm_func = wasm_func_new_with_env(wasm_store, functype, &__wasm_dyncall, dcc, NULL);
     return wasm_func;
@@ -314,14 +382,18 @@ static wasm_func_t *link_and_prepare_dyncall_function(
 typedef struct DynCallbackContext {
     wasm_func_t *wasm_func;
     char *sig;
+
+    // Decoded from the signature when the callback is created.
+    i32  arg_count;
+    char return_type;
 } DynCallbackContext;
 
 static DCsigchar __wasm_dyncallback(DCCallback *cb, DCArgs *args, DCValue *result, void *userdata) {
     DynCallbackContext *ctx = userdata;
-    int arg_count = bh_str_last_index_of(ctx->sig, ')') - 1;
+    int arg_count = ctx->arg_count;
 
-    wasm_val_vec_t wasm_args;
-    wasm_val_vec_new_uninitialized(&wasm_args, arg_count);
+    wasm_val_t *arg_values = alloca(sizeof(wasm_val_t) * arg_count);
+    wasm_val_vec_t wasm_args = { arg_count, arg_values };
 
     for (int i = 0; i < arg_count; i++) {
         switch (ctx->sig[i]) {
@@ -342,32 +414,29 @@ static DCsigchar __wasm_dyncallback(DCCallback *cb, DCArgs *args, DCValue *resul
         }
     }
 
-    wasm_val_vec_t wasm_results;
-    wasm_val_vec_new_uninitialized(&wasm_results, 1);
+    wasm_val_t result_value = WASM_INIT_VAL;
+    wasm_val_vec_t wasm_results = { ctx->return_type == 'v' ? 0 : 1, &result_value };
 
     wasm_func_call(ctx->wasm_func, &wasm_args, &wasm_results);
 
-    switch (ctx->sig[arg_count + 1]) {
-        case 'B': result->B = wasm_results.data[0].of.i32; break;
-        case 'c': result->c = wasm_results.data[0].of.i32; break;
-        case 'C': result->C = wasm_results.data[0].of.i32; break;
-        case 's': result->s = wasm_results.data[0].of.i32; break;
-        case 'S': result->S = wasm_results.data[0].of.i32; break;
-        case 'i': result->i = wasm_results.data[0].of.i32; break;
-        case 'I': result->I = wasm_results.data[0].of.i32; break;
-        case 'j': result->j = wasm_results.data[0].of.i64; break;
-        case 'J': result->J = wasm_results.data[0].of.i64; break;
-        case 'l': result->l = wasm_results.data[0].of.i64; break;
-        case 'L': result->L = wasm_results.data[0].of.i64; break;
-        case 'f': result->f = wasm_results.data[0].of.f32; break;
-        case 'd': result->d = wasm_results.data[0].of.f64; break;
-        case 'p': result->p = (void *) wasm_results.data[0].of.i64; break;
+    switch (ctx->return_type) {
+        case 'B': result->B = result_value.of.i32; break;
+        case 'c': result->c = result_value.of.i32; break;
+        case 'C': result->C = result_value.of.i32; break;
+        case 's': result->s = result_value.of.i32; break;
+        case 'S': result->S = result_value.of.i32; break;
+        case 'i': result->i = result_value.of.i32; break;
+        case 'I': result->I = result_value.of.i32; break;
+        case 'j': result->j = result_value.of.i64; break;
+        case 'J': result->J = result_value.of.i64; break;
+        case 'l': result->l = result_value.of.i64; break;
+        case 'L': result->L = result_value.of.i64; break;
+        case 'f': result->f = result_value.of.f32; break;
+        case 'd': result->d = result_value.of.f64; break;
+        case 'p': result->p = (void *) result_value.of.i64; break;
     }
 
-    wasm_val_vec_delete(&wasm_args);
-    wasm_val_vec_delete(&wasm_results);
-
-    return ctx->sig[arg_count + 1];
+    return ctx->return_type;
 }
 
 static void (* wasm_func_from_idx(wasm_table_t *func_table, unsigned int index, char *signature))(void) {
@@ -379,6 +448,8 @@ static void (* wasm_func_from_idx(wasm_table_t *func_table, unsigned int index,
     DynCallbackContext *dcc = bh_alloc_item(bh_heap_allocator(), DynCallbackContext);
     dcc->wasm_func = func;
     dcc->sig = signature;
+    dcc->arg_count = bh_str_last_index_of(signature, ')') - 1;
+    dcc->return_type = signature[dcc->arg_count + 1];
 
     return (void (*)()) dcbNewCallback(signature, &__wasm_dyncallback, dcc);
 }
@@ -456,6 +527,12 @@ static void onyx_print_trap(wasm_trap_t* trap) {
 }
 
 static void cleanup_wasm_objects() {
+#ifdef USE_OVM_DEBUGGER
+    // Threads that are still running use the module, store and engine.
+    bool wasm_instance_threads_active(wasm_instance_t *base);
+    if (wasm_instance && wasm_instance_threads_active(wasm_instance)) return;
+#endif
+
     if (wasm_instance) wasm_instance_delete(wasm_instance);
     if (wasm_module) wasm_module_delete(wasm_module);
     if (wasm_store)  wasm_store_delete(wasm_store);
@@ -580,6 +657,14 @@ static b32 link_wasm_imports(
     return 1;
 }
 
+void onyx_run_set_program_cache(char *dir) {
+    program_cache_dir = dir;
+}
+
+void onyx_run_set_jit(b32 enabled) {
+    jit_disabled = !enabled;
+}
+
 void onyx_run_initialize(b32 debug_enabled, const char *debug_socket) {
     wasm_config = wasm_config_new();
     if (!wasm_config) {
@@ -607,6 +692,14 @@ void onyx_run_initialize(b32 debug_enabled, const char *debug_socket) {
         void wasm_config_set_listen_path(wasm_config_t *config, const char *listen_path);
         wasm_config_set_listen_path(wasm_config, socket_path);
     #endif
+
+    if (program_cache_dir && !debug_enabled) {
+        void wasm_config_set_program_cache_dir(wasm_config_t *config, char *program_cache_dir);
+        wasm_config_set_program_cache_dir(wasm_config, program_cache_dir);
+    }
+
+    void wasm_config_enable_jit(wasm_config_t *config, bool enabled);
+    wasm_config_enable_jit(wasm_config, !jit_disabled);
 #endif
 
 #ifndef USE_OVM_DEBUGGER
@@ -696,6 +789,12 @@ b32 onyx_run_wasm_code(bh_buffer wasm_bytes, int argc, char *argv[]) {
     wasm_runtime.wasm_func_from_idx = wasm_func_from_idx;
 #endif
 
+#ifdef USE_OVM_DEBUGGER
+    wasm_instance_t *wasm_instance_new_thread(wasm_instance_t *base);
+    wasm_runtime.wasm_instance_new_thread = wasm_instance_new_thread;
+    wasm_runtime.wasm_memory_host_mapped = 1;
+#endif
+
     wasm_runtime.argc = argc;
     wasm_runtime.argv = argv;
 
@@ -170,8 +170,8 @@ static MethodDataInfo write_method_data(struct TypeBuilderContext *ctx, Type *ty
     fori (i, 0, shlen(scope->symbols)) {
         AstFunction* node = (AstFunction *) strip_aliases(scope->symbols[i].value);
         if (node->kind != Ast_Kind_Function) continue;
-        assert(node->entity);
-        assert(node->entity->function == node);
+        assert(ast_entity(ctx->context, node));
+        assert(ast_entity(ctx->context, node)->function == node);
 
         // Name
         char *name = scope->symbols[i].key;
@@ -182,7 +182,7 @@ static MethodDataInfo write_method_data(struct TypeBuilderContext *ctx, Type *ty
         // any data member
         bh_buffer_align(&ctx->buffer, 4);
         u32 data_loc = ctx->buffer.length;
-        u32 func_idx = get_element_idx(ctx->module, node);
+        u32 func_idx = get_element_idx(ctx->module, node, ctx->constexpr_ctx.data_id);
         bh_buffer_write_u32(&ctx->buffer, func_idx);
         bh_buffer_write_u32(&ctx->buffer, 0);
         
@@ -1096,14 +1096,14 @@ static u64 build_tagged_procedures(OnyxWasmModule *module) {
         bh_buffer_align(&tag_proc_buffer, 4);
         tag_proc_info[index++] = tag_proc_buffer.length;
 
-        assert(func->entity && func->entity->package);
+        assert(ast_entity(module->context, func) && ast_entity(module->context, func)->package);
 
-        bh_buffer_write_u32(&tag_proc_buffer, get_element_idx(module, func));
+        bh_buffer_write_u32(&tag_proc_buffer, get_element_idx(module, func, proc_info_data_id));
         bh_buffer_write_u32(&tag_proc_buffer, 0);
         bh_buffer_write_u32(&tag_proc_buffer, func->type->id);
         ensure_type_has_been_submitted_for_emission(module, func->type);
         WRITE_SLICE(tag_array_base, tag_count);
-        bh_buffer_write_u32(&tag_proc_buffer, func->entity->package->id);
+        bh_buffer_write_u32(&tag_proc_buffer, ast_entity(module->context, func)->package->id);
     }
 
     WasmDatum proc_info_data = {
@@ -1244,7 +1244,7 @@ static u64 build_tagged_globals(OnyxWasmModule *module) {
         bh_buffer_align(&tag_global_buffer, 4);
         tag_global_info[index++] = tag_global_buffer.length;
 
-        assert(memres->entity && memres->entity->package);
+        assert(ast_entity(module->context, memres) && ast_entity(module->context, memres)->package);
 
         DatumPatchInfo patch;
         patch.kind = Datum_Patch_Data;
@@ -1259,7 +1259,7 @@ static u64 build_tagged_globals(OnyxWasmModule *module) {
         bh_buffer_write_u32(&tag_global_buffer, memres->type->id);
         ensure_type_has_been_submitted_for_emission(module, memres->type);
         WRITE_SLICE(tag_array_base, tag_count);
-        bh_buffer_write_u32(&tag_global_buffer, memres->entity->package->id);
+        bh_buffer_write_u32(&tag_global_buffer, ast_entity(module->context, memres)->package->id);
     }
 
     WasmDatum global_info_data = {
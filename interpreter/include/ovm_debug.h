@@ -270,6 +270,7 @@ typedef struct debug_info_builder_t {
 void debug_info_builder_init(debug_info_builder_t *, debug_info_t *);
 void debug_info_builder_prepare(debug_info_builder_t *, u8 *);
 void debug_info_builder_emit_location(debug_info_builder_t *);
+void debug_info_builder_remove_last_location(debug_info_builder_t *);
 void debug_info_builder_step(debug_info_builder_t *);
 void debug_info_builder_begin_func(debug_info_builder_t *, i32 func_idx);
 void debug_info_builder_end_func(debug_info_builder_t *);
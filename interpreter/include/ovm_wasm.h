@@ -9,11 +9,17 @@
 
 struct wasm_config_t {
     bool debug_enabled;
+    bool jit_enabled;
     char *listen_path;
+
+    // Directory for translated program caches. NULL disables them.
+    char *program_cache_dir;
 };
 
 void wasm_config_enable_debug(wasm_config_t *config, bool enabled);
+void wasm_config_enable_jit(wasm_config_t *config, bool enabled);
 void wasm_config_set_listen_path(wasm_config_t *config, char *listen_path);
+void wasm_config_set_program_cache_dir(wasm_config_t *config, char *program_cache_dir);
 
 struct wasm_engine_t {
     wasm_config_t *config;
@@ -30,6 +36,11 @@ struct wasm_store_t {
 
 // Types
 
+//
+// The standard C API has no kind for SIMD values yet. They are only ever
+// used inside of a module, never passed across the host API.
+#define WASM_V128 ((wasm_valkind_t) 4)
+
 struct wasm_valtype_t {
     wasm_valkind_t kind;
 };
@@ -230,8 +241,21 @@ struct wasm_instance_t {
     wasm_extern_vec_t exports;
 
     ovm_state_t *state;
+
+    //
+    // Set on instances created by wasm_instance_new_thread, to the instance
+    // they share everything but their state with.
+    struct wasm_instance_t *thread_base;
+
+    // Thread instances that finished running and can be reused.
+    bh_arr(struct wasm_instance_t *) idle_threads;
+    i32 active_threads;
+    pthread_mutex_t thread_lock;
 };
 
+wasm_instance_t *wasm_instance_new_thread(wasm_instance_t *base);
+bool wasm_instance_threads_active(wasm_instance_t *base);
+
 
 bool wasm_functype_equals(wasm_functype_t *a, wasm_functype_t *b);
 
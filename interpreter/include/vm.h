@@ -23,6 +23,10 @@ typedef struct ovm_value_t ovm_value_t;
 typedef struct ovm_instr_t ovm_instr_t;
 typedef struct ovm_static_data_t ovm_static_data_t;
 typedef struct ovm_static_integer_array_t ovm_static_integer_array_t;
+typedef struct ovm_jit_t ovm_jit_t;
+typedef struct ovm_jit_chunk_t ovm_jit_chunk_t;
+
+typedef i32 (*ovm_native_func_t)(ovm_state_t *state, ovm_value_t *values, u8 *memory);
 
 
 //
@@ -90,6 +94,12 @@ struct ovm_program_t {
 
     i32 register_count;
     ovm_store_t *store;
+
+    //
+    // Set when the program was loaded from a program cache file. `code` then
+    // points into this mapping instead of being allocated on the heap.
+    void *cache_mapping;
+    i64   cache_mapping_size;
 };
 
 ovm_program_t *ovm_program_new(ovm_store_t *store);
@@ -110,22 +120,40 @@ void ovm_program_modify_static_int(ovm_program_t *program, int arr, int idx, int
 struct ovm_engine_t {
     ovm_store_t *store;
 
-    pthread_mutex_t atomic_mutex;
-
     i64   memory_size; // This is probably going to always be 4GiB.
     void *memory;
 
     debug_state_t *debug;
+
+    //
+    // NULL unless the JIT is enabled. Never enabled at the same time as debugging.
+    ovm_jit_t *jit;
 };
 
 ovm_engine_t *ovm_engine_new(ovm_store_t *store);
 void          ovm_engine_delete(ovm_engine_t *engine);
 void          ovm_engine_enable_debug(ovm_engine_t *engine, debug_state_t *debug);
+void          ovm_engine_enable_jit(ovm_engine_t *engine, u32 call_threshold);
 bool          ovm_engine_memory_ensure_capacity(ovm_engine_t *engine, i64 minimum_size);
 void          ovm_engine_memory_copy(ovm_engine_t *engine, i64 target, void *data, i64 size);
 
 bool ovm_program_load_from_file(ovm_program_t *program, ovm_engine_t *engine, char *filename);
 
+//
+// Program caches store a fully translated program, so it can be memory-mapped
+// instead of being translated again. `key` identifies the input the program was
+// translated from; loading fails if the file was written for a different key or
+// by a different build of the VM. All three fields of the key are compared, so
+// inputs whose `hash` collides do not share a cache.
+typedef struct ovm_program_cache_key_t {
+    u64 hash;
+    u64 check;
+    u64 length;
+} ovm_program_cache_key_t;
+
+bool ovm_program_save_to_cache(ovm_program_t *program, char *filename, ovm_program_cache_key_t *key);
+bool ovm_program_load_from_cache(ovm_program_t *program, char *filename, ovm_program_cache_key_t *key);
+
 //
 // Represents ephemeral state / execution context.
 // If multiple threads are used, multiple states are needed.
@@ -170,6 +198,7 @@ struct ovm_state_t {
 
 ovm_state_t *ovm_state_new(ovm_engine_t *engine, ovm_program_t *program);
 void         ovm_state_delete(ovm_state_t *state);
+void         ovm_state_reset(ovm_state_t *state);
 void ovm_state_link_external_funcs(ovm_program_t *program, ovm_state_t *state, ovm_linkable_func_t *funcs);
 void ovm_state_register_external_func(ovm_state_t *state, i32 idx, void (*func)(void *, ovm_value_t *, ovm_value_t *), void *data);
 ovm_value_t ovm_state_register_get(ovm_state_t *state, i32 idx);
@@ -184,6 +213,11 @@ struct ovm_stack_frame_t {
 
     i32 return_address;
     i32 return_number_value;
+
+    //
+    // Set when the caller is compiled code, in which case returning from
+    // this frame leaves the interpreter instead of resuming the caller.
+    bool native_caller;
 };
 
 
@@ -209,6 +243,11 @@ struct ovm_func_t {
         i32 start_instr;
         i32 external_func_idx;
     };
+
+    //
+    // Used by the JIT. `native` is set once the function has been compiled.
+    u32 call_count;
+    ovm_native_func_t native;
 };
 
 struct ovm_external_func_t {
@@ -230,6 +269,42 @@ ovm_value_t ovm_func_call(ovm_engine_t *engine, ovm_state_t *state, ovm_program_
         i32 param_count, ovm_value_t *params);
 ovm_value_t ovm_run_code(ovm_engine_t *engine, ovm_state_t *state, ovm_program_t *program);
 
+//
+// Baseline JIT
+//
+// Internal functions that are called often enough are compiled to native code.
+// See src/vm/jit.c for how compiled code and the interpreter interact.
+//
+
+#define OVM_JIT_CALL_THRESHOLD 100
+
+#define OVM_NATIVE_RETURNED   -1
+#define OVM_NATIVE_TRAPPED    -2
+
+struct ovm_jit_chunk_t {
+    u8 *base;
+    u8 *writable;
+    i64 size;
+};
+
+struct ovm_jit_t {
+    pthread_mutex_t lock;
+    u32 call_threshold;
+
+    u8 *chunk;
+    u8 *chunk_writable;
+    i64 chunk_used;
+    i64 chunk_size;
+    bh_arr(ovm_jit_chunk_t) chunks;
+};
+
+ovm_jit_t        *ovm_jit_new(u32 call_threshold);
+void              ovm_jit_delete(ovm_jit_t *jit);
+ovm_native_func_t ovm_jit_compile(ovm_jit_t *jit, ovm_program_t *program, ovm_func_t *func);
+
+// Called by compiled code for `call` and `calli`. Returns true if the callee trapped.
+bool ovm__jit_call_func(ovm_state_t *state, i32 func_idx, i32 result_number);
+
 //
 // Instruction encoding
 //
@@ -359,6 +434,102 @@ struct ovm_instr_t {
 #define OVMI_MEM_SIZE          0x4e   // %r = <size in bytes of memory>
 #define OVMI_MEM_GROW          0x4f   // %r = <grow memory, return new size in bytes>
 
+//
+// Fused instructions. These are never emitted for a single WASM instruction;
+// the code builder produces them when it sees a common sequence, to save
+// a dispatch in the interpreter.
+#define OVMI_ADDI              0x50   // %r = %a + b              // b is a signed immediate
+
+#define OVMI_BR_LT             0x51   // br pc + a if %r < %b
+#define OVMI_BR_LT_S           0x52   // br pc + a if %r < %b
+#define OVMI_BR_LE             0x53   // br pc + a if %r <= %b
+#define OVMI_BR_LE_S           0x54   // br pc + a if %r <= %b
+#define OVMI_BR_EQ             0x55   // br pc + a if %r == %b
+#define OVMI_BR_GE             0x56   // br pc + a if %r >= %b
+#define OVMI_BR_GE_S           0x57   // br pc + a if %r >= %b
+#define OVMI_BR_GT             0x58   // br pc + a if %r > %b
+#define OVMI_BR_GT_S           0x59   // br pc + a if %r > %b
+#define OVMI_BR_NE             0x5a   // br pc + a if %r != %b
+
+//
+// Atomic instructions. Every access is sequentially consistent. The
+// read-modify-write instructions expect the static offset to already
+// be added to the address in %a.
+#define OVMI_ATOMIC_LOAD       0x5b   // %r = *(t *) &mem[%a + b]
+#define OVMI_ATOMIC_STORE      0x5c   // *(t *) &mem[%r + b] = %a
+#define OVMI_ATOMIC_ADD        0x5d   // %r = *(t *) &mem[%a], *(t *) &mem[%a] += %b
+#define OVMI_ATOMIC_SUB        0x5e   // %r = *(t *) &mem[%a], *(t *) &mem[%a] -= %b
+#define OVMI_ATOMIC_AND        0x5f   // %r = *(t *) &mem[%a], *(t *) &mem[%a] &= %b
+#define OVMI_ATOMIC_OR         0x60   // %r = *(t *) &mem[%a], *(t *) &mem[%a] |= %b
+#define OVMI_ATOMIC_XOR        0x61   // %r = *(t *) &mem[%a], *(t *) &mem[%a] ^= %b
+#define OVMI_ATOMIC_XCHG       0x62   // %r = *(t *) &mem[%a], *(t *) &mem[%a] = %b
+#define OVMI_ATOMIC_WAIT       0x63   // %r = <wait on mem[%r] while it equals %a, for at most %b ns>
+#define OVMI_ATOMIC_NOTIFY     0x64   // %r = <wake at most %b waiters on mem[%a]>
+#define OVMI_ATOMIC_FENCE      0x65
+
+//
+// SIMD instructions. A v128 fills an entire ovm_value_t, including the byte
+// that normally holds the type, so v128 values never carry a valid type.
+// For these instructions the type selects the lane shape instead:
+// I8 = i8x16, I16 = i16x8, I32 = i32x4, I64 = i64x2, F32 = f32x4, F64 = f64x2,
+// and V128 is used when the shape does not matter. Loads, stores and
+// immediates of v128s use the normal instructions with the V128 type;
+// `imm.v128` takes the index of a static integer array holding the bytes.
+#define OVMI_SPLAT             0x66   // %r = { %a, %a, ... }
+#define OVMI_EXTRACT           0x67   // %r = %a[b]
+#define OVMI_EXTRACT_S         0x68   // %r = %a[b] (sign extended)
+#define OVMI_REPLACE           0x69   // %r[b] = %a
+#define OVMI_SHUFFLE           0x6a   // %r = { (%a ++ %b)[%r[0]], (%a ++ %b)[%r[1]], ... }
+#define OVMI_SWIZZLE           0x6b   // %r = { %a[%b[0]], %a[%b[1]], ... }
+#define OVMI_VADD              0x6c   // %r = %a + %b
+#define OVMI_VSUB              0x6d   // %r = %a - %b
+#define OVMI_VMUL              0x6e   // %r = %a * %b
+#define OVMI_VDIV              0x6f   // %r = %a / %b
+#define OVMI_VADD_SAT          0x70   // %r = %a + %b (saturating)
+#define OVMI_VADD_SAT_S        0x71   // %r = %a + %b (saturating, sign aware)
+#define OVMI_VSUB_SAT          0x72   // %r = %a - %b (saturating)
+#define OVMI_VSUB_SAT_S        0x73   // %r = %a - %b (saturating, sign aware)
+#define OVMI_VAVGR             0x74   // %r = (%a + %b + 1) / 2
+#define OVMI_VMIN              0x75   // %r = min(%a, %b)
+#define OVMI_VMIN_S            0x76   // %r = min(%a, %b) (sign aware)
+#define OVMI_VMAX              0x77   // %r = max(%a, %b)
+#define OVMI_VMAX_S            0x78   // %r = max(%a, %b) (sign aware)
+#define OVMI_VABS              0x79   // %r = |%a|
+#define OVMI_VNEG              0x7a   // %r = -%a
+#define OVMI_VSQRT             0x7b   // %r = sqrt(%a)
+#define OVMI_VSHL              0x7c   // %r = %a << %b        // %b is a scalar
+#define OVMI_VSHR              0x7d   // %r = %a >> %b        // %b is a scalar
+#define OVMI_VSAR              0x7e   // %r = %a >>> %b       // %b is a scalar
+#define OVMI_VEQ               0x7f   // %r = %a == %b        // each lane is all 1s or all 0s
+#define OVMI_VNE               0x80   // %r = %a != %b
+#define OVMI_VLT               0x81   // %r = %a < %b
+#define OVMI_VLT_S             0x82   // %r = %a < %b
+#define OVMI_VLE               0x83   // %r = %a <= %b
+#define OVMI_VLE_S             0x84   // %r = %a <= %b
+#define OVMI_VGT               0x85   // %r = %a > %b
+#define OVMI_VGT_S             0x86   // %r = %a > %b
+#define OVMI_VGE               0x87   // %r = %a >= %b
+#define OVMI_VGE_S             0x88   // %r = %a >= %b
+#define OVMI_VNOT              0x89   // %r = ~%a
+#define OVMI_VAND              0x8a   // %r = %a & %b
+#define OVMI_VANDNOT           0x8b   // %r = %a & ~%b
+#define OVMI_VOR               0x8c   // %r = %a | %b
+#define OVMI_VXOR              0x8d   // %r = %a ^ %b
+#define OVMI_VBITSELECT        0x8e   // %r = (%a & %r) | (%b & ~%r)
+#define OVMI_VANY_TRUE         0x8f   // %r = <any lane of %a is not 0>
+#define OVMI_VALL_TRUE         0x90   // %r = <every lane of %a is not 0>
+#define OVMI_VBITMASK          0x91   // %r = <the top bit of each lane of %a>
+#define OVMI_VNARROW           0x92   // %r = <lanes of %a and %b, saturated to half width, unsigned>
+#define OVMI_VNARROW_S         0x93   // %r = <lanes of %a and %b, saturated to half width, signed>
+#define OVMI_VWIDEN_LOW        0x94   // %r = <low lanes of %a extended to double width>
+#define OVMI_VWIDEN_LOW_S      0x95   // %r = <low lanes of %a extended to double width> (sign aware)
+#define OVMI_VWIDEN_HIGH       0x96   // %r = <high lanes of %a extended to double width>
+#define OVMI_VWIDEN_HIGH_S     0x97   // %r = <high lanes of %a extended to double width> (sign aware)
+#define OVMI_VTRUNC_SAT        0x98   // %r = (u32x4) %a      // saturating
+#define OVMI_VTRUNC_SAT_S      0x99   // %r = (i32x4) %a      // saturating
+#define OVMI_VCONVERT          0x9a   // %r = (f32x4) %a      // from u32x4
+#define OVMI_VCONVERT_S        0x9b   // %r = (f32x4) %a      // from i32x4
+
 //
 // OVM_TYPED_INSTR(OVMI_ADD, OVM_TYPE_I32) == instruction for adding i32s
 //
@@ -366,6 +537,7 @@ struct ovm_instr_t {
 
 
 void ovm_disassemble(ovm_program_t *program, u32 instr_addr, bh_buffer *instr_text);
+u64  ovm_instr_table_hash(u64 hash);
 
 #endif
 
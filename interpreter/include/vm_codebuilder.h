@@ -5,6 +5,7 @@
 #include "ovm_debug.h"
 
 typedef struct ovm_code_builder_t ovm_code_builder_t;
+typedef struct stack_value_t stack_value_t;
 typedef struct label_target_t label_target_t;
 typedef struct branch_patch_t branch_patch_t;
 typedef enum label_kind_t label_kind_t;
@@ -13,12 +14,18 @@ typedef enum label_kind_t label_kind_t;
 // A new code builder will be "made" for each function
 // being compiled.
 struct ovm_code_builder_t {
-    bh_arr(i32) execution_stack;
+    bh_arr(stack_value_t) execution_stack;
 
     i32 next_label_idx;
     bh_arr(label_target_t) label_stack;
     bh_arr(branch_patch_t) branch_patches;
 
+    //
+    // The first instruction that could be reached from somewhere other
+    // than the instruction before it. Instructions before this cannot
+    // be rewritten when folding temporaries into locals.
+    i32 last_label_instr;
+
     i32 param_count, result_count, local_count;
 
     ovm_program_t *program;
@@ -30,6 +37,16 @@ struct ovm_code_builder_t {
     debug_info_builder_t *debug_builder;
 };
 
+//
+// Every slot on the WASM execution stack is mapped to a value number.
+// For slots that hold temporaries, the instruction that produced the
+// value is remembered so a later `local.set` can retarget it directly.
+struct stack_value_t {
+    i32 value;
+    i32 def_instr;  // -1 if the defining instruction cannot be retargeted.
+    i32 high_water; // Highest temporary value number live at or below this slot.
+};
+
 enum label_kind_t {
     label_kind_func,
     label_kind_block,
@@ -86,7 +103,16 @@ void               ovm_code_builder_add_load(ovm_code_builder_t *builder, u32 ov
 void               ovm_code_builder_add_store(ovm_code_builder_t *builder, u32 ovm_type, i32 offset);
 void               ovm_code_builder_add_atomic_load(ovm_code_builder_t *builder, u32 ovm_type, i32 offset);
 void               ovm_code_builder_add_atomic_store(ovm_code_builder_t *builder, u32 ovm_type, i32 offset);
+void               ovm_code_builder_add_atomic_rmw(ovm_code_builder_t *builder, u32 instr, u32 ovm_type, i32 offset);
 void               ovm_code_builder_add_cmpxchg(ovm_code_builder_t *builder, u32 ovm_type, i32 offset);
+void               ovm_code_builder_add_atomic_wait(ovm_code_builder_t *builder, u32 ovm_type, i32 offset);
+void               ovm_code_builder_add_atomic_notify(ovm_code_builder_t *builder, i32 offset);
+void               ovm_code_builder_add_atomic_fence(ovm_code_builder_t *builder);
+void               ovm_code_builder_add_v128_imm(ovm_code_builder_t *builder, u8 *bytes);
+void               ovm_code_builder_add_extract_lane(ovm_code_builder_t *builder, u32 instr, i32 lane);
+void               ovm_code_builder_add_replace_lane(ovm_code_builder_t *builder, u32 instr, i32 lane);
+void               ovm_code_builder_add_shuffle(ovm_code_builder_t *builder, u8 *lanes);
+void               ovm_code_builder_add_bitselect(ovm_code_builder_t *builder);
 void               ovm_code_builder_add_memory_copy(ovm_code_builder_t *builder);
 void               ovm_code_builder_add_memory_fill(ovm_code_builder_t *builder);
 void               ovm_code_builder_add_memory_size(ovm_code_builder_t *builder);
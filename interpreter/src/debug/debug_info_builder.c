@@ -136,6 +136,10 @@ void debug_info_builder_emit_location(debug_info_builder_t *builder) {
     bh_arr_push(builder->info->instruction_reducer, bh_arr_length(builder->info->line_info) - 1);
 }
 
+void debug_info_builder_remove_last_location(debug_info_builder_t *builder) {
+    bh_arr_pop(builder->info->instruction_reducer);
+}
+
 void debug_info_builder_begin_func(debug_info_builder_t *builder, i32 func_idx) {
     if (!builder->data) return;
     if (func_idx >= bh_arr_length(builder->info->funcs)) return;
@@ -5,35 +5,195 @@
 // #define BUILDER_DEBUG
 
 #if defined(BUILDER_DEBUG)
-    #define POP_VALUE(b)     (bh_arr_length((b)->execution_stack) == 0 ? (assert(0 && "invalid value pop"), 0) : bh_arr_pop((b)->execution_stack))
+    #define POP_VALUE(b)     (bh_arr_length((b)->execution_stack) == 0 ? (assert(0 && "invalid value pop"), 0) : bh_arr_pop((b)->execution_stack).value)
 #else
-    #define POP_VALUE(b) bh_arr_pop((b)->execution_stack)
+    #define POP_VALUE(b) bh_arr_pop((b)->execution_stack).value
 #endif
 
-#define PUSH_VALUE(b, r) (bh_arr_push((b)->execution_stack, r))
+#define POP_ENTRY(b) bh_arr_pop((b)->execution_stack)
 
-#define LAST_VALUE(b) bh_arr_last((b)->execution_stack)
+#define PUSH_VALUE(b, r) (push_value((b), (r), -1))
+
+// Pushes a value that was just written by the last instruction in the program.
+#define PUSH_DEFINED_VALUE(b, r) (push_value((b), (r), bh_arr_length((b)->program->code) - 1))
+
+#define LAST_VALUE(b) bh_arr_last((b)->execution_stack).value
 
 #define IS_TEMPORARY_VALUE(b, r) (r >= (b->param_count + b->local_count))
 
+static inline i32 high_water_below(ovm_code_builder_t *b, i32 slot) {
+    if (slot <= 0) return b->param_count + b->local_count - 1;
+    return b->execution_stack[slot - 1].high_water;
+}
+
+static inline void push_value(ovm_code_builder_t *b, i32 value, i32 def_instr) {
+    stack_value_t entry;
+    entry.value = value;
+    entry.def_instr = def_instr;
+    entry.high_water = high_water_below(b, bh_arr_length(b->execution_stack));
+    if (IS_TEMPORARY_VALUE(b, value)) entry.high_water = bh_max(entry.high_water, value);
+
+    bh_arr_push(b->execution_stack, entry);
+}
+
+//
+// The temporaries live on the execution stack always form a prefix of the
+// temporary value numbers, so the next free value number is one past the
+// highest temporary still on the stack. Value numbers above that are dead
+// and get reused, which keeps frames as small as the deepest stack needs.
 static inline int NEXT_VALUE(ovm_code_builder_t *b) {
 #if defined(BUILDER_DEBUG)
     b->highest_value_number += 1;
     return b->highest_value_number - 1;
 
 #else
-    if (bh_arr_length(b->execution_stack) == 0) {
-        return b->param_count + b->local_count;
+    i32 next = high_water_below(b, bh_arr_length(b->execution_stack)) + 1;
+
+    b->highest_value_number = bh_max(b->highest_value_number, next);
+    return next;
+#endif
+}
+
+//
+// Superinstruction fusion
+//
+// Common instruction sequences are fused into a single instruction as they
+// are emitted, so the interpreter pays for one dispatch instead of two.
+// A sequence can only be fused if the value passed between the two halves
+// is a temporary that was produced by the last instruction, and nothing
+// can branch to the instruction being removed.
+//
+
+static inline i32 last_fusable_instr(ovm_code_builder_t *b) {
+    i32 last = bh_arr_length(b->program->code) - 1;
+    if (last < b->last_label_instr) return -1;
+    return last;
+}
+
+static void remove_last_instruction(ovm_code_builder_t *b) {
+    bh_arr_pop(b->program->code);
+    debug_info_builder_remove_last_location(b->debug_builder);
+}
+
+//
+// imm %t, c; add %r, %a, %t    ->   addi %r, %a, c
+// imm %t, c; sub %r, %a, %t    ->   addi %r, %a, -c
+static bool try_fuse_add_immediate(ovm_code_builder_t *b, ovm_instr_t *binop, stack_value_t left, stack_value_t right) {
+    i32 op   = OVM_INSTR_INSTR(*binop);
+    i32 type = OVM_INSTR_TYPE(*binop);
+    if (op != OVMI_ADD && op != OVMI_SUB) return false;
+    if (type != OVM_TYPE_I32 && type != OVM_TYPE_I64) return false;
+
+    i32 last = last_fusable_instr(b);
+    if (last < 0) return false;
+
+    ovm_instr_t *imm = &b->program->code[last];
+    if (imm->full_instr != OVM_TYPED_INSTR(OVMI_IMM, type)) return false;
+
+    i32 other;
+    if (right.def_instr == last) {
+        other = left.value;
+    } else if (left.def_instr == last && op == OVMI_ADD) {
+        other = right.value;
+    } else {
+        return false;
+    }
+
+    i32 value;
+    if (type == OVM_TYPE_I32) {
+        value = imm->i;
+        if (op == OVMI_SUB) value = (i32) (0u - (u32) value);
+    } else {
+        i64 wide = imm->l;
+        if (op == OVMI_SUB) {
+            if (wide == INT64_MIN) return false;
+            wide = -wide;
+        }
+
+        if (wide < INT32_MIN || wide > INT32_MAX) return false;
+        value = (i32) wide;
     }
 
-    i32 max = b->param_count + b->local_count;
-    bh_arr_each(i32, reg, b->execution_stack) {
-        max = bh_max(*reg, max);
+    remove_last_instruction(b);
+
+    binop->full_instr = OVM_TYPED_INSTR(OVMI_ADDI, type);
+    binop->a = other;
+    binop->b = value;
+    return true;
+}
+
+//
+// addi %t, %a, c; load %r, [%t + o]    ->   load %r, [%a + c+o]
+//
+// The same applies to stores. Both the add and the address computation
+// of loads and stores wrap at 32-bits, so the offsets can simply be summed.
+static void try_fold_address_immediate(ovm_code_builder_t *b, stack_value_t addr, i32 *addr_reg, i32 *offset) {
+    i32 last = last_fusable_instr(b);
+    if (last < 0 || addr.def_instr != last) return;
+
+    ovm_instr_t *addi = &b->program->code[last];
+    if (addi->full_instr != OVM_TYPED_INSTR(OVMI_ADDI, OVM_TYPE_I32)) return;
+
+    *addr_reg = addi->a;
+    *offset   = (i32) ((u32) *offset + (u32) addi->b);
+
+    remove_last_instruction(b);
+}
+
+//
+// lt %t, %a, %b; br_nz L, %t    ->   br_lt L, %a, %b
+// lt %t, %a, %b; br_z  L, %t    ->   br_ge L, %a, %b
+// eqz %t, %a;    br_z  L, %t    ->   br_nz L, %a
+//
+// Branching when a comparison is false is only fused for integers, as the
+// negated comparison is not equivalent for floats when NaNs are involved.
+static bool try_fuse_compare_branch(ovm_code_builder_t *b, stack_value_t cond, bool branch_if_true, ovm_instr_t *branch) {
+    i32 last = last_fusable_instr(b);
+    if (last < 0 || cond.def_instr != last) return false;
+
+    ovm_instr_t cmp = b->program->code[last];
+    i32 op   = OVM_INSTR_INSTR(cmp);
+    i32 type = OVM_INSTR_TYPE(cmp);
+    if (op < OVMI_LT || op > OVMI_NE) return false;
+
+    //
+    // `i32.eqz` is emitted as an immediate 0 and an equality check.
+    if (op == OVMI_EQ && type == OVM_TYPE_I32 && last - 1 >= b->last_label_instr) {
+        ovm_instr_t *imm = &b->program->code[last - 1];
+        if (imm->full_instr == OVM_TYPED_INSTR(OVMI_IMM, OVM_TYPE_I32) && imm->i == 0
+            && imm->r == cmp.b && imm->r != cmp.a && IS_TEMPORARY_VALUE(b, imm->r)) {
+            remove_last_instruction(b);
+            remove_last_instruction(b);
+
+            branch->full_instr = OVM_TYPED_INSTR(branch_if_true ? OVMI_BR_Z : OVMI_BR_NZ, OVM_TYPE_NONE);
+            branch->b = cmp.a;
+            return true;
+        }
     }
 
-    b->highest_value_number = bh_max(b->highest_value_number, max + 1);
-    return max + 1;
-#endif
+    if (!branch_if_true) {
+        if (type != OVM_TYPE_I32 && type != OVM_TYPE_I64) return false;
+
+        switch (op) {
+            case OVMI_LT:   op = OVMI_GE;   break;
+            case OVMI_LT_S: op = OVMI_GE_S; break;
+            case OVMI_LE:   op = OVMI_GT;   break;
+            case OVMI_LE_S: op = OVMI_GT_S; break;
+            case OVMI_EQ:   op = OVMI_NE;   break;
+            case OVMI_GE:   op = OVMI_LT;   break;
+            case OVMI_GE_S: op = OVMI_LT_S; break;
+            case OVMI_GT:   op = OVMI_LE;   break;
+            case OVMI_GT_S: op = OVMI_LE_S; break;
+            case OVMI_NE:   op = OVMI_EQ;   break;
+        }
+    }
+
+    remove_last_instruction(b);
+
+    branch->full_instr = OVM_TYPED_INSTR(OVMI_BR_LT + (op - OVMI_LT), type);
+    branch->r = cmp.a;
+    branch->b = cmp.b;
+    return true;
 }
 
 ovm_code_builder_t ovm_code_builder_new(ovm_program_t *program, debug_info_builder_t *debug, i32 param_count, i32 result_count, i32 local_count) {
@@ -48,6 +208,7 @@ ovm_code_builder_t ovm_code_builder_new(ovm_program_t *program, debug_info_build
     bh_arr_new(bh_heap_allocator(), builder.execution_stack, 32);
 
     builder.next_label_idx = 0;
+    builder.last_label_instr = builder.start_instr;
     builder.label_stack = NULL;
     builder.branch_patches = NULL;
     bh_arr_new(bh_heap_allocator(), builder.label_stack, 32);
@@ -81,6 +242,7 @@ i32 ovm_code_builder_push_label_target(ovm_code_builder_t *builder, label_kind_t
 
     if (kind == label_kind_loop) {
         target.instr = bh_arr_length(builder->program->code);
+        builder->last_label_instr = target.instr;
     }
 
     bh_arr_push(builder->label_stack, target);
@@ -94,6 +256,8 @@ void ovm_code_builder_pop_label_target(ovm_code_builder_t *builder) {
         target.instr = bh_arr_length(builder->program->code);
     }
 
+    builder->last_label_instr = bh_arr_length(builder->program->code);
+
     fori (i, 0, bh_arr_length(builder->branch_patches)) {
         branch_patch_t patch = builder->branch_patches[i];
         if (patch.label_idx != target.idx) continue;
@@ -131,6 +295,8 @@ void ovm_code_builder_patch_else(ovm_code_builder_t *builder, label_target_t if_
         int br_delta = bh_arr_length(builder->program->code) - patch.branch_instr - 1;
         assert(patch.kind == branch_patch_instr_a);
 
+        builder->last_label_instr = bh_arr_length(builder->program->code);
+
         builder->program->code[patch.branch_instr].a = br_delta;
 
         bh_arr_fastdelete(builder->branch_patches, i);
@@ -166,19 +332,22 @@ void ovm_code_builder_add_break(ovm_code_builder_t *builder) {
 }
 
 void ovm_code_builder_add_binop(ovm_code_builder_t *builder, u32 instr) {
-    i32 right  = POP_VALUE(builder);
-    i32 left   = POP_VALUE(builder);
+    stack_value_t right = POP_ENTRY(builder);
+    stack_value_t left  = POP_ENTRY(builder);
     i32 result = NEXT_VALUE(builder);
 
     ovm_instr_t binop;
     binop.full_instr = instr;
     binop.r = result;
-    binop.a = left;
-    binop.b = right;
+
+    if (!try_fuse_add_immediate(builder, &binop, left, right)) {
+        binop.a = left.value;
+        binop.b = right.value;
+    }
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &binop);
-    PUSH_VALUE(builder, result);
+    PUSH_DEFINED_VALUE(builder, result);
 }
 
 void ovm_code_builder_add_imm(ovm_code_builder_t *builder, u32 ovm_type, void *imm) {
@@ -198,7 +367,7 @@ void ovm_code_builder_add_imm(ovm_code_builder_t *builder, u32 ovm_type, void *i
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &imm_instr);
-    PUSH_VALUE(builder, imm_instr.r);
+    PUSH_DEFINED_VALUE(builder, imm_instr.r);
 }
 
 void ovm_code_builder_add_unop(ovm_code_builder_t *builder, u32 instr) {
@@ -211,7 +380,7 @@ void ovm_code_builder_add_unop(ovm_code_builder_t *builder, u32 instr) {
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &unop);
-    PUSH_VALUE(builder, unop.r);
+    PUSH_DEFINED_VALUE(builder, unop.r);
 }
 
 void ovm_code_builder_add_branch(ovm_code_builder_t *builder, i32 label_idx) {
@@ -233,14 +402,19 @@ void ovm_code_builder_add_branch(ovm_code_builder_t *builder, i32 label_idx) {
 
 void ovm_code_builder_add_cond_branch(ovm_code_builder_t *builder, i32 label_idx, bool branch_if_true, bool targets_else) {
     ovm_instr_t branch_instr = {0};
-    if (branch_if_true) {
-        branch_instr.full_instr = OVM_TYPED_INSTR(OVMI_BR_NZ, OVM_TYPE_NONE);
-    } else {
-        branch_instr.full_instr = OVM_TYPED_INSTR(OVMI_BR_Z, OVM_TYPE_NONE);
+    stack_value_t cond = POP_ENTRY(builder);
+
+    if (!try_fuse_compare_branch(builder, cond, branch_if_true, &branch_instr)) {
+        if (branch_if_true) {
+            branch_instr.full_instr = OVM_TYPED_INSTR(OVMI_BR_NZ, OVM_TYPE_NONE);
+        } else {
+            branch_instr.full_instr = OVM_TYPED_INSTR(OVMI_BR_Z, OVM_TYPE_NONE);
+        }
+
+        branch_instr.b = cond.value;
     }
 
     branch_instr.a = -1;
-    branch_instr.b = POP_VALUE(builder);
 
     branch_patch_t patch;
     patch.kind = branch_patch_instr_a;
@@ -361,7 +535,7 @@ void ovm_code_builder_add_call(ovm_code_builder_t *builder, i32 func_idx, i32 pa
     ovm_program_add_instructions(builder->program, 1, &call_instr);
 
     if (has_return_value) {
-        PUSH_VALUE(builder, call_instr.r);
+        PUSH_DEFINED_VALUE(builder, call_instr.r);
     }
 }
 
@@ -389,12 +563,99 @@ void ovm_code_builder_add_indirect_call(ovm_code_builder_t *builder, i32 param_c
     ovm_program_add_instructions(builder->program, 2, call_instrs);
 
     if (has_return_value) {
-        PUSH_VALUE(builder, call_instrs[1].r);
+        PUSH_DEFINED_VALUE(builder, call_instrs[1].r);
+    }
+}
+
+//
+// Instructions that only compute a value into %r, without side effects
+// or the possibility of trapping. These can be deleted if their result
+// is never used.
+static bool instr_is_pure(ovm_instr_t *instr) {
+    switch (OVM_INSTR_INSTR(*instr)) {
+        case OVMI_ADD: case OVMI_SUB: case OVMI_MUL:
+        case OVMI_AND: case OVMI_OR:  case OVMI_XOR:
+        case OVMI_SHL: case OVMI_SHR: case OVMI_SAR:
+        case OVMI_IMM: case OVMI_MOV: case OVMI_REG_GET: case OVMI_ADDI:
+        case OVMI_LT: case OVMI_LT_S: case OVMI_LE: case OVMI_LE_S: case OVMI_EQ:
+        case OVMI_GE: case OVMI_GE_S: case OVMI_GT: case OVMI_GT_S: case OVMI_NE:
+        case OVMI_CLZ: case OVMI_CTZ: case OVMI_POPCNT: case OVMI_ROTL: case OVMI_ROTR:
+        case OVMI_MEM_SIZE:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+//
+// Instructions that can transfer control somewhere other than the next
+// instruction. A write to a local cannot be moved across one of these.
+static bool instr_is_barrier(ovm_instr_t *instr) {
+    switch (OVM_INSTR_INSTR(*instr)) {
+        case OVMI_RETURN:
+        case OVMI_BR: case OVMI_BR_Z: case OVMI_BR_NZ:
+        case OVMI_BRI: case OVMI_BRI_Z: case OVMI_BRI_NZ:
+        case OVMI_BR_LT: case OVMI_BR_LT_S: case OVMI_BR_LE: case OVMI_BR_LE_S: case OVMI_BR_EQ:
+        case OVMI_BR_GE: case OVMI_BR_GE_S: case OVMI_BR_GT: case OVMI_BR_GT_S: case OVMI_BR_NE:
+        case OVMI_BREAK:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool instr_uses_value(ovm_instr_t *instr, i32 value) {
+    switch (OVM_INSTR_INSTR(*instr)) {
+        case OVMI_NOP: case OVMI_BREAK: case OVMI_BR:
+            return false;
+
+        case OVMI_IMM: case OVMI_REG_GET: case OVMI_MEM_SIZE:
+            return instr->r == value;
+
+        case OVMI_CALL:
+            return instr->r == value;
+
+        case OVMI_IDX_ARR:
+            return instr->r == value || instr->b == value;
+
+        case OVMI_LOAD: case OVMI_ADDI:
+            return instr->r == value || instr->a == value;
+
+        case OVMI_REG_SET: case OVMI_PARAM: case OVMI_RETURN: case OVMI_BRI:
+            return instr->a == value;
+
+        case OVMI_BR_Z: case OVMI_BR_NZ:
+            return instr->b == value;
+
+        case OVMI_BR_LT: case OVMI_BR_LT_S: case OVMI_BR_LE: case OVMI_BR_LE_S: case OVMI_BR_EQ:
+        case OVMI_BR_GE: case OVMI_BR_GE_S: case OVMI_BR_GT: case OVMI_BR_GT_S: case OVMI_BR_NE:
+            return instr->r == value || instr->b == value;
+
+        case OVMI_STORE:
+            return instr->r == value || instr->a == value;
+
+        case OVMI_BRI_Z: case OVMI_BRI_NZ:
+            return instr->a == value || instr->b == value;
+
+        default:
+            return instr->r == value || instr->a == value || instr->b == value;
     }
 }
 
 void ovm_code_builder_drop_value(ovm_code_builder_t *builder) {
-    POP_VALUE(builder);
+    stack_value_t dropped = bh_arr_pop(builder->execution_stack);
+
+    //
+    // If the dropped value was computed by the last instruction and nothing
+    // can branch to that instruction, it is dead and can be removed entirely.
+    i32 last_instr_idx = last_fusable_instr(builder);
+    if (last_instr_idx >= 0 && dropped.def_instr == last_instr_idx) {
+        if (instr_is_pure(&builder->program->code[last_instr_idx])) {
+            remove_last_instruction(builder);
+        }
+    }
 }
 
 void ovm_code_builder_add_local_get(ovm_code_builder_t *builder, i32 local_idx) {
@@ -403,8 +664,8 @@ void ovm_code_builder_add_local_get(ovm_code_builder_t *builder, i32 local_idx)
 
 static void maybe_copy_register_if_going_to_be_replaced(ovm_code_builder_t *builder, i32 local_idx) {
     b32 need_to_copy = 0;
-    bh_arr_each(i32, reg, builder->execution_stack) {
-        if (*reg == local_idx) {
+    bh_arr_each(stack_value_t, entry, builder->execution_stack) {
+        if (entry->value == local_idx) {
             need_to_copy = 1;
             break;
         }
@@ -421,21 +682,48 @@ static void maybe_copy_register_if_going_to_be_replaced(ovm_code_builder_t *buil
         debug_info_builder_emit_location(builder->debug_builder);
         ovm_program_add_instructions(builder->program, 1, &instr);
 
-        bh_arr_each(i32, reg, builder->execution_stack) {
-            if (*reg == local_idx) {
-                *reg = new_register;
+        fori (i, 0, bh_arr_length(builder->execution_stack)) {
+            stack_value_t *entry = &builder->execution_stack[i];
+            if (entry->value == local_idx) {
+                entry->value = new_register;
+                entry->def_instr = -1;
+            }
+
+            entry->high_water = high_water_below(builder, i);
+            if (IS_TEMPORARY_VALUE(builder, entry->value)) {
+                entry->high_water = bh_max(entry->high_water, entry->value);
             }
         }
     }
 }
 
+//
+// Tries to make the instruction that computed the temporary on the top of
+// the stack write directly into `local_idx`, instead of emitting a MOV.
+// This is valid as long as every path from that instruction to here is
+// straight-line code that does not otherwise touch the local.
+static bool try_fold_into_local(ovm_code_builder_t *builder, i32 local_idx) {
+    stack_value_t top = bh_arr_last(builder->execution_stack);
+    if (top.def_instr < 0 || top.def_instr < builder->last_label_instr) return false;
+    if (!IS_TEMPORARY_VALUE(builder, top.value)) return false;
+
+    ovm_instr_t *code = builder->program->code;
+    if (code[top.def_instr].r != top.value) return false;
+
+    fori (i, top.def_instr + 1, bh_arr_length(code)) {
+        if (instr_is_barrier(&code[i]))           return false;
+        if (instr_uses_value(&code[i], local_idx)) return false;
+    }
+
+    code[top.def_instr].r = local_idx;
+    return true;
+}
+
 void ovm_code_builder_add_local_set(ovm_code_builder_t *builder, i32 local_idx) {
     maybe_copy_register_if_going_to_be_replaced(builder, local_idx);
 
     // :PrimitiveOptimization
-    ovm_instr_t *last_instr = &bh_arr_last(builder->program->code);
-    if (IS_TEMPORARY_VALUE(builder, last_instr->r) && last_instr->r == LAST_VALUE(builder)) {
-        last_instr->r = local_idx;
+    if (try_fold_into_local(builder, local_idx)) {
         POP_VALUE(builder);
         return;
     }
@@ -467,14 +755,15 @@ void ovm_code_builder_add_register_get(ovm_code_builder_t *builder, i32 reg_idx)
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &instr);
 
-    PUSH_VALUE(builder, instr.r);
+    PUSH_DEFINED_VALUE(builder, instr.r);
 }
 
 void ovm_code_builder_add_register_set(ovm_code_builder_t *builder, i32 reg_idx) {
     // :PrimitiveOptimization
     {
-        ovm_instr_t *last_instr = &bh_arr_last(builder->program->code);
-        if (OVM_INSTR_INSTR(*last_instr) == OVMI_MOV) {
+        i32 last_instr_idx = bh_arr_length(builder->program->code) - 1;
+        ovm_instr_t *last_instr = &builder->program->code[last_instr_idx];
+        if (last_instr_idx >= builder->last_label_instr && OVM_INSTR_INSTR(*last_instr) == OVMI_MOV) {
             if (IS_TEMPORARY_VALUE(builder, last_instr->r) && last_instr->r == LAST_VALUE(builder)) {
 
                 last_instr->full_instr = OVM_TYPED_INSTR(OVMI_REG_SET, OVM_TYPE_NONE);
@@ -499,13 +788,17 @@ void ovm_code_builder_add_load(ovm_code_builder_t *builder, u32 ovm_type, i32 of
     ovm_instr_t load_instr = {0};
     load_instr.full_instr = OVM_TYPED_INSTR(OVMI_LOAD, ovm_type);
     load_instr.b = offset;
-    load_instr.a = POP_VALUE(builder);
+
+    stack_value_t addr = POP_ENTRY(builder);
+    load_instr.a = addr.value;
+    try_fold_address_immediate(builder, addr, &load_instr.a, &load_instr.b);
+
     load_instr.r = NEXT_VALUE(builder);
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &load_instr);
 
-    PUSH_VALUE(builder, load_instr.r);
+    PUSH_DEFINED_VALUE(builder, load_instr.r);
 }
 
 void ovm_code_builder_add_store(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
@@ -513,62 +806,16 @@ void ovm_code_builder_add_store(ovm_code_builder_t *builder, u32 ovm_type, i32 o
     store_instr.full_instr = OVM_TYPED_INSTR(OVMI_STORE, ovm_type);
     store_instr.b = offset;
     store_instr.a = POP_VALUE(builder);
-    store_instr.r = POP_VALUE(builder);
+
+    stack_value_t addr = POP_ENTRY(builder);
+    store_instr.r = addr.value;
+    try_fold_address_immediate(builder, addr, &store_instr.r, &store_instr.b);
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &store_instr);
     return;
 }
 
-void ovm_code_builder_add_cmpxchg(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
-    // This is an optimization for a 0 offset that could come back, but since CMPXCHG is
-    // not a common instruction (I think it is used in one place in the entire standard library),
-    // it does not make much of a difference.
-    //
-    // if (offset == 0) {
-    //     ovm_instr_t cmpxchg_instr = {0};
-    //     cmpxchg_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_CMPXCHG, ovm_type);
-    //     cmpxchg_instr.b = POP_VALUE(builder);
-    //     cmpxchg_instr.a = POP_VALUE(builder);
-    //     cmpxchg_instr.r = POP_VALUE(builder);
-
-    //     debug_info_builder_emit_location(builder->debug_builder);
-    //     ovm_program_add_instructions(builder->program, 1, &cmpxchg_instr);
-
-    //     PUSH_VALUE(builder, cmpxchg_instr.r);
-    //     return;
-    // }
-
-    ovm_instr_t instrs[3] = {0};
-    // imm.i32 %n, offset
-    instrs[0].full_instr = OVM_TYPED_INSTR(OVMI_IMM, OVM_TYPE_I32);
-    instrs[0].i = offset;
-    instrs[0].r = NEXT_VALUE(builder);
-
-    int value_reg = POP_VALUE(builder);
-    int expected_reg = POP_VALUE(builder);
-    int addr_reg = POP_VALUE(builder);
-
-    // add.i32 %n, %n, %i
-    instrs[1].full_instr = OVM_TYPED_INSTR(OVMI_ADD, OVM_TYPE_I32);
-    instrs[1].r = instrs[0].r;
-    instrs[1].a = addr_reg;
-    instrs[1].b = instrs[0].r;
-
-    // cmpxchg.x %n, %e, %v
-    instrs[2].full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_CMPXCHG, ovm_type);
-    instrs[2].r = instrs[1].r;
-    instrs[2].a = expected_reg;
-    instrs[2].b = value_reg;
-
-    debug_info_builder_emit_location(builder->debug_builder);
-    debug_info_builder_emit_location(builder->debug_builder);
-    debug_info_builder_emit_location(builder->debug_builder);
-    ovm_program_add_instructions(builder->program, 3, instrs);
-
-    PUSH_VALUE(builder, instrs[2].r);
-}
-
 void ovm_code_builder_add_memory_size(ovm_code_builder_t *builder) {
     ovm_instr_t instr = {0};
     instr.full_instr = OVM_TYPED_INSTR(OVMI_MEM_SIZE, OVM_TYPE_NONE);
@@ -577,7 +824,7 @@ void ovm_code_builder_add_memory_size(ovm_code_builder_t *builder) {
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &instr);
 
-    PUSH_VALUE(builder, instr.r);
+    PUSH_DEFINED_VALUE(builder, instr.r);
 }
 
 void ovm_code_builder_add_memory_grow(ovm_code_builder_t *builder) {
@@ -589,7 +836,7 @@ void ovm_code_builder_add_memory_grow(ovm_code_builder_t *builder) {
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &instr);
 
-    PUSH_VALUE(builder, instr.r);
+    PUSH_DEFINED_VALUE(builder, instr.r);
 }
 
 void ovm_code_builder_add_memory_copy(ovm_code_builder_t *builder) {
@@ -618,26 +865,215 @@ void ovm_code_builder_add_memory_fill(ovm_code_builder_t *builder) {
 // CopyNPaste from _add_load
 void ovm_code_builder_add_atomic_load(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
     ovm_instr_t load_instr = {0};
-    load_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_LOAD, ovm_type);
+    load_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_ATOMIC_LOAD, ovm_type);
     load_instr.b = offset;
-    load_instr.a = POP_VALUE(builder);
+
+    stack_value_t addr = POP_ENTRY(builder);
+    load_instr.a = addr.value;
+    try_fold_address_immediate(builder, addr, &load_instr.a, &load_instr.b);
+
     load_instr.r = NEXT_VALUE(builder);
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &load_instr);
 
-    PUSH_VALUE(builder, load_instr.r);
+    PUSH_DEFINED_VALUE(builder, load_instr.r);
 }
 
 //
 // CopyNPaste from _add_store
 void ovm_code_builder_add_atomic_store(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
     ovm_instr_t store_instr = {0};
-    store_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_STORE, ovm_type);
+    store_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_ATOMIC_STORE, ovm_type);
     store_instr.b = offset;
     store_instr.a = POP_VALUE(builder);
-    store_instr.r = POP_VALUE(builder);
+
+    stack_value_t addr = POP_ENTRY(builder);
+    store_instr.r = addr.value;
+    try_fold_address_immediate(builder, addr, &store_instr.r, &store_instr.b);
 
     debug_info_builder_emit_location(builder->debug_builder);
     ovm_program_add_instructions(builder->program, 1, &store_instr);
 }
+
+//
+// The remaining atomic instructions have no room for a static offset, so it is
+// added to the address with an addi first. The destination of the addi is
+// allocated before the operands are popped, so it can never alias one of them.
+static void emit_atomic_address(ovm_code_builder_t *builder, i32 dest, i32 addr_reg, i32 offset) {
+    ovm_instr_t addi_instr = {0};
+    addi_instr.full_instr = OVM_TYPED_INSTR(OVMI_ADDI, OVM_TYPE_I32);
+    addi_instr.r = dest;
+    addi_instr.a = addr_reg;
+    addi_instr.b = offset;
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &addi_instr);
+}
+
+// %r = op(mem[%a], %b)
+static void add_atomic_binary(ovm_code_builder_t *builder, u32 instr, u32 ovm_type, i32 offset) {
+    i32 addr_tmp = offset != 0 ? NEXT_VALUE(builder) : -1;
+
+    ovm_instr_t atomic_instr = {0};
+    atomic_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(instr, ovm_type);
+    atomic_instr.b = POP_VALUE(builder);
+    atomic_instr.a = POP_VALUE(builder);
+
+    if (offset != 0) {
+        emit_atomic_address(builder, addr_tmp, atomic_instr.a, offset);
+        atomic_instr.a = addr_tmp;
+    }
+
+    atomic_instr.r = NEXT_VALUE(builder);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &atomic_instr);
+
+    PUSH_DEFINED_VALUE(builder, atomic_instr.r);
+}
+
+// %r = op(mem[%r], %a, %b)
+//
+// The address register is also the result, so it is always copied into a
+// fresh temporary first; it might otherwise be a local. For the same reason
+// the result can never be retargeted into a local by a later `local.set`.
+static void add_atomic_ternary(ovm_code_builder_t *builder, u32 instr, u32 ovm_type, i32 offset) {
+    ovm_instr_t atomic_instr = {0};
+    atomic_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(instr, ovm_type);
+    atomic_instr.r = NEXT_VALUE(builder);
+    atomic_instr.b = POP_VALUE(builder);
+    atomic_instr.a = POP_VALUE(builder);
+
+    emit_atomic_address(builder, atomic_instr.r, POP_VALUE(builder), offset);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &atomic_instr);
+
+    PUSH_VALUE(builder, atomic_instr.r);
+}
+
+void ovm_code_builder_add_atomic_rmw(ovm_code_builder_t *builder, u32 instr, u32 ovm_type, i32 offset) {
+    add_atomic_binary(builder, instr, ovm_type, offset);
+}
+
+void ovm_code_builder_add_cmpxchg(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
+    add_atomic_ternary(builder, OVMI_CMPXCHG, ovm_type, offset);
+}
+
+void ovm_code_builder_add_atomic_wait(ovm_code_builder_t *builder, u32 ovm_type, i32 offset) {
+    add_atomic_ternary(builder, OVMI_ATOMIC_WAIT, ovm_type, offset);
+}
+
+void ovm_code_builder_add_atomic_notify(ovm_code_builder_t *builder, i32 offset) {
+    add_atomic_binary(builder, OVMI_ATOMIC_NOTIFY, OVM_TYPE_NONE, offset);
+}
+
+void ovm_code_builder_add_atomic_fence(ovm_code_builder_t *builder) {
+    ovm_instr_t fence_instr = {0};
+    fence_instr.full_instr = OVMI_ATOMIC | OVM_TYPED_INSTR(OVMI_ATOMIC_FENCE, OVM_TYPE_NONE);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &fence_instr);
+}
+
+//
+// SIMD
+//
+// Most SIMD instructions are plain unary or binary operations and go
+// through _add_unop and _add_binop. The ones below also read %r as an
+// input, so like the atomic ternaries, their result is allocated before the
+// operands are popped and can never be retargeted into a local.
+//
+
+void ovm_code_builder_add_v128_imm(ovm_code_builder_t *builder, u8 *bytes) {
+    i32 data[4];
+    memcpy(data, bytes, 16);
+
+    ovm_instr_t imm_instr = {0};
+    imm_instr.full_instr = OVM_TYPED_INSTR(OVMI_IMM, OVM_TYPE_V128);
+    imm_instr.r = NEXT_VALUE(builder);
+    imm_instr.a = ovm_program_register_static_ints(builder->program, 4, data);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &imm_instr);
+    PUSH_DEFINED_VALUE(builder, imm_instr.r);
+}
+
+void ovm_code_builder_add_extract_lane(ovm_code_builder_t *builder, u32 instr, i32 lane) {
+    ovm_instr_t extract_instr = {0};
+    extract_instr.full_instr = instr;
+    extract_instr.a = POP_VALUE(builder);
+    extract_instr.b = lane;
+    extract_instr.r = NEXT_VALUE(builder);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &extract_instr);
+    PUSH_DEFINED_VALUE(builder, extract_instr.r);
+}
+
+static void emit_mov(ovm_code_builder_t *builder, i32 dest, i32 src) {
+    ovm_instr_t mov_instr = {0};
+    mov_instr.full_instr = OVM_TYPED_INSTR(OVMI_MOV, OVM_TYPE_NONE);
+    mov_instr.r = dest;
+    mov_instr.a = src;
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &mov_instr);
+}
+
+// %r = %vec; %r[lane] = %a
+void ovm_code_builder_add_replace_lane(ovm_code_builder_t *builder, u32 instr, i32 lane) {
+    ovm_instr_t replace_instr = {0};
+    replace_instr.full_instr = instr;
+    replace_instr.r = NEXT_VALUE(builder);
+    replace_instr.a = POP_VALUE(builder);
+    replace_instr.b = lane;
+
+    emit_mov(builder, replace_instr.r, POP_VALUE(builder));
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &replace_instr);
+    PUSH_VALUE(builder, replace_instr.r);
+}
+
+// %r = <lanes>; %r = shuffle(%a, %b, %r)
+void ovm_code_builder_add_shuffle(ovm_code_builder_t *builder, u8 *lanes) {
+    i32 data[4];
+    memcpy(data, lanes, 16);
+
+    ovm_instr_t shuffle_instr = {0};
+    shuffle_instr.full_instr = OVM_TYPED_INSTR(OVMI_SHUFFLE, OVM_TYPE_V128);
+    shuffle_instr.r = NEXT_VALUE(builder);
+    shuffle_instr.b = POP_VALUE(builder);
+    shuffle_instr.a = POP_VALUE(builder);
+
+    ovm_instr_t imm_instr = {0};
+    imm_instr.full_instr = OVM_TYPED_INSTR(OVMI_IMM, OVM_TYPE_V128);
+    imm_instr.r = shuffle_instr.r;
+    imm_instr.a = ovm_program_register_static_ints(builder->program, 4, data);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &imm_instr);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &shuffle_instr);
+    PUSH_VALUE(builder, shuffle_instr.r);
+}
+
+// %r = %mask; %r = bitselect(%a, %b, %r)
+void ovm_code_builder_add_bitselect(ovm_code_builder_t *builder) {
+    ovm_instr_t select_instr = {0};
+    select_instr.full_instr = OVM_TYPED_INSTR(OVMI_VBITSELECT, OVM_TYPE_V128);
+    select_instr.r = NEXT_VALUE(builder);
+
+    i32 mask = POP_VALUE(builder);
+    select_instr.b = POP_VALUE(builder);
+    select_instr.a = POP_VALUE(builder);
+
+    emit_mov(builder, select_instr.r, mask);
+
+    debug_info_builder_emit_location(builder->debug_builder);
+    ovm_program_add_instructions(builder->program, 1, &select_instr);
+    PUSH_VALUE(builder, select_instr.r);
+}
@@ -8,6 +8,7 @@ enum instr_format_kind_t {
     instr_format_none,
 
     instr_format_rab,
+    instr_format_rai,
     instr_format_ra,
     instr_format_a,
 
@@ -22,6 +23,7 @@ enum instr_format_kind_t {
     instr_format_br_cond,
     instr_format_bri,
     instr_format_bri_cond,
+    instr_format_br_cmp,
 
     instr_format_call,
     instr_format_calli,
@@ -127,9 +129,104 @@ static instr_format_t instr_formats[] = {
     { "break", instr_format_none },
 
     { "memory_size", instr_format_none },
-    { "memory_grow", instr_format_ra }
+    { "memory_grow", instr_format_ra },
+
+    { "addi", instr_format_rai },
+
+    { "br_lt", instr_format_br_cmp },
+    { "br_lt_s", instr_format_br_cmp },
+    { "br_le", instr_format_br_cmp },
+    { "br_le_s", instr_format_br_cmp },
+    { "br_eq", instr_format_br_cmp },
+    { "br_ge", instr_format_br_cmp },
+    { "br_ge_s", instr_format_br_cmp },
+    { "br_gt", instr_format_br_cmp },
+    { "br_gt_s", instr_format_br_cmp },
+    { "br_ne", instr_format_br_cmp },
+
+    { "atomic_load", instr_format_load },
+    { "atomic_store", instr_format_store },
+    { "atomic_add", instr_format_rab },
+    { "atomic_sub", instr_format_rab },
+    { "atomic_and", instr_format_rab },
+    { "atomic_or", instr_format_rab },
+    { "atomic_xor", instr_format_rab },
+    { "atomic_xchg", instr_format_rab },
+    { "atomic_wait", instr_format_rab },
+    { "atomic_notify", instr_format_rab },
+    { "atomic_fence", instr_format_none },
+
+    { "splat", instr_format_ra },
+    { "extract", instr_format_rai },
+    { "extract_s", instr_format_rai },
+    { "replace", instr_format_rai },
+    { "shuffle", instr_format_rab },
+    { "swizzle", instr_format_rab },
+    { "vadd", instr_format_rab },
+    { "vsub", instr_format_rab },
+    { "vmul", instr_format_rab },
+    { "vdiv", instr_format_rab },
+    { "vadd_sat", instr_format_rab },
+    { "vadd_sat_s", instr_format_rab },
+    { "vsub_sat", instr_format_rab },
+    { "vsub_sat_s", instr_format_rab },
+    { "vavgr", instr_format_rab },
+    { "vmin", instr_format_rab },
+    { "vmin_s", instr_format_rab },
+    { "vmax", instr_format_rab },
+    { "vmax_s", instr_format_rab },
+    { "vabs", instr_format_ra },
+    { "vneg", instr_format_ra },
+    { "vsqrt", instr_format_ra },
+    { "vshl", instr_format_rab },
+    { "vshr", instr_format_rab },
+    { "vsar", instr_format_rab },
+    { "veq", instr_format_rab },
+    { "vne", instr_format_rab },
+    { "vlt", instr_format_rab },
+    { "vlt_s", instr_format_rab },
+    { "vle", instr_format_rab },
+    { "vle_s", instr_format_rab },
+    { "vgt", instr_format_rab },
+    { "vgt_s", instr_format_rab },
+    { "vge", instr_format_rab },
+    { "vge_s", instr_format_rab },
+    { "vnot", instr_format_ra },
+    { "vand", instr_format_rab },
+    { "vandnot", instr_format_rab },
+    { "vor", instr_format_rab },
+    { "vxor", instr_format_rab },
+    { "vbitselect", instr_format_rab },
+    { "vany_true", instr_format_ra },
+    { "vall_true", instr_format_ra },
+    { "vbitmask", instr_format_ra },
+    { "vnarrow", instr_format_rab },
+    { "vnarrow_s", instr_format_rab },
+    { "vwiden_low", instr_format_ra },
+    { "vwiden_low_s", instr_format_ra },
+    { "vwiden_high", instr_format_ra },
+    { "vwiden_high_s", instr_format_ra },
+    { "vtrunc_sat", instr_format_ra },
+    { "vtrunc_sat_s", instr_format_ra },
+    { "vconvert", instr_format_ra },
+    { "vconvert_s", instr_format_ra },
 };
 
+//
+// Every opcode has an entry in the table above, so a hash of it changes whenever an
+// instruction is added, removed or renumbered. Used to version program cache files.
+u64 ovm_instr_table_hash(u64 hash) {
+    fori (i, 0, (i32) (sizeof(instr_formats) / sizeof(instr_formats[0]))) {
+        for (char *c = instr_formats[i].instr; *c; c++) {
+            hash = (hash ^ (u8) *c) * 0x100000001b3ull;
+        }
+
+        hash = (hash ^ (u8) instr_formats[i].kind) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
 void ovm_disassemble(ovm_program_t *program, u32 instr_addr, bh_buffer *instr_text) {
     static char buf[256];
 
@@ -151,6 +248,7 @@ void ovm_disassemble(ovm_program_t *program, u32 instr_addr, bh_buffer *instr_te
     u32 formatted = 0;
     switch (format->kind) {
         case instr_format_rab: formatted = snprintf(buf, 255, "%%%d, %%%d, %%%d", instr->r, instr->a, instr->b); break;
+        case instr_format_rai: formatted = snprintf(buf, 255, "%%%d, %%%d, %d", instr->r, instr->a, instr->b); break;
         case instr_format_ra:  formatted = snprintf(buf, 255, "%%%d, %%%d", instr->r, instr->a); break;
         case instr_format_a:   formatted = snprintf(buf, 255, "%%%d", instr->a); break;
 
@@ -162,6 +260,7 @@ void ovm_disassemble(ovm_program_t *program, u32 instr_addr, bh_buffer *instr_te
                 case OVM_TYPE_I64:  formatted = snprintf(buf, 255, "%%%d, %lld", instr->r, instr->l); break;
                 case OVM_TYPE_F32:  formatted = snprintf(buf, 255, "%%%d, %f",   instr->r, instr->f); break;
                 case OVM_TYPE_F64:  formatted = snprintf(buf, 255, "%%%d, %lf",  instr->r, instr->d); break;
+                case OVM_TYPE_V128: formatted = snprintf(buf, 255, "%%%d, __static_arr_%d", instr->r, instr->a); break;
             }
             break;
 
@@ -174,6 +273,7 @@ void ovm_disassemble(ovm_program_t *program, u32 instr_addr, bh_buffer *instr_te
         case instr_format_br_cond:  formatted = snprintf(buf, 255, "%d, %%%d", instr_addr + instr->a + 1, instr->b); break;
         case instr_format_bri:      formatted = snprintf(buf, 255, "ip + %%%d", instr->a); break;
         case instr_format_bri_cond: formatted = snprintf(buf, 255, "ip + %%%d, %%%d", instr->a, instr->b); break;
+        case instr_format_br_cmp:   formatted = snprintf(buf, 255, "%d, %%%d, %%%d", instr_addr + instr->a + 1, instr->r, instr->b); break;
 
         case instr_format_call:
             if (instr->r >= 0) {
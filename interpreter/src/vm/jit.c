@@ -0,0 +1,897 @@
+#define _GNU_SOURCE
+
+#include "vm.h"
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//
+// Baseline JIT
+//
+// Once an internal function has been called `call_threshold` times, the range of
+// instructions that makes up its body is translated, one instruction at a time, into
+// x86-64 machine code. No registers are allocated across instructions; every value
+// number still lives in the frame in `numbered_values` that the interpreter would
+// have used. Because of this, the compiled code and the interpreter agree on the state
+// of the function at every instruction boundary. Anything that is not supported here
+// (traps, rarely used instructions, atomics) simply returns the index of that
+// instruction, and the caller continues running the function in the interpreter from
+// there.
+//
+// Compiled code returns one of:
+//     OVM_NATIVE_RETURNED  - the function returned, the result is in state->__tmp_value.
+//     OVM_NATIVE_TRAPPED   - something that was called trapped, the value the interpreter
+//                            stopped with is in state->__tmp_value.
+//     >= 0                 - the instruction to resume interpreting at.
+//
+// Register usage in compiled code:
+//     rbx - values (the current frame)
+//     r12 - base address of linear memory
+//     r13 - state
+// Everything else is scratch, as calls out of compiled code are only made at
+// instruction boundaries.
+//
+
+#if defined(__x86_64__) && defined(_BH_LINUX)
+
+static_assert(sizeof(ovm_value_t) == 16, "The JIT assumes values are 16 bytes");
+
+#define JIT_CHUNK_SIZE (1 << 20)
+#define JIT_PAGE_SIZE  4096
+#define JIT_CODE_ALIGN 16
+#define JIT_EPILOGUE   -1
+#define JIT_EXIT_SIZE  10
+
+enum {
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+};
+
+#define REG_XMM0 0
+#define REG_XMM1 1
+
+enum {
+    CC_B  = 0x2, CC_AE = 0x3, CC_E  = 0x4, CC_NE = 0x5,
+    CC_BE = 0x6, CC_A  = 0x7, CC_P  = 0xa, CC_NP = 0xb,
+    CC_L  = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G  = 0xf,
+};
+
+#define VAL_DISP(n)  ((i32) ((n) * sizeof(ovm_value_t)))
+#define TYPE_DISP(n) (VAL_DISP(n) + (i32) offsetof(ovm_value_t, type))
+
+typedef struct jit_patch_t {
+    i32 offset;     // Location of the rel32 to fill in.
+    i32 target;     // Instruction index, or JIT_EPILOGUE.
+} jit_patch_t;
+
+typedef struct jit_builder_t {
+    bh_arr(u8)          code;
+    bh_arr(i32)         instr_offsets;
+    bh_arr(jit_patch_t) patches;
+    bh_arr(i32)         jump_table_refs;
+
+    ovm_program_t *program;
+    i32 start_instr;
+    i32 end_instr;
+} jit_builder_t;
+
+
+//
+// Encoding
+//
+
+static inline void emit_u8(jit_builder_t *jb, u8 b) {
+    bh_arr_push(jb->code, b);
+}
+
+static inline void emit_u32(jit_builder_t *jb, u32 v) {
+    fori (i, 0, 4) emit_u8(jb, (v >> (i * 8)) & 0xff);
+}
+
+static inline void emit_u64(jit_builder_t *jb, u64 v) {
+    fori (i, 0, 8) emit_u8(jb, (v >> (i * 8)) & 0xff);
+}
+
+//
+// Opcodes greater than 0xff are two byte opcodes starting with 0x0F.
+static void emit_op(jit_builder_t *jb, u8 prefix, u16 opcode, bool w, i32 reg, i32 index, i32 base) {
+    if (prefix) emit_u8(jb, prefix);
+
+    u8 rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+    if (rex != 0x40) emit_u8(jb, rex);
+
+    if (opcode > 0xff) emit_u8(jb, opcode >> 8);
+    emit_u8(jb, opcode & 0xff);
+}
+
+// op reg, rm
+static void emit_reg(jit_builder_t *jb, u8 prefix, u16 opcode, bool w, i32 reg, i32 rm) {
+    emit_op(jb, prefix, opcode, w, reg, 0, rm);
+    emit_u8(jb, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op reg, [base + disp]
+static void emit_mem(jit_builder_t *jb, u8 prefix, u16 opcode, bool w, i32 reg, i32 base, i32 disp) {
+    emit_op(jb, prefix, opcode, w, reg, 0, base);
+    emit_u8(jb, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == REG_RSP) emit_u8(jb, 0x24);
+    emit_u32(jb, disp);
+}
+
+// op reg, [base + index << scale + disp]
+static void emit_mem_sib(jit_builder_t *jb, u8 prefix, u16 opcode, bool w, i32 reg, i32 base, i32 index, i32 scale, i32 disp) {
+    emit_op(jb, prefix, opcode, w, reg, index, base);
+    emit_u8(jb, 0x84 | ((reg & 7) << 3));
+    emit_u8(jb, (scale << 6) | ((index & 7) << 3) | (base & 7));
+    emit_u32(jb, disp);
+}
+
+static void emit_jump(jit_builder_t *jb, u16 opcode, i32 target) {
+    if (opcode > 0xff) emit_u8(jb, opcode >> 8);
+    emit_u8(jb, opcode & 0xff);
+
+    jit_patch_t patch;
+    patch.offset = bh_arr_length(jb->code);
+    patch.target = target;
+    bh_arr_push(jb->patches, patch);
+
+    emit_u32(jb, 0);
+}
+
+static inline void emit_jcc(jit_builder_t *jb, u8 cc, i32 target) {
+    emit_jump(jb, 0x0f80 | cc, target);
+}
+
+//
+// Leaves compiled code with `status`. Always JIT_EXIT_SIZE bytes long, so
+// short jumps can skip over it.
+static void emit_exit(jit_builder_t *jb, i32 status) {
+    emit_u8(jb, 0xb8 + REG_RAX);
+    emit_u32(jb, status);
+    emit_jump(jb, 0xe9, JIT_EPILOGUE);
+}
+
+static void emit_call(jit_builder_t *jb, void *func) {
+    emit_op(jb, 0, 0xb8 + REG_RAX, 1, 0, 0, 0);
+    emit_u64(jb, (u64) func);
+    emit_reg(jb, 0, 0xff, 0, 2, REG_RAX);
+}
+
+static inline void emit_load_value(jit_builder_t *jb, bool w, i32 reg, i32 value) {
+    emit_mem(jb, 0, 0x8b, w, reg, REG_RBX, VAL_DISP(value));
+}
+
+static inline void emit_store_value(jit_builder_t *jb, bool w, i32 reg, i32 value) {
+    emit_mem(jb, 0, 0x89, w, reg, REG_RBX, VAL_DISP(value));
+}
+
+static inline void emit_set_type(jit_builder_t *jb, i32 value, u8 type) {
+    emit_mem(jb, 0, 0xc6, 0, 0, REG_RBX, TYPE_DISP(value));
+    emit_u8(jb, type);
+}
+
+static void emit_copy_value(jit_builder_t *jb, i32 dest_base, i32 dest_disp, i32 src_base, i32 src_disp) {
+    emit_mem(jb, 0, 0x8b, 1, REG_RAX, src_base,  src_disp);
+    emit_mem(jb, 0, 0x89, 1, REG_RAX, dest_base, dest_disp);
+    emit_mem(jb, 0, 0x8b, 1, REG_RAX, src_base,  src_disp + 8);
+    emit_mem(jb, 0, 0x89, 1, REG_RAX, dest_base, dest_disp + 8);
+}
+
+//
+// rax = (u32) (%value + offset), the same wrapping the interpreter does.
+static void emit_address(jit_builder_t *jb, i32 value, i32 offset) {
+    emit_load_value(jb, 0, REG_RAX, value);
+    if (offset != 0) {
+        emit_reg(jb, 0, 0x81, 0, 0, REG_RAX);
+        emit_u32(jb, offset);
+    }
+}
+
+//
+// The frame and linear memory can both move whenever control leaves compiled code.
+static void emit_reload_frame(jit_builder_t *jb) {
+    emit_mem(jb, 0, 0x8b, 1, REG_RBX, REG_R13, offsetof(ovm_state_t, __frame_values));
+    emit_mem(jb, 0, 0x8b, 1, REG_RAX, REG_R13, offsetof(ovm_state_t, engine));
+    emit_mem(jb, 0, 0x8b, 1, REG_R12, REG_RAX, offsetof(ovm_engine_t, memory));
+}
+
+
+//
+// Translation
+//
+
+static bool jit_is_float(i32 type) {
+    return type == OVM_TYPE_F32 || type == OVM_TYPE_F64;
+}
+
+static u8 jit_sse_prefix(i32 type) {
+    return type == OVM_TYPE_F64 ? 0xf2 : 0xf3;
+}
+
+static bool jit_branch_target(jit_builder_t *jb, i32 idx, i32 offset, i32 *target) {
+    *target = idx + 1 + offset;
+    return *target >= jb->start_instr && *target < jb->end_instr;
+}
+
+//
+// Loads %a and %b into xmm0 and xmm1, then sets the flags so the condition
+// returned is true when `%a <op> %b`. NaN's compare false for everything
+// except !=, which needs a second check of the parity flag by the caller.
+static u8 emit_float_compare(jit_builder_t *jb, i32 op, i32 type, i32 a, i32 b) {
+    u8 sse = jit_sse_prefix(type);
+    u8 ucomi_prefix = type == OVM_TYPE_F64 ? 0x66 : 0;
+
+    emit_mem(jb, sse, 0x0f10, 0, REG_XMM0, REG_RBX, VAL_DISP(a));
+    emit_mem(jb, sse, 0x0f10, 0, REG_XMM1, REG_RBX, VAL_DISP(b));
+
+    switch (op) {
+        case OVMI_LT: case OVMI_LT_S: emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM1, REG_XMM0); return CC_A;
+        case OVMI_LE: case OVMI_LE_S: emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM1, REG_XMM0); return CC_AE;
+        case OVMI_GT: case OVMI_GT_S: emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM0, REG_XMM1); return CC_A;
+        case OVMI_GE: case OVMI_GE_S: emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM0, REG_XMM1); return CC_AE;
+        case OVMI_EQ:                 emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM0, REG_XMM1); return CC_E;
+        case OVMI_NE:                 emit_reg(jb, ucomi_prefix, 0x0f2e, 0, REG_XMM0, REG_XMM1); return CC_NE;
+    }
+
+    return CC_E;
+}
+
+static u8 jit_int_condition(i32 op) {
+    switch (op) {
+        case OVMI_LT:   return CC_B;
+        case OVMI_LT_S: return CC_L;
+        case OVMI_LE:   return CC_BE;
+        case OVMI_LE_S: return CC_LE;
+        case OVMI_EQ:   return CC_E;
+        case OVMI_GE:   return CC_AE;
+        case OVMI_GE_S: return CC_GE;
+        case OVMI_GT:   return CC_A;
+        case OVMI_GT_S: return CC_G;
+        case OVMI_NE:   return CC_NE;
+    }
+
+    return CC_E;
+}
+
+static bool jit_translate_conversion(jit_builder_t *jb, ovm_instr_t *instr, i32 op, i32 type) {
+    bool from_float = op >= OVMI_CVT_F32;
+    bool to_float   = jit_is_float(type);
+    bool to_wide    = type == OVM_TYPE_I64 || type == OVM_TYPE_F64;
+
+    //
+    // Get the source into rax or xmm0, extended to 64-bits for integers.
+    bool source_64 = false;
+    switch (op) {
+        case OVMI_CVT_I8:    emit_mem(jb, 0, 0x0fb6, 0, REG_RAX, REG_RBX, VAL_DISP(instr->a)); break;
+        case OVMI_CVT_I8_S:  emit_mem(jb, 0, 0x0fbe, 1, REG_RAX, REG_RBX, VAL_DISP(instr->a)); break;
+        case OVMI_CVT_I16:   emit_mem(jb, 0, 0x0fb7, 0, REG_RAX, REG_RBX, VAL_DISP(instr->a)); break;
+        case OVMI_CVT_I16_S: emit_mem(jb, 0, 0x0fbf, 1, REG_RAX, REG_RBX, VAL_DISP(instr->a)); break;
+        case OVMI_CVT_I32:   emit_mem(jb, 0, 0x8b,   0, REG_RAX, REG_RBX, VAL_DISP(instr->a)); source_64 = true; break;
+        case OVMI_CVT_I32_S: emit_mem(jb, 0, 0x63,   1, REG_RAX, REG_RBX, VAL_DISP(instr->a)); source_64 = true; break;
+
+        case OVMI_CVT_I64: case OVMI_CVT_I64_S:
+            // Unsigned 64-bit integers do not convert to floats with a single instruction.
+            if (to_float && op == OVMI_CVT_I64) return false;
+            emit_mem(jb, 0, 0x8b, 1, REG_RAX, REG_RBX, VAL_DISP(instr->a));
+            source_64 = true;
+            break;
+
+        case OVMI_CVT_F32: case OVMI_CVT_F32_S:
+            emit_mem(jb, 0xf3, 0x0f10, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->a));
+            break;
+
+        case OVMI_CVT_F64: case OVMI_CVT_F64_S:
+            emit_mem(jb, 0xf2, 0x0f10, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->a));
+            break;
+
+        default: return false;
+    }
+
+    if (from_float && to_float) {
+        // cvtss2sd / cvtsd2ss
+        emit_reg(jb, op < OVMI_CVT_F64 ? 0xf3 : 0xf2, 0x0f5a, 0, REG_XMM0, REG_XMM0);
+
+    } else if (from_float) {
+        bool is_signed = op == OVMI_CVT_F32_S || op == OVMI_CVT_F64_S;
+
+        // Unsigned 64-bit results have no direct instruction. Unsigned 32-bit results
+        // are converted as 64-bit signed integers and truncated, like C compilers do.
+        if (type == OVM_TYPE_I64 && !is_signed) return false;
+
+        emit_reg(jb, op < OVMI_CVT_F64 ? 0xf3 : 0xf2, 0x0f2c, to_wide || !is_signed, REG_RAX, REG_XMM0);
+
+    } else if (to_float) {
+        if (!source_64) return false;
+
+        // cvtsi2ss / cvtsi2sd. Unsigned 32-bit integers were zero-extended, so they are
+        // converted as 64-bit signed integers.
+        emit_reg(jb, jit_sse_prefix(type), 0x0f2a, op != OVMI_CVT_I32_S, REG_XMM0, REG_RAX);
+    }
+
+    switch (type) {
+        case OVM_TYPE_I8:  emit_mem(jb, 0,    0x88,   0, REG_RAX,  REG_RBX, VAL_DISP(instr->r)); break;
+        case OVM_TYPE_I16: emit_mem(jb, 0x66, 0x89,   0, REG_RAX,  REG_RBX, VAL_DISP(instr->r)); break;
+        case OVM_TYPE_I32: emit_mem(jb, 0,    0x89,   0, REG_RAX,  REG_RBX, VAL_DISP(instr->r)); break;
+        case OVM_TYPE_I64: emit_mem(jb, 0,    0x89,   1, REG_RAX,  REG_RBX, VAL_DISP(instr->r)); break;
+        case OVM_TYPE_F32: emit_mem(jb, 0xf3, 0x0f11, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->r)); break;
+        case OVM_TYPE_F64: emit_mem(jb, 0xf2, 0x0f11, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->r)); break;
+        default: return false;
+    }
+
+    emit_set_type(jb, instr->r, type);
+    return true;
+}
+
+//
+// Returns false if the instruction is not supported. Anything that was emitted
+// for it is discarded, and replaced with an exit to the interpreter.
+static bool jit_translate_instr(jit_builder_t *jb, i32 idx, ovm_instr_t *instr) {
+    if (instr->full_instr & OVMI_ATOMIC) return false;
+
+    i32 op   = OVM_INSTR_INSTR(*instr);
+    i32 type = OVM_INSTR_TYPE(*instr);
+    if (type == OVM_TYPE_V128) return false;
+
+    bool w   = type == OVM_TYPE_I64 || type == OVM_TYPE_F64;
+    u8 sse   = jit_sse_prefix(type);
+
+    switch (op) {
+        case OVMI_NOP: return true;
+
+        case OVMI_ADD: case OVMI_SUB: case OVMI_MUL:
+        case OVMI_AND: case OVMI_OR:  case OVMI_XOR: {
+            if (jit_is_float(type)) {
+                u16 float_op = op == OVMI_ADD ? 0x0f58 : op == OVMI_SUB ? 0x0f5c : 0x0f59;
+                if (op != OVMI_ADD && op != OVMI_SUB && op != OVMI_MUL) return false;
+
+                emit_mem(jb, sse, 0x0f10,   0, REG_XMM0, REG_RBX, VAL_DISP(instr->a));
+                emit_mem(jb, sse, float_op, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->b));
+                emit_mem(jb, sse, 0x0f11,   0, REG_XMM0, REG_RBX, VAL_DISP(instr->r));
+                emit_set_type(jb, instr->r, type);
+                return true;
+            }
+
+            u16 int_op = 0;
+            switch (op) {
+                case OVMI_ADD: int_op = 0x03;   break;
+                case OVMI_SUB: int_op = 0x2b;   break;
+                case OVMI_MUL: int_op = 0x0faf; break;
+                case OVMI_AND: int_op = 0x23;   break;
+                case OVMI_OR:  int_op = 0x0b;   break;
+                case OVMI_XOR: int_op = 0x33;   break;
+            }
+
+            emit_load_value(jb, w, REG_RAX, instr->a);
+            emit_mem(jb, 0, int_op, w, REG_RAX, REG_RBX, VAL_DISP(instr->b));
+            emit_store_value(jb, w, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+        }
+
+        case OVMI_DIV: case OVMI_DIV_S: case OVMI_REM: case OVMI_REM_S: {
+            if (jit_is_float(type)) {
+                emit_mem(jb, sse, 0x0f10, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->a));
+                emit_mem(jb, sse, 0x0f5e, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->b));
+                emit_mem(jb, sse, 0x0f11, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->r));
+                emit_set_type(jb, instr->r, type);
+                return true;
+            }
+
+            bool is_signed = op == OVMI_DIV_S || op == OVMI_REM_S;
+
+            emit_load_value(jb, w, REG_RAX, instr->a);
+            if (is_signed) {
+                if (w) emit_u8(jb, 0x48);
+                emit_u8(jb, 0x99);                              // cdq / cqo
+            } else {
+                emit_reg(jb, 0, 0x31, 0, REG_RDX, REG_RDX);     // xor edx, edx
+            }
+
+            emit_mem(jb, 0, 0xf7, w, is_signed ? 7 : 6, REG_RBX, VAL_DISP(instr->b));
+            emit_store_value(jb, w, (op == OVMI_DIV || op == OVMI_DIV_S) ? REG_RAX : REG_RDX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+        }
+
+        case OVMI_SHL: case OVMI_SHR: case OVMI_SAR: {
+            i32 digit = op == OVMI_SHL ? 4 : op == OVMI_SHR ? 5 : 7;
+
+            emit_load_value(jb, 0, REG_RCX, instr->b);
+            emit_load_value(jb, w, REG_RAX, instr->a);
+            emit_reg(jb, 0, 0xd3, w, digit, REG_RAX);
+            emit_store_value(jb, w, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+        }
+
+        case OVMI_IMM: {
+            if (w) {
+                emit_op(jb, 0, 0xb8 + REG_RAX, 1, 0, 0, 0);
+                emit_u64(jb, (u64) instr->l);
+            } else {
+                emit_u8(jb, 0xb8 + REG_RAX);
+                emit_u32(jb, (u32) instr->i);
+            }
+
+            // The upper bits of 32-bit immediates are zeroed, like the interpreter does.
+            emit_store_value(jb, 1, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+        }
+
+        case OVMI_MOV:
+            emit_copy_value(jb, REG_RBX, VAL_DISP(instr->r), REG_RBX, VAL_DISP(instr->a));
+            return true;
+
+        case OVMI_ADDI:
+            emit_load_value(jb, w, REG_RAX, instr->a);
+            emit_reg(jb, 0, 0x81, w, 0, REG_RAX);
+            emit_u32(jb, (u32) instr->b);
+            emit_store_value(jb, w, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+
+        case OVMI_LOAD: {
+            emit_address(jb, instr->a, instr->b);
+
+            switch (type) {
+                case OVM_TYPE_I8:
+                    emit_mem_sib(jb, 0, 0x0fb6, 0, REG_RCX, REG_R12, REG_RAX, 0, 0);
+                    emit_mem(jb, 0, 0x88, 0, REG_RCX, REG_RBX, VAL_DISP(instr->r));
+                    break;
+
+                case OVM_TYPE_I16:
+                    emit_mem_sib(jb, 0, 0x0fb7, 0, REG_RCX, REG_R12, REG_RAX, 0, 0);
+                    emit_mem(jb, 0x66, 0x89, 0, REG_RCX, REG_RBX, VAL_DISP(instr->r));
+                    break;
+
+                default:
+                    emit_mem_sib(jb, 0, 0x8b, w, REG_RCX, REG_R12, REG_RAX, 0, 0);
+                    emit_store_value(jb, w, REG_RCX, instr->r);
+                    break;
+            }
+
+            emit_set_type(jb, instr->r, type);
+            return true;
+        }
+
+        case OVMI_STORE: {
+            emit_address(jb, instr->r, instr->b);
+            emit_load_value(jb, w, REG_RCX, instr->a);
+
+            switch (type) {
+                case OVM_TYPE_I8:  emit_mem_sib(jb, 0,    0x88, 0, REG_RCX, REG_R12, REG_RAX, 0, 0); break;
+                case OVM_TYPE_I16: emit_mem_sib(jb, 0x66, 0x89, 0, REG_RCX, REG_R12, REG_RAX, 0, 0); break;
+                default:           emit_mem_sib(jb, 0,    0x89, w, REG_RCX, REG_R12, REG_RAX, 0, 0); break;
+            }
+
+            return true;
+        }
+
+        case OVMI_COPY:
+            // memmove(memory + %r, memory + %a, %b)
+            emit_load_value(jb, 0, REG_RAX, instr->r);
+            emit_mem_sib(jb, 0, 0x8d, 1, REG_RDI, REG_R12, REG_RAX, 0, 0);
+            emit_load_value(jb, 0, REG_RAX, instr->a);
+            emit_mem_sib(jb, 0, 0x8d, 1, REG_RSI, REG_R12, REG_RAX, 0, 0);
+            emit_load_value(jb, 0, REG_RDX, instr->b);
+            emit_call(jb, memmove);
+            return true;
+
+        case OVMI_FILL:
+            // memset(memory + %r, %a, %b), with the same signed operands as the interpreter.
+            emit_mem(jb, 0, 0x63, 1, REG_RAX, REG_RBX, VAL_DISP(instr->r));
+            emit_mem_sib(jb, 0, 0x8d, 1, REG_RDI, REG_R12, REG_RAX, 0, 0);
+            emit_mem(jb, 0, 0x0fb6, 0, REG_RSI, REG_RBX, VAL_DISP(instr->a));
+            emit_mem(jb, 0, 0x63, 1, REG_RDX, REG_RBX, VAL_DISP(instr->b));
+            emit_call(jb, memset);
+            return true;
+
+        case OVMI_REG_GET:
+            emit_mem(jb, 0, 0x8b, 1, REG_RDX, REG_R13, offsetof(ovm_state_t, registers));
+            emit_copy_value(jb, REG_RBX, VAL_DISP(instr->r), REG_RDX, VAL_DISP(instr->a));
+            return true;
+
+        case OVMI_REG_SET:
+            emit_mem(jb, 0, 0x8b, 1, REG_RDX, REG_R13, offsetof(ovm_state_t, registers));
+            emit_copy_value(jb, REG_RDX, VAL_DISP(instr->r), REG_RBX, VAL_DISP(instr->a));
+            return true;
+
+        case OVMI_IDX_ARR: {
+            ovm_static_integer_array_t data_elem = jb->program->static_data[instr->a];
+
+            // Out of bounds accesses are left to the interpreter to report.
+            emit_load_value(jb, 0, REG_RAX, instr->b);
+            emit_reg(jb, 0, 0x81, 0, 7, REG_RAX);
+            emit_u32(jb, data_elem.len);
+            emit_u8(jb, 0x70 | CC_B);
+            emit_u8(jb, JIT_EXIT_SIZE);
+            emit_exit(jb, idx);
+
+            emit_op(jb, 0, 0xb8 + REG_RDX, 1, 0, 0, 0);
+            emit_u64(jb, (u64) &jb->program->static_integers);
+            emit_mem(jb, 0, 0x8b, 1, REG_RDX, REG_RDX, 0);
+            emit_mem_sib(jb, 0, 0x8b, 0, REG_RAX, REG_RDX, REG_RAX, 2, data_elem.start_idx * sizeof(i32));
+            emit_store_value(jb, 0, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, OVM_TYPE_I32);
+            return true;
+        }
+
+        case OVMI_LT: case OVMI_LT_S: case OVMI_LE: case OVMI_LE_S: case OVMI_EQ:
+        case OVMI_GE: case OVMI_GE_S: case OVMI_GT: case OVMI_GT_S: case OVMI_NE: {
+            if (jit_is_float(type)) {
+                u8 cc = emit_float_compare(jb, op, type, instr->a, instr->b);
+                emit_reg(jb, 0, 0x0f90 | cc, 0, 0, REG_RAX);
+
+                if (op == OVMI_EQ) {
+                    emit_reg(jb, 0, 0x0f90 | CC_NP, 0, 0, REG_RCX);
+                    emit_reg(jb, 0, 0x20, 0, REG_RCX, REG_RAX);     // and al, cl
+                }
+
+                if (op == OVMI_NE) {
+                    emit_reg(jb, 0, 0x0f90 | CC_P, 0, 0, REG_RCX);
+                    emit_reg(jb, 0, 0x08, 0, REG_RCX, REG_RAX);     // or al, cl
+                }
+
+            } else {
+                emit_load_value(jb, w, REG_RAX, instr->a);
+                emit_mem(jb, 0, 0x3b, w, REG_RAX, REG_RBX, VAL_DISP(instr->b));
+                emit_reg(jb, 0, 0x0f90 | jit_int_condition(op), 0, 0, REG_RAX);
+            }
+
+            emit_reg(jb, 0, 0x0fb6, 0, REG_RAX, REG_RAX);
+            emit_store_value(jb, 0, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, OVM_TYPE_I32);
+            return true;
+        }
+
+        case OVMI_PARAM:
+            // state->param_buf[state->param_count++] = %a
+            emit_mem(jb, 0, 0x8b, 1, REG_RDX, REG_R13, offsetof(ovm_state_t, param_buf));
+            emit_mem(jb, 0, 0x8b, 0, REG_RCX, REG_R13, offsetof(ovm_state_t, param_count));
+            emit_reg(jb, 0, 0xc1, 1, 4, REG_RCX);
+            emit_u8(jb, 4);
+            emit_load_value(jb, 1, REG_RAX, instr->a);
+            emit_mem_sib(jb, 0, 0x89, 1, REG_RAX, REG_RDX, REG_RCX, 0, 0);
+            emit_mem(jb, 0, 0x8b, 1, REG_RAX, REG_RBX, VAL_DISP(instr->a) + 8);
+            emit_mem_sib(jb, 0, 0x89, 1, REG_RAX, REG_RDX, REG_RCX, 0, 8);
+            emit_mem(jb, 0, 0xff, 0, 0, REG_R13, offsetof(ovm_state_t, param_count));
+            return true;
+
+        case OVMI_RETURN:
+            emit_copy_value(jb, REG_R13, offsetof(ovm_state_t, __tmp_value), REG_RBX, VAL_DISP(instr->a));
+            emit_exit(jb, OVM_NATIVE_RETURNED);
+            return true;
+
+        case OVMI_CALL: case OVMI_CALLI:
+            emit_reg(jb, 0, 0x89, 1, REG_R13, REG_RDI);
+            if (op == OVMI_CALL) {
+                emit_u8(jb, 0xb8 + REG_RSI);
+                emit_u32(jb, instr->a);
+            } else {
+                emit_load_value(jb, 0, REG_RSI, instr->a);
+            }
+
+            emit_u8(jb, 0xb8 + REG_RDX);
+            emit_u32(jb, instr->r);
+            emit_call(jb, ovm__jit_call_func);
+
+            emit_reg(jb, 0, 0x85, 0, REG_RAX, REG_RAX);
+            emit_u8(jb, 0x70 | CC_E);
+            emit_u8(jb, JIT_EXIT_SIZE);
+            emit_exit(jb, OVM_NATIVE_TRAPPED);
+
+            emit_reload_frame(jb);
+            return true;
+
+        case OVMI_BR: {
+            i32 target;
+            if (!jit_branch_target(jb, idx, instr->a, &target)) return false;
+
+            emit_jump(jb, 0xe9, target);
+            return true;
+        }
+
+        case OVMI_BR_Z: case OVMI_BR_NZ: {
+            i32 target;
+            if (!jit_branch_target(jb, idx, instr->a, &target)) return false;
+
+            emit_mem(jb, 0, 0x83, 0, 7, REG_RBX, VAL_DISP(instr->b));
+            emit_u8(jb, 0);
+            emit_jcc(jb, op == OVMI_BR_Z ? CC_E : CC_NE, target);
+            return true;
+        }
+
+        case OVMI_BR_LT: case OVMI_BR_LT_S: case OVMI_BR_LE: case OVMI_BR_LE_S: case OVMI_BR_EQ:
+        case OVMI_BR_GE: case OVMI_BR_GE_S: case OVMI_BR_GT: case OVMI_BR_GT_S: case OVMI_BR_NE: {
+            i32 target;
+            if (!jit_branch_target(jb, idx, instr->a, &target)) return false;
+
+            i32 compare_op = op - OVMI_BR_LT + OVMI_LT;
+            if (jit_is_float(type)) {
+                u8 cc = emit_float_compare(jb, compare_op, type, instr->r, instr->b);
+
+                if (compare_op == OVMI_EQ) {
+                    emit_u8(jb, 0x70 | CC_P);
+                    emit_u8(jb, 6);
+                }
+
+                if (compare_op == OVMI_NE) {
+                    emit_jcc(jb, CC_P, target);
+                }
+
+                emit_jcc(jb, cc, target);
+                return true;
+            }
+
+            emit_load_value(jb, w, REG_RAX, instr->r);
+            emit_mem(jb, 0, 0x3b, w, REG_RAX, REG_RBX, VAL_DISP(instr->b));
+            emit_jcc(jb, jit_int_condition(compare_op), target);
+            return true;
+        }
+
+        case OVMI_BRI: {
+            // Branches through a table of offsets to every instruction, placed after the code.
+            emit_mem(jb, 0, 0x63, 1, REG_RAX, REG_RBX, VAL_DISP(instr->a));
+            emit_reg(jb, 0, 0x81, 1, 0, REG_RAX);
+            emit_u32(jb, idx + 1 - jb->start_instr);
+            emit_reg(jb, 0, 0x81, 1, 7, REG_RAX);
+            emit_u32(jb, jb->end_instr - jb->start_instr);
+            emit_u8(jb, 0x70 | CC_B);
+            emit_u8(jb, JIT_EXIT_SIZE);
+            emit_exit(jb, idx);
+
+            // lea rcx, [rip + table]
+            emit_op(jb, 0, 0x8d, 1, REG_RCX, 0, 0);
+            emit_u8(jb, 0x05 | (REG_RCX << 3));
+            bh_arr_push(jb->jump_table_refs, bh_arr_length(jb->code));
+            emit_u32(jb, 0);
+
+            emit_mem_sib(jb, 0, 0x63, 1, REG_RDX, REG_RCX, REG_RAX, 2, 0);
+            emit_reg(jb, 0, 0x01, 1, REG_RCX, REG_RDX);
+            emit_reg(jb, 0, 0xff, 0, 4, REG_RDX);
+            return true;
+        }
+
+        case OVMI_NEG:
+            if (type == OVM_TYPE_F32) {
+                emit_load_value(jb, 0, REG_RAX, instr->a);
+                emit_u8(jb, 0x35);
+                emit_u32(jb, 0x80000000);
+                emit_store_value(jb, 0, REG_RAX, instr->r);
+            } else {
+                emit_load_value(jb, 1, REG_RAX, instr->a);
+                emit_reg(jb, 0, 0x0fba, 1, 7, REG_RAX);         // btc rax, 63
+                emit_u8(jb, 63);
+                emit_store_value(jb, 1, REG_RAX, instr->r);
+            }
+
+            emit_set_type(jb, instr->r, type);
+            return true;
+
+        case OVMI_SQRT:
+            emit_mem(jb, sse, 0x0f51, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->a));
+            emit_mem(jb, sse, 0x0f11, 0, REG_XMM0, REG_RBX, VAL_DISP(instr->r));
+            emit_set_type(jb, instr->r, type);
+            return true;
+
+        case OVMI_CVT_I8:  case OVMI_CVT_I8_S:  case OVMI_CVT_I16: case OVMI_CVT_I16_S:
+        case OVMI_CVT_I32: case OVMI_CVT_I32_S: case OVMI_CVT_I64: case OVMI_CVT_I64_S:
+        case OVMI_CVT_F32: case OVMI_CVT_F32_S: case OVMI_CVT_F64: case OVMI_CVT_F64_S:
+            return jit_translate_conversion(jb, instr, op, type);
+
+        case OVMI_TRANSMUTE_I32: case OVMI_TRANSMUTE_I64:
+        case OVMI_TRANSMUTE_F32: case OVMI_TRANSMUTE_F64:
+            emit_load_value(jb, w, REG_RAX, instr->a);
+            emit_store_value(jb, w, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, type);
+            return true;
+
+        case OVMI_MEM_SIZE:
+            emit_mem(jb, 0, 0x8b, 1, REG_RAX, REG_R13, offsetof(ovm_state_t, engine));
+            emit_mem(jb, 0, 0x8b, 1, REG_RAX, REG_RAX, offsetof(ovm_engine_t, memory_size));
+            emit_reg(jb, 0, 0xc1, 1, 5, REG_RAX);
+            emit_u8(jb, 16);
+            emit_store_value(jb, 0, REG_RAX, instr->r);
+            emit_set_type(jb, instr->r, OVM_TYPE_I32);
+            return true;
+    }
+
+    return false;
+}
+
+static i32 jit_func_end_instr(ovm_program_t *program, ovm_func_t *func) {
+    i32 end = bh_arr_length(program->code);
+
+    bh_arr_each(ovm_func_t, other, program->funcs) {
+        if (other->kind != OVM_FUNC_INTERNAL) continue;
+        if (other->start_instr > func->start_instr && other->start_instr < end) {
+            end = other->start_instr;
+        }
+    }
+
+    return end;
+}
+
+static void jit_translate_func(jit_builder_t *jb) {
+    // push rbx; push r12; push r13
+    emit_u8(jb, 0x53);
+    emit_u8(jb, 0x41); emit_u8(jb, 0x54);
+    emit_u8(jb, 0x41); emit_u8(jb, 0x55);
+
+    emit_reg(jb, 0, 0x89, 1, REG_RDI, REG_R13);
+    emit_reg(jb, 0, 0x89, 1, REG_RSI, REG_RBX);
+    emit_reg(jb, 0, 0x89, 1, REG_RDX, REG_R12);
+
+    fori (idx, jb->start_instr, jb->end_instr) {
+        i32 offset = bh_arr_length(jb->code);
+        bh_arr_push(jb->instr_offsets, offset);
+
+        if (!jit_translate_instr(jb, idx, &jb->program->code[idx])) {
+            bh_arr_set_length(jb->code, offset);
+            emit_exit(jb, idx);
+        }
+    }
+
+    // Running off the end of the function is left to the interpreter.
+    emit_exit(jb, jb->end_instr);
+
+    i32 epilogue = bh_arr_length(jb->code);
+    emit_u8(jb, 0x41); emit_u8(jb, 0x5d);
+    emit_u8(jb, 0x41); emit_u8(jb, 0x5c);
+    emit_u8(jb, 0x5b);
+    emit_u8(jb, 0xc3);
+
+    bh_arr_each(jit_patch_t, patch, jb->patches) {
+        i32 target = patch->target == JIT_EPILOGUE
+            ? epilogue
+            : jb->instr_offsets[patch->target - jb->start_instr];
+
+        i32 rel = target - (patch->offset + 4);
+        memcpy(&jb->code[patch->offset], &rel, sizeof(rel));
+    }
+
+    if (bh_arr_length(jb->jump_table_refs) > 0) {
+        while (bh_arr_length(jb->code) % 4 != 0) emit_u8(jb, 0xcc);
+
+        i32 table = bh_arr_length(jb->code);
+        bh_arr_each(i32, offset, jb->instr_offsets) {
+            emit_u32(jb, *offset - table);
+        }
+
+        bh_arr_each(i32, ref, jb->jump_table_refs) {
+            i32 rel = table - (*ref + 4);
+            memcpy(&jb->code[*ref], &rel, sizeof(rel));
+        }
+    }
+}
+
+//
+// Code memory is never writable and executable at the same time at the same address.
+// Every chunk is a memory file that is mapped twice: once read-write, which is where
+// code is copied to, and once read-execute, which is where it runs from. This lets
+// functions be packed next to each other in the same pages, without ever changing the
+// protection of pages that other threads could be running code from.
+static u8 *jit_alloc_code(ovm_jit_t *jit, i32 size, u8 **writable) {
+    bh_align(size, JIT_CODE_ALIGN);
+
+    if (jit->chunk == NULL || jit->chunk_used + size > jit->chunk_size) {
+        i64 chunk_size = bh_max(JIT_CHUNK_SIZE, size);
+        bh_align(chunk_size, JIT_PAGE_SIZE);
+
+        int fd = memfd_create("ovm-jit", MFD_CLOEXEC);
+        if (fd < 0) return NULL;
+
+        u8 *exec_view = MAP_FAILED, *write_view = MAP_FAILED;
+        if (ftruncate(fd, chunk_size) == 0) {
+            write_view = mmap(NULL, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            exec_view  = mmap(NULL, chunk_size, PROT_READ | PROT_EXEC,  MAP_SHARED, fd, 0);
+        }
+
+        // The mappings keep the memory file alive.
+        close(fd);
+
+        if (write_view == MAP_FAILED || exec_view == MAP_FAILED) {
+            if (write_view != MAP_FAILED) munmap(write_view, chunk_size);
+            if (exec_view  != MAP_FAILED) munmap(exec_view,  chunk_size);
+            return NULL;
+        }
+
+        ovm_jit_chunk_t new_chunk;
+        new_chunk.base = exec_view;
+        new_chunk.writable = write_view;
+        new_chunk.size = chunk_size;
+        bh_arr_push(jit->chunks, new_chunk);
+
+        jit->chunk = exec_view;
+        jit->chunk_writable = write_view;
+        jit->chunk_size = chunk_size;
+        jit->chunk_used = 0;
+    }
+
+    u8 *code = jit->chunk + jit->chunk_used;
+    *writable = jit->chunk_writable + jit->chunk_used;
+    jit->chunk_used += size;
+    return code;
+}
+
+ovm_jit_t *ovm_jit_new(u32 call_threshold) {
+    ovm_jit_t *jit = bh_alloc_item(bh_heap_allocator(), ovm_jit_t);
+    memset(jit, 0, sizeof(*jit));
+
+    jit->call_threshold = call_threshold;
+    pthread_mutex_init(&jit->lock, NULL);
+    bh_arr_new(bh_heap_allocator(), jit->chunks, 4);
+
+    return jit;
+}
+
+void ovm_jit_delete(ovm_jit_t *jit) {
+    bh_arr_each(ovm_jit_chunk_t, chunk, jit->chunks) {
+        munmap(chunk->base, chunk->size);
+        munmap(chunk->writable, chunk->size);
+    }
+
+    bh_arr_free(jit->chunks);
+    pthread_mutex_destroy(&jit->lock);
+    bh_free(bh_heap_allocator(), jit);
+}
+
+ovm_native_func_t ovm_jit_compile(ovm_jit_t *jit, ovm_program_t *program, ovm_func_t *func) {
+    if (func->kind != OVM_FUNC_INTERNAL) return NULL;
+
+    jit_builder_t jb;
+    memset(&jb, 0, sizeof(jb));
+    jb.program = program;
+    jb.start_instr = func->start_instr;
+    jb.end_instr = jit_func_end_instr(program, func);
+
+    bh_arr_new(bh_heap_allocator(), jb.code, 1024);
+    bh_arr_new(bh_heap_allocator(), jb.instr_offsets, jb.end_instr - jb.start_instr);
+    bh_arr_new(bh_heap_allocator(), jb.patches, 64);
+    bh_arr_new(bh_heap_allocator(), jb.jump_table_refs, 4);
+
+    jit_translate_func(&jb);
+
+    pthread_mutex_lock(&jit->lock);
+
+    ovm_native_func_t native = func->native;
+    if (!native) {
+        u8 *writable;
+        u8 *code = jit_alloc_code(jit, bh_arr_length(jb.code), &writable);
+        if (code) {
+            memcpy(writable, jb.code, bh_arr_length(jb.code));
+
+            native = (ovm_native_func_t) code;
+            __atomic_store_n(&func->native, native, __ATOMIC_RELEASE);
+        }
+    }
+
+    pthread_mutex_unlock(&jit->lock);
+
+    bh_arr_free(jb.code);
+    bh_arr_free(jb.instr_offsets);
+    bh_arr_free(jb.patches);
+    bh_arr_free(jb.jump_table_refs);
+
+    return native;
+}
+
+#else
+
+//
+// There is no JIT for this platform, so everything is interpreted.
+
+ovm_jit_t *ovm_jit_new(u32 call_threshold) {
+    return NULL;
+}
+
+void ovm_jit_delete(ovm_jit_t *jit) {
+}
+
+ovm_native_func_t ovm_jit_compile(ovm_jit_t *jit, ovm_program_t *program, ovm_func_t *func) {
+    return NULL;
+}
+
+#endif
@@ -1,5 +1,11 @@
 #include "vm.h"
 
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 //
 // I'm very lazy and silly, so this code make the drastic assumption that the
 // endianness of the machine that the file was built on and the machine the
@@ -104,6 +110,266 @@ bool ovm_program_load_from_file(ovm_program_t *program, ovm_engine_t *engine, ch
     return true;
 }
 
+
+//
+// Program cache files
+//
+// Unlike the OVMI format above, a program cache holds everything that translating a
+// WebAssembly module's code produces, and the file is memory-mapped instead of read.
+// The instructions are used straight out of the mapping, so loading a cached program
+// costs about as much as copying the function table.
+//
+// Layout (native endianness, every field 4-byte aligned):
+//
+//     header         magic "OVMC", format version, build id, key (hash, check, length),
+//                    sizeof(ovm_instr_t)
+//     funcs          count, then per function: kind, param count, value number count,
+//                    start instruction or external index, name length, name (padded)
+//     static ints    count, then the integers
+//     static data    count, then (start index, length) pairs
+//     code           count, then the instructions, preceded by room for a bh_arr
+//                    header so `code` can point into the mapping like a normal bh_arr.
+//
+
+#define OVM_PROGRAM_CACHE_VERSION 3
+
+//
+// Bump this whenever the code builder starts producing different instructions for the
+// same module. Changes to the instruction set itself are picked up from the opcode table.
+#define OVM_TRANSLATOR_VERSION 1
+
+static u64 program_cache_hash(u64 hash, const void *data, i64 size) {
+    fori (i, 0, size) {
+        hash = (hash ^ ((const u8 *) data)[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+//
+// Identifies what a cache file's contents depend on: the file format, the translator,
+// the layout of an instruction and the numbering of the opcodes. This only uses inputs
+// that are versioned, so two builds of the same sources agree on it, and a VM that
+// translates differently never maps another one's cache.
+static u64 program_cache_build_id() {
+    i32 layout[] = {
+        OVM_PROGRAM_CACHE_VERSION,
+        OVM_TRANSLATOR_VERSION,
+        sizeof(ovm_instr_t),
+        offsetof(ovm_instr_t, r),
+        offsetof(ovm_instr_t, a),
+        offsetof(ovm_instr_t, b),
+        offsetof(ovm_instr_t, l),
+        OVM_INSTR_MASK,
+        OVMI_ATOMIC,
+        sizeof(ovm_static_integer_array_t),
+    };
+
+    u64 hash = program_cache_hash(0xcbf29ce484222325ull, layout, sizeof(layout));
+    return ovm_instr_table_hash(hash);
+}
+
+//
+// The code of a cached program is used in place in the file mapping, so it must never
+// be resized or freed through its bh_arr header.
+static BH_ALLOCATOR_PROC(program_cache_code_allocator_proc) {
+    assert(0 && "The code of a cached program cannot be reallocated.");
+    return NULL;
+}
+
+static void program_cache_write_i32(bh_buffer *buffer, i32 value) {
+    bh_buffer_append(buffer, &value, sizeof(value));
+}
+
+bool ovm_program_save_to_cache(ovm_program_t *program, char *filename, ovm_program_cache_key_t *key) {
+    bh_buffer buffer;
+    bh_buffer_init(&buffer, bh_heap_allocator(), 4096);
+
+    bh_buffer_append(&buffer, "OVMC", 4);
+    program_cache_write_i32(&buffer, OVM_PROGRAM_CACHE_VERSION);
+    u64 build_id = program_cache_build_id();
+    bh_buffer_append(&buffer, &build_id, sizeof(build_id));
+    bh_buffer_append(&buffer, key, sizeof(*key));
+    program_cache_write_i32(&buffer, sizeof(ovm_instr_t));
+
+    program_cache_write_i32(&buffer, bh_arr_length(program->funcs));
+    bh_arr_each(ovm_func_t, func, program->funcs) {
+        i32 name_len = func->name ? strlen(func->name) : 0;
+
+        program_cache_write_i32(&buffer, func->kind);
+        program_cache_write_i32(&buffer, func->param_count);
+        program_cache_write_i32(&buffer, func->value_number_count);
+        program_cache_write_i32(&buffer, func->kind == OVM_FUNC_INTERNAL ? func->start_instr : func->external_func_idx);
+        program_cache_write_i32(&buffer, name_len);
+
+        // The name is stored with its null terminator, so it can be used in place.
+        bh_buffer_append(&buffer, func->name ? func->name : "", name_len);
+        bh_buffer_write_byte(&buffer, 0);
+        bh_buffer_align(&buffer, 4);
+    }
+
+    program_cache_write_i32(&buffer, bh_arr_length(program->static_integers));
+    bh_buffer_append(&buffer, program->static_integers, bh_arr_length(program->static_integers) * sizeof(i32));
+
+    program_cache_write_i32(&buffer, bh_arr_length(program->static_data));
+    bh_arr_each(ovm_static_integer_array_t, arr, program->static_data) {
+        program_cache_write_i32(&buffer, arr->start_idx);
+        program_cache_write_i32(&buffer, arr->len);
+    }
+
+    program_cache_write_i32(&buffer, bh_arr_length(program->code));
+    bh_buffer_append(&buffer, &(bh__arr) {0}, sizeof(bh__arr));
+    bh_buffer_align(&buffer, 16);
+    bh_buffer_append(&buffer, program->code, bh_arr_length(program->code) * sizeof(ovm_instr_t));
+
+    //
+    // The file is written under a temporary name and then renamed, so another process
+    // starting the same program never sees a partially written cache.
+    char temp_filename[512];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.%d.tmp", filename, getpid());
+
+    bool success = false;
+    int fd = open(temp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        i64 written = 0;
+        while (written < buffer.length) {
+            i64 n = write(fd, buffer.data + written, buffer.length - written);
+            if (n <= 0) break;
+            written += n;
+        }
+
+        close(fd);
+
+        success = written == buffer.length && rename(temp_filename, filename) == 0;
+        if (!success) unlink(temp_filename);
+    }
+
+    bh_buffer_free(&buffer);
+    return success;
+}
+
+typedef struct program_cache_reader_t {
+    u8  *data;
+    i64  size;
+    i64  offset;
+    bool failed;
+} program_cache_reader_t;
+
+static void *program_cache_read(program_cache_reader_t *reader, i64 size) {
+    if (reader->failed || size < 0 || reader->offset + size > reader->size) {
+        reader->failed = true;
+        return NULL;
+    }
+
+    void *result = reader->data + reader->offset;
+    reader->offset += size;
+    return result;
+}
+
+static i32 program_cache_read_i32(program_cache_reader_t *reader) {
+    i32 *value = program_cache_read(reader, sizeof(i32));
+    return value ? *value : 0;
+}
+
+bool ovm_program_load_from_cache(ovm_program_t *program, char *filename, ovm_program_cache_key_t *key) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    //
+    // The mapping is private and writable so the bh_arr header in front of the code
+    // can be filled in. Only that page is ever copied.
+    u8 *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    program_cache_reader_t reader = { data, st.st_size, 0, false };
+
+    char *magic    = program_cache_read(&reader, 4);
+    i32 version    = program_cache_read_i32(&reader);
+    u64 *build_id  = program_cache_read(&reader, sizeof(u64));
+    ovm_program_cache_key_t *file_key = program_cache_read(&reader, sizeof(*file_key));
+    i32 instr_size = program_cache_read_i32(&reader);
+
+    if (reader.failed
+        || strncmp(magic, "OVMC", 4)
+        || version != OVM_PROGRAM_CACHE_VERSION
+        || *build_id != program_cache_build_id()
+        || file_key->hash   != key->hash
+        || file_key->check  != key->check
+        || file_key->length != key->length
+        || instr_size != sizeof(ovm_instr_t)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    bh_arr_clear(program->funcs);
+    bh_arr_clear(program->static_integers);
+    bh_arr_clear(program->static_data);
+
+    i32 func_count = program_cache_read_i32(&reader);
+    fori (i, 0, func_count) {
+        i32 kind               = program_cache_read_i32(&reader);
+        i32 param_count        = program_cache_read_i32(&reader);
+        i32 value_number_count = program_cache_read_i32(&reader);
+        i32 start_or_index     = program_cache_read_i32(&reader);
+        i32 name_len           = program_cache_read_i32(&reader);
+        i64 name_size = name_len + 1;
+        bh_align(name_size, 4);
+        char *name = program_cache_read(&reader, name_size);
+        if (reader.failed) break;
+
+        if (kind == OVM_FUNC_INTERNAL) {
+            ovm_program_register_func(program, name, start_or_index, param_count, value_number_count);
+        } else {
+            ovm_program_register_external_func(program, name, param_count, start_or_index);
+        }
+    }
+
+    i32 static_int_count = program_cache_read_i32(&reader);
+    i32 *static_ints = program_cache_read(&reader, (i64) static_int_count * sizeof(i32));
+    if (static_ints) bh_arr_insert_end(program->static_integers, static_int_count);
+    if (static_ints) memcpy(program->static_integers, static_ints, static_int_count * sizeof(i32));
+
+    i32 static_data_count = program_cache_read_i32(&reader);
+    ovm_static_integer_array_t *static_data = program_cache_read(&reader, (i64) static_data_count * sizeof(*static_data));
+    if (static_data) bh_arr_insert_end(program->static_data, static_data_count);
+    if (static_data) memcpy(program->static_data, static_data, static_data_count * sizeof(*static_data));
+
+    i32 code_count = program_cache_read_i32(&reader);
+    program_cache_read(&reader, sizeof(bh__arr));
+    i64 code_offset = reader.offset;
+    bh_align(code_offset, 16);
+    program_cache_read(&reader, code_offset - reader.offset);
+    ovm_instr_t *code = program_cache_read(&reader, (i64) code_count * sizeof(ovm_instr_t));
+
+    if (reader.failed) {
+        bh_arr_clear(program->funcs);
+        bh_arr_clear(program->static_integers);
+        bh_arr_clear(program->static_data);
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    bh__arr *code_header = bh__arrhead(code);
+    code_header->allocator = (bh_allocator) { program_cache_code_allocator_proc, NULL };
+    code_header->length    = code_count;
+    code_header->capacity  = code_count;
+
+    bh_arr_free(program->code);
+    program->code = code;
+    program->cache_mapping = data;
+    program->cache_mapping_size = st.st_size;
+
+    return true;
+}
+
+
 void ovm_state_link_external_funcs(ovm_program_t *program, ovm_state_t *state, ovm_linkable_func_t *funcs) {
     bh_arr_each(ovm_func_t, f, program->funcs) {
         if (f->kind == OVM_FUNC_INTERNAL) continue;
@@ -4,6 +4,12 @@
 
 #include <sys/mman.h>
 #include <signal.h>
+#include <errno.h>
+
+#if defined(_BH_LINUX)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
 
 #if defined(__arm64__)
     #include <arm_neon.h>
@@ -22,6 +28,22 @@
 #define __ovm_popcount(v)   __builtin_popcount(v)
 #define __ovm_popcountll(v) __builtin_popcount(v)
 
+//
+// Lane views of a v128 value slot. These alias the ovm_value_t they are
+// read from, which is only guaranteed to be 8-byte aligned.
+#define OVM_VECTOR_TYPE(name, t) typedef t ovm_##name __attribute__((vector_size(16), aligned(8), may_alias))
+OVM_VECTOR_TYPE(i8x16, i8);
+OVM_VECTOR_TYPE(u8x16, u8);
+OVM_VECTOR_TYPE(i16x8, i16);
+OVM_VECTOR_TYPE(u16x8, u16);
+OVM_VECTOR_TYPE(i32x4, i32);
+OVM_VECTOR_TYPE(u32x4, u32);
+OVM_VECTOR_TYPE(i64x2, i64);
+OVM_VECTOR_TYPE(u64x2, u64);
+OVM_VECTOR_TYPE(f32x4, f32);
+OVM_VECTOR_TYPE(f64x2, f64);
+#undef OVM_VECTOR_TYPE
+
 #include <math.h> // REMOVE THIS!!!  only needed for sqrt
 #include <pthread.h>
 
@@ -72,6 +94,8 @@ ovm_program_t *ovm_program_new(ovm_store_t *store) {
     program->code  = NULL;
     program->static_integers = NULL;
     program->static_data  = NULL;
+    program->cache_mapping = NULL;
+    program->cache_mapping_size = 0;
     bh_arr_new(store->heap_allocator, program->funcs, 16);
     bh_arr_new(store->heap_allocator, program->code, 1024);
     bh_arr_new(store->heap_allocator, program->static_integers, 128);
@@ -82,7 +106,13 @@ ovm_program_t *ovm_program_new(ovm_store_t *store) {
 
 void ovm_program_delete(ovm_program_t *program) {
     bh_arr_free(program->funcs);
-    bh_arr_free(program->code);
+
+    if (program->cache_mapping) {
+        munmap(program->cache_mapping, program->cache_mapping_size);
+    } else {
+        bh_arr_free(program->code);
+    }
+
     bh_arr_free(program->static_integers);
     bh_arr_free(program->static_data);
 
@@ -119,6 +149,8 @@ int ovm_program_register_func(ovm_program_t *program, char *name, i32 instr, i32
     func.start_instr = instr;
     func.param_count = param_count;
     func.value_number_count = value_number_count;
+    func.call_count = 0;
+    func.native = NULL;
 
     bh_arr_push(program->funcs, func);
     return func.id;
@@ -132,6 +164,8 @@ int ovm_program_register_external_func(ovm_program_t *program, char *name, i32 p
     func.param_count = param_count;
     func.external_func_idx = external_func_idx;
     func.value_number_count = param_count;
+    func.call_count = 0;
+    func.native = NULL;
 
     bh_arr_push(program->funcs, func);
     return func.id;
@@ -139,11 +173,14 @@ int ovm_program_register_external_func(ovm_program_t *program, char *name, i32 p
 
 void ovm_program_begin_func(ovm_program_t *program, char *name, i32 param_count, i32 value_number_count) {
     ovm_func_t func;
+    func.kind = OVM_FUNC_INTERNAL;
     func.id = bh_arr_length(program->funcs);
     func.name = name;
     func.start_instr = bh_arr_length(program->code);
     func.param_count = param_count;
     func.value_number_count = value_number_count;
+    func.call_count = 0;
+    func.native = NULL;
 
     bh_arr_push(program->funcs, func);
 }
@@ -164,7 +201,7 @@ ovm_engine_t *ovm_engine_new(ovm_store_t *store) {
     engine->memory_size = 0;
     engine->memory = NULL;
     engine->debug = NULL;
-    pthread_mutex_init(&engine->atomic_mutex, NULL);
+    engine->jit = NULL;
 
     //
     // HACK: This should not be necessary, but because moving the memory around
@@ -187,6 +224,10 @@ void ovm_engine_delete(ovm_engine_t *engine) {
         munmap(engine->memory, engine->memory_size);
     }
 
+    if (engine->jit) {
+        ovm_jit_delete(engine->jit);
+    }
+
     bh_free(store->heap_allocator, engine);
 }
 
@@ -213,6 +254,12 @@ void ovm_engine_enable_debug(ovm_engine_t *engine, debug_state_t *debug) {
     // sigaction(SIGINT, &sa, NULL);   Don't overload Ctrl+C
 }
 
+void ovm_engine_enable_jit(ovm_engine_t *engine, u32 call_threshold) {
+    if (engine->debug || engine->jit) return;
+
+    engine->jit = ovm_jit_new(call_threshold);
+}
+
 bool ovm_engine_memory_ensure_capacity(ovm_engine_t *engine, i64 minimum_size) {
     if (engine->memory_size >= minimum_size) return true;
 
@@ -303,6 +350,19 @@ void ovm_state_delete(ovm_state_t *state) {
     bh_arr_free(state->external_funcs);
 }
 
+//
+// Prepares a state that finished running to be used by another thread.
+// The registers and external functions are left as they are.
+void ovm_state_reset(ovm_state_t *state) {
+    bh_arr_clear(state->numbered_values);
+    bh_arr_clear(state->stack_frames);
+
+    state->pc = 0;
+    state->value_number_offset = 0;
+    state->param_count = 0;
+    state->call_depth = 0;
+}
+
 void ovm_state_register_external_func(ovm_state_t *state, i32 idx, void (*func)(void *, ovm_value_t *, ovm_value_t *), void *data) {
     ovm_external_func_t external_func;
     external_func.native_func = func;
@@ -335,6 +395,7 @@ static void ovm__func_setup_stack_frame(ovm_state_t *state, ovm_func_t *func, i3
     frame.value_number_base  = bh_arr_length(state->numbered_values);
     frame.return_address = state->pc;
     frame.return_number_value = result_number;
+    frame.native_caller = false;
     bh_arr_push(state->stack_frames, frame);
 
     //
@@ -376,6 +437,29 @@ static ovm_stack_frame_t ovm__func_teardown_stack_frame(ovm_state_t *state) {
     return frame;
 }
 
+//
+// Returns the compiled version of the function, compiling it if it
+// has just become hot enough.
+static inline ovm_native_func_t ovm__func_native_code(ovm_state_t *state, ovm_func_t *func) {
+    ovm_native_func_t native = __atomic_load_n(&func->native, __ATOMIC_ACQUIRE);
+    if (native) return native;
+
+    ovm_jit_t *jit = state->engine->jit;
+    if (!jit) return NULL;
+
+    // Every thread shares `func`, so the count is updated atomically. Threads that
+    // call the function while it is being compiled also compile it, and whichever
+    // finishes second uses the code the first one installed.
+    u32 calls = __atomic_add_fetch(&func->call_count, 1, __ATOMIC_RELAXED);
+    if (calls < jit->call_threshold) return NULL;
+
+    native = ovm_jit_compile(jit, state->program, func);
+
+    // If there was no memory for the code, wait another threshold of calls before trying again.
+    if (!native) __atomic_store_n(&func->call_count, 0, __ATOMIC_RELAXED);
+    return native;
+}
+
 ovm_value_t ovm_func_call(ovm_engine_t *engine, ovm_state_t *state, ovm_program_t *program, i32 func_idx, i32 param_count, ovm_value_t *params) {
     ovm_func_t *func = &program->funcs[func_idx];
     ovm_assert(func->value_number_count >= func->param_count);
@@ -391,7 +475,24 @@ ovm_value_t ovm_func_call(ovm_engine_t *engine, ovm_state_t *state, ovm_program_
             }
 
             state->pc = func->start_instr;
-            ovm_value_t result = ovm_run_code(engine, state, program);
+
+            ovm_value_t result;
+            ovm_native_func_t native = ovm__func_native_code(state, func);
+            if (native) {
+                i32 resume_at = native(state, state->__frame_values, engine->memory);
+                if (resume_at == OVM_NATIVE_RETURNED) {
+                    ovm__func_teardown_stack_frame(state);
+                }
+
+                if (resume_at < 0) {
+                    state->call_depth -= 1;
+                    return state->__tmp_value;
+                }
+
+                state->pc = resume_at;
+            }
+
+            result = ovm_run_code(engine, state, program);
 
             state->call_depth -= 1;
             return result;
@@ -524,6 +625,77 @@ static void __ovm_debug_hook(ovm_engine_t *engine, ovm_state_t *state) {
     if (state->debug->run_count > 0) state->debug->run_count--;
 }
 
+
+//
+// Backing implementation of memory.atomic.wait and memory.atomic.notify.
+// Returns 0 when woken, 1 when the value did not match and 2 on timeout,
+// which is what the WASM threads proposal expects.
+//
+// The OS primitives only operate on 32-bit words, so 64-bit waits compare
+// the full value first and then sleep on the low word. Since notify is
+// given the same address, these waiters are still woken correctly.
+static i32 ovm__atomic_wait(void *addr, u64 expected, bool wide, i64 timeout_ns) {
+    u64 current = wide ? __atomic_load_n((u64 *) addr, __ATOMIC_SEQ_CST)
+                       : __atomic_load_n((u32 *) addr, __ATOMIC_SEQ_CST);
+    if (!wide) expected = (u32) expected;
+    if (current != expected) return 1;
+
+    #if defined(_BH_LINUX)
+    struct timespec delay;
+    struct timespec *t = NULL;
+    if (timeout_ns >= 0) {
+        delay.tv_sec  = timeout_ns / 1000000000;
+        delay.tv_nsec = timeout_ns % 1000000000;
+        t = &delay;
+    }
+
+    int res = syscall(SYS_futex, addr, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, (u32) expected, t, NULL, 0);
+    if (res == -1) {
+        if (errno == EAGAIN)    return 1;
+        if (errno == ETIMEDOUT) return 2;
+    }
+
+    return 0;
+
+    #elif defined(_BH_DARWIN)
+    extern int __ulock_wait(u32 operation, void *addr, u64 value, u32 timeout_us);
+
+    u32 timeout_us = 0;
+    if (timeout_ns >= 0) {
+        timeout_us = (u32) bh_max(timeout_ns / 1000, 1);
+    }
+
+    int res = __ulock_wait(1 /* UL_COMPARE_AND_WAIT */, addr, (u32) expected, timeout_us);
+    if (res == -1 && errno == ETIMEDOUT) return 2;
+
+    return 0;
+
+    #else
+    return 2;
+    #endif
+}
+
+static i32 ovm__atomic_notify(void *addr, u32 count) {
+    if (count == 0) return 0;
+
+    #if defined(_BH_LINUX)
+    int res = syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, (int) bh_min(count, 0x7fffffff), NULL, NULL, 0);
+    return res < 0 ? 0 : res;
+
+    #elif defined(_BH_DARWIN)
+    extern int __ulock_wake(u32 operation, void *addr, u64 wake_value);
+
+    u32 op = 1 /* UL_COMPARE_AND_WAIT */;
+    if (count > 1) op |= 0x100 /* ULF_WAKE_ALL */;
+
+    int res = __ulock_wake(op, addr, 0);
+    return res < 0 ? 0 : 1;
+
+    #else
+    return 0;
+    #endif
+}
+
 #define OVMI_FUNC_NAME(n) ovmi_exec_##n
 #define OVMI_DISPATCH_NAME ovmi_dispatch
 #define OVMI_DEBUG_HOOK ((void)0)
@@ -548,14 +720,71 @@ ovm_value_t ovm_run_code(ovm_engine_t *engine, ovm_state_t *state, ovm_program_t
         exec_table = ovmi_debug_dispatch;
     }
 
+    if (state->debug) {
+        __ovm_debug_hook(engine, state);
+    }
+
     ovm_instr_t *code = program->code;
     u8 *memory = engine->memory;
     ovm_value_t *values = state->__frame_values;
-    ovm_instr_t *instr = &code[state->pc];
+    ovm_instr_t *instr = &code[state->pc++];
 
     return exec_table[instr->full_instr & 0x7ff](instr, state, values, memory, code);
 }
 
+bool ovm__jit_call_func(ovm_state_t *state, i32 func_idx, i32 result_number) {
+    ovm_func_t *func = &state->program->funcs[func_idx];
+    i32 extra_params = state->param_count - func->param_count;
+    ovm_assert(extra_params >= 0);
+
+    i32 frame_count = bh_arr_length(state->stack_frames);
+    ovm__func_setup_stack_frame(state, func, result_number);
+    state->param_count -= func->param_count;
+
+    ovm_value_t result = {0};
+    if (func->kind == OVM_FUNC_INTERNAL) {
+        memcpy(state->__frame_values, &state->param_buf[extra_params], func->param_count * sizeof(ovm_value_t));
+        bh_arr_last(state->stack_frames).native_caller = true;
+
+        i32 resume_at = func->start_instr;
+        ovm_native_func_t native = ovm__func_native_code(state, func);
+        if (native) {
+            resume_at = native(state, state->__frame_values, state->engine->memory);
+        }
+
+        if (resume_at == OVM_NATIVE_TRAPPED) return true;
+
+        if (resume_at == OVM_NATIVE_RETURNED) {
+            ovm__func_teardown_stack_frame(state);
+            result = state->__tmp_value;
+
+        } else {
+            state->pc = resume_at;
+            result = ovm_run_code(state->engine, state, state->program);
+
+            //
+            // Returning always pops the frame, so if it is still here,
+            // the interpreter stopped because of a trap.
+            if (bh_arr_length(state->stack_frames) > frame_count) {
+                state->__tmp_value = result;
+                return true;
+            }
+        }
+
+    } else {
+        ovm_external_func_t external_func = state->external_funcs[func->external_func_idx];
+        external_func.native_func(external_func.userdata, &state->param_buf[extra_params], &result);
+
+        ovm__func_teardown_stack_frame(state);
+    }
+
+    if (result_number >= 0) {
+        state->__frame_values[result_number] = result;
+    }
+
+    return false;
+}
+
 
 void ovm_print_stack_trace(ovm_engine_t *engine, ovm_state_t *state, ovm_program_t *program) {
     int i = 0;
@@ -36,6 +36,7 @@
     FORCE_TAILCALL return OVMI_DISPATCH_NAME[instr->full_instr & OVM_INSTR_MASK](instr, state, values, memory, code);
 
 #define VAL(loc) values[loc]
+#define VEC(loc, t) (*(ovm_##t *) &values[loc])
 
 typedef OVMI_INSTR_PROTO((* ovmi_instr_exec_t));
 
@@ -199,6 +200,42 @@ OVM_OP_EXEC(ge_s, >=)
 #undef OVM_OP
 
 
+//
+// Fused Operations
+//
+
+OVMI_INSTR_EXEC(addi_i32) {
+    ovm_assert(VAL(instr->a).type == OVM_TYPE_I32);
+    VAL(instr->r).u32 = VAL(instr->a).u32 + (u32) instr->b;
+    VAL(instr->r).type = OVM_TYPE_I32;
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(addi_i64) {
+    ovm_assert(VAL(instr->a).type == OVM_TYPE_I64);
+    VAL(instr->r).u64 = VAL(instr->a).u64 + (u64) (i64) instr->b;
+    VAL(instr->r).type = OVM_TYPE_I64;
+    NEXT_OP;
+}
+
+#define OVM_OP(t, op, ctype) \
+    ovm_assert(VAL(instr->r).type == t && VAL(instr->b).type == t); \
+    if (VAL(instr->r).ctype op VAL(instr->b).ctype) state->pc += instr->a;
+
+OVM_OP_EXEC(br_eq, ==)
+OVM_OP_EXEC(br_ne, !=)
+OVM_OP_UNSIGNED_EXEC(br_lt, <)
+OVM_OP_UNSIGNED_EXEC(br_le, <=)
+OVM_OP_UNSIGNED_EXEC(br_gt, >)
+OVM_OP_UNSIGNED_EXEC(br_ge, >=)
+OVM_OP_EXEC(br_lt_s, <)
+OVM_OP_EXEC(br_le_s, <=)
+OVM_OP_EXEC(br_gt_s, >)
+OVM_OP_EXEC(br_ge_s, >=)
+
+#undef OVM_OP
+
+
 
 //
 // Memory / register operations
@@ -330,7 +367,7 @@ OVMI_INSTR_EXEC(return) {
     state->pc = frame.return_address;
     values = state->__frame_values;
 
-    if (bh_arr_length(state->stack_frames) == 0) {
+    if (bh_arr_length(state->stack_frames) == 0 || frame.native_caller) {
         return val;
     }
 
@@ -363,7 +400,26 @@ OVMI_INSTR_EXEC(return) {
     if (func->kind == OVM_FUNC_INTERNAL) { \
         values = state->__frame_values; \
         memcpy(&VAL(0), &state->param_buf[extra_params], func->param_count * sizeof(ovm_value_t)); \
-        state->pc = func->start_instr; \
+\
+        ovm_native_func_t native = ovm__func_native_code(state, func); \
+        if (!native) { \
+            state->pc = func->start_instr; \
+        } else { \
+            i32 resume_at = native(state, values, memory); \
+            if (resume_at == OVM_NATIVE_TRAPPED) return state->__tmp_value; \
+\
+            memory = state->engine->memory; \
+            if (resume_at == OVM_NATIVE_RETURNED) { \
+                ovm__func_teardown_stack_frame(state); \
+                values = state->__frame_values; \
+                if (instr->r >= 0) { \
+                    VAL(instr->r) = state->__tmp_value; \
+                } \
+            } else { \
+                state->pc = resume_at; \
+                values = state->__frame_values; \
+            } \
+        } \
     } else { \
         ovm_external_func_t external_func = state->external_funcs[func->external_func_idx]; \
         external_func.native_func(external_func.userdata, &state->param_buf[extra_params], &state->__tmp_value); \
@@ -485,31 +541,581 @@ OVM_CVT(f64, i64, f64, u64, OVM_TYPE_I64, u64);
 
 
 //
-// Compare exchange
+// Atomics
+//
+// These are lowered directly to the compiler's __atomic builtins, so they
+// never take a lock. Narrow results are zero-extended, and the code builder
+// follows them with the same conversion a normal narrow load would get.
 //
 
-#define CMPXCHG(otype, ctype) \
-    OVMI_INSTR_EXEC(cmpxchg_##ctype) { \
-        pthread_mutex_lock(&state->engine->atomic_mutex); \
-        if (VAL(instr->r).u32 == 0) OVMI_EXCEPTION_HOOK; \
-        ctype *addr = (ctype *) &memory[VAL(instr->r).u32]; \
+#define OVM_ATOMIC_LOAD(otype, type_, stype) \
+    OVMI_INSTR_EXEC(atomic_load_##otype) { \
+        u32 src = VAL(instr->a).u32 + (u32) instr->b; \
+        if (src == 0) OVMI_EXCEPTION_HOOK; \
+        VAL(instr->r).u64 = 0; \
+        VAL(instr->r).stype = __atomic_load_n((stype *) &memory[src], __ATOMIC_SEQ_CST); \
+        VAL(instr->r).type = type_; \
+        NEXT_OP; \
+    }
+
+OVM_ATOMIC_LOAD(i8,  OVM_TYPE_I8,  u8)
+OVM_ATOMIC_LOAD(i16, OVM_TYPE_I16, u16)
+OVM_ATOMIC_LOAD(i32, OVM_TYPE_I32, u32)
+OVM_ATOMIC_LOAD(i64, OVM_TYPE_I64, u64)
+
+#undef OVM_ATOMIC_LOAD
+
+#define OVM_ATOMIC_STORE(otype, stype) \
+    OVMI_INSTR_EXEC(atomic_store_##otype) { \
+        u32 dest = VAL(instr->r).u32 + (u32) instr->b; \
+        if (dest == 0) OVMI_EXCEPTION_HOOK; \
+        __atomic_store_n((stype *) &memory[dest], VAL(instr->a).stype, __ATOMIC_SEQ_CST); \
+        NEXT_OP; \
+    }
+
+OVM_ATOMIC_STORE(i8,  u8)
+OVM_ATOMIC_STORE(i16, u16)
+OVM_ATOMIC_STORE(i32, u32)
+OVM_ATOMIC_STORE(i64, u64)
+
+#undef OVM_ATOMIC_STORE
+
+#define OVM_ATOMIC_RMW(name, builtin, otype, type_, stype) \
+    OVMI_INSTR_EXEC(atomic_##name##_##otype) { \
+        u32 addr = VAL(instr->a).u32; \
+        if (addr == 0) OVMI_EXCEPTION_HOOK; \
+        stype old = builtin((stype *) &memory[addr], VAL(instr->b).stype, __ATOMIC_SEQ_CST); \
+        VAL(instr->r).u64 = 0; \
+        VAL(instr->r).stype = old; \
+        VAL(instr->r).type = type_; \
+        NEXT_OP; \
+    }
+
+#define OVM_ATOMIC_RMW_ALL(name, builtin) \
+    OVM_ATOMIC_RMW(name, builtin, i8,  OVM_TYPE_I8,  u8) \
+    OVM_ATOMIC_RMW(name, builtin, i16, OVM_TYPE_I16, u16) \
+    OVM_ATOMIC_RMW(name, builtin, i32, OVM_TYPE_I32, u32) \
+    OVM_ATOMIC_RMW(name, builtin, i64, OVM_TYPE_I64, u64)
+
+OVM_ATOMIC_RMW_ALL(add,  __atomic_fetch_add)
+OVM_ATOMIC_RMW_ALL(sub,  __atomic_fetch_sub)
+OVM_ATOMIC_RMW_ALL(and,  __atomic_fetch_and)
+OVM_ATOMIC_RMW_ALL(or,   __atomic_fetch_or)
+OVM_ATOMIC_RMW_ALL(xor,  __atomic_fetch_xor)
+OVM_ATOMIC_RMW_ALL(xchg, __atomic_exchange_n)
+
+#undef OVM_ATOMIC_RMW_ALL
+#undef OVM_ATOMIC_RMW
+
+#define OVM_CMPXCHG(otype, type_, stype) \
+    OVMI_INSTR_EXEC(cmpxchg_##otype) { \
+        u32 addr = VAL(instr->r).u32; \
+        if (addr == 0) OVMI_EXCEPTION_HOOK; \
+        stype expected = VAL(instr->a).stype; \
+        __atomic_compare_exchange_n((stype *) &memory[addr], &expected, VAL(instr->b).stype, \
+                                    false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
  \
         VAL(instr->r).u64 = 0; \
+        VAL(instr->r).stype = expected; \
+        VAL(instr->r).type = type_; \
+        NEXT_OP; \
+    }
+
+OVM_CMPXCHG(i8,  OVM_TYPE_I8,  u8)
+OVM_CMPXCHG(i16, OVM_TYPE_I16, u16)
+OVM_CMPXCHG(i32, OVM_TYPE_I32, u32)
+OVM_CMPXCHG(i64, OVM_TYPE_I64, u64)
+
+#undef OVM_CMPXCHG
+
+#define OVM_ATOMIC_WAIT(otype, stype, wide) \
+    OVMI_INSTR_EXEC(atomic_wait_##otype) { \
+        u32 addr = VAL(instr->r).u32; \
+        if (addr == 0) OVMI_EXCEPTION_HOOK; \
+        i32 res = ovm__atomic_wait(&memory[addr], VAL(instr->a).stype, wide, VAL(instr->b).i64); \
+        VAL(instr->r).u64 = 0; \
+        VAL(instr->r).i32 = res; \
+        VAL(instr->r).type = OVM_TYPE_I32; \
+        NEXT_OP; \
+    }
+
+OVM_ATOMIC_WAIT(i32, u32, false)
+OVM_ATOMIC_WAIT(i64, u64, true)
+
+#undef OVM_ATOMIC_WAIT
+
+OVMI_INSTR_EXEC(atomic_notify) {
+    u32 addr = VAL(instr->a).u32;
+    if (addr == 0) OVMI_EXCEPTION_HOOK;
+    i32 res = ovm__atomic_notify(&memory[addr], VAL(instr->b).u32);
+    VAL(instr->r).u64 = 0;
+    VAL(instr->r).i32 = res;
+    VAL(instr->r).type = OVM_TYPE_I32;
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(atomic_fence) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    NEXT_OP;
+}
+
+
+//
+// SIMD
+//
+// The lane-wise operations are written with vector extensions, which the
+// compiler lowers directly to SSE2 or NEON. The operations that have no
+// operator use the intrinsics, and the few that neither cover well are
+// written out per lane.
+//
+
+OVMI_INSTR_EXEC(imm_v128) {
+    ovm_static_integer_array_t data_elem = state->program->static_data[instr->a];
+    memcpy(&VAL(instr->r), &state->program->static_integers[data_elem.start_idx], 16);
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(load_v128) {
+    u32 src = VAL(instr->a).u32 + (u32) instr->b;
+    if (src == 0) OVMI_EXCEPTION_HOOK;
+    memcpy(&VAL(instr->r), &memory[src], 16);
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(store_v128) {
+    u32 dest = VAL(instr->r).u32 + (u32) instr->b;
+    if (dest == 0) OVMI_EXCEPTION_HOOK;
+    memcpy(&memory[dest], &VAL(instr->a), 16);
+    NEXT_OP;
+}
+
+#define OVM_SPLAT(shape, vtype, stype) \
+    OVMI_INSTR_EXEC(splat_##shape) { \
+        ovm_##vtype v = {0}; \
+        v += VAL(instr->a).stype; \
+        VEC(instr->r, vtype) = v; \
+        NEXT_OP; \
+    }
+
+OVM_SPLAT(i8,  i8x16, i8)
+OVM_SPLAT(i16, i16x8, i16)
+OVM_SPLAT(i32, i32x4, i32)
+OVM_SPLAT(i64, i64x2, i64)
+OVM_SPLAT(f32, f32x4, f32)
+OVM_SPLAT(f64, f64x2, f64)
+
+#undef OVM_SPLAT
+
+#define OVM_EXTRACT(name, shape, vtype, otype, dtype, ctype) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        ctype lane = VEC(instr->a, vtype)[instr->b]; \
+        VAL(instr->r).u64 = 0; \
+        VAL(instr->r).dtype = lane; \
         VAL(instr->r).type = otype; \
-        VAL(instr->r).ctype = *addr; \
+        NEXT_OP; \
+    }
+
+OVM_EXTRACT(extract,   i8,  u8x16, OVM_TYPE_I32, u32, u8)
+OVM_EXTRACT(extract,   i16, u16x8, OVM_TYPE_I32, u32, u16)
+OVM_EXTRACT(extract,   i32, i32x4, OVM_TYPE_I32, i32, i32)
+OVM_EXTRACT(extract,   i64, i64x2, OVM_TYPE_I64, i64, i64)
+OVM_EXTRACT(extract,   f32, f32x4, OVM_TYPE_F32, f32, f32)
+OVM_EXTRACT(extract,   f64, f64x2, OVM_TYPE_F64, f64, f64)
+OVM_EXTRACT(extract_s, i8,  i8x16, OVM_TYPE_I32, i32, i8)
+OVM_EXTRACT(extract_s, i16, i16x8, OVM_TYPE_I32, i32, i16)
+
+#undef OVM_EXTRACT
+
+#define OVM_REPLACE(shape, vtype, stype) \
+    OVMI_INSTR_EXEC(replace_##shape) { \
+        VEC(instr->r, vtype)[instr->b] = VAL(instr->a).stype; \
+        NEXT_OP; \
+    }
+
+OVM_REPLACE(i8,  i8x16, i8)
+OVM_REPLACE(i16, i16x8, i16)
+OVM_REPLACE(i32, i32x4, i32)
+OVM_REPLACE(i64, i64x2, i64)
+OVM_REPLACE(f32, f32x4, f32)
+OVM_REPLACE(f64, f64x2, f64)
+
+#undef OVM_REPLACE
+
+OVMI_INSTR_EXEC(shuffle_v128) {
+    u8 both[32];
+    memcpy(both,      &VAL(instr->a), 16);
+    memcpy(both + 16, &VAL(instr->b), 16);
+
+    ovm_u8x16 lanes = VEC(instr->r, u8x16);
+    ovm_u8x16 result;
+    fori (i, 0, 16) result[i] = both[lanes[i] & 31];
+
+    VEC(instr->r, u8x16) = result;
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(swizzle_v128) {
+    ovm_u8x16 v       = VEC(instr->a, u8x16);
+    ovm_u8x16 indices = VEC(instr->b, u8x16);
+    ovm_u8x16 result;
+    fori (i, 0, 16) result[i] = indices[i] < 16 ? v[indices[i]] : 0;
+
+    VEC(instr->r, u8x16) = result;
+    NEXT_OP;
+}
+
+#define OVM_VOP(name, shape, vtype, op) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        VEC(instr->r, vtype) = VEC(instr->a, vtype) op VEC(instr->b, vtype); \
+        NEXT_OP; \
+    }
+
+#define OVM_VOP_TYPED(name, op) \
+    OVM_VOP(name, i8,  i8x16, op) \
+    OVM_VOP(name, i16, i16x8, op) \
+    OVM_VOP(name, i32, i32x4, op) \
+    OVM_VOP(name, i64, i64x2, op) \
+    OVM_VOP(name, f32, f32x4, op) \
+    OVM_VOP(name, f64, f64x2, op)
+
+OVM_VOP_TYPED(vadd, +)
+OVM_VOP_TYPED(vsub, -)
+
+OVM_VOP(vmul, i16, i16x8, *)
+OVM_VOP(vmul, i32, i32x4, *)
+OVM_VOP(vmul, i64, i64x2, *)
+OVM_VOP(vmul, f32, f32x4, *)
+OVM_VOP(vmul, f64, f64x2, *)
+OVM_VOP(vdiv, f32, f32x4, /)
+OVM_VOP(vdiv, f64, f64x2, /)
+
+OVM_VOP(vand,    v128, u64x2, &)
+OVM_VOP(vor,     v128, u64x2, |)
+OVM_VOP(vxor,    v128, u64x2, ^)
+OVM_VOP(vandnot, v128, u64x2, & ~)
+
+#undef OVM_VOP_TYPED
+#undef OVM_VOP
+
+//
+// Comparisons produce a vector of signed lanes that are all 1s or all 0s,
+// which is exactly what WASM expects.
+#define OVM_VCMP(name, shape, vtype, rtype, op) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        VEC(instr->r, rtype) = (ovm_##rtype) (VEC(instr->a, vtype) op VEC(instr->b, vtype)); \
+        NEXT_OP; \
+    }
+
+#define OVM_VCMP_UNSIGNED(name, op) \
+    OVM_VCMP(name, i8,  u8x16, i8x16, op) \
+    OVM_VCMP(name, i16, u16x8, i16x8, op) \
+    OVM_VCMP(name, i32, u32x4, i32x4, op) \
+    OVM_VCMP(name, i64, u64x2, i64x2, op) \
+    OVM_VCMP(name, f32, f32x4, i32x4, op) \
+    OVM_VCMP(name, f64, f64x2, i64x2, op)
+
+#define OVM_VCMP_SIGNED(name, op) \
+    OVM_VCMP(name, i8,  i8x16, i8x16, op) \
+    OVM_VCMP(name, i16, i16x8, i16x8, op) \
+    OVM_VCMP(name, i32, i32x4, i32x4, op) \
+    OVM_VCMP(name, i64, i64x2, i64x2, op)
+
+OVM_VCMP_UNSIGNED(veq, ==)
+OVM_VCMP_UNSIGNED(vne, !=)
+OVM_VCMP_UNSIGNED(vlt, <)
+OVM_VCMP_UNSIGNED(vle, <=)
+OVM_VCMP_UNSIGNED(vgt, >)
+OVM_VCMP_UNSIGNED(vge, >=)
+OVM_VCMP_SIGNED(vlt_s, <)
+OVM_VCMP_SIGNED(vle_s, <=)
+OVM_VCMP_SIGNED(vgt_s, >)
+OVM_VCMP_SIGNED(vge_s, >=)
+
+#undef OVM_VCMP_SIGNED
+#undef OVM_VCMP_UNSIGNED
+#undef OVM_VCMP
+
+//
+// Minimum and maximum are a comparison and a select. For floats this
+// matches bh_min and bh_max used by the scalar instructions.
+#define OVM_VMINMAX(name, shape, vtype, mtype, op) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        ovm_##vtype a = VEC(instr->a, vtype); \
+        ovm_##vtype b = VEC(instr->b, vtype); \
+        ovm_##mtype m = (ovm_##mtype) (a op b); \
+        VEC(instr->r, mtype) = (((ovm_##mtype) a) & m) | (((ovm_##mtype) b) & ~m); \
+        NEXT_OP; \
+    }
+
+OVM_VMINMAX(vmin,   i8,  u8x16, u8x16, <)
+OVM_VMINMAX(vmin,   i16, u16x8, u16x8, <)
+OVM_VMINMAX(vmin,   i32, u32x4, u32x4, <)
+OVM_VMINMAX(vmin,   f32, f32x4, u32x4, <)
+OVM_VMINMAX(vmin,   f64, f64x2, u64x2, <)
+OVM_VMINMAX(vmin_s, i8,  i8x16, u8x16, <)
+OVM_VMINMAX(vmin_s, i16, i16x8, u16x8, <)
+OVM_VMINMAX(vmin_s, i32, i32x4, u32x4, <)
+OVM_VMINMAX(vmax,   i8,  u8x16, u8x16, >)
+OVM_VMINMAX(vmax,   i16, u16x8, u16x8, >)
+OVM_VMINMAX(vmax,   i32, u32x4, u32x4, >)
+OVM_VMINMAX(vmax,   f32, f32x4, u32x4, >)
+OVM_VMINMAX(vmax,   f64, f64x2, u64x2, >)
+OVM_VMINMAX(vmax_s, i8,  i8x16, u8x16, >)
+OVM_VMINMAX(vmax_s, i16, i16x8, u16x8, >)
+OVM_VMINMAX(vmax_s, i32, i32x4, u32x4, >)
+
+#undef OVM_VMINMAX
+
+#if defined(__x86_64__)
+    #define OVM_VINTRIN(name, shape, vtype, sse_func, neon_func, neon_type) \
+        OVMI_INSTR_EXEC(name##_##shape) { \
+            VEC(instr->r, vtype) = (ovm_##vtype) sse_func((__m128i) VEC(instr->a, vtype), (__m128i) VEC(instr->b, vtype)); \
+            NEXT_OP; \
+        }
+#else
+    #define OVM_VINTRIN(name, shape, vtype, sse_func, neon_func, neon_type) \
+        OVMI_INSTR_EXEC(name##_##shape) { \
+            VEC(instr->r, vtype) = (ovm_##vtype) neon_func((neon_type) VEC(instr->a, vtype), (neon_type) VEC(instr->b, vtype)); \
+            NEXT_OP; \
+        }
+#endif
+
+OVM_VINTRIN(vadd_sat,   i8,  u8x16, _mm_adds_epu8,  vqaddq_u8,  uint8x16_t)
+OVM_VINTRIN(vadd_sat,   i16, u16x8, _mm_adds_epu16, vqaddq_u16, uint16x8_t)
+OVM_VINTRIN(vadd_sat_s, i8,  i8x16, _mm_adds_epi8,  vqaddq_s8,  int8x16_t)
+OVM_VINTRIN(vadd_sat_s, i16, i16x8, _mm_adds_epi16, vqaddq_s16, int16x8_t)
+OVM_VINTRIN(vsub_sat,   i8,  u8x16, _mm_subs_epu8,  vqsubq_u8,  uint8x16_t)
+OVM_VINTRIN(vsub_sat,   i16, u16x8, _mm_subs_epu16, vqsubq_u16, uint16x8_t)
+OVM_VINTRIN(vsub_sat_s, i8,  i8x16, _mm_subs_epi8,  vqsubq_s8,  int8x16_t)
+OVM_VINTRIN(vsub_sat_s, i16, i16x8, _mm_subs_epi16, vqsubq_s16, int16x8_t)
+OVM_VINTRIN(vavgr,      i8,  u8x16, _mm_avg_epu8,   vrhaddq_u8,  uint8x16_t)
+OVM_VINTRIN(vavgr,      i16, u16x8, _mm_avg_epu16,  vrhaddq_u16, uint16x8_t)
+
+#undef OVM_VINTRIN
+
+#define OVM_VNEG(shape, vtype) \
+    OVMI_INSTR_EXEC(vneg_##shape) { \
+        VEC(instr->r, vtype) = -VEC(instr->a, vtype); \
+        NEXT_OP; \
+    }
+
+OVM_VNEG(i8,  i8x16)
+OVM_VNEG(i16, i16x8)
+OVM_VNEG(i32, i32x4)
+OVM_VNEG(i64, i64x2)
+OVM_VNEG(f32, f32x4)
+OVM_VNEG(f64, f64x2)
+
+#undef OVM_VNEG
+
+#define OVM_VABS(shape, vtype) \
+    OVMI_INSTR_EXEC(vabs_##shape) { \
+        ovm_##vtype a = VEC(instr->a, vtype); \
+        ovm_##vtype m = a >> (sizeof(a[0]) * 8 - 1); \
+        VEC(instr->r, vtype) = (a ^ m) - m; \
+        NEXT_OP; \
+    }
+
+OVM_VABS(i8,  i8x16)
+OVM_VABS(i16, i16x8)
+OVM_VABS(i32, i32x4)
+
+#undef OVM_VABS
+
+// Clearing the sign bit also does the right thing for NaNs and -0.
+OVMI_INSTR_EXEC(vabs_f32) { VEC(instr->r, u32x4) = VEC(instr->a, u32x4) & 0x7fffffff;            NEXT_OP; }
+OVMI_INSTR_EXEC(vabs_f64) { VEC(instr->r, u64x2) = VEC(instr->a, u64x2) & 0x7fffffffffffffffull; NEXT_OP; }
+
+OVMI_INSTR_EXEC(vsqrt_f32) {
+#if defined(__x86_64__)
+    VEC(instr->r, f32x4) = (ovm_f32x4) _mm_sqrt_ps((__m128) VEC(instr->a, f32x4));
+#else
+    VEC(instr->r, f32x4) = (ovm_f32x4) vsqrtq_f32((float32x4_t) VEC(instr->a, f32x4));
+#endif
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(vsqrt_f64) {
+#if defined(__x86_64__)
+    VEC(instr->r, f64x2) = (ovm_f64x2) _mm_sqrt_pd((__m128d) VEC(instr->a, f64x2));
+#else
+    VEC(instr->r, f64x2) = (ovm_f64x2) vsqrtq_f64((float64x2_t) VEC(instr->a, f64x2));
+#endif
+    NEXT_OP;
+}
+
+//
+// WASM takes the shift amount modulo the lane width.
+#define OVM_VSHIFT(name, shape, vtype, op) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        ovm_##vtype a = VEC(instr->a, vtype); \
+        VEC(instr->r, vtype) = a op (i32) (VAL(instr->b).u32 & (sizeof(a[0]) * 8 - 1)); \
+        NEXT_OP; \
+    }
+
+OVM_VSHIFT(vshl, i8,  u8x16, <<)
+OVM_VSHIFT(vshl, i16, u16x8, <<)
+OVM_VSHIFT(vshl, i32, u32x4, <<)
+OVM_VSHIFT(vshl, i64, u64x2, <<)
+OVM_VSHIFT(vshr, i8,  u8x16, >>)
+OVM_VSHIFT(vshr, i16, u16x8, >>)
+OVM_VSHIFT(vshr, i32, u32x4, >>)
+OVM_VSHIFT(vshr, i64, u64x2, >>)
+OVM_VSHIFT(vsar, i8,  i8x16, >>)
+OVM_VSHIFT(vsar, i16, i16x8, >>)
+OVM_VSHIFT(vsar, i32, i32x4, >>)
+OVM_VSHIFT(vsar, i64, i64x2, >>)
+
+#undef OVM_VSHIFT
+
+OVMI_INSTR_EXEC(vnot_v128) {
+    VEC(instr->r, u64x2) = ~VEC(instr->a, u64x2);
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(vbitselect_v128) {
+    ovm_u64x2 mask = VEC(instr->r, u64x2);
+    VEC(instr->r, u64x2) = (VEC(instr->a, u64x2) & mask) | (VEC(instr->b, u64x2) & ~mask);
+    NEXT_OP;
+}
+
+//
+// A v128 has a non-zero lane exactly when it is not all 0s, no matter the
+// shape. It has no zero lanes exactly when comparing it to 0 gives all 0s.
+#define OVM_VTRUTH(shape, vtype) \
+    OVMI_INSTR_EXEC(vany_true_##shape) { \
+        ovm_u64x2 v = VEC(instr->a, u64x2); \
+        VAL(instr->r).u64 = (v[0] | v[1]) != 0; \
+        VAL(instr->r).type = OVM_TYPE_I32; \
+        NEXT_OP; \
+    } \
+ \
+    OVMI_INSTR_EXEC(vall_true_##shape) { \
+        ovm_u64x2 zeros = (ovm_u64x2) (VEC(instr->a, vtype) == 0); \
+        VAL(instr->r).u64 = (zeros[0] | zeros[1]) == 0; \
+        VAL(instr->r).type = OVM_TYPE_I32; \
+        NEXT_OP; \
+    }
+
+OVM_VTRUTH(i8,  i8x16)
+OVM_VTRUTH(i16, i16x8)
+OVM_VTRUTH(i32, i32x4)
+
+#undef OVM_VTRUTH
+
+OVMI_INSTR_EXEC(vbitmask_i8) {
+#if defined(__x86_64__)
+    u32 mask = (u32) _mm_movemask_epi8((__m128i) VEC(instr->a, i8x16));
+#else
+    ovm_u8x16 v = VEC(instr->a, u8x16);
+    u32 mask = 0;
+    fori (i, 0, 16) mask |= (u32) (v[i] >> 7) << i;
+#endif
+
+    VAL(instr->r).u64 = mask;
+    VAL(instr->r).type = OVM_TYPE_I32;
+    NEXT_OP;
+}
+
+#define OVM_VBITMASK(shape, vtype, lanes) \
+    OVMI_INSTR_EXEC(vbitmask_##shape) { \
+        ovm_##vtype v = VEC(instr->a, vtype); \
+        u32 mask = 0; \
+        fori (i, 0, lanes) mask |= (u32) (v[i] >> (sizeof(v[0]) * 8 - 1)) << i; \
  \
-        if (*addr == VAL(instr->a).ctype) { \
-            *addr = VAL(instr->b).ctype ; \
+        VAL(instr->r).u64 = mask; \
+        VAL(instr->r).type = OVM_TYPE_I32; \
+        NEXT_OP; \
+    }
+
+OVM_VBITMASK(i16, u16x8, 8)
+OVM_VBITMASK(i32, u32x4, 4)
+
+#undef OVM_VBITMASK
+
+//
+// The narrowing instructions always treat their inputs as signed, and
+// saturate to the range of the (signed or unsigned) output lane.
+#define OVM_VNARROW(name, shape, vtype, stype, lanes, min, max) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        ovm_##stype a = VEC(instr->a, stype); \
+        ovm_##stype b = VEC(instr->b, stype); \
+        ovm_##vtype result; \
+        fori (i, 0, lanes) { \
+            result[i]         = bh_clamp(a[i], min, max); \
+            result[i + lanes] = bh_clamp(b[i], min, max); \
         } \
  \
-        pthread_mutex_unlock(&state->engine->atomic_mutex); \
+        VEC(instr->r, vtype) = result; \
         NEXT_OP; \
     }
 
-CMPXCHG(OVM_TYPE_I32, i32)
-CMPXCHG(OVM_TYPE_I64, i64)
+OVM_VNARROW(vnarrow,   i8,  u8x16, i16x8, 8, 0,      255)
+OVM_VNARROW(vnarrow,   i16, u16x8, i32x4, 4, 0,      65535)
+OVM_VNARROW(vnarrow_s, i8,  i8x16, i16x8, 8, -128,   127)
+OVM_VNARROW(vnarrow_s, i16, i16x8, i32x4, 4, -32768, 32767)
 
-#undef CMPXCHG
+#undef OVM_VNARROW
+
+#define OVM_VWIDEN(name, shape, vtype, stype, lanes, first) \
+    OVMI_INSTR_EXEC(name##_##shape) { \
+        ovm_##stype a = VEC(instr->a, stype); \
+        ovm_##vtype result; \
+        fori (i, 0, lanes) result[i] = a[i + first]; \
+ \
+        VEC(instr->r, vtype) = result; \
+        NEXT_OP; \
+    }
+
+OVM_VWIDEN(vwiden_low,    i16, u16x8, u8x16, 8, 0)
+OVM_VWIDEN(vwiden_low,    i32, u32x4, u16x8, 4, 0)
+OVM_VWIDEN(vwiden_low_s,  i16, i16x8, i8x16, 8, 0)
+OVM_VWIDEN(vwiden_low_s,  i32, i32x4, i16x8, 4, 0)
+OVM_VWIDEN(vwiden_high,   i16, u16x8, u8x16, 8, 8)
+OVM_VWIDEN(vwiden_high,   i32, u32x4, u16x8, 4, 4)
+OVM_VWIDEN(vwiden_high_s, i16, i16x8, i8x16, 8, 8)
+OVM_VWIDEN(vwiden_high_s, i32, i32x4, i16x8, 4, 4)
+
+#undef OVM_VWIDEN
+
+//
+// Unlike the scalar truncations, these saturate and turn NaNs into 0.
+OVMI_INSTR_EXEC(vtrunc_sat_i32) {
+    ovm_f32x4 a = VEC(instr->a, f32x4);
+    ovm_u32x4 result;
+    fori (i, 0, 4) {
+        if      (!(a[i] > 0.0f))        result[i] = 0;
+        else if (a[i] >= 4294967296.0f) result[i] = 0xffffffff;
+        else                            result[i] = (u32) a[i];
+    }
+
+    VEC(instr->r, u32x4) = result;
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(vtrunc_sat_s_i32) {
+    ovm_f32x4 a = VEC(instr->a, f32x4);
+    ovm_i32x4 result;
+    fori (i, 0, 4) {
+        if      (a[i] != a[i])           result[i] = 0;
+        else if (a[i] <= -2147483648.0f) result[i] = INT32_MIN;
+        else if (a[i] >=  2147483648.0f) result[i] = INT32_MAX;
+        else                             result[i] = (i32) a[i];
+    }
+
+    VEC(instr->r, i32x4) = result;
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(vconvert_f32) {
+    VEC(instr->r, f32x4) = __builtin_convertvector(VEC(instr->a, u32x4), ovm_f32x4);
+    NEXT_OP;
+}
+
+OVMI_INSTR_EXEC(vconvert_s_f32) {
+    VEC(instr->r, f32x4) = __builtin_convertvector(VEC(instr->a, i32x4), ovm_f32x4);
+    NEXT_OP;
+}
 
 
 //
@@ -552,8 +1158,13 @@ OVMI_INSTR_EXEC(illegal) {
 #define IROW_TYPED(name)   NULL, D(name##_i8), D(name##_i16), D(name##_i32), D(name##_i64), D(name##_f32), D(name##_f64), NULL,
 #define IROW_PARTIAL(name) NULL, NULL, NULL, D(name##_i32), D(name##_i64), D(name##_f32), D(name##_f64), NULL,
 #define IROW_INT(name)     NULL, NULL, NULL, D(name##_i32), D(name##_i64), NULL, NULL, NULL,
+#define IROW_INTEGER(name) NULL, D(name##_i8), D(name##_i16), D(name##_i32), D(name##_i64), NULL, NULL, NULL,
 #define IROW_FLOAT(name)   NULL, NULL, NULL, NULL, NULL, D(name##_f32), D(name##_f64), NULL,
 #define IROW_SAME(name)    D(name),D(name),D(name),D(name),D(name),D(name),D(name),NULL,
+#define IROW_VECTOR(name)  NULL, D(name##_i8), D(name##_i16), D(name##_i32), D(name##_i64), D(name##_f32), D(name##_f64), NULL,
+#define IROW_SMALL(name)   NULL, D(name##_i8), D(name##_i16), NULL, NULL, NULL, NULL, NULL,
+#define IROW_WIDE(name)    NULL, NULL, D(name##_i16), D(name##_i32), NULL, NULL, NULL, NULL,
+#define IROW_BITWISE(name) NULL, NULL, NULL, NULL, NULL, NULL, NULL, D(name##_v128),
 
 static ovmi_instr_exec_t OVMI_DISPATCH_NAME[] = {
     IROW_UNTYPED(nop) // 0x00
@@ -572,10 +1183,10 @@ static ovmi_instr_exec_t OVMI_DISPATCH_NAME[] = {
     IROW_INT(sar)
     IROW_SAME(illegal)
     IROW_SAME(illegal)
-    IROW_PARTIAL(imm) // 0x10
+    NULL, NULL, NULL, D(imm_i32), D(imm_i64), D(imm_f32), D(imm_f64), D(imm_v128), // 0x10
     IROW_UNTYPED(mov)
-    IROW_TYPED(load)
-    IROW_TYPED(store)
+    NULL, D(load_i8),  D(load_i16),  D(load_i32),  D(load_i64),  D(load_f32),  D(load_f64),  D(load_v128),
+    NULL, D(store_i8), D(store_i16), D(store_i32), D(store_i64), D(store_f32), D(store_f64), D(store_v128),
     IROW_UNTYPED(copy)
     IROW_UNTYPED(fill)
     IROW_UNTYPED(reg_get)
@@ -632,10 +1243,86 @@ static ovmi_instr_exec_t OVMI_DISPATCH_NAME[] = {
     NULL, NULL, NULL, NULL, D(transmute_i64_f64), NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, D(transmute_f32_i32), NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, D(transmute_f64_i64), NULL,
-    IROW_INT(cmpxchg)
+    IROW_INTEGER(cmpxchg)
     IROW_SAME(illegal)
     IROW_UNTYPED(mem_size)
     IROW_UNTYPED(mem_grow)
+    IROW_INT(addi)  // 0x50
+    IROW_PARTIAL(br_lt)
+    IROW_PARTIAL(br_lt_s)
+    IROW_PARTIAL(br_le)
+    IROW_PARTIAL(br_le_s)
+    IROW_PARTIAL(br_eq)
+    IROW_PARTIAL(br_ge)
+    IROW_PARTIAL(br_ge_s)
+    IROW_PARTIAL(br_gt)
+    IROW_PARTIAL(br_gt_s)
+    IROW_PARTIAL(br_ne)
+    IROW_INTEGER(atomic_load)
+    IROW_INTEGER(atomic_store)
+    IROW_INTEGER(atomic_add)
+    IROW_INTEGER(atomic_sub)
+    IROW_INTEGER(atomic_and)
+    IROW_INTEGER(atomic_or)   // 0x60
+    IROW_INTEGER(atomic_xor)
+    IROW_INTEGER(atomic_xchg)
+    IROW_INT(atomic_wait)
+    IROW_UNTYPED(atomic_notify)
+    IROW_UNTYPED(atomic_fence)
+    IROW_VECTOR(splat)
+    IROW_VECTOR(extract)
+    NULL, D(extract_s_i8), D(extract_s_i16), NULL, NULL, NULL, NULL, NULL,
+    IROW_VECTOR(replace)
+    IROW_BITWISE(shuffle)
+    IROW_BITWISE(swizzle)
+    IROW_VECTOR(vadd)
+    IROW_VECTOR(vsub)
+    NULL, NULL, D(vmul_i16), D(vmul_i32), D(vmul_i64), D(vmul_f32), D(vmul_f64), NULL,
+    IROW_FLOAT(vdiv)
+    IROW_SMALL(vadd_sat)  // 0x70
+    IROW_SMALL(vadd_sat_s)
+    IROW_SMALL(vsub_sat)
+    IROW_SMALL(vsub_sat_s)
+    IROW_SMALL(vavgr)
+    NULL, D(vmin_i8), D(vmin_i16), D(vmin_i32), NULL, D(vmin_f32), D(vmin_f64), NULL,
+    NULL, D(vmin_s_i8), D(vmin_s_i16), D(vmin_s_i32), NULL, NULL, NULL, NULL,
+    NULL, D(vmax_i8), D(vmax_i16), D(vmax_i32), NULL, D(vmax_f32), D(vmax_f64), NULL,
+    NULL, D(vmax_s_i8), D(vmax_s_i16), D(vmax_s_i32), NULL, NULL, NULL, NULL,
+    NULL, D(vabs_i8), D(vabs_i16), D(vabs_i32), NULL, D(vabs_f32), D(vabs_f64), NULL,
+    IROW_VECTOR(vneg)
+    IROW_FLOAT(vsqrt)
+    IROW_INTEGER(vshl)
+    IROW_INTEGER(vshr)
+    IROW_INTEGER(vsar)
+    IROW_VECTOR(veq)
+    IROW_VECTOR(vne)  // 0x80
+    IROW_VECTOR(vlt)
+    IROW_INTEGER(vlt_s)
+    IROW_VECTOR(vle)
+    IROW_INTEGER(vle_s)
+    IROW_VECTOR(vgt)
+    IROW_INTEGER(vgt_s)
+    IROW_VECTOR(vge)
+    IROW_INTEGER(vge_s)
+    IROW_BITWISE(vnot)
+    IROW_BITWISE(vand)
+    IROW_BITWISE(vandnot)
+    IROW_BITWISE(vor)
+    IROW_BITWISE(vxor)
+    IROW_BITWISE(vbitselect)
+    NULL, D(vany_true_i8), D(vany_true_i16), D(vany_true_i32), NULL, NULL, NULL, NULL,
+    NULL, D(vall_true_i8), D(vall_true_i16), D(vall_true_i32), NULL, NULL, NULL, NULL,  // 0x90
+    NULL, D(vbitmask_i8), D(vbitmask_i16), D(vbitmask_i32), NULL, NULL, NULL, NULL,
+    IROW_SMALL(vnarrow)
+    IROW_SMALL(vnarrow_s)
+    IROW_WIDE(vwiden_low)
+    IROW_WIDE(vwiden_low_s)
+    IROW_WIDE(vwiden_high)
+    IROW_WIDE(vwiden_high_s)
+    NULL, NULL, NULL, D(vtrunc_sat_i32), NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, D(vtrunc_sat_s_i32), NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, D(vconvert_f32), NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, D(vconvert_s_f32), NULL, NULL,
 };
 
 #undef D
@@ -643,8 +1330,13 @@ static ovmi_instr_exec_t OVMI_DISPATCH_NAME[] = {
 #undef IROW_TYPED
 #undef IROW_PARTIAL
 #undef IROW_INT
+#undef IROW_INTEGER
 #undef IROW_FLOAT
 #undef IROW_SAME
+#undef IROW_VECTOR
+#undef IROW_SMALL
+#undef IROW_WIDE
+#undef IROW_BITWISE
 
 #undef OVM_OP_EXEC
 #undef OVM_OP_UNSIGNED_EXEC
@@ -655,6 +1347,7 @@ static ovmi_instr_exec_t OVMI_DISPATCH_NAME[] = {
 #undef OVMI_INSTR_EXEC
 #undef NEXT_OP
 #undef VAL
+#undef VEC
 
 #undef OVMI_FUNC_NAME
 #undef OVMI_DISPATCH_NAME
@@ -4,7 +4,9 @@
 wasm_config_t *wasm_config_new() {
     wasm_config_t *config = malloc(sizeof(*config));
     config->debug_enabled = false;
+    config->jit_enabled   = true;
     config->listen_path   = "/tmp/ovm-debug.0000";
+    config->program_cache_dir = NULL;
     return config;
 }
 
@@ -16,7 +18,14 @@ void wasm_config_enable_debug(wasm_config_t *config, bool enabled) {
     config->debug_enabled = enabled;
 }
 
+void wasm_config_enable_jit(wasm_config_t *config, bool enabled) {
+    config->jit_enabled = enabled;
+}
+
 void wasm_config_set_listen_path(wasm_config_t *config, char *listen_path) {
     config->listen_path = listen_path;
 }
 
+void wasm_config_set_program_cache_dir(wasm_config_t *config, char *program_cache_dir) {
+    config->program_cache_dir = program_cache_dir;
+}
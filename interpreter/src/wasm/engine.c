@@ -28,6 +28,10 @@ wasm_engine_t *wasm_engine_new_with_config(wasm_config_t *config) {
         debug_host_start(engine->engine->debug);
     }
 
+    if (!config || config->jit_enabled) {
+        ovm_engine_enable_jit(engine->engine, OVM_JIT_CALL_THRESHOLD);
+    }
+
     return engine;
 }
 
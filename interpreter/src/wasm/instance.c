@@ -21,7 +21,6 @@ struct ovm_wasm_binding {
     int param_count;
     int result_count;
     wasm_func_t *func;
-    wasm_val_vec_t param_buffer;
 };
 
 #define WASM_TO_OVM(w, o) { \
@@ -126,8 +125,15 @@ static wasm_trap_t *wasm_to_ovm_func_call_binding(void *vbinding, const wasm_val
 static void ovm_to_wasm_func_call_binding(void *env, ovm_value_t* params, ovm_value_t *res) {
     ovm_wasm_binding *binding = (ovm_wasm_binding *) env;
 
+    //
+    // The parameters are converted on the stack, because the same binding is
+    // used by every thread of the instance.
+    wasm_val_vec_t param_buffer;
+    param_buffer.data = alloca(sizeof(wasm_val_t) * binding->param_count);
+    param_buffer.size = binding->param_count;
+
     fori (i, 0, binding->param_count) {
-        OVM_TO_WASM(params[i], binding->param_buffer.data[i]);
+        OVM_TO_WASM(params[i], param_buffer.data[i]);
     }
 
     wasm_val_t return_value;
@@ -135,7 +141,7 @@ static void ovm_to_wasm_func_call_binding(void *env, ovm_value_t* params, ovm_va
     wasm_results.data = &return_value;
     wasm_results.size = binding->result_count;
 
-    wasm_trap_t *trap = wasm_func_call(binding->func, &binding->param_buffer, &wasm_results);
+    wasm_trap_t *trap = wasm_func_call(binding->func, &param_buffer, &wasm_results);
     assert(!trap);
 
     if (binding->result_count > 0) {
@@ -184,8 +190,6 @@ static void prepare_instance(wasm_instance_t *instance, const wasm_extern_vec_t
                 binding->param_count  = functype->params.size;
                 binding->result_count = functype->results.size;
                 binding->func         = func;
-                binding->param_buffer.data = bh_alloc(ovm_store->arena_allocator, sizeof(wasm_val_t) * binding->param_count);
-                binding->param_buffer.size = binding->param_count;
 
                 ovm_state_register_external_func(ovm_state, importtype->external_func_idx, ovm_to_wasm_func_call_binding, binding);
                 break;
@@ -339,6 +343,10 @@ wasm_instance_t *wasm_instance_new(wasm_store_t *store, const wasm_module_t *mod
     instance->memories = NULL;
     instance->tables = NULL;
     instance->globals = NULL;
+    instance->thread_base = NULL;
+    instance->idle_threads = NULL;
+    instance->active_threads = 0;
+    pthread_mutex_init(&instance->thread_lock, NULL);
     bh_arr_new(store->engine->store->heap_allocator, instance->funcs, module->functypes.size);
     bh_arr_new(store->engine->store->heap_allocator, instance->memories, 1);
     bh_arr_new(store->engine->store->heap_allocator, instance->tables, 1);
@@ -358,6 +366,32 @@ wasm_instance_t *wasm_instance_new(wasm_store_t *store, const wasm_module_t *mod
 }
 
 void wasm_instance_delete(wasm_instance_t *instance) {
+    if (instance->thread_base) {
+        wasm_instance_t *base = instance->thread_base;
+
+        pthread_mutex_lock(&base->thread_lock);
+        bh_arr_push(base->idle_threads, instance);
+        base->active_threads--;
+        pthread_mutex_unlock(&base->thread_lock);
+        return;
+    }
+
+    //
+    // Threads are detached, so some can still be running, or still be returning their
+    // instance after join() woke up. They share everything below with this instance,
+    // so nothing is freed while any are left. The embedder should check
+    // wasm_instance_threads_active before deleting the module, store and engine.
+    if (wasm_instance_threads_active(instance)) return;
+
+    bh_arr_each(wasm_instance_t *, idle, instance->idle_threads) {
+        wasm_extern_vec_delete(&(*idle)->exports);
+        ovm_state_delete((*idle)->state);
+        bh_free(instance->store->engine->store->heap_allocator, *idle);
+    }
+
+    bh_arr_free(instance->idle_threads);
+    pthread_mutex_destroy(&instance->thread_lock);
+
     bh_arr_free(instance->funcs);
     bh_arr_free(instance->memories);
     bh_arr_free(instance->globals);
@@ -368,6 +402,142 @@ void wasm_instance_delete(wasm_instance_t *instance) {
     bh_free(instance->store->engine->store->heap_allocator, instance);
 }
 
+//
+// Thread instances
+//
+// Every thread of a running program needs its own VM state, but nothing else about
+// an instance differs between threads: the program, the import bindings, the memory
+// and the tables are all shared. wasm_instance_new_thread creates an instance that
+// only has its own state, with its function and global exports bound to that state.
+//
+// Deleting a thread instance returns it to its base instance, so the next thread can
+// reuse it without allocating anything. The active data segments are not applied
+// again, because the memory is already initialized.
+//
+// This is not part of the standard C API.
+//
+
+static void thread_instance_reset_globals(wasm_instance_t *instance) {
+    wasm_instance_t *base = instance->thread_base;
+    const wasm_module_t *module = instance->module;
+
+    i32 register_index = 0;
+    fori (i, 0, (int) module->imports.size) {
+        if (module->imports.data[i]->type->kind != WASM_EXTERN_GLOBAL) continue;
+
+        ovm_state_register_set(instance->state, register_index, ovm_state_register_get(base->state, register_index));
+        register_index++;
+    }
+
+    fori (i, 0, (int) module->globaltypes.size) {
+        ovm_value_t val = {0};
+        WASM_TO_OVM(module->globaltypes.data[i]->type.global.initial_value, val);
+        ovm_state_register_set(instance->state, register_index, val);
+        register_index++;
+    }
+}
+
+static wasm_instance_t *thread_instance_new(wasm_instance_t *base) {
+    wasm_store_t *store = base->store;
+    const wasm_module_t *module = base->module;
+    ovm_store_t *ovm_store = store->engine->store;
+    ovm_engine_t *ovm_engine = store->engine->engine;
+
+    wasm_instance_t *instance = bh_alloc(ovm_store->heap_allocator, sizeof(*instance));
+    memset(instance, 0, sizeof(*instance));
+    instance->store = store;
+    instance->module = module;
+    instance->thread_base = base;
+    instance->state = ovm_state_new(ovm_engine, module->program);
+
+    // The import bindings do not depend on the state they are called from.
+    i32 external_func_count = bh_arr_length(base->state->external_funcs);
+    bh_arr_insert_end(instance->state->external_funcs, external_func_count);
+    memcpy(instance->state->external_funcs, base->state->external_funcs, external_func_count * sizeof(ovm_external_func_t));
+
+    wasm_extern_vec_new_uninitialized(&instance->exports, module->exports.size);
+    fori (i, 0, (int) module->exports.size) {
+        wasm_exporttype_t *externtype = module->exports.data[i];
+
+        switch (externtype->type->kind) {
+            case WASM_EXTERN_FUNC: {
+                wasm_func_t *base_func = base->funcs[externtype->index];
+
+                // Re-exported imports are not bound to a state.
+                if (!base_func->inner.func.env_present || base_func->inner.func.func_ptr != (void (*)()) wasm_to_ovm_func_call_binding) {
+                    instance->exports.data[i] = base->exports.data[i];
+                    break;
+                }
+
+                wasm_ovm_binding *binding = bh_alloc(ovm_store->arena_allocator, sizeof(*binding));
+                binding->engine   = ovm_engine;
+                binding->func_idx = externtype->index;
+                binding->program  = module->program;
+                binding->state    = instance->state;
+                binding->instance = instance;
+
+                wasm_func_t *func = wasm_func_new_with_env(store, base_func->inner.func.type,
+                    wasm_to_ovm_func_call_binding, binding, NULL);
+
+                instance->exports.data[i] = wasm_func_as_extern(func);
+                break;
+            }
+
+            case WASM_EXTERN_GLOBAL: {
+                wasm_global_t *base_global = base->globals[externtype->index];
+                wasm_global_t *global = wasm_global_new(store,
+                    wasm_externtype_as_globaltype_const(base_global->inner.type), &base_global->inner.global.initial_value);
+
+                global->inner.global.engine         = ovm_engine;
+                global->inner.global.state          = instance->state;
+                global->inner.global.register_index = base_global->inner.global.register_index;
+
+                instance->exports.data[i] = wasm_global_as_extern(global);
+                break;
+            }
+
+            case WASM_EXTERN_MEMORY:
+            case WASM_EXTERN_TABLE:
+                instance->exports.data[i] = base->exports.data[i];
+                break;
+        }
+    }
+
+    return instance;
+}
+
+wasm_instance_t *wasm_instance_new_thread(wasm_instance_t *base) {
+    if (base->thread_base) base = base->thread_base;
+
+    wasm_instance_t *instance = NULL;
+
+    pthread_mutex_lock(&base->thread_lock);
+    if (bh_arr_length(base->idle_threads) > 0) {
+        instance = bh_arr_pop(base->idle_threads);
+    }
+    base->active_threads++;
+    pthread_mutex_unlock(&base->thread_lock);
+
+    if (instance) {
+        ovm_state_reset(instance->state);
+    } else {
+        instance = thread_instance_new(base);
+    }
+
+    thread_instance_reset_globals(instance);
+    return instance;
+}
+
+bool wasm_instance_threads_active(wasm_instance_t *base) {
+    if (base->thread_base) base = base->thread_base;
+
+    pthread_mutex_lock(&base->thread_lock);
+    bool active = base->active_threads > 0;
+    pthread_mutex_unlock(&base->thread_lock);
+
+    return active;
+}
+
 void wasm_instance_exports(const wasm_instance_t *instance, wasm_extern_vec_t *out) {
     *out = instance->exports;
 }
@@ -6,10 +6,132 @@
 
 #include "./module_parsing.h"
 
+#include <sys/stat.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+
+//
+// Translating every function to OVM instructions is most of the work of loading a
+// module. When a program cache directory is configured, the translated program is
+// saved there, named after a hash of the binary, and later loads of the same binary
+// map that file instead of translating again. Everything else in the module is
+// cheap to parse, so it is still read from the binary.
+//
+// Caches are not used while debugging, because the debug info built during
+// translation is not stored in them.
+//
+// Loading a cache refreshes its modification time. Whenever a new cache is written,
+// caches that have not been used for OVM_PROGRAM_CACHE_MAX_AGE are deleted, so
+// binaries that are no longer run do not keep their caches forever. A cache written
+// by a VM that translates differently is replaced the next time its binary is run.
+//
+
+#define OVM_PROGRAM_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+
+//
+// The file is named after `hash`. `check` is an independent hash of the same bytes,
+// so a collision in `hash` alone does not load the wrong program.
+static ovm_program_cache_key_t module_binary_key(const wasm_byte_vec_t *binary) {
+    const u8 *data = (const u8 *) binary->data;
+    u64 hash  = 0xcbf29ce484222325ull ^ binary->size;
+    u64 check = 0x9e3779b97f4a7c15ull;
+
+    size_t i = 0;
+    for (; i + 8 <= binary->size; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+
+        check = (check + word * 0xc2b2ae3d27d4eb4full);
+        check = ((check << 31) | (check >> 33)) * 0x9e3779b97f4a7c15ull;
+    }
+
+    for (; i < binary->size; i++) {
+        hash  = (hash ^ data[i]) * 0x100000001b3ull;
+        check = ((check ^ data[i]) * 0xff51afd7ed558ccdull) ^ (check >> 31);
+    }
+
+    ovm_program_cache_key_t key;
+    key.hash   = hash;
+    key.check  = check;
+    key.length = binary->size;
+    return key;
+}
+
+static bool ensure_directory_exists(char *path) {
+    char buffer[512];
+    if (strlen(path) >= sizeof(buffer)) return false;
+    strcpy(buffer, path);
+
+    for (char *c = buffer + 1; ; c++) {
+        if (*c != '/' && *c != '\0') continue;
+
+        char saved = *c;
+        *c = '\0';
+        if (mkdir(buffer, 0755) != 0 && errno != EEXIST) return false;
+        *c = saved;
+
+        if (saved == '\0') return true;
+    }
+}
+
+static char *module_program_cache_path(wasm_module_t *module, u64 key) {
+    wasm_engine_t *engine = module->store->engine;
+    if (!engine->config || !engine->config->program_cache_dir) return NULL;
+    if (engine->engine->debug) return NULL;
+
+    char *dir = engine->config->program_cache_dir;
+    if (!ensure_directory_exists(dir)) return NULL;
+
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016llx.ovmc", (unsigned long long) key);
+    return bh_aprintf(engine->store->arena_allocator, "%s/%s", dir, filename);
+}
+
+static void module_program_cache_evict(char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    time_t now = time(NULL);
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        // This also matches the temporary files of writes that never finished.
+        if (!strstr(entry->d_name, ".ovmc")) continue;
+
+        struct stat st;
+        if (fstatat(dirfd(d), entry->d_name, &st, 0) != 0) continue;
+
+        if (now - st.st_mtime > OVM_PROGRAM_CACHE_MAX_AGE) {
+            unlinkat(dirfd(d), entry->d_name, 0);
+        }
+    }
+
+    closedir(d);
+}
+
 static bool module_build(wasm_module_t *module, const wasm_byte_vec_t *binary) {
     wasm_engine_t *engine = module->store->engine;
     module->program = ovm_program_new(engine->store);
 
+    ovm_program_cache_key_t cache_key = module_binary_key(binary);
+    char *cache_path = module_program_cache_path(module, cache_key.hash);
+
+    ovm_program_t *cached_program = NULL;
+    if (cache_path) {
+        cached_program = ovm_program_new(engine->store);
+        if (ovm_program_load_from_cache(cached_program, cache_path, &cache_key)) {
+            utimensat(AT_FDCWD, cache_path, NULL, 0);
+
+        } else {
+            ovm_program_delete(cached_program);
+            cached_program = NULL;
+        }
+    }
+
     build_context ctx;
     ctx.binary  = *binary;
     ctx.offset  = 8;  // Skip the magic bytes and version
@@ -17,6 +139,7 @@ static bool module_build(wasm_module_t *module, const wasm_byte_vec_t *binary) {
     ctx.program = module->program;
     ctx.store   = engine->store;
     ctx.next_external_func_idx = 0;
+    ctx.code_cached = cached_program != NULL;
 
     debug_info_builder_init(&ctx.debug_builder, &module->debug_info);
     sh_new_arena(module->custom_sections);
@@ -25,6 +148,18 @@ static bool module_build(wasm_module_t *module, const wasm_byte_vec_t *binary) {
         parse_section(&ctx);
     }
 
+    //
+    // The program built while parsing holds only what the other sections registered,
+    // which the cached program already contains.
+    if (cached_program) {
+        ovm_program_delete(module->program);
+        module->program = cached_program;
+
+    } else if (cache_path) {
+        ovm_program_save_to_cache(module->program, cache_path, &cache_key);
+        module_program_cache_evict(engine->config->program_cache_dir);
+    }
+
     // TODO: This is not correct when the module imports a global.
     // But Onyx does not do this, so I don't care at the moment.
     module->program->register_count = module->globaltypes.size;
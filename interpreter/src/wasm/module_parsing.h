@@ -21,6 +21,10 @@ struct build_context {
     int func_table_arr_idx;
     int next_external_func_idx;
 
+    // Set when the translated code was loaded from a program cache, in which case
+    // the code section is skipped.
+    bool code_cached;
+
     debug_info_builder_t debug_builder;
 
     // This will be set/reset for every code (function) entry.
@@ -52,7 +56,7 @@ static inline wasm_valkind_t parse_valtype(build_context *ctx) {
         case 0x7e: return WASM_I64;
         case 0x7d: return WASM_F32;
         case 0x7c: return WASM_F64;
-        case 0x7b: assert(0 && "SIMD values are not currently supported");
+        case 0x7b: return WASM_V128;
         case 0x70: return WASM_FUNCREF;
         case 0x6F: return WASM_ANYREF;
         default:   assert(0 && "Invalid valtype.");
@@ -453,22 +457,43 @@ static void parse_fe_instruction(build_context *ctx) {
     int instr_num = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
 
     switch (instr_num) {
+        case 0x00: {
+            int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            ovm_code_builder_add_atomic_notify(&ctx->builder, offset);
+            break;
+        }
+
+        case 0x01:
+        case 0x02: {
+            int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            ovm_code_builder_add_atomic_wait(&ctx->builder, instr_num == 0x01 ? OVM_TYPE_I32 : OVM_TYPE_I64, offset);
+            break;
+        }
+
+        case 0x03: {
+            assert(CONSUME_BYTE(ctx) == 0x00);
+            ovm_code_builder_add_atomic_fence(&ctx->builder);
+            break;
+        }
 
-#define LOAD_CASE(num, type) \
+#define LOAD_CASE(num, type, convert, convert_op, convert_type) \
         case num : { \
             int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset); \
             int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset); \
             ovm_code_builder_add_atomic_load(&ctx->builder, type, offset); \
+            if (convert) ovm_code_builder_add_unop(&ctx->builder, OVM_TYPED_INSTR(convert_op, convert_type)); \
             break; \
         }
 
-        LOAD_CASE(0x10, OVM_TYPE_I32)
-        LOAD_CASE(0x11, OVM_TYPE_I64)
-        LOAD_CASE(0x12, OVM_TYPE_I8)
-        LOAD_CASE(0x13, OVM_TYPE_I16)
-        LOAD_CASE(0x14, OVM_TYPE_I8)
-        LOAD_CASE(0x15, OVM_TYPE_I16)
-        LOAD_CASE(0x16, OVM_TYPE_I32)
+        LOAD_CASE(0x10, OVM_TYPE_I32, false, 0, 0)
+        LOAD_CASE(0x11, OVM_TYPE_I64, false, 0, 0)
+        LOAD_CASE(0x12, OVM_TYPE_I8,  true, OVMI_CVT_I8,  OVM_TYPE_I32)
+        LOAD_CASE(0x13, OVM_TYPE_I16, true, OVMI_CVT_I16, OVM_TYPE_I32)
+        LOAD_CASE(0x14, OVM_TYPE_I8,  true, OVMI_CVT_I8,  OVM_TYPE_I64)
+        LOAD_CASE(0x15, OVM_TYPE_I16, true, OVMI_CVT_I16, OVM_TYPE_I64)
+        LOAD_CASE(0x16, OVM_TYPE_I32, true, OVMI_CVT_I32, OVM_TYPE_I64)
 
 #undef LOAD_CASE
 
@@ -490,28 +515,240 @@ static void parse_fe_instruction(build_context *ctx) {
 
 #undef STORE_CASE
 
-#define CMPXCHG_CASE(num, type) \
+//
+// Every read-modify-write instruction comes in the same seven widths,
+// in the same order, so one macro covers a whole group. The narrow
+// variants are zero-extended like an unsigned load.
+#define RMW_CASE(num, instr, type, convert, convert_op, convert_type) \
         case num : { \
             int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset); \
             int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset); \
-            ovm_code_builder_add_cmpxchg(&ctx->builder, type, offset); \
+            if (instr == OVMI_CMPXCHG) ovm_code_builder_add_cmpxchg(&ctx->builder, type, offset); \
+            else                       ovm_code_builder_add_atomic_rmw(&ctx->builder, instr, type, offset); \
+            if (convert) ovm_code_builder_add_unop(&ctx->builder, OVM_TYPED_INSTR(convert_op, convert_type)); \
             break; \
         }
 
-        CMPXCHG_CASE(0x48, OVM_TYPE_I32)
-        CMPXCHG_CASE(0x49, OVM_TYPE_I64)
-        CMPXCHG_CASE(0x4A, OVM_TYPE_I8)
-        CMPXCHG_CASE(0x4B, OVM_TYPE_I16)
-        CMPXCHG_CASE(0x4C, OVM_TYPE_I8)
-        CMPXCHG_CASE(0x4D, OVM_TYPE_I16)
-        CMPXCHG_CASE(0x4E, OVM_TYPE_I32)
-
-#undef CMPXCHG_CASE
+#define RMW_GROUP(start, instr) \
+        RMW_CASE(start + 0, instr, OVM_TYPE_I32, false, 0, 0) \
+        RMW_CASE(start + 1, instr, OVM_TYPE_I64, false, 0, 0) \
+        RMW_CASE(start + 2, instr, OVM_TYPE_I8,  true, OVMI_CVT_I8,  OVM_TYPE_I32) \
+        RMW_CASE(start + 3, instr, OVM_TYPE_I16, true, OVMI_CVT_I16, OVM_TYPE_I32) \
+        RMW_CASE(start + 4, instr, OVM_TYPE_I8,  true, OVMI_CVT_I8,  OVM_TYPE_I64) \
+        RMW_CASE(start + 5, instr, OVM_TYPE_I16, true, OVMI_CVT_I16, OVM_TYPE_I64) \
+        RMW_CASE(start + 6, instr, OVM_TYPE_I32, true, OVMI_CVT_I32, OVM_TYPE_I64)
+
+        RMW_GROUP(0x1E, OVMI_ATOMIC_ADD)
+        RMW_GROUP(0x25, OVMI_ATOMIC_SUB)
+        RMW_GROUP(0x2C, OVMI_ATOMIC_AND)
+        RMW_GROUP(0x33, OVMI_ATOMIC_OR)
+        RMW_GROUP(0x3A, OVMI_ATOMIC_XOR)
+        RMW_GROUP(0x41, OVMI_ATOMIC_XCHG)
+        RMW_GROUP(0x48, OVMI_CMPXCHG)
+
+#undef RMW_GROUP
+#undef RMW_CASE
 
         default: assert(0 && "UNHANDLED ATOMIC INSTRUCTION... SORRY :/");
     }
 }
 
+//
+// SIMD instructions use the numbering from the version of the SIMD proposal
+// that the Onyx compiler emits, which differs from the final standard.
+static void parse_fd_instruction(build_context *ctx) {
+    int instr_num = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+
+#define V(instr, type) OVM_TYPED_INSTR(instr, type)
+#define UNOP(num, instr, type)  case num: ovm_code_builder_add_unop (&ctx->builder, V(instr, type)); break;
+#define BINOP(num, instr, type) case num: ovm_code_builder_add_binop(&ctx->builder, V(instr, type)); break;
+
+    switch (instr_num) {
+        case 0: {
+            int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            ovm_code_builder_add_load(&ctx->builder, OVM_TYPE_V128, offset);
+            break;
+        }
+
+        case 11: {
+            int alignment = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            int offset    = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+            ovm_code_builder_add_store(&ctx->builder, OVM_TYPE_V128, offset);
+            break;
+        }
+
+        case 12: {
+            u8 bytes[16];
+            fori (i, 0, 16) bytes[i] = CONSUME_BYTE(ctx);
+            ovm_code_builder_add_v128_imm(&ctx->builder, bytes);
+            break;
+        }
+
+        case 13: {
+            u8 lanes[16];
+            fori (i, 0, 16) lanes[i] = CONSUME_BYTE(ctx);
+            ovm_code_builder_add_shuffle(&ctx->builder, lanes);
+            break;
+        }
+
+        BINOP(14, OVMI_SWIZZLE, OVM_TYPE_V128)
+
+        UNOP(15, OVMI_SPLAT, OVM_TYPE_I8)
+        UNOP(16, OVMI_SPLAT, OVM_TYPE_I16)
+        UNOP(17, OVMI_SPLAT, OVM_TYPE_I32)
+        UNOP(18, OVMI_SPLAT, OVM_TYPE_I64)
+        UNOP(19, OVMI_SPLAT, OVM_TYPE_F32)
+        UNOP(20, OVMI_SPLAT, OVM_TYPE_F64)
+
+#define LANE_CASE(num, func, instr, type) \
+        case num: ovm_code_builder_add_##func(&ctx->builder, V(instr, type), CONSUME_BYTE(ctx)); break;
+
+        LANE_CASE(21, extract_lane, OVMI_EXTRACT_S, OVM_TYPE_I8)
+        LANE_CASE(22, extract_lane, OVMI_EXTRACT,   OVM_TYPE_I8)
+        LANE_CASE(23, replace_lane, OVMI_REPLACE,   OVM_TYPE_I8)
+        LANE_CASE(24, extract_lane, OVMI_EXTRACT_S, OVM_TYPE_I16)
+        LANE_CASE(25, extract_lane, OVMI_EXTRACT,   OVM_TYPE_I16)
+        LANE_CASE(26, replace_lane, OVMI_REPLACE,   OVM_TYPE_I16)
+        LANE_CASE(27, extract_lane, OVMI_EXTRACT,   OVM_TYPE_I32)
+        LANE_CASE(28, replace_lane, OVMI_REPLACE,   OVM_TYPE_I32)
+        LANE_CASE(29, extract_lane, OVMI_EXTRACT,   OVM_TYPE_I64)
+        LANE_CASE(30, replace_lane, OVMI_REPLACE,   OVM_TYPE_I64)
+        LANE_CASE(31, extract_lane, OVMI_EXTRACT,   OVM_TYPE_F32)
+        LANE_CASE(32, replace_lane, OVMI_REPLACE,   OVM_TYPE_F32)
+        LANE_CASE(33, extract_lane, OVMI_EXTRACT,   OVM_TYPE_F64)
+        LANE_CASE(34, replace_lane, OVMI_REPLACE,   OVM_TYPE_F64)
+
+#undef LANE_CASE
+
+#define INT_COMPARE_GROUP(start, type) \
+        BINOP(start + 0, OVMI_VEQ,   type) \
+        BINOP(start + 1, OVMI_VNE,   type) \
+        BINOP(start + 2, OVMI_VLT_S, type) \
+        BINOP(start + 3, OVMI_VLT,   type) \
+        BINOP(start + 4, OVMI_VGT_S, type) \
+        BINOP(start + 5, OVMI_VGT,   type) \
+        BINOP(start + 6, OVMI_VLE_S, type) \
+        BINOP(start + 7, OVMI_VLE,   type) \
+        BINOP(start + 8, OVMI_VGE_S, type) \
+        BINOP(start + 9, OVMI_VGE,   type)
+
+#define FLOAT_COMPARE_GROUP(start, type) \
+        BINOP(start + 0, OVMI_VEQ, type) \
+        BINOP(start + 1, OVMI_VNE, type) \
+        BINOP(start + 2, OVMI_VLT, type) \
+        BINOP(start + 3, OVMI_VGT, type) \
+        BINOP(start + 4, OVMI_VLE, type) \
+        BINOP(start + 5, OVMI_VGE, type)
+
+        INT_COMPARE_GROUP(35, OVM_TYPE_I8)
+        INT_COMPARE_GROUP(45, OVM_TYPE_I16)
+        INT_COMPARE_GROUP(55, OVM_TYPE_I32)
+        FLOAT_COMPARE_GROUP(65, OVM_TYPE_F32)
+        FLOAT_COMPARE_GROUP(71, OVM_TYPE_F64)
+
+#undef FLOAT_COMPARE_GROUP
+#undef INT_COMPARE_GROUP
+
+        UNOP (77, OVMI_VNOT,    OVM_TYPE_V128)
+        BINOP(78, OVMI_VAND,    OVM_TYPE_V128)
+        BINOP(79, OVMI_VANDNOT, OVM_TYPE_V128)
+        BINOP(80, OVMI_VOR,     OVM_TYPE_V128)
+        BINOP(81, OVMI_VXOR,    OVM_TYPE_V128)
+        case 82: ovm_code_builder_add_bitselect(&ctx->builder); break;
+
+//
+// The i8x16, i16x8 and i32x4 groups share the same layout, 32 opcodes apart.
+#define INT_GROUP(start, type) \
+        UNOP (start + 0,  OVMI_VABS,      type) \
+        UNOP (start + 1,  OVMI_VNEG,      type) \
+        UNOP (start + 2,  OVMI_VANY_TRUE, type) \
+        UNOP (start + 3,  OVMI_VALL_TRUE, type) \
+        UNOP (start + 4,  OVMI_VBITMASK,  type) \
+        BINOP(start + 11, OVMI_VSHL,      type) \
+        BINOP(start + 12, OVMI_VSAR,      type) \
+        BINOP(start + 13, OVMI_VSHR,      type) \
+        BINOP(start + 14, OVMI_VADD,      type) \
+        BINOP(start + 17, OVMI_VSUB,      type)
+
+#define SMALL_INT_GROUP(start, type) \
+        BINOP(start + 5,  OVMI_VNARROW_S,  type) \
+        BINOP(start + 6,  OVMI_VNARROW,    type) \
+        BINOP(start + 15, OVMI_VADD_SAT_S, type) \
+        BINOP(start + 16, OVMI_VADD_SAT,   type) \
+        BINOP(start + 18, OVMI_VSUB_SAT_S, type) \
+        BINOP(start + 19, OVMI_VSUB_SAT,   type) \
+        BINOP(start + 27, OVMI_VAVGR,      type)
+
+#define MINMAX_GROUP(start, type) \
+        BINOP(start + 0, OVMI_VMIN_S, type) \
+        BINOP(start + 1, OVMI_VMIN,   type) \
+        BINOP(start + 2, OVMI_VMAX_S, type) \
+        BINOP(start + 3, OVMI_VMAX,   type)
+
+#define WIDEN_GROUP(start, type) \
+        UNOP(start + 0, OVMI_VWIDEN_LOW_S,  type) \
+        UNOP(start + 1, OVMI_VWIDEN_HIGH_S, type) \
+        UNOP(start + 2, OVMI_VWIDEN_LOW,    type) \
+        UNOP(start + 3, OVMI_VWIDEN_HIGH,   type)
+
+        INT_GROUP(96, OVM_TYPE_I8)
+        SMALL_INT_GROUP(96, OVM_TYPE_I8)
+        MINMAX_GROUP(118, OVM_TYPE_I8)
+
+        INT_GROUP(128, OVM_TYPE_I16)
+        SMALL_INT_GROUP(128, OVM_TYPE_I16)
+        WIDEN_GROUP(135, OVM_TYPE_I16)
+        BINOP(149, OVMI_VMUL, OVM_TYPE_I16)
+        MINMAX_GROUP(150, OVM_TYPE_I16)
+
+        INT_GROUP(160, OVM_TYPE_I32)
+        WIDEN_GROUP(167, OVM_TYPE_I32)
+        BINOP(181, OVMI_VMUL, OVM_TYPE_I32)
+        MINMAX_GROUP(182, OVM_TYPE_I32)
+
+#undef WIDEN_GROUP
+#undef MINMAX_GROUP
+#undef SMALL_INT_GROUP
+#undef INT_GROUP
+
+        UNOP (193, OVMI_VNEG, OVM_TYPE_I64)
+        BINOP(203, OVMI_VSHL, OVM_TYPE_I64)
+        BINOP(204, OVMI_VSAR, OVM_TYPE_I64)
+        BINOP(205, OVMI_VSHR, OVM_TYPE_I64)
+        BINOP(206, OVMI_VADD, OVM_TYPE_I64)
+        BINOP(209, OVMI_VSUB, OVM_TYPE_I64)
+        BINOP(213, OVMI_VMUL, OVM_TYPE_I64)
+
+#define FLOAT_GROUP(start, type) \
+        UNOP (start + 0, OVMI_VABS,  type) \
+        UNOP (start + 1, OVMI_VNEG,  type) \
+        UNOP (start + 3, OVMI_VSQRT, type) \
+        BINOP(start + 4, OVMI_VADD,  type) \
+        BINOP(start + 5, OVMI_VSUB,  type) \
+        BINOP(start + 6, OVMI_VMUL,  type) \
+        BINOP(start + 7, OVMI_VDIV,  type) \
+        BINOP(start + 8, OVMI_VMIN,  type) \
+        BINOP(start + 9, OVMI_VMAX,  type)
+
+        FLOAT_GROUP(224, OVM_TYPE_F32)
+        FLOAT_GROUP(236, OVM_TYPE_F64)
+
+#undef FLOAT_GROUP
+
+        UNOP(248, OVMI_VTRUNC_SAT_S, OVM_TYPE_I32)
+        UNOP(249, OVMI_VTRUNC_SAT,   OVM_TYPE_I32)
+        UNOP(250, OVMI_VCONVERT_S,   OVM_TYPE_F32)
+        UNOP(251, OVMI_VCONVERT,     OVM_TYPE_F32)
+
+        default: assert(0 && "UNHANDLED SIMD INSTRUCTION");
+    }
+
+#undef BINOP
+#undef UNOP
+#undef V
+}
+
 static void parse_instruction(build_context *ctx) {
     debug_info_builder_step(&ctx->debug_builder);
 
@@ -899,6 +1136,7 @@ static void parse_instruction(build_context *ctx) {
         case 0xC4: ovm_code_builder_add_unop (&ctx->builder, OVM_TYPED_INSTR(OVMI_CVT_I32_S, OVM_TYPE_I64)); break;
 
         case 0xFC: parse_fc_instruction(ctx); break;
+        case 0xFD: parse_fd_instruction(ctx); break;
         case 0xFE: parse_fe_instruction(ctx); break;
 
         default: assert(0 && "UNHANDLED INSTRUCTION");
@@ -913,6 +1151,7 @@ static void parse_expression(build_context *ctx) {
 
 static void parse_code_section(build_context *ctx) {
     unsigned int section_size = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
+    unsigned int section_start = ctx->offset;
     unsigned int code_count = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
     assert(ctx->module->functypes.size == code_count);
 
@@ -921,6 +1160,11 @@ static void parse_code_section(build_context *ctx) {
     // HACK HACK HACK THIS IS SUCH A BAD WAY OF DOING THIS
     ctx->module->memory_init_idx = bh_arr_length(ctx->program->funcs) + code_count;
 
+    if (ctx->code_cached) {
+        ctx->offset = section_start + section_size;
+        return;
+    }
+
     fori (i, 0, (int) code_count) {
         unsigned int code_size = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
         unsigned int local_sections_count = uleb128_to_uint((u8 *)ctx->binary.data, (i32 *)&ctx->offset);
@@ -17,6 +17,7 @@ static wasm_valtype_t
     valtype_i64     = { WASM_I64 },
     valtype_f32     = { WASM_F32 },
     valtype_f64     = { WASM_F64 },
+    valtype_v128    = { WASM_V128 },
     valtype_anyref  = { WASM_ANYREF },
     valtype_funcref = { WASM_FUNCREF };
 
@@ -27,6 +28,7 @@ wasm_valtype_t *wasm_valtype_new(wasm_valkind_t kind) {
         case WASM_I64:     return &valtype_i64;
         case WASM_F32:     return &valtype_f32;
         case WASM_F64:     return &valtype_f64;
+        case WASM_V128:    return &valtype_v128;
         case WASM_ANYREF:  return &valtype_anyref;
         case WASM_FUNCREF: return &valtype_funcref;
         default: assert(0);
@@ -23,11 +23,14 @@
     #include <poll.h>
     #include <termios.h>
     #include <sys/ioctl.h>
+    #include <sys/uio.h>
+    #include <sys/mman.h>
     #include <unistd.h>
 #endif
 
 #if defined(_BH_LINUX)
     #include <linux/futex.h>
+    #include <sys/epoll.h>
 #endif
 
 #if defined(_BH_DARWIN)
@@ -63,6 +66,13 @@ ONYX_LIBRARY {
     ONYX_FUNC(__file_tell)
     ONYX_FUNC(__file_read)
     ONYX_FUNC(__file_write)
+    ONYX_FUNC(__file_pread)
+    ONYX_FUNC(__file_pwrite)
+    ONYX_FUNC(__file_readv)
+    ONYX_FUNC(__file_writev)
+    ONYX_FUNC(__file_map_page_size)
+    ONYX_FUNC(__file_map)
+    ONYX_FUNC(__file_unmap)
     ONYX_FUNC(__file_flush)
     ONYX_FUNC(__file_size)
     ONYX_FUNC(__file_get_standard)
@@ -124,6 +134,10 @@ ONYX_LIBRARY {
     ONYX_FUNC(__net_resolve_start)
     ONYX_FUNC(__net_resolve_next)
     ONYX_FUNC(__net_resolve_end)
+    ONYX_FUNC(__net_poller_create)
+    ONYX_FUNC(__net_poller_close)
+    ONYX_FUNC(__net_poller_ctl)
+    ONYX_FUNC(__net_poller_wait)
 
     ONYX_FUNC(__cptr_make)
     ONYX_FUNC(__cptr_read)
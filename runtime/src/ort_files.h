@@ -124,39 +124,301 @@ ONYX_DEF(__file_tell, (WASM_I64), (WASM_I32)) {
     return NULL;
 }
 
-ONYX_DEF(__file_read, (WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
-    i64 fd = params->data[0].of.i64;
-    bh_file file = { (bh_file_descriptor) fd };
+//
+// Reading and writing use the file descriptor's position directly, so each call is a
+// single system call. The positional versions do not move the file's position.
+//
+// The result is 0 on success, or 2 if the operation failed.
+//
+
+static b32 onyx_file_read(i64 fd, void *buffer, i32 length, i64 *bytes_read) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    isize res = read((i32) fd, buffer, length);
+    if (res < 0) return 0;
+    *bytes_read = res;
+    return 1;
+#endif
 
-    i32 curr_pos = bh_file_tell(&file);
-    b32 success = bh_file_read_at(&file,
-            bh_file_tell(&file),
+#ifdef _BH_WINDOWS
+    DWORD read_count = 0;
+    if (!ReadFile((HANDLE) fd, buffer, length, &read_count, NULL)) return 0;
+    *bytes_read = read_count;
+    return 1;
+#endif
+}
+
+static b32 onyx_file_write(i64 fd, void *buffer, i32 length, i64 *bytes_wrote) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    isize res = write((i32) fd, buffer, length);
+    if (res < 0) return 0;
+    *bytes_wrote = res;
+    return 1;
+#endif
+
+#ifdef _BH_WINDOWS
+    DWORD write_count = 0;
+    if (!WriteFile((HANDLE) fd, buffer, length, &write_count, NULL)) return 0;
+    *bytes_wrote = write_count;
+    return 1;
+#endif
+}
+
+ONYX_DEF(__file_read, (WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    i64 bytes_read = 0;
+    b32 success = onyx_file_read(params->data[0].of.i64,
             ONYX_PTR(params->data[1].of.i32),
             params->data[2].of.i32,
-            (i64 *) ONYX_PTR(params->data[3].of.i32));
+            &bytes_read);
 
-    bh_file_seek_to(&file, curr_pos + *(i32 *) ONYX_PTR(params->data[3].of.i32));
+    if (params->data[3].of.i32) *(i64 *) ONYX_PTR(params->data[3].of.i32) = bytes_read;
 
-    results->data[0] = WASM_I32_VAL(0);
-    if (!success) results->data[0] = WASM_I32_VAL(2);
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
     return NULL;
 }
 
 ONYX_DEF(__file_write, (WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
-    i64 fd = params->data[0].of.i64;
-    bh_file file = { (bh_file_descriptor) fd };
-
-    i32 curr_pos = bh_file_tell(&file);
-    b32 success = bh_file_write_at(&file,
-            bh_file_tell(&file),
+    i64 bytes_wrote = 0;
+    b32 success = onyx_file_write(params->data[0].of.i64,
             ONYX_PTR(params->data[1].of.i32),
             params->data[2].of.i32,
-            (i64 *) ONYX_PTR(params->data[3].of.i32));
+            &bytes_wrote);
+
+    if (params->data[3].of.i32) *(i64 *) ONYX_PTR(params->data[3].of.i32) = bytes_wrote;
+
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
+    return NULL;
+}
+
+#ifdef _BH_WINDOWS
+//
+// Files are not opened for overlapped I/O, so ReadFile and WriteFile still move the
+// file pointer when they are given an offset. pread and pwrite do not, so the file
+// pointer is put back afterwards. Unlike pread and pwrite, this is not atomic: the
+// file pointer can be wrong while another thread uses the same file.
+static LARGE_INTEGER onyx_file_position(HANDLE handle) {
+    LARGE_INTEGER zero = {0}, position = {0};
+    SetFilePointerEx(handle, zero, &position, FILE_CURRENT);
+    return position;
+}
+#endif
+
+ONYX_DEF(__file_pread, (WASM_I64, WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    i64 fd      = params->data[0].of.i64;
+    i64 offset  = params->data[1].of.i64;
+    void *buf   = ONYX_PTR(params->data[2].of.i32);
+    i32 length  = params->data[3].of.i32;
+    b32 success = 0;
+    i64 bytes_read = 0;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    isize res = pread((i32) fd, buf, length, offset);
+    if (res >= 0) {
+        bytes_read = res;
+        success = 1;
+    }
+#endif
+
+#ifdef _BH_WINDOWS
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset     = (DWORD) offset;
+    overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+    LARGE_INTEGER position = onyx_file_position((HANDLE) fd);
+
+    DWORD read_count = 0;
+    success = ReadFile((HANDLE) fd, buf, length, &read_count, &overlapped) || GetLastError() == ERROR_HANDLE_EOF;
+    bytes_read = read_count;
+
+    SetFilePointerEx((HANDLE) fd, position, NULL, FILE_BEGIN);
+#endif
+
+    if (params->data[4].of.i32) *(i64 *) ONYX_PTR(params->data[4].of.i32) = bytes_read;
+
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
+    return NULL;
+}
+
+ONYX_DEF(__file_pwrite, (WASM_I64, WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    i64 fd      = params->data[0].of.i64;
+    i64 offset  = params->data[1].of.i64;
+    void *buf   = ONYX_PTR(params->data[2].of.i32);
+    i32 length  = params->data[3].of.i32;
+    b32 success = 0;
+    i64 bytes_wrote = 0;
 
-    bh_file_seek_to(&file, curr_pos + *(i32 *) ONYX_PTR(params->data[3].of.i32));
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    isize res = pwrite((i32) fd, buf, length, offset);
+    if (res >= 0) {
+        bytes_wrote = res;
+        success = 1;
+    }
+#endif
+
+#ifdef _BH_WINDOWS
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset     = (DWORD) offset;
+    overlapped.OffsetHigh = (DWORD) (offset >> 32);
+
+    LARGE_INTEGER position = onyx_file_position((HANDLE) fd);
+
+    DWORD write_count = 0;
+    success = WriteFile((HANDLE) fd, buf, length, &write_count, &overlapped);
+    bytes_wrote = write_count;
+
+    SetFilePointerEx((HANDLE) fd, position, NULL, FILE_BEGIN);
+#endif
+
+    if (params->data[4].of.i32) *(i64 *) ONYX_PTR(params->data[4].of.i32) = bytes_wrote;
+
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
+    return NULL;
+}
+
+//
+// The vectored versions take a slice of buffers ([] [] u8). At most
+// ONYX_MAX_IO_VECTORS buffers are used by one call; like a short read or
+// write, the caller has to continue with the remaining buffers.
+//
+#define ONYX_MAX_IO_VECTORS 64
+
+typedef struct OnyxIOVector {
+    u32 data;
+    u32 count;
+} OnyxIOVector;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+static i32 onyx_fill_io_vectors(struct iovec *iov, i32 buffers, i32 buffer_count) {
+    OnyxIOVector *onyx_iov = ONYX_PTR(buffers);
+    i32 count = bh_min(buffer_count, ONYX_MAX_IO_VECTORS);
+
+    fori (i, 0, count) {
+        iov[i].iov_base = ONYX_PTR(onyx_iov[i].data);
+        iov[i].iov_len  = onyx_iov[i].count;
+    }
+
+    return count;
+}
+#endif
+
+ONYX_DEF(__file_readv, (WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    i64 fd = params->data[0].of.i64;
+    b32 success = 1;
+    i64 bytes_read = 0;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    struct iovec iov[ONYX_MAX_IO_VECTORS];
+    i32 count = onyx_fill_io_vectors(iov, params->data[1].of.i32, params->data[2].of.i32);
+
+    isize res = readv((i32) fd, iov, count);
+    if (res < 0) success = 0;
+    else         bytes_read = res;
+#endif
+
+#ifdef _BH_WINDOWS
+    OnyxIOVector *onyx_iov = ONYX_PTR(params->data[1].of.i32);
+    fori (i, 0, params->data[2].of.i32) {
+        i64 part = 0;
+        success = onyx_file_read(fd, ONYX_PTR(onyx_iov[i].data), onyx_iov[i].count, &part);
+        if (!success) break;
+
+        bytes_read += part;
+        if (part < onyx_iov[i].count) break;
+    }
+#endif
+
+    if (params->data[3].of.i32) *(i64 *) ONYX_PTR(params->data[3].of.i32) = bytes_read;
+
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
+    return NULL;
+}
+
+ONYX_DEF(__file_writev, (WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    i64 fd = params->data[0].of.i64;
+    b32 success = 1;
+    i64 bytes_wrote = 0;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    struct iovec iov[ONYX_MAX_IO_VECTORS];
+    i32 count = onyx_fill_io_vectors(iov, params->data[1].of.i32, params->data[2].of.i32);
+
+    isize res = writev((i32) fd, iov, count);
+    if (res < 0) success = 0;
+    else         bytes_wrote = res;
+#endif
+
+#ifdef _BH_WINDOWS
+    OnyxIOVector *onyx_iov = ONYX_PTR(params->data[1].of.i32);
+    fori (i, 0, params->data[2].of.i32) {
+        i64 part = 0;
+        success = onyx_file_write(fd, ONYX_PTR(onyx_iov[i].data), onyx_iov[i].count, &part);
+        if (!success) break;
+
+        bytes_wrote += part;
+        if (part < onyx_iov[i].count) break;
+    }
+#endif
+
+    if (params->data[3].of.i32) *(i64 *) ONYX_PTR(params->data[3].of.i32) = bytes_wrote;
+
+    results->data[0] = WASM_I32_VAL(success ? 0 : 2);
+    return NULL;
+}
+
+//
+// Mapping files into linear memory
+//
+// When the runtime's linear memory is a host mapping (as it is with OVM), a file can be
+// mapped directly over a page-aligned region of it. The Onyx side allocates the region,
+// and restores it with __file_unmap before freeing it. Other runtimes report a page
+// size of 0, and the contents are read instead.
+//
+// Mode 1 maps the file read-only; mode 2 maps it copy-on-write. In neither mode do
+// writes reach the file.
+//
+
+ONYX_DEF(__file_map_page_size, (), (WASM_I32)) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    if (runtime->wasm_memory_host_mapped) {
+        results->data[0] = WASM_I32_VAL(getpagesize());
+        return NULL;
+    }
+#endif
+
+    results->data[0] = WASM_I32_VAL(0);
+    return NULL;
+}
+
+ONYX_DEF(__file_map, (WASM_I64, WASM_I64, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    i64 fd     = params->data[0].of.i64;
+    i64 offset = params->data[1].of.i64;
+    void *addr = ONYX_PTR(params->data[2].of.i32);
+    u32 length = (u32) params->data[3].of.i32;
+    i32 mode   = params->data[4].of.i32;
+
+    int prot = mode == 1 ? PROT_READ : (PROT_READ | PROT_WRITE);
+
+    void *mapped = mmap(addr, length, prot, MAP_PRIVATE | MAP_FIXED, (int) fd, offset);
+    results->data[0] = WASM_I32_VAL(mapped == addr);
+    return NULL;
+#endif
+
+    results->data[0] = WASM_I32_VAL(0);
+    return NULL;
+}
+
+ONYX_DEF(__file_unmap, (WASM_I32, WASM_I32), (WASM_I32)) {
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    void *addr = ONYX_PTR(params->data[0].of.i32);
+    u32 length = (u32) params->data[1].of.i32;
+
+    // Replaces the file mapping with zeroed memory, like the rest of the linear memory.
+    void *mapped = mmap(addr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    results->data[0] = WASM_I32_VAL(mapped == addr);
+    return NULL;
+#endif
 
     results->data[0] = WASM_I32_VAL(0);
-    if (!success) results->data[0] = WASM_I32_VAL(2);
     return NULL;
 }
 
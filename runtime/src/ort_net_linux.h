@@ -107,6 +107,12 @@ ONYX_DEF(__net_setting_flag, (WASM_I32, WASM_I32, WASM_I32), ()) {
             setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (void *) &params->data[2].of.i32, sizeof(int));
             break;
         }
+
+        case 4: { // :EnumDependent  Reuse-Port
+            int s = params->data[0].of.i32;
+            setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (void *) &params->data[2].of.i32, sizeof(int));
+            break;
+        }
     }
 
     return NULL;
@@ -477,3 +483,110 @@ ONYX_DEF(__net_resolve_end, (WASM_I64), ()) {
 }
 
 
+
+
+//
+// Readiness polling
+//
+// Sockets are registered with a poller once, and waiting only reports the
+// sockets that have something to do. Unlike __poll, the cost of a wait does
+// not grow with the number of registered sockets. This uses epoll on Linux;
+// elsewhere __net_poller_create fails and callers fall back to __poll.
+//
+
+// :EnumDependent These match Socket_Poller.Events.
+#define ONYX_POLLER_READABLE       0x01
+#define ONYX_POLLER_WRITABLE       0x02
+#define ONYX_POLLER_CLOSED         0x04
+#define ONYX_POLLER_EDGE_TRIGGERED 0x08
+
+#define ONYX_POLLER_MAX_EVENTS 256
+
+#if defined(_BH_LINUX)
+static u32 onyx_poller_events_to_epoll(i32 events) {
+    u32 result = 0;
+    if (events & ONYX_POLLER_READABLE)       result |= EPOLLIN;
+    if (events & ONYX_POLLER_WRITABLE)       result |= EPOLLOUT;
+    if (events & ONYX_POLLER_EDGE_TRIGGERED) result |= EPOLLET;
+    return result;
+}
+
+static i32 epoll_events_to_onyx_poller(u32 events) {
+    i32 result = 0;
+    if (events & EPOLLIN)               result |= ONYX_POLLER_READABLE;
+    if (events & EPOLLOUT)              result |= ONYX_POLLER_WRITABLE;
+    if (events & (EPOLLHUP | EPOLLERR)) result |= ONYX_POLLER_CLOSED;
+    return result;
+}
+#endif
+
+ONYX_DEF(__net_poller_create, (), (WASM_I32)) {
+    #if defined(_BH_LINUX)
+    results->data[0] = WASM_I32_VAL(epoll_create1(EPOLL_CLOEXEC));
+    #else
+    results->data[0] = WASM_I32_VAL(-1);
+    #endif
+
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_close, (WASM_I32), ()) {
+    #if defined(_BH_LINUX)
+    close(params->data[0].of.i32);
+    #endif
+
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_ctl, (WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I64), (WASM_I32)) {
+    #if defined(_BH_LINUX)
+    int op;
+    switch (params->data[1].of.i32) {
+        // :EnumDependent These match Socket_Poller.Operation.
+        case 0: op = EPOLL_CTL_ADD; break;
+        case 1: op = EPOLL_CTL_MOD; break;
+        case 2: op = EPOLL_CTL_DEL; break;
+        default:
+            results->data[0] = WASM_I32_VAL(0);
+            return NULL;
+    }
+
+    struct epoll_event event;
+    event.events   = onyx_poller_events_to_epoll(params->data[3].of.i32);
+    event.data.u64 = params->data[4].of.i64;
+
+    int res = epoll_ctl(params->data[0].of.i32, op, params->data[2].of.i32, &event);
+    results->data[0] = WASM_I32_VAL(res == 0);
+    #else
+    results->data[0] = WASM_I32_VAL(0);
+    #endif
+
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_wait, (WASM_I32, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    #if defined(_BH_LINUX)
+    struct epoll_event events[ONYX_POLLER_MAX_EVENTS];
+    int max_events = bh_min(params->data[2].of.i32, ONYX_POLLER_MAX_EVENTS);
+
+    int count = epoll_wait(params->data[0].of.i32, events, max_events, params->data[3].of.i32);
+    if (count < 0) {
+        // Being interrupted by a signal is treated as a wait that timed out.
+        results->data[0] = WASM_I32_VAL(errno == EINTR ? 0 : -1);
+        return NULL;
+    }
+
+    // Each output event is { data: u64; events: u32; }, padded to 16 bytes.
+    u8 *out = ONYX_PTR(params->data[1].of.i32);
+    for (int i = 0; i < count; i++) {
+        *(u64 *) (out + 16 * i)     = events[i].data.u64;
+        *(i32 *) (out + 16 * i + 8) = epoll_events_to_onyx_poller(events[i].events);
+    }
+
+    results->data[0] = WASM_I32_VAL(count);
+    #else
+    results->data[0] = WASM_I32_VAL(-1);
+    #endif
+
+    return NULL;
+}
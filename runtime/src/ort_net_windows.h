@@ -99,3 +99,22 @@ ONYX_DEF(__net_resolve_next, (WASM_I64, WASM_I32, WASM_I32), (WASM_I64)) {
 ONYX_DEF(__net_resolve_end, (WASM_I64), ()) {
     return NULL;
 }
+
+ONYX_DEF(__net_poller_create, (), (WASM_I32)) {
+    results->data[0] = WASM_I32_VAL(-1);
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_close, (WASM_I32), ()) {
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_ctl, (WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I64), (WASM_I32)) {
+    results->data[0] = WASM_I32_VAL(0);
+    return NULL;
+}
+
+ONYX_DEF(__net_poller_wait, (WASM_I32, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
+    results->data[0] = WASM_I32_VAL(-1);
+    return NULL;
+}
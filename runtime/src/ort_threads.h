@@ -21,7 +21,39 @@ typedef struct OnyxThread {
     #endif
 } OnyxThread;
 
-static bh_arr(OnyxThread) threads = NULL;
+//
+// Threads are detached as soon as they are created, and remove themselves from
+// this list when they exit. The list only exists so __kill_thread can find them.
+static bh_arr(OnyxThread *) threads = NULL;
+
+#if defined(_BH_LINUX) || defined(_BH_DARWIN)
+    static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+    #define THREADS_LOCK()   pthread_mutex_lock(&threads_lock)
+    #define THREADS_UNLOCK() pthread_mutex_unlock(&threads_lock)
+#endif
+
+#ifdef _BH_WINDOWS
+    static SRWLOCK threads_lock = SRWLOCK_INIT;
+    #define THREADS_LOCK()   AcquireSRWLockExclusive(&threads_lock)
+    #define THREADS_UNLOCK() ReleaseSRWLockExclusive(&threads_lock)
+#endif
+
+// Returns true if the thread was still in the list.
+static b32 onyx_remove_thread(OnyxThread *thread) {
+    b32 found = 0;
+
+    THREADS_LOCK();
+    fori (i, 0, bh_arr_length(threads)) {
+        if (threads[i] == thread) {
+            bh_arr_fastdelete(threads, i);
+            found = 1;
+            break;
+        }
+    }
+    THREADS_UNLOCK();
+
+    return found;
+}
 
 #if defined(_BH_LINUX) || defined(_BH_DARWIN)
 static void *onyx_run_thread(void *data) {
@@ -39,10 +71,6 @@ static i32 onyx_run_thread(void *data) {
 
     wasm_trap_t* trap=NULL;
 
-    // NOTE: This is cached in a local variable because there is a tiny chance that if a lot of threads are created
-    // then the backing array for the thread handles will move and thread* we have well not be valid. I'm betting on this
-    // not happening before now in the function; however, it *could* happen before we call thread_exit. This would be bad
-    // because of the normal reasons why accessing memory that you don't own any more is bad.
     i32 thread_id = thread->id;
 
     { // Call the _thread_start procedure
@@ -74,13 +102,19 @@ static i32 onyx_run_thread(void *data) {
 
     runtime->wasm_instance_delete(thread->instance);
 
+    // If the thread was killed, __kill_thread already closed the handle.
+    if (onyx_remove_thread(thread)) {
+        #ifdef _BH_WINDOWS
+        CloseHandle(thread->thread_handle);
+        #endif
+    }
+
+    bh_free(bh_heap_allocator(), thread);
     return 0;
 }
 
 ONYX_DEF(__spawn_thread, (WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I32), (WASM_I32)) {
-    if (threads == NULL) bh_arr_new(bh_heap_allocator(), threads, 128);
-    bh_arr_insert_end(threads, 1);
-    OnyxThread *thread = &bh_arr_last(threads);
+    OnyxThread *thread = bh_alloc_item(bh_heap_allocator(), OnyxThread);
 
     thread->id         = params->data[0].of.i32;
     thread->tls_base   = params->data[1].of.i32;
@@ -89,18 +123,29 @@ ONYX_DEF(__spawn_thread, (WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM
     thread->closureptr = params->data[4].of.i32;
     thread->dataptr    = params->data[5].of.i32;
 
-    wasm_trap_t* traps = NULL;
-    thread->instance = runtime->wasm_instance_new(runtime->wasm_store, runtime->wasm_module, &runtime->wasm_imports, &traps);
+    if (runtime->wasm_instance_new_thread) {
+        thread->instance = runtime->wasm_instance_new_thread(runtime->wasm_instance);
+    } else {
+        wasm_trap_t* traps = NULL;
+        thread->instance = runtime->wasm_instance_new(runtime->wasm_store, runtime->wasm_module, &runtime->wasm_imports, &traps);
+    }
     assert(thread->instance);
 
+    // The thread has to be in the list before it starts, because it removes itself when it exits.
+    THREADS_LOCK();
+    if (threads == NULL) bh_arr_new(bh_heap_allocator(), threads, 128);
+    bh_arr_push(threads, thread);
+
     #if defined(_BH_LINUX) || defined(_BH_DARWIN)
         pthread_create(&thread->thread, NULL, onyx_run_thread, thread);
+        pthread_detach(thread->thread);
     #endif
 
     #ifdef _BH_WINDOWS
         // thread->thread_handle = CreateThread(NULL, 0, onyx_run_thread, thread, 0, &thread->thread_id);
         thread->thread_handle = (HANDLE) _beginthreadex(NULL, 0, onyx_run_thread, thread, 0, &thread->thread_id);
     #endif
+    THREADS_UNLOCK();
 
     results->data[0] = WASM_I32_VAL(1);
     return NULL;
@@ -109,8 +154,11 @@ ONYX_DEF(__spawn_thread, (WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM_I32, WASM
 ONYX_DEF(__kill_thread, (WASM_I32), (WASM_I32)) {
     i32 thread_id = params->data[0].of.i32;
 
+    THREADS_LOCK();
+
     i32 i = 0;
-    bh_arr_each(OnyxThread, thread, threads) {
+    bh_arr_each(OnyxThread *, pthread, threads) {
+        OnyxThread *thread = *pthread;
         if (thread->id == thread_id) {
             #if defined(_BH_LINUX) || defined(_BH_DARWIN)
             // This leads to some weirdness and bugs...
@@ -124,7 +172,9 @@ ONYX_DEF(__kill_thread, (WASM_I32), (WASM_I32)) {
             CloseHandle(thread->thread_handle);
             #endif
 
-            bh_arr_deleten(threads, i, 1);
+            bh_arr_fastdelete(threads, i);
+            THREADS_UNLOCK();
+
             results->data[0] = WASM_I32_VAL(1);
             return NULL;
         }
@@ -132,6 +182,8 @@ ONYX_DEF(__kill_thread, (WASM_I32), (WASM_I32)) {
         i++;
     }
 
+    THREADS_UNLOCK();
+
     results->data[0] = WASM_I32_VAL(0);
     return NULL;
 }
@@ -14,6 +14,7 @@
 
 
 typedef struct onyx_context_t onyx_context_t;
+typedef struct onyx_source_cache_t onyx_source_cache_t;
 
 typedef enum onyx_option_t {
     ONYX_OPTION_NO_OP,
@@ -42,12 +43,18 @@ typedef enum onyx_option_t {
     ONYX_OPTION_COLLECT_PERF,
 
     ONYX_OPTION_PLATFORM,
+
+    ONYX_OPTION_DISABLE_TREE_SHAKING,
+    ONYX_OPTION_DISABLE_PEEPHOLE,
+
+    ONYX_OPTION_COLLECT_TRACE,
 } onyx_option_t;
 
 typedef enum onyx_pump_t {
     ONYX_PUMP_CONTINUE,
     ONYX_PUMP_DONE,
     ONYX_PUMP_ERRORED,
+    ONYX_PUMP_PAUSED,
 } onyx_pump_t;
 
 typedef enum onyx_platform_t {
@@ -69,12 +76,43 @@ typedef enum onyx_output_type_t {
     ONYX_OUTPUT_TYPE_JS   = 1,
     ONYX_OUTPUT_TYPE_ODOC = 2,
     ONYX_OUTPUT_TYPE_OSYM = 3,
+
+    // Only available when ONYX_OPTION_COLLECT_TRACE is set. These can be
+    // requested even if the compilation failed.
+    ONYX_OUTPUT_TYPE_TRACE         = 4, // Chrome trace event JSON
+    ONYX_OUTPUT_TYPE_TRACE_SUMMARY = 5, // Plain text, for printing
+
+    // Plain text listing the polymorphic procedures with the most instances.
+    ONYX_OUTPUT_TYPE_POLYMORPH_SUMMARY = 6,
 } onyx_output_type_t;
 
 typedef enum onyx_stat_t {
     ONYX_STAT_FILE_COUNT  = 1,
     ONYX_STAT_LINE_COUNT  = 2,
     ONYX_STAT_TOKEN_COUNT = 3,
+
+    ONYX_STAT_ENTITIES_PROCESSED = 4,
+    ONYX_STAT_ENTITIES_YIELDED   = 5,
+    ONYX_STAT_ENTITIES_PARKED    = 6,
+    ONYX_STAT_ENTITIES_WOKEN     = 7,
+
+    ONYX_STAT_SOURCE_CACHE_HITS   = 8,
+    ONYX_STAT_SOURCE_CACHE_MISSES = 9,
+
+    ONYX_STAT_FUNCTIONS_REMOVED    = 10,
+    ONYX_STAT_INSTRUCTIONS_REMOVED = 11,
+
+    // Bytes of memory used by the compiler, grouped by what they hold.
+    ONYX_STAT_MEMORY_SOURCE       = 12,
+    ONYX_STAT_MEMORY_TOKENS       = 13,
+    ONYX_STAT_MEMORY_AST          = 14,
+    ONYX_STAT_MEMORY_ENTITIES     = 15,
+    ONYX_STAT_MEMORY_INSTRUCTIONS = 16,
+
+    ONYX_STAT_POLYMORPH_LOOKUPS   = 17,
+    ONYX_STAT_POLYMORPH_INSTANCES = 18,
+
+    ONYX_STAT_DATA_SEGMENTS_REMOVED = 19,
 } onyx_stat_t;
 
 typedef enum onyx_event_type_t {
@@ -110,6 +148,15 @@ API void onyx_context_free(onyx_context_t *ctx);
 API void onyx_options_ready(onyx_context_t *ctx);
 API onyx_pump_t onyx_pump(onyx_context_t *ctx);
 
+/// A source cache keeps source files that have been read and tokenized, so later
+/// compilations only redo that work for the files that changed on disk. A cache can
+/// be given to any number of contexts, but only one of them can be alive at a time.
+API onyx_source_cache_t *onyx_source_cache_create();
+API void onyx_source_cache_free(onyx_source_cache_t *cache);
+
+/// Call before `onyx_options_ready`.
+API void onyx_context_set_source_cache(onyx_context_t *ctx, onyx_source_cache_t *cache);
+
 
 //
 // Events
@@ -142,6 +189,26 @@ API void onyx_add_mapped_dir(onyx_context_t *ctx, char *mapped_name, int32_t map
 /// Directly injects Onyx code as a new compilation unit
 API void onyx_inject_code(onyx_context_t *ctx, uint8_t *code, int32_t length);
 
+/// Leaves a file out of the compilation until `onyx_release_held_files` is called, as if
+/// nothing loaded it. Takes the full path, and must be called before `onyx_options_ready`.
+/// While files are held, `onyx_pump` returns ONYX_PUMP_PAUSED once everything that does
+/// not depend on them has been checked. Nothing is emitted before they are released.
+API void onyx_hold_file(onyx_context_t *ctx, char *filename, int32_t length);
+
+/// Loads the held files and lets the compilation run to the end. A paused context can be
+/// forked (on Linux and MacOS) and released in the child, to compile any number of
+/// versions of the held files without checking the rest of the program again.
+API void onyx_release_held_files(onyx_context_t *ctx);
+
+/// After release, the held files can change decisions made while they were held. For
+/// example, they could declare a symbol that shadows the one a lookup already found, or
+/// add an option to an overloaded procedure that was already called. The result could
+/// then differ from compiling everything at once, so `onyx_pump` stops with
+/// ONYX_PUMP_ERRORED. These are the files where those decisions were made, or NULL if
+/// the file is not known. Holding them as well avoids the conflict.
+API int32_t     onyx_held_file_conflict_count(onyx_context_t *ctx);
+API const char *onyx_held_file_conflict_filepath(onyx_context_t *ctx, int32_t conflict_index);
+
 //
 // Errors 
 //
@@ -178,5 +245,14 @@ API const char *onyx_stat_filepath(onyx_context_t *ctx, int32_t file_index);
 API void onyx_run_wasm(void *buffer, int32_t buffer_length, int argc, char **argv);
 API void onyx_run_wasm_with_debug(void *buffer, int32_t buffer_length, int argc, char **argv, char *socket_path);
 
+// Sets the directory where the Onyx runtime keeps translated programs, so later runs
+// of the same WASM binary start without translating it again. Must be called before
+// running. Ignored by other runtimes and when debugging.
+API void onyx_run_set_program_cache_dir(char *dir);
+
+// Enables or disables compiling frequently called functions to native code. It is
+// enabled by default. Must be called before running. Ignored by other runtimes.
+API void onyx_run_set_jit_enabled(int32_t enabled);
+
 #endif
 
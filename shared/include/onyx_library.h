@@ -44,6 +44,16 @@ typedef struct OnyxRuntime {
     void (*wasm_instance_delete)(wasm_instance_t *instance);
 
     wasm_store_t *wasm_store;
+
+    // This is only set when using the OVMwasm runtime. It creates an instance that shares
+    // everything with the given instance except for its execution state, which is much
+    // cheaper than instantiating the module again for every thread.
+    wasm_instance_t *(*wasm_instance_new_thread)(wasm_instance_t *instance);
+
+    // Set when the linear memory is a host mapping that parts of can be replaced
+    // with file mappings. This is only the case for the OVMwasm runtime, which
+    // reserves the whole address space up front.
+    int wasm_memory_host_mapped;
 } OnyxRuntime;
 
 OnyxRuntime* runtime;